@@ -0,0 +1,73 @@
+
+#
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+#
+# Optional fast codecs for TPP data compression. Libraries found are
+# appended to libz_lib, so every target that links libz for TPP
+# compression picks them up as well.
+#
+AC_DEFUN([PBS_AC_WITH_FAST_COMPRESSION],
+[
+  AC_ARG_WITH([lz4],
+    AS_HELP_STRING([--with-lz4],
+      [Build LZ4 support for TPP data compression (default: if found).]
+    )
+  )
+  AC_ARG_WITH([zstd],
+    AS_HELP_STRING([--with-zstd],
+      [Build zstd support for TPP data compression (default: if found).]
+    )
+  )
+  AS_IF([test "x$with_lz4" != "xno"],
+    [AC_CHECK_HEADER([lz4frame.h],
+      [AC_CHECK_LIB([lz4], [LZ4F_compressFrame],
+        [libz_lib="$libz_lib -llz4"
+         AC_DEFINE([PBS_HAVE_LZ4], [], [Defined when liblz4 is available])])])
+     AS_IF([test "x$with_lz4" = "xyes" -a "x$ac_cv_lib_lz4_LZ4F_compressFrame" != "xyes"],
+       AC_MSG_ERROR([liblz4 requested but not found.]))]
+  )
+  AS_IF([test "x$with_zstd" != "xno"],
+    [AC_CHECK_HEADER([zstd.h],
+      [AC_CHECK_LIB([zstd], [ZSTD_compress_usingCDict],
+        [libz_lib="$libz_lib -lzstd"
+         AC_DEFINE([PBS_HAVE_ZSTD], [], [Defined when libzstd is available])])])
+     AS_IF([test "x$with_zstd" = "xyes" -a "x$ac_cv_lib_zstd_ZSTD_compress_usingCDict" != "xyes"],
+       AC_MSG_ERROR([libzstd requested but not found.]))]
+  )
+])
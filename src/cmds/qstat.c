@@ -2323,7 +2323,10 @@ main(int argc, char **argv, char **envp) /* qstat */
 	char *conflict = "qstat: conflicting options.\n";
 	char *pc;
 	int located = FALSE;
-	char extend[4];
+	char extend[256];
+	char *sort_key = NULL;
+	char *page_limit = NULL;
+	char *page_offset = NULL;
 	int wide = 0;
 	int format = 0;
 	time_t timenow;
@@ -2369,12 +2372,12 @@ main(int argc, char **argv, char **envp) /* qstat */
 
 #if !defined(PBS_NO_POSIX_VIOLATION)
 #ifdef NAS /* localmod 071 */
-#define GETOPT_ARGS "aeinpqrstwxu:fGHJMQEBW:T1"
+#define GETOPT_ARGS "aeinpqrstwxu:fGHJMQEBW:T1k:m:c:"
 #else
-#define GETOPT_ARGS "ainpqrstwxu:fGHJMQEBW:T1F:D:"
+#define GETOPT_ARGS "ainpqrstwxu:fGHJMQEBW:T1F:D:k:m:c:"
 #endif /* localmod 071 */
 #else
-#define GETOPT_ARGS "fQBW:"
+#define GETOPT_ARGS "fQBW:k:m:c:"
 #endif /* PBS_NO_POSIX_VIOLATION */
 
 	/*test for real deal or just version and exit*/
@@ -2536,6 +2539,25 @@ main(int argc, char **argv, char **envp) /* qstat */
 				display_attribs = NULL; /* get all attributes */
 				break;
 
+			case 'k':
+				/* order jobs by this attribute in the server */
+				sort_key = optarg;
+				break;
+
+			case 'm':
+				/* return at most this many jobs */
+				if (strspn(optarg, "0123456789") != strlen(optarg) || atol(optarg) <= 0)
+					errflg++;
+				page_limit = optarg;
+				break;
+
+			case 'c':
+				/* skip this many jobs, e.g. the ones of previous pages */
+				if (*optarg == '\0' || strspn(optarg, "0123456789") != strlen(optarg))
+					errflg++;
+				page_offset = optarg;
+				break;
+
 			case 'B':
 				B_opt = 1;
 				mode = SERVERS;
@@ -2706,14 +2728,38 @@ main(int argc, char **argv, char **envp) /* qstat */
 			errflg++;
 		}
 	}
+	if (sort_key != NULL && (alt_opt & ALT_DISPLAY_T)) {
+		fprintf(stderr, "%s", conflict);
+		errflg++;
+	}
 #endif /* PBS_NO_POSIX_VIOLATION */
 
+	/*
+	 * ordering and paging is done by the server, passed as options after
+	 * the flag letters of the extend, see EXTEND_OPT_SORT in libpbs.h
+	 */
+	if (sort_key != NULL || page_limit != NULL || page_offset != NULL) {
+		size_t len = strlen(extend);
+
+		if ((sort_key != NULL && strchr(sort_key, ':') != NULL) || (B_opt || Q_opt))
+			errflg++;
+		if (sort_key != NULL)
+			len += snprintf(extend + len, sizeof(extend) - len, "%s%s", EXTEND_OPT_SORT, sort_key);
+		if (page_limit != NULL && len < sizeof(extend))
+			len += snprintf(extend + len, sizeof(extend) - len, "%s%s", EXTEND_OPT_LIMIT, page_limit);
+		if (page_offset != NULL && len < sizeof(extend))
+			len += snprintf(extend + len, sizeof(extend) - len, "%s%s", EXTEND_OPT_OFFSET, page_offset);
+		if (len >= sizeof(extend))
+			errflg++;
+	}
+
 	if (errflg) {
 		static char usag2[] = "qstat --version\n";
 		static char usage[] = "usage: \n\
-qstat [-f] [-J] [-p] [-t] [-x] [-E] [-F format | -w] [-D delim] [ job_identifier... | destination... ]\n\
+qstat [-f] [-J] [-p] [-t] [-x] [-E] [-F format | -w] [-D delim]\n\
+\t[-k [-]attribute] [-m count] [-c offset] [ job_identifier... | destination... ]\n\
 qstat [-a|-i|-r|-H|-T] [-J] [-t] [-u user] [-n] [-s] [-G|-M] [-1] [-w]\n\
-\t[ job_identifier... | destination... ]\n\
+\t[-k [-]attribute] [-m count] [-c offset] [ job_identifier... | destination... ]\n\
 qstat -Q [-f] [-F format] [-D delim] [ destination... ]\n\
 qstat -q [-G|-M] [ destination... ]\n\
 qstat -B [-f] [-F format] [-D delim] [ server_name... ]\n";
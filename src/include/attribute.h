@@ -180,6 +180,7 @@ union attr_val {		       /* the attribute value	*/
 struct attribute {
 	unsigned int at_flags : ATRVFLAG; /* attribute flags	*/
 	unsigned int at_type : ATRVTYPE;  /* type of attribute    */
+	unsigned int at_rindex;		  /* ATR_TYPE_RESC: handle of its resource index, 0 if none */
 	svrattrl *at_user_encoded;	  /* encoded svrattrl form for users*/
 	svrattrl *at_priv_encoded;	  /* encoded svrattrl form for mgr/op*/
 	union attr_val at_val;		  /* the attribute value	*/
@@ -363,6 +364,7 @@ extern int decode_l(attribute *patr, char *name, char *rn, char *val);
 extern int decode_ll(attribute *patr, char *name, char *rn, char *val);
 extern int decode_size(attribute *patr, char *name, char *rn, char *val);
 extern int decode_str(attribute *patr, char *name, char *rn, char *val);
+extern int decode_istr(attribute *patr, char *name, char *rn, char *val);
 extern int decode_jobname(attribute *patr, char *name, char *rn, char *val);
 extern int decode_time(attribute *patr, char *name, char *rn, char *val);
 extern int decode_arst(attribute *patr, char *name, char *rn, char *val);
@@ -420,6 +422,7 @@ extern int set_l(attribute *attr, attribute *nattr, enum batch_op);
 extern int set_ll(attribute *attr, attribute *nattr, enum batch_op);
 extern int set_size(attribute *attr, attribute *nattr, enum batch_op);
 extern int set_str(attribute *attr, attribute *nattr, enum batch_op);
+extern int set_istr(attribute *attr, attribute *nattr, enum batch_op);
 extern int set_arst(attribute *attr, attribute *nattr, enum batch_op);
 extern int set_arst_uniq(attribute *attr, attribute *nattr, enum batch_op);
 extern int set_resc(attribute *attr, attribute *nattr, enum batch_op);
@@ -439,6 +442,7 @@ extern int comp_ll(attribute *attr, attribute *with);
 extern int comp_size(attribute *attr, attribute *with);
 extern void from_size(const struct size_value *, char *);
 extern int comp_str(attribute *attr, attribute *with);
+extern int comp_istr(attribute *attr, attribute *with);
 extern int comp_arst(attribute *attr, attribute *with);
 extern int comp_resc(attribute *attr, attribute *with);
 extern int comp_unkn(attribute *attr, attribute *with);
@@ -454,6 +458,7 @@ extern int at_non_zero_time(attribute *attr, void *pobj, int mode);
 extern int set_log_events(attribute *pattr, void *pobject, int actmode);
 
 extern void free_str(attribute *attr);
+extern void free_istr(attribute *attr);
 extern void free_arst(attribute *attr);
 extern void free_entlim(attribute *attr);
 extern void free_resc(attribute *attr);
@@ -626,6 +631,8 @@ char get_attr_c(const attribute *pattr);
 long get_attr_l(const attribute *pattr);
 long long get_attr_ll(const attribute *pattr);
 char *get_attr_str(const attribute *pattr);
+extern char *istr_get(const char *str);
+extern void istr_put(char *str);
 struct array_strings *get_attr_arst(const attribute *pattr);
 int is_attr_set(const attribute *pattr);
 attribute *_get_attr_by_idx(attribute *list, int attr_idx);
@@ -207,6 +207,10 @@ extern void DIS_tcp_funcs();
 #define DIS_WRITE_BUF 0
 #define DIS_READ_BUF 1
 
+/* integer encodings of a channel, text is the default and what old peers speak */
+#define DIS_ENC_TEXT 0
+#define DIS_ENC_BINARY 1
+
 typedef struct pbs_dis_buf {
 	size_t tdis_bufsize;
 	size_t tdis_len;
@@ -224,6 +228,7 @@ typedef struct pbs_tcp_chan {
 	pbs_dis_buf_t readbuf;
 	pbs_dis_buf_t writebuf;
 	int is_old_client; /* This is just for backward compatibility */
+	int encoding;	   /* DIS_ENC_* used for integers, negotiated per connection */
 	pbs_tcp_auth_data_t auths[2];
 } pbs_tcp_chan_t;
 
@@ -234,7 +239,11 @@ int dis_getc(int);
 int dis_gets(int, char *, size_t);
 int dis_puts(int, const char *, size_t);
 int dis_flush(int);
+char *dis_take_writebuf(int, size_t *);
+int dis_flush_scatter(int, int, char **, size_t *);
 void dis_setup_chan(int, pbs_tcp_chan_t *(*) (int) );
+void dis_set_encoding(int, int);
+int dis_get_encoding(int);
 void dis_destroy_chan(int);
 
 void transport_chan_set_ctx_status(int, int, int);
@@ -250,6 +259,10 @@ extern pbs_tcp_chan_t *(*pfn_transport_get_chan)(int);
 extern int (*pfn_transport_set_chan)(int, pbs_tcp_chan_t *);
 extern int (*pfn_transport_recv)(int, void *, int);
 extern int (*pfn_transport_send)(int, void *, int);
+/* optional, hands a malloc'ed buffer over to the transport (NULLs it if taken) */
+extern int (*pfn_transport_send_buf)(int, void **, int);
+/* optional, sends a body shared by all members of a multicast channel behind per member headers */
+extern int (*pfn_transport_send_scatter)(int, void *, unsigned int, void **, unsigned int *);
 
 #define transport_recv(x, y, z) (*pfn_transport_recv)(x, y, z)
 #define transport_send(x, y, z) (*pfn_transport_send)(x, y, z)
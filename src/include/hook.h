@@ -315,6 +315,18 @@ typedef struct hook hook;
 #define FMT_HOOK_RESCDEF_COPY "%s" FMT_HOOK_PREFIX "resourcedef.%s"
 #define FMT_HOOK_LOG "%s" FMT_HOOK_PREFIX "log%d"
 
+/*
+ * Hook executor: a pbs_python process started with HOOK_EXECUTOR_MODE that
+ * keeps the interpreter and compiled hook scripts loaded.  A request on its
+ * socket (created in the hooks work directory) is a 32-bit length in host
+ * order, followed by that many bytes of NUL-terminated strings:
+ *	<working directory> <hook config file or ""> <pbs_python --hook args>...
+ * The reply is the int wait status of the process that ran the hook.
+ */
+#define HOOK_EXECUTOR_MODE "--hook-executor"
+#define HOOK_EXECUTOR_SOCK "executor.sock"
+#define HOOK_EXECUTOR_MAXREQ 65536
+
 /* Special log levels  - values must not intersect PBS_EVENT* values in log.h */
 
 #define SEVERITY_LOG_DEBUG 0x0005   /* syslog DEBUG */
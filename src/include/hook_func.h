@@ -99,6 +99,8 @@ extern void add_pending_mom_hook_action(void *minfo, char *, unsigned int);
 
 extern void delete_pending_mom_hook_action(void *minfo, char *, unsigned int);
 
+extern void drop_synced_mom_hook_action(void *minfo, char *, unsigned int);
+
 extern void add_pending_mom_allhooks_action(void *minfo, unsigned int);
 
 extern int has_pending_mom_action_delete(char *);
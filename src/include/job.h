@@ -314,6 +314,26 @@ typedef struct noderes {
 	enum PBS_NodeRes_Status nr_status;
 } noderes;
 
+/*
+ * Fanout tree state of a wide multi-node job, see $sister_tree_fanout.
+ * Node i reports to node (i-1)/st_fanout, node 0 being Mother Superior.
+ */
+typedef struct sister_tree {
+	int st_fanout;		 /* children per node, sent as the IM taskid */
+	int st_joinwait;	 /* children whose subtree has not joined */
+	int st_joinsent;	 /* subtree join already sent to parent */
+	int st_nnodes;		 /* number of entries in st_nodes */
+	tm_node_id *st_nodes;	 /* joined nodes of this subtree */
+	int st_pollwait;	 /* children yet to answer the current poll */
+	int st_pollstream;	 /* stream of the pending poll, -1 if none */
+	tm_event_t st_pollevent; /* event of the pending poll */
+	int st_pollkill;	 /* kill recommendation of this subtree */
+	u_long st_cput;		 /* cput of this subtree */
+	u_long st_mem;		 /* mem of this subtree */
+	u_long st_cpupct;	 /* cpupercent of this subtree */
+	pbs_list_head *st_used;	 /* hook resources_used by host index */
+} sister_tree_t;
+
 /* State for a sister */
 
 #define SISTER_OKAY 0
@@ -329,6 +349,12 @@ typedef struct noderes {
 #define MOM_NO_PROC 0x0008	  /* no procs found for job */
 #define MOM_RESTART_ACTIVE 0x0010 /* restart in progress */
 
+/* job flags for ji_jnlflags (mom only), see job_recov_fs.c */
+
+#define JOB_JNL_FILE 0x0001 /* job file has been written at least once */
+#define JOB_JNL_FULL 0x0002 /* journal holds a full image newer than the file */
+#define JOB_JNL_PEND 0x0004 /* job or task records journaled since checkpoint */
+
 #define PBS_MAX_POLL_DOWNTIME 300 /* 5 minutes by default */
 #endif				  /* MOM */
 
@@ -450,6 +476,7 @@ struct job {
 	int ji_parent2child_job_update_status_pipe; /* write pipe for parent mom to send job update status to child starter process */
 	int ji_parent2child_moms_status_pipe;	    /* write pipe for parent mom to send sister moms status to child starter process */
 	int ji_updated;				    /* set to 1 if job's node assignment was updated */
+	int ji_jnlflags;			    /* state journal flags, JOB_JNL_* */
 	time_t ji_walltime_stamp;		    /* time stamp for accumulating walltime */
 	struct work_task *ji_bg_hook_task;
 	struct work_task *ji_report_task;
@@ -458,6 +485,7 @@ struct job {
 #else				 /* not WIN32 */
 	pid_t ji_momsubt; /* pid of mom subtask   */
 #endif				 /* WIN32 */
+	double ji_launch_start;	 /* when the job starter was forked, msecs */
 	struct var_table ji_env; /* environment for the job */
 	/* ptr to post processing func  */
 	void (*ji_mompost)(struct job *, int);
@@ -470,6 +498,7 @@ struct job {
 	hnodent *ji_hosts;		   /* ptr to job host management stuff */
 	vmpiprocs *ji_vnods;		   /* ptr to job vnode management stuff */
 	noderes *ji_resources;		   /* ptr to array of node resources */
+	sister_tree_t *ji_tree;		   /* fanout tree state, wide jobs only */
 	vmpiprocs *ji_assn_vnodes;	   /* ptr to actual assigned vnodes (for hooks) */
 	pbs_list_head ji_tasks;		   /* list of task structs */
 	pbs_list_head ji_failed_node_list; /* list of mom nodes which fail to join job */
@@ -742,6 +771,7 @@ typedef struct infoent {
 #define IM_PMIX 26
 #define IM_RECONNECT_TO_MS 27
 #define IM_JOIN_RECOV_JOB 28
+#define IM_JOIN_TREE 29 /* join acks aggregated up the sister tree */
 
 #define IM_ERROR 99
 #define IM_ERROR2 100
@@ -1062,6 +1092,11 @@ attribute *get_jattr(const job *pjob, int attr_idx);
 
 extern job *job_recov_fs(char *);
 extern int job_save_fs(job *);
+extern int job_journal_task(pbs_task *);
+extern void job_journal_purge(job *);
+extern void job_journal_stamp(int);
+extern void job_journal_replay(void);
+extern void job_journal_checkpoint(int);
 
 #define job_save job_save_fs
 #define job_recov job_recov_fs
@@ -66,6 +66,8 @@ extern "C" {
 #define PBS_BATCH_PROT_TYPE 2
 #define PBS_BATCH_PROT_VER_OLD 1
 #define PBS_BATCH_PROT_VER 2
+/* extend token of the Authenticate request, offers binary integers (DIS_ENC_BINARY) */
+#define PBS_EXTEND_DIS_BINARY "dis_binary"
 #define SCRIPT_CHUNK_Z (65536)
 #ifndef TRUE
 #define TRUE 1
@@ -318,6 +320,10 @@ struct batch_reply {
 #define EXTEND_OPT_IMPLICIT_COMMIT ":C:" /* option added to pbs_submit() extend parameter to request implicit commit */
 #define EXTEND_OPT_NEXT_MSG_TYPE "next_msg_type"
 #define EXTEND_OPT_NEXT_MSG_PARAM "next_msg_param"
+/* options added after any flag letters to the extend of pbs_statjob() and pbs_selstat() */
+#define EXTEND_OPT_SORT ":sort="     /* order jobs by attribute[.resource], a leading '-' for descending */
+#define EXTEND_OPT_LIMIT ":limit="   /* return at most this many jobs */
+#define EXTEND_OPT_OFFSET ":offset=" /* skip this many matching jobs, the cursor of the next page */
 
 int is_compose(int, int);
 int is_compose_cmd(int, int, char **);
@@ -85,6 +85,29 @@ extern char pbs_jobdir_root[];
 extern int pbs_jobdir_root_shared;
 #define JOBDIR_DEFAULT "PBS_USER_HOME"
 
+/* used by mom_main.c and mom_mach.c for $cgroup_sample_root */
+extern char cgroup_sample_root[];
+
+/* used by mom_main.c and job_recov_fs.c for $job_state_journal */
+extern int mom_job_journal;
+
+/* used by mom_main.c and mom_hook_func.c for $hook_executor */
+extern int mom_hook_executor;
+
+/* $cgroup_manager, see linux/mom_cgroup.c */
+extern int mom_cgroup_manager;
+extern int cgroup_job_create(job *pjob);
+extern int cgroup_job_attach(job *pjob);
+extern void cgroup_job_remove(job *pjob);
+extern int cgroup_job_dir(job *pjob, char *buf, size_t len);
+
+/* $sister_tree_fanout, see mom_comm.c */
+extern int sister_tree_fanout;
+extern tm_task_id sister_tree_setup(job *pjob);
+extern int sister_tree_children(job *pjob, int idx, int *first);
+extern int send_sisters_tree(job *pjob, int com);
+extern void sister_tree_free(job *pjob);
+
 /* test bits */
 #define PBSQA_DELJOB_SLEEP 1
 #define PBSQA_DELJOB_CRASH 2
@@ -219,6 +242,7 @@ extern void update_jobs_status(void);
 extern void calc_cpupercent(job *, unsigned long, unsigned long, time_t);
 extern void dorestrict_user(void);
 extern int task_save(pbs_task *ptask);
+extern int task_write(pbs_task *ptask);
 extern void send_join_job_restart(int, eventent *, int, job *, pbs_list_head *);
 extern int send_resc_used_to_ms(int stream, job *pjob);
 extern int recv_resc_used_from_sister(int stream, job *pjob, int nodeidx);
@@ -333,6 +357,11 @@ extern int is_child_path(char *, char *);
 extern int pbs_glob(char *, char *);
 extern void rmjobdir(char *, char *, uid_t, gid_t, int);
 extern int stage_file(int, int, char *, struct rqfpair *, int, cpy_files *, char *, char *);
+#ifndef WIN32
+/* $stage_workers, see stage_func.c */
+extern int stage_workers;
+extern int stage_files(int, char *, pbs_list_head *, int, cpy_files *, char *, int *);
+#endif
 #ifdef WIN32
 extern int mktmpdir(char *, char *);
 extern int mkjobdir(char *, char *, char *, HANDLE login_handle);
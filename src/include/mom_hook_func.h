@@ -204,6 +204,9 @@ extern void vna_list_free(pbs_list_head);
 extern void mom_hook_input_init(mom_hook_input_t *hook_input);
 extern void mom_hook_output_init(mom_hook_output_t *hook_output);
 extern void send_hook_fail_action(hook *);
+#ifndef WIN32
+extern void hook_executor_stop(void);
+#endif
 
 #ifdef __cplusplus
 }
@@ -47,6 +47,7 @@ extern "C" {
 
 #define PBS_IDX_DUPS_OK 0x01   /* duplicate key allowed in index */
 #define PBS_IDX_ICASE_CMP 0x02 /* set case-insensitive compare */
+#define PBS_IDX_HASH 0x04      /* hash table, iterated in no particular order */
 
 #define PBS_IDX_RET_OK 0    /* index op succeed */
 #define PBS_IDX_RET_FAIL -1 /* index op failed */
@@ -55,7 +56,8 @@ extern "C" {
  * @brief
  *	Create an empty index
  *
- * @param[in] - dups   - Whether duplicates are allowed or not in index
+ * @param[in] - dups   - Whether duplicates are allowed or not in index,
+ *			 and other PBS_IDX_* flags
  * @param[in] - keylen - length of key in index (can be 0 for default size)
  *
  * @return void *
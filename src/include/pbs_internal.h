@@ -243,6 +243,12 @@ struct pbs_config
 	char *pbs_mom_node_name;	/* mom short name used for natural node, default NULL */
 	unsigned int pbs_log_highres_timestamp; /* high resolution logging */
 	unsigned int pbs_sched_threads;	/* number of threads for scheduler */
+	unsigned int pbs_use_io_uring;	/* use io_uring for event monitoring, if built in */
+	unsigned int pbs_leaf_router_hash; /* order leaf's pbs_comms by consistent hash */
+	char *pbs_compression_codec;	/* codec used to compress TPP data: zlib, lz4 or zstd */
+	char *pbs_compression_dict;	/* zstd dictionary for TPP data compression */
+	unsigned int pbs_mcast_scatter;	/* pbs_comms can split scatter multicast packets */
+	unsigned int pbs_comm_multipath; /* pbs_comm spreads streams over all routes to a leaf */
 	char *pbs_daemon_service_user; /* user the scheduler runs as */
 	char *pbs_daemon_service_auth_user; /* auth user the scheduler runs as */
 	char current_user[PBS_MAXUSER+1]; /* current running user */
@@ -310,6 +316,12 @@ extern struct pbs_config pbs_conf;
 #define PBS_CONF_MOM_NODE_NAME	"PBS_MOM_NODE_NAME"
 #define PBS_CONF_LOG_HIGHRES_TIMESTAMP	"PBS_LOG_HIGHRES_TIMESTAMP"
 #define PBS_CONF_SCHED_THREADS	"PBS_SCHED_THREADS"
+#define PBS_CONF_USE_IO_URING	"PBS_USE_IO_URING"
+#define PBS_CONF_LEAF_ROUTER_HASH	"PBS_LEAF_ROUTER_HASH"
+#define PBS_CONF_COMPRESSION_CODEC	"PBS_COMPRESSION_CODEC"
+#define PBS_CONF_COMPRESSION_DICT	"PBS_COMPRESSION_DICT"
+#define PBS_CONF_MCAST_SCATTER	"PBS_MCAST_SCATTER"
+#define PBS_CONF_COMM_MULTIPATH	"PBS_COMM_MULTIPATH"
 #define PBS_CONF_DAEMON_SERVICE_USER "PBS_DAEMON_SERVICE_USER"
 #define PBS_CONF_DAEMON_SERVICE_AUTH_USER "PBS_DAEMON_SERVICE_AUTH_USER"
 #ifdef WIN32
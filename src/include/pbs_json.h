@@ -59,6 +59,19 @@ int pbs_json_insert_parsed(json_data *parent, char *key, char *value, int ignore
 int pbs_json_print(json_data *data, FILE *stream);
 void pbs_json_delete(json_data *data);
 
+json_data *pbs_json_parse(const char *text);
+json_data *pbs_json_get_item(json_data *obj, const char *key);
+int pbs_json_get_bool(json_data *obj, const char *key, int dflt);
+double pbs_json_get_number(json_data *obj, const char *key, double dflt);
+char *pbs_json_get_string(json_data *obj, const char *key);
+int pbs_json_array_size(json_data *array);
+json_data *pbs_json_array_item(json_data *array, int index);
+char *pbs_json_string_value(json_data *item);
+int pbs_json_number_value(json_data *item, double *value);
+int pbs_json_merge(json_data *dst, json_data *src);
+int pbs_json_object_size(json_data *obj);
+int pbs_json_dumps(json_data *data, char **buf, size_t *size, size_t offset);
+
 #ifdef __cplusplus
 }
 #endif
@@ -80,3 +80,4 @@ struct config {
 
 extern char *arch(struct rm_attribute *);
 extern char *physmem(struct rm_attribute *);
+extern char *launch_latency(struct rm_attribute *);
@@ -106,6 +106,7 @@ typedef struct resource_def {
 	unsigned int rs_entlimflg;	  /* tracking entity limits for this  */
 	struct resource_def *rs_next;
 	unsigned int rs_custom; /* bit flag to indicate custom resource or builtin */
+	unsigned int rs_index;	/* slot in resource list indexes, 0 until first indexed */
 } resource_def;
 
 struct resc_sum {
@@ -129,6 +130,8 @@ extern int svr_resc_size;	   /* size (num elements) in above  */
 extern int svr_resc_unk;	   /* index to "unknown" resource   */
 
 extern resource *add_resource_entry(attribute *, resource_def *);
+extern void drop_resc_index(attribute *);
+extern void unlink_resc_entry(attribute *, resource *);
 extern int cr_rescdef_idx(resource_def *resc_def, int limit);
 extern resource_def *find_resc_def(resource_def *, char *);
 extern resource *find_resc_entry(const attribute *, resource_def *);
@@ -382,9 +382,37 @@ struct stat_cntl {
 	char sc_jobid[PBS_MAXSVRJOBID + 1];
 };
 
+/* a job collected for sorting, carries the paging control for the compare */
+typedef struct stat_page_ent {
+	job *se_job;		  /* matching job */
+	struct stat_page *se_page; /* paging control holding the sort key */
+} stat_page_ent_t;
+
+/* server side ordering and paging of a job status, see parse_stat_page() */
+typedef struct stat_page {
+	int sp_active;		     /* any of sort, limit or offset given */
+	int sp_sort_idx;	     /* job attribute to sort by, -1 if not sorting */
+	resource_def *sp_sort_rdef;  /* resource of that attribute to sort by, if any */
+	int sp_sort_desc;	     /* sort in descending order */
+	long sp_limit;		     /* max entries to return, 0 for no limit */
+	long sp_offset;		     /* matching entries to skip */
+	long sp_seen;		     /* matching entries passed so far */
+	long sp_taken;		     /* entries returned so far */
+	stat_page_ent_t *sp_jobs;    /* matching jobs collected for sorting */
+	int sp_njobs;
+	int sp_size;
+} stat_page_t;
+
 extern int status_job(job *, struct batch_request *, svrattrl *, pbs_list_head *, int *, int);
 extern int status_subjob(job *, struct batch_request *, svrattrl *, int, pbs_list_head *, int *, int);
 extern int stat_to_mom(job *, struct stat_cntl *);
+extern int stat_extend_flag(char *, int);
+extern int parse_stat_page(char *, int, stat_page_t *);
+extern int stat_page_add(stat_page_t *, job *);
+extern void stat_page_sort(stat_page_t *);
+extern int stat_page_admit(stat_page_t *);
+extern int stat_page_full(stat_page_t *);
+extern void free_stat_page(stat_page_t *);
 
 #endif /* STAT_CNTL */
 #ifdef __cplusplus
@@ -108,6 +108,10 @@ struct tpp_config {
 	int numthreads;
 	char *node_name; /* list of comma separated node names */
 	int compress;
+	int compress_codec;  /* codec used to compress data, TPP_COMPR_ZLIB etc */
+	char *compress_dict; /* zstd dictionary file, NULL if none */
+	int mcast_scatter;   /* all pbs_comms understand scatter multicast packets */
+	int multipath;	     /* pbs_comm spreads streams over all routes to a leaf */
 	int tcp_keepalive; /* use keepalive? */
 	int tcp_keep_idle;
 	int tcp_keep_intvl;
@@ -126,6 +130,8 @@ extern int set_tpp_config(struct pbs_config *, struct tpp_config *, char *, int,
 extern void free_tpp_config(struct tpp_config *);
 extern void DIS_tpp_funcs();
 extern int tpp_open(char *, unsigned int);
+extern int tpp_send(int, void *, int);
+extern int tpp_recv(int, void *, int);
 extern int tpp_close(int);
 extern int tpp_eom(int);
 extern int tpp_bind(unsigned int);
@@ -143,6 +149,7 @@ extern int tpp_mcast_open(void);
 extern int tpp_mcast_add_strm(int, int, bool);
 extern int *tpp_mcast_members(int, int *);
 extern int tpp_mcast_send(int, void *, unsigned int, unsigned int);
+extern int tpp_mcast_send_scatter(int, void *, unsigned int, void **, unsigned int *);
 extern int tpp_mcast_close(int);
 
 /**********************************************************************/
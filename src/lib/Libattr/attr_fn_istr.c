@@ -0,0 +1,324 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+
+#include <pbs_config.h> /* the master config generated by configure */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pbs_ifl.h"
+#include "list_link.h"
+#include "attribute.h"
+#include "pbs_error.h"
+#include "pbs_idx.h"
+
+/**
+ * @file	attr_fn_istr.c
+ * @brief
+ * 	This file contains functions for manipulating attributes of type string
+ *	whose values are interned.
+ *
+ * @details
+ *	Values such as queue names, user, group, account and project names are
+ *	carried by thousands of jobs and nodes. Attributes using this set of
+ *	functions hold a reference to a single shared, refcounted copy of each
+ *	distinct value instead of a private copy, and two such values are equal
+ *	when their pointers are.
+ *
+ *	The value is still a plain "char *" in at_val.at_str, so it is read and
+ *	encoded exactly like an ATR_TYPE_STR attribute (encode_str is shared).
+ *	It must never be modified in place or released with free(); that is
+ *	left to set_istr() and free_istr(). A value that was not interned, e.g.
+ *	one set by decode_str() for an indirect resource, is tolerated and freed
+ *	as usual.
+ *
+ * -------------------------------------------------
+ * Set of general attribute functions for attributes
+ * with value type "interned string"
+ * -------------------------------------------------
+ */
+
+typedef struct istr {
+	unsigned long is_refct; /* number of values referencing the string */
+	char is_str[1];		/* the string, is also the key in istr_idx */
+} istr_t;
+
+static void *istr_idx = NULL; /* index of interned strings, by string */
+
+/**
+ * @brief
+ * 	istr_get - get a reference to the interned copy of a string, the copy
+ *	is created if the string is not interned yet
+ *
+ * @param[in] str - string to intern
+ *
+ * @return	char *
+ * @retval	the interned string, to be released with istr_put()
+ * @retval	NULL	out of memory
+ *
+ * @par MT-safe: No
+ */
+char *
+istr_get(const char *str)
+{
+	istr_t *pis = NULL;
+	void *key = (void *) str;
+	size_t len;
+
+	if (istr_idx == NULL && (istr_idx = pbs_idx_create(PBS_IDX_HASH, 0)) == NULL)
+		return strdup(str);
+
+	if (pbs_idx_find(istr_idx, &key, (void **) &pis, NULL) == PBS_IDX_RET_OK) {
+		pis->is_refct++;
+		return pis->is_str;
+	}
+
+	len = strlen(str);
+	if ((pis = malloc(sizeof(istr_t) + len)) == NULL)
+		return NULL;
+	pis->is_refct = 1;
+	memcpy(pis->is_str, str, len + 1);
+	if (pbs_idx_insert(istr_idx, pis->is_str, pis) != PBS_IDX_RET_OK) {
+		free(pis);
+		return strdup(str); /* a private copy, see istr_put() */
+	}
+	return pis->is_str;
+}
+
+/**
+ * @brief
+ * 	istr_put - release a reference obtained from istr_get(), the interned
+ *	copy is freed with its last reference
+ *
+ * @param[in] str - string returned by istr_get(), or any malloc-ed string
+ *
+ * @return	void
+ *
+ * @par MT-safe: No
+ */
+void
+istr_put(char *str)
+{
+	istr_t *pis = NULL;
+	void *key = str;
+
+	if (str == NULL)
+		return;
+
+	if (istr_idx == NULL ||
+	    pbs_idx_find(istr_idx, &key, (void **) &pis, NULL) != PBS_IDX_RET_OK ||
+	    pis->is_str != str) {
+		/* not the interned copy, a private one */
+		free(str);
+		return;
+	}
+	if (--pis->is_refct == 0) {
+		pbs_idx_delete(istr_idx, pis->is_str);
+		free(pis);
+	}
+}
+
+/**
+ * @brief
+ * 	decode_istr - decode string into interned string attribute
+ *
+ * @param[in] patr - ptr to attribute to decode
+ * @param[in] name - attribute name
+ * @param[in] rescn - resource name or null
+ * @param[out] val - string holding values for attribute structure
+ *
+ * @retval      int
+ * @retval      0       if ok
+ * @retval      >0      error number1 if error,
+ * @retval      *patr   members set
+ *
+ */
+
+int
+decode_istr(attribute *patr, char *name, char *rescn, char *val)
+{
+	if ((patr->at_flags & ATR_VFLAG_SET) && (patr->at_val.at_str))
+		istr_put(patr->at_val.at_str);
+
+	if ((val != NULL) && (*val != '\0')) {
+		patr->at_val.at_str = istr_get(val);
+		if (patr->at_val.at_str == NULL) {
+			ATR_UNSET(patr);
+			return (PBSE_SYSTEM);
+		}
+		post_attr_set(patr);
+	} else {
+		ATR_UNSET(patr);
+		patr->at_val.at_str = NULL;
+	}
+	return (0);
+}
+
+/**
+ * @brief
+ * 	set_istr - set interned string attribute value based upon another
+ *
+ *	A+B --> B is concatenated to end of A
+ *	A=B --> A is replaced with B
+ *	A-B --> If B is a substring at the end of A, it is stripped off
+ *
+ *	The result is interned, A's old value is released.
+ *
+ * @param[in]   attr - pointer to new attribute to be set (A)
+ * @param[in]   new  - pointer to attribute (B)
+ * @param[in]   op   - operator
+ *
+ * @return      int
+ * @retval      0       if ok
+ * @retval     >0       if error
+ *
+ */
+
+int
+set_istr(attribute *attr, attribute *new, enum batch_op op)
+{
+	char *old = attr->at_val.at_str;
+	char *buf = NULL;
+	char *result;
+	char *p;
+	size_t nsize;
+
+	assert(attr && new &&new->at_val.at_str && (new->at_flags &ATR_VFLAG_SET));
+	nsize = strlen(new->at_val.at_str); /* length of new string */
+	if ((op == INCR) && !old)
+		op = SET; /* no current string, change INCR to SET */
+
+	switch (op) {
+
+		case SET: /* set is replace old string with new */
+
+			result = new->at_val.at_str;
+			break;
+
+		case INCR: /* INCR is concatenate new to old string */
+
+			if ((buf = malloc(strlen(old) + nsize + 1)) == NULL)
+				return (PBSE_SYSTEM);
+			strcpy(buf, old);
+			strcat(buf, new->at_val.at_str);
+			result = buf;
+			break;
+
+		case DECR: /* DECR is remove substring if match, start at end */
+
+			if (!old || nsize == 0)
+				return (0);
+			if ((buf = strdup(old)) == NULL)
+				return (PBSE_SYSTEM);
+			p = buf + strlen(buf) - nsize;
+			while (p >= buf) {
+				if (strncmp(p, new->at_val.at_str, nsize) == 0) {
+					do {
+						*p = *(p + nsize);
+					} while (*p++);
+				}
+				p--;
+			}
+			result = buf;
+			break;
+
+		default:
+			return (PBSE_INTERNAL);
+	}
+
+	if (*result != '\0') {
+		if ((attr->at_val.at_str = istr_get(result)) == NULL) {
+			attr->at_val.at_str = old;
+			free(buf);
+			return (PBSE_SYSTEM);
+		}
+		post_attr_set(attr);
+	} else {
+		attr->at_val.at_str = NULL;
+		attr->at_flags &= ~ATR_VFLAG_SET;
+	}
+	istr_put(old);
+	free(buf);
+
+	return (0);
+}
+
+/**
+ * @brief
+ * 	comp_istr - compare two attributes of type ATR_TYPE_STR, of which at
+ *	least the first holds an interned value
+ *
+ * @param[in] attr - pointer to attribute structure
+ * @param[in] with - pointer to attribute structure
+ *
+ * @return      int
+ * @retval      0       if the values are equal
+ * @retval      !0      otherwise, as strcmp()
+ *
+ */
+
+int
+comp_istr(attribute *attr, attribute *with)
+{
+	if (!attr || !attr->at_val.at_str)
+		return (-1);
+	if (attr->at_val.at_str == with->at_val.at_str)
+		return (0);
+	return (strcmp(attr->at_val.at_str, with->at_val.at_str));
+}
+
+/**
+ * @brief
+ * 	free_istr - release the interned value of a string attribute
+ *
+ * @param[in] attr - pointer to attribute structure
+ *
+ * @return	Void
+ *
+ */
+
+void
+free_istr(attribute *attr)
+{
+	if ((attr->at_flags & ATR_VFLAG_SET) && (attr->at_val.at_str))
+		istr_put(attr->at_val.at_str);
+	free_null(attr);
+	attr->at_val.at_str = NULL;
+}
@@ -94,6 +94,32 @@ int comp_resc_lt; /* count of resources compared < */
 int comp_resc_nc; /* count of resources not compared  */
 void *resc_attrdef_idx = NULL;
 
+/*
+ * Index of a long resource list, a vector of its entries keyed by the
+ * rs_index of their resource_def. It is built by find_resc_entry() once a
+ * walk of the list takes RESC_INDEX_MIN steps, kept up to date by
+ * add_resource_entry() and dropped by free_resc(). The attribute holds a
+ * handle (at_rindex) into resc_index_tbl, the index remembers its owner and
+ * the ends of the list so that a copied or moved attribute does not use it.
+ * Entries are taken out of a list with unlink_resc_entry(), which drops the
+ * index first: the ends alone cannot tell that an entry in the middle went
+ * away.
+ */
+#define RESC_INDEX_MIN 16
+
+typedef struct resc_index {
+	const attribute *ri_attr;    /* attribute the index belongs to */
+	pbs_list_link *ri_first;     /* first and last link of the list when */
+	pbs_list_link *ri_last;	     /* the index was last brought up to date */
+	unsigned int ri_nslots;	     /* number of entries in ri_slot */
+	resource *ri_slot[1];	     /* entry of rs_index n at [n - 1], or NULL */
+} resc_index_t;
+
+static resc_index_t **resc_index_tbl; /* indexed by at_rindex - 1 */
+static unsigned int resc_index_tblsz;
+static unsigned int resc_index_free;  /* hint, a free slot of resc_index_tbl is at or after it */
+static unsigned int resc_index_last;  /* last rs_index handed out */
+
 /**
  * @brief
  * 	decode_resc - decode a "attribute name/resource name/value" triplet into
@@ -152,9 +178,12 @@ decode_resc(attribute *patr, char *name, char *rescn, char *val)
 	post_attr_set(patr);
 
 	if ((resc_access_perm & ATR_PERM_ALLOW_INDIRECT) && (*val == '@')) {
-		if (strcmp(rescn, "ncpus") != 0)
+		if (strcmp(rescn, "ncpus") != 0) {
+			/* the direct value may be interned, let its type free it */
+			if ((prsc->rs_value.at_flags & ATR_VFLAG_INDIRECT) == 0)
+				prdef->rs_free(&prsc->rs_value);
 			rv = decode_str(&prsc->rs_value, name, rescn, val);
-		else
+		} else
 			rv = PBSE_BADNDATVAL;
 		if (rv == 0)
 			prsc->rs_value.at_flags |= ATR_VFLAG_INDIRECT;
@@ -435,6 +464,7 @@ free_resc(attribute *pattr)
 	if (!pattr)
 		return;
 
+	drop_resc_index(pattr);
 	pr = (resource *) GET_NEXT(pattr->at_val.at_list);
 	while (pr != NULL) {
 		next = (resource *) GET_NEXT(pr->rs_link);
@@ -471,7 +501,7 @@ cr_rescdef_idx(resource_def *resc_def, int limit)
 		return -1;
 
 	/* create the attribute index */
-	if ((resc_attrdef_idx = pbs_idx_create(PBS_IDX_ICASE_CMP, 0)) == NULL)
+	if ((resc_attrdef_idx = pbs_idx_create(PBS_IDX_HASH | PBS_IDX_ICASE_CMP, 0)) == NULL)
 		return -1;
 
 	/* add all attributes to the tree with key as the attr name */
@@ -508,6 +538,185 @@ find_resc_def(resource_def *resc_def, char *name)
 	return def;
 }
 
+/**
+ * @brief
+ * 	get_resc_index - get the index of a resource list attribute if it has
+ *	one and it still describes the list
+ *
+ * @param[in] pattr - pointer to attribute structure
+ *
+ * @return	resc_index_t *
+ * @retval	the index	if usable
+ * @retval	NULL		if none or out of date
+ *
+ * @par MT-safe: No
+ */
+static resc_index_t *
+get_resc_index(const attribute *pattr)
+{
+	resc_index_t *ri;
+
+	if (pattr->at_rindex == 0 || pattr->at_rindex > resc_index_tblsz)
+		return NULL;
+	ri = resc_index_tbl[pattr->at_rindex - 1];
+	if (ri == NULL || ri->ri_attr != pattr)
+		return NULL;
+	if (ri->ri_first != pattr->at_val.at_list.ll_next || ri->ri_last != pattr->at_val.at_list.ll_prior) {
+		/* list was changed behind our back, e.g. moved */
+		drop_resc_index((attribute *) pattr);
+		return NULL;
+	}
+	return ri;
+}
+
+/**
+ * @brief
+ * 	drop_resc_index - free the index of a resource list attribute, to be
+ *	called before its list is moved or rebuilt other than by free_resc()
+ *
+ * @param[in] pattr - pointer to attribute structure
+ *
+ * @return	void
+ *
+ * @par MT-safe: No
+ */
+void
+drop_resc_index(attribute *pattr)
+{
+	unsigned int h = pattr->at_rindex;
+
+	if (h == 0 || h > resc_index_tblsz)
+		return;
+	pattr->at_rindex = 0;
+	if (resc_index_tbl[h - 1] == NULL || resc_index_tbl[h - 1]->ri_attr != pattr)
+		return; /* a copy of an attribute, the index is not ours */
+	free(resc_index_tbl[h - 1]);
+	resc_index_tbl[h - 1] = NULL;
+	if (h - 1 < resc_index_free)
+		resc_index_free = h - 1;
+}
+
+/**
+ * @brief
+ * 	unlink_resc_entry - take an entry out of the resource list of an
+ *	attribute, dropping the index of the list.  The entry is not freed.
+ *
+ * @param[in] pattr - pointer to attribute structure
+ * @param[in] pr - the entry, linked into the list of pattr
+ *
+ * @return	void
+ *
+ * @par MT-safe: No
+ */
+void
+unlink_resc_entry(attribute *pattr, resource *pr)
+{
+	drop_resc_index(pattr);
+	delete_link(&pr->rs_link);
+}
+
+/**
+ * @brief
+ * 	build_resc_index - (re)build the index of a resource list attribute,
+ *	handing out an rs_index to each resource_def in the list without one
+ *
+ * @param[in] pattr - pointer to attribute structure
+ *
+ * @return	void
+ *
+ * @par MT-safe: No
+ */
+static void
+build_resc_index(attribute *pattr)
+{
+	resource *pr;
+	resc_index_t *ri;
+	unsigned int h;
+
+	drop_resc_index(pattr);
+
+	for (pr = (resource *) GET_NEXT(pattr->at_val.at_list); pr != NULL; pr = (resource *) GET_NEXT(pr->rs_link))
+		if (pr->rs_defin->rs_index == 0)
+			pr->rs_defin->rs_index = ++resc_index_last;
+
+	ri = malloc(sizeof(resc_index_t) + (resc_index_last - 1) * sizeof(resource *));
+	if (ri == NULL)
+		return; /* just keep walking the list */
+	ri->ri_attr = pattr;
+	ri->ri_nslots = resc_index_last;
+	memset(ri->ri_slot, 0, resc_index_last * sizeof(resource *));
+	for (pr = (resource *) GET_NEXT(pattr->at_val.at_list); pr != NULL; pr = (resource *) GET_NEXT(pr->rs_link))
+		ri->ri_slot[pr->rs_defin->rs_index - 1] = pr;
+	ri->ri_first = pattr->at_val.at_list.ll_next;
+	ri->ri_last = pattr->at_val.at_list.ll_prior;
+
+	for (h = resc_index_free; h < resc_index_tblsz; h++)
+		if (resc_index_tbl[h] == NULL)
+			break;
+	if (h == resc_index_tblsz) {
+		unsigned int sz = resc_index_tblsz ? resc_index_tblsz * 2 : 64;
+		resc_index_t **tmp = realloc(resc_index_tbl, sz * sizeof(resc_index_t *));
+
+		if (tmp == NULL) {
+			free(ri);
+			return;
+		}
+		memset(tmp + resc_index_tblsz, 0, (sz - resc_index_tblsz) * sizeof(resc_index_t *));
+		resc_index_tbl = tmp;
+		resc_index_tblsz = sz;
+	}
+	resc_index_tbl[h] = ri;
+	resc_index_free = h + 1;
+	pattr->at_rindex = h + 1;
+}
+
+/**
+ * @brief
+ * 	add_to_resc_index - record an entry just linked into a resource list
+ *	in the index of the list, if it has one
+ *
+ * @param[in] pattr - pointer to attribute structure
+ * @param[in] pr - the new entry
+ *
+ * @return	void
+ *
+ * @par MT-safe: No
+ */
+static void
+add_to_resc_index(attribute *pattr, resource *pr)
+{
+	resc_index_t *ri;
+	pbs_list_link *first = pattr->at_val.at_list.ll_next;
+	pbs_list_link *last = pattr->at_val.at_list.ll_prior;
+
+	if (pattr->at_rindex == 0 || pattr->at_rindex > resc_index_tblsz)
+		return;
+	ri = resc_index_tbl[pattr->at_rindex - 1];
+	if (ri == NULL || ri->ri_attr != pattr)
+		return;
+	/* only the new entry may have become one of the ends */
+	if ((ri->ri_first != first && first != &pr->rs_link) || (ri->ri_last != last && last != &pr->rs_link)) {
+		drop_resc_index(pattr);
+		return;
+	}
+	if (pr->rs_defin->rs_index == 0)
+		pr->rs_defin->rs_index = ++resc_index_last;
+	if (pr->rs_defin->rs_index > ri->ri_nslots) {
+		resc_index_t *tmp = realloc(ri, sizeof(resc_index_t) + (resc_index_last - 1) * sizeof(resource *));
+
+		if (tmp == NULL) {
+			drop_resc_index(pattr);
+			return;
+		}
+		memset(tmp->ri_slot + tmp->ri_nslots, 0, (resc_index_last - tmp->ri_nslots) * sizeof(resource *));
+		tmp->ri_nslots = resc_index_last;
+		ri = resc_index_tbl[pattr->at_rindex - 1] = tmp;
+	}
+	ri->ri_slot[pr->rs_defin->rs_index - 1] = pr;
+	ri->ri_first = first;
+	ri->ri_last = last;
+}
+
 /**
  * @brief
  * 	find_resc_entry - find a resource (value) entry in a list headed in
@@ -526,13 +735,24 @@ resource *
 find_resc_entry(const attribute *pattr, resource_def *rscdf)
 {
 	resource *pr;
+	resc_index_t *ri;
+	int steps = 0;
+
+	if ((ri = get_resc_index(pattr)) != NULL) {
+		if (rscdf->rs_index == 0 || rscdf->rs_index > ri->ri_nslots)
+			return NULL;
+		return ri->ri_slot[rscdf->rs_index - 1];
+	}
 
 	pr = (resource *) GET_NEXT(pattr->at_val.at_list);
 	while (pr != NULL) {
 		if (pr->rs_defin == rscdf)
 			break;
+		steps++;
 		pr = (resource *) GET_NEXT(pr->rs_link);
 	}
+	if (steps >= RESC_INDEX_MIN)
+		build_resc_index((attribute *) pattr); /* only at_rindex changes */
 	return (pr);
 }
 
@@ -559,6 +779,10 @@ add_resource_entry(attribute *pattr, resource_def *prdef)
 	resource *new;
 	resource *pr;
 
+	/* with an index an existing entry is found without comparing names */
+	if (get_resc_index(pattr) != NULL && (pr = find_resc_entry(pattr, prdef)) != NULL)
+		return (pr);
+
 	pr = (resource *) GET_NEXT(pattr->at_val.at_list);
 	while (pr != NULL) {
 		i = strcasecmp(pr->rs_defin->rs_name, prdef->rs_name);
@@ -577,6 +801,7 @@ add_resource_entry(attribute *pattr, resource_def *prdef)
 	new->rs_defin = prdef;
 	new->rs_value.at_type = prdef->rs_type;
 	new->rs_value.at_flags = 0;
+	new->rs_value.at_rindex = 0;
 	new->rs_value.at_user_encoded = 0;
 	new->rs_value.at_priv_encoded = 0;
 	prdef->rs_free(&new->rs_value);
@@ -586,6 +811,7 @@ add_resource_entry(attribute *pattr, resource_def *prdef)
 	} else {
 		append_link(&pattr->at_val.at_list, &new->rs_link, new);
 	}
+	add_to_resc_index(pattr, new);
 	post_attr_set(pattr);
 	return (new);
 }
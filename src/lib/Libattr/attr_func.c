@@ -112,7 +112,7 @@ cr_attrdef_idx(attribute_def *adef, int limit)
 		return NULL;
 
 	/* create the attribute index */
-	if ((attrdef_idx = pbs_idx_create(PBS_IDX_ICASE_CMP, 0)) == NULL)
+	if ((attrdef_idx = pbs_idx_create(PBS_IDX_HASH | PBS_IDX_ICASE_CMP, 0)) == NULL)
 		return NULL;
 
 	/* add all attributes to the tree with key as the attr name */
@@ -1891,8 +1891,8 @@ decode_project(attribute *patr, char *name, char *rescn, char *val)
 	if (strpbrk(pc, ETLIM_INVALIDCHAR) != NULL)
 		return PBSE_BADATVAL;
 
-	return (decode_str(patr, name, rescn,
-			   (*val == '\0') ? PBS_DEFAULT_PROJECT : val));
+	return (decode_istr(patr, name, rescn,
+			    (*val == '\0') ? PBS_DEFAULT_PROJECT : val));
 }
 
 /**
@@ -43,12 +43,15 @@
 #include <stdlib.h>
 #include "auth.h"
 #include "dis.h"
+#include "dis_.h"
 #include "pbs_error.h"
 #include "pbs_internal.h"
 
 #define PKT_MAGIC "PKTV1"
 #define PKT_MAGIC_SZ sizeof(PKT_MAGIC)
 #define PKT_HDR_SZ (PKT_MAGIC_SZ + 1 + sizeof(int))
+/* bytes needed by a 64 bit magnitude in varint form, see dis_putvarint() */
+#define DIS_VARINT_MAXSZ 10
 
 static pbs_dis_buf_t *dis_get_readbuf(int);
 static pbs_dis_buf_t *dis_get_writebuf(int);
@@ -270,6 +273,7 @@ static int
 __send_pkt(int fd, pbs_dis_buf_t *tp, int encrypt_done)
 {
 	int i;
+	int len;
 
 	if (!encrypt_done && transport_chan_is_encrypted(fd)) {
 		void *authctx = transport_chan_get_authctx(fd, FOR_ENCRYPT);
@@ -292,10 +296,25 @@ __send_pkt(int fd, pbs_dis_buf_t *tp, int encrypt_done)
 	i = htonl(tp->tdis_len - PKT_HDR_SZ);
 	memcpy((void *) (tp->tdis_data + PKT_HDR_SZ - sizeof(int)), &i, sizeof(int));
 
-	i = transport_send(fd, (void *) tp->tdis_data, tp->tdis_len);
+	len = tp->tdis_len;
+	if (pfn_transport_send_buf != NULL && len >= PBS_DIS_BUFSZ) {
+		void *buf = tp->tdis_data;
+
+		/*
+		 * large message, hand the buffer itself over to the transport
+		 * instead of having it copied, a new one is allocated on next use
+		 */
+		i = (*pfn_transport_send_buf)(fd, &buf, len);
+		if (buf == NULL) {
+			tp->tdis_data = NULL;
+			tp->tdis_bufsize = 0;
+			dis_clear_buf(tp);
+		}
+	} else
+		i = transport_send(fd, (void *) tp->tdis_data, len);
 	if (i < 0)
 		return i;
-	if (i != tp->tdis_len)
+	if (i != len)
 		return -1;
 	dis_clear_buf(tp);
 	return i;
@@ -774,6 +793,214 @@ dis_puts(int fd, const char *str, size_t ct)
 	return ct;
 }
 
+/**
+ * @brief
+ *	set the integer encoding (DIS_ENC_*) used on the channel of given fd
+ *
+ * @param[in] fd - file descriptor
+ * @param[in] enc - DIS_ENC_TEXT or DIS_ENC_BINARY
+ *
+ * @return void
+ *
+ * @par Side Effects:
+ *	None
+ *
+ * @par MT-safe: Yes
+ *
+ */
+void
+dis_set_encoding(int fd, int enc)
+{
+	pbs_tcp_chan_t *chan = transport_get_chan(fd);
+
+	if (chan == NULL)
+		return;
+	chan->encoding = enc;
+}
+
+/**
+ * @brief
+ *	get the integer encoding (DIS_ENC_*) used on the channel of given fd
+ *
+ * @param[in] fd - file descriptor
+ *
+ * @return int
+ * @retval DIS_ENC_TEXT - plain DIS, also when fd has no channel
+ * @retval DIS_ENC_BINARY - varint encoding negotiated
+ *
+ * @par Side Effects:
+ *	None
+ *
+ * @par MT-safe: Yes
+ *
+ */
+int
+dis_get_encoding(int fd)
+{
+	pbs_tcp_chan_t *chan = transport_get_chan(fd);
+
+	if (chan == NULL)
+		return DIS_ENC_TEXT;
+	return chan->encoding;
+}
+
+/**
+ * @brief
+ *	dis_putvarint - put an integer in binary (varint) form into the write buffer
+ *
+ *	The first byte carries a continuation bit (0x80), the sign (0x40) and the
+ *	low 6 bits of the magnitude, every following byte a continuation bit and
+ *	the next 7 bits, so a 64 bit magnitude needs at most DIS_VARINT_MAXSZ bytes.
+ *
+ * @param[in] fd - file descriptor
+ * @param[in] negate - is the value negative?
+ * @param[in] value - magnitude of the value
+ *
+ * @return int
+ * @retval DIS_SUCCESS - success
+ * @retval DIS_PROTO - error
+ *
+ * @par Side Effects:
+ *	None
+ *
+ * @par MT-safe: Yes
+ *
+ */
+int
+dis_putvarint(int fd, int negate, u_Long value)
+{
+	unsigned char buf[DIS_VARINT_MAXSZ];
+	int i = 0;
+
+	buf[i] = (unsigned char) (value & 0x3f);
+	if (negate)
+		buf[i] |= 0x40;
+	value >>= 6;
+	while (value) {
+		buf[i++] |= 0x80;
+		buf[i] = (unsigned char) (value & 0x7f);
+		value >>= 7;
+	}
+	if (dis_puts(fd, (char *) buf, i + 1) < 0)
+		return DIS_PROTO;
+	return DIS_SUCCESS;
+}
+
+/**
+ * @brief
+ *	dis_getvarint - get an integer written by dis_putvarint from the read buffer
+ *
+ * @param[in] fd - file descriptor
+ * @param[out] negate - set if the value is negative
+ * @param[out] value - magnitude of the value
+ *
+ * @return int
+ * @retval DIS_SUCCESS - success
+ * @retval DIS_OVERFLOW - magnitude does not fit, value set to UlONG_MAX
+ * @retval DIS_PROTO - malformed varint
+ * @retval DIS_EOD - no data or error
+ * @retval DIS_EOF - stream closed
+ *
+ * @par Side Effects:
+ *	None
+ *
+ * @par MT-safe: Yes
+ *
+ */
+int
+dis_getvarint(int fd, int *negate, u_Long *value)
+{
+	pbs_dis_buf_t *tp = dis_get_readbuf(fd);
+	u_Long locval = 0;
+	unsigned char c;
+	int shift = 6;
+	int i;
+
+	if (tp == NULL)
+		return DIS_EOD;
+	for (i = 0; i < DIS_VARINT_MAXSZ; i++) {
+		if (tp->tdis_len <= 0) {
+			/* not enought data, try to get more */
+			int unused;
+			int rc;
+
+			dis_clear_buf(tp);
+			if ((rc = __recv_pkt(fd, &unused, tp)) <= 0) {
+				dis_clear_buf(tp);
+				return (rc == -2) ? DIS_EOF : DIS_EOD;
+			}
+		}
+		c = (unsigned char) *tp->tdis_pos;
+		tp->tdis_pos++;
+		tp->tdis_len--;
+		if (i == 0) {
+			*negate = (c & 0x40) != 0;
+			locval = c & 0x3f;
+		} else {
+			if (shift > 57 && ((u_Long) (c & 0x7f) >> (64 - shift)) != 0) {
+				*value = UlONG_MAX;
+				return DIS_OVERFLOW;
+			}
+			locval |= (u_Long) (c & 0x7f) << shift;
+			shift += 7;
+		}
+		if (!(c & 0x80)) {
+			*value = locval;
+			return DIS_SUCCESS;
+		}
+	}
+	return DIS_PROTO;
+}
+
+/**
+ * @brief
+ *	dis_getvarcoef - get the coefficient of a floating point number sent
+ *	in binary form and reduce it to the significant digits of the reader
+ *
+ *	Mirrors what disrl_ does for the text form: at most <sigd> digits are
+ *	kept, the first dropped digit rounds the last kept one.
+ *
+ * @param[in] fd - file descriptor
+ * @param[in] sigd - number of significant digits wanted
+ * @param[out] coef - coefficient, signed
+ * @param[out] ndigs - number of digits kept in the coefficient
+ * @param[out] nskips - number of low order digits dropped
+ *
+ * @return int
+ * @retval DIS_SUCCESS - success
+ * @retval !DIS_SUCCESS - error from dis_getvarint
+ *
+ * @par MT-safe: Yes
+ *
+ */
+int
+dis_getvarcoef(int fd, unsigned sigd, dis_long_double_t *coef, unsigned *ndigs, unsigned *nskips)
+{
+	int negate;
+	int rc;
+	unsigned n;
+	unsigned d;
+	u_Long value;
+	u_Long tmp;
+
+	if ((rc = dis_getvarint(fd, &negate, &value)) != DIS_SUCCESS)
+		return rc;
+	for (n = 1, tmp = value; tmp >= 10; tmp /= 10)
+		n++;
+	*nskips = n > sigd ? n - sigd : 0;
+	*ndigs = n - *nskips;
+	if (*nskips > 0) {
+		for (n = 1; n < *nskips; n++)
+			value /= 10;
+		d = (unsigned) (value % 10);
+		value /= 10;
+		if (d > 5 || (d == 5 && *nskips > 1))
+			value++;
+	}
+	*coef = negate ? -(dis_long_double_t) value : (dis_long_double_t) value;
+	return DIS_SUCCESS;
+}
+
 /**
  * @brief
  *	flush dis write buffer
@@ -808,6 +1035,129 @@ dis_flush(int fd)
 	return 0;
 }
 
+/**
+ * @brief
+ *	Take out the data written so far to the dis write buffer, without
+ *	sending it, so it can be used as a header for dis_flush_scatter
+ *
+ * @param[in] fd - file descriptor
+ * @param[out] len - length of the data returned
+ *
+ * @return char *
+ *
+ * @retval !NULL - malloc'ed copy of the data, caller must free
+ * @retval NULL - error
+ *
+ * @par Side Effects:
+ *	The write buffer is cleared
+ *
+ * @par MT-safe: Yes
+ *
+ */
+char *
+dis_take_writebuf(int fd, size_t *len)
+{
+	pbs_dis_buf_t *tp = dis_get_writebuf(fd);
+	char *data;
+
+	if (tp == NULL)
+		return NULL;
+	*len = (tp->tdis_len > PKT_HDR_SZ) ? tp->tdis_len - PKT_HDR_SZ : 0;
+	if ((data = malloc(*len + 1)) == NULL)
+		return NULL;
+	if (*len > 0)
+		memcpy(data, tp->tdis_data + PKT_HDR_SZ, *len);
+	dis_clear_buf(tp);
+	return data;
+}
+
+/**
+ * @brief
+ *	flush dis write buffer of a multicast channel, with a different header
+ *	in front of it for each member
+ *
+ *	Each member receives one packet holding its header followed by the
+ *	data in the write buffer, while the data itself is handed to the
+ *	transport only once. Members sharing a header should be next to each
+ *	other and point to the same header, so its packet header is built once.
+ *
+ * @param[in] fd - multicast channel
+ * @param[in] nmembers - number of members in the channel
+ * @param[in] prefixes - header (dis data) for each member
+ * @param[in] prefix_lens - length of the header for each member
+ *
+ * @return int
+ *
+ * @retval  0 on success
+ * @retval -1 on error sending, the write buffer is cleared
+ * @retval -2 if nothing was sent (not supported by the transport or
+ *	      channel, or out of memory), the write buffer is left as is
+ *
+ * @par Side Effects:
+ *	None
+ *
+ * @par MT-safe: Yes
+ *
+ */
+int
+dis_flush_scatter(int fd, int nmembers, char **prefixes, size_t *prefix_lens)
+{
+	pbs_dis_buf_t *tp = dis_get_writebuf(fd);
+	void **hdrs;
+	unsigned int *hdr_lens;
+	char *body = NULL;
+	size_t body_len = 0;
+	char type = 0;
+	int rc = -2;
+	int i, j;
+
+	/* encryption covers a whole packet, so it can't be split up */
+	if (tp == NULL || pfn_transport_send_scatter == NULL || transport_chan_is_encrypted(fd))
+		return -2;
+
+	if (tp->tdis_len > PKT_HDR_SZ) {
+		body = tp->tdis_data + PKT_HDR_SZ;
+		body_len = tp->tdis_len - PKT_HDR_SZ;
+		type = *(tp->tdis_data + PKT_MAGIC_SZ);
+	}
+
+	hdrs = calloc(nmembers, sizeof(void *));
+	hdr_lens = malloc(sizeof(unsigned int) * nmembers);
+	if (hdrs == NULL || hdr_lens == NULL)
+		goto done;
+
+	for (i = 0; i < nmembers; i++) {
+		if (i > 0 && prefixes[i] == prefixes[i - 1]) {
+			hdrs[i] = hdrs[i - 1];
+			hdr_lens[i] = hdr_lens[i - 1];
+			continue;
+		}
+		hdr_lens[i] = PKT_HDR_SZ + prefix_lens[i];
+		if ((hdrs[i] = malloc(hdr_lens[i])) == NULL)
+			goto done;
+		strcpy(hdrs[i], PKT_MAGIC);
+		*((char *) hdrs[i] + PKT_MAGIC_SZ) = type;
+		j = htonl(prefix_lens[i] + body_len);
+		memcpy((char *) hdrs[i] + PKT_HDR_SZ - sizeof(int), &j, sizeof(int));
+		memcpy((char *) hdrs[i] + PKT_HDR_SZ, prefixes[i], prefix_lens[i]);
+	}
+
+	rc = ((*pfn_transport_send_scatter)(fd, body, body_len, hdrs, hdr_lens) >= 0) ? 0 : -1;
+	dis_clear_buf(tp);
+
+done:
+	if (hdrs) {
+		for (i = 0; i < nmembers; i++) {
+			if (i > 0 && hdrs[i] == hdrs[i - 1])
+				continue;
+			free(hdrs[i]);
+		}
+	}
+	free(hdrs);
+	free(hdr_lens);
+	return rc;
+}
+
 /**
  * @brief
  * 	dis_destroy_chan - release structures associated with fd
@@ -87,6 +87,15 @@ disrd_(int stream, unsigned count, unsigned *ndigs, unsigned *nskips, double *dv
 	unsigned unum;
 	char *cp;
 
+	if (recursv == 0 && dis_get_encoding(stream) == DIS_ENC_BINARY) {
+		dis_long_double_t ldval;
+		int rc;
+
+		if ((rc = dis_getvarcoef(stream, FLT_DIG, &ldval, ndigs, nskips)) == DIS_SUCCESS)
+			*dval = (double) ldval;
+		return (rc);
+	}
+
 	if (++recursv > DIS_RECURSIVE_LIMIT)
 		return (DIS_PROTO);
 
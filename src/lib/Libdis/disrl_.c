@@ -71,6 +71,9 @@ disrl_(int stream, dis_long_double_t *ldval, unsigned *ndigs, unsigned *nskips,
 
 	assert(stream >= 0);
 
+	if (recursv == 0 && dis_get_encoding(stream) == DIS_ENC_BINARY)
+		return (dis_getvarcoef(stream, sigd, ldval, ndigs, nskips));
+
 	if (++recursv > DIS_RECURSIVE_LIMIT)
 		return (DIS_PROTO);
 
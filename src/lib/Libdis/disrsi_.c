@@ -73,6 +73,19 @@ disrsi_(int stream, int *negate, unsigned *value, unsigned count, int recursv)
 	assert(count);
 	assert(stream >= 0);
 
+	if (recursv == 0 && dis_get_encoding(stream) == DIS_ENC_BINARY) {
+		u_Long ullval;
+		int rc;
+
+		if ((rc = dis_getvarint(stream, negate, &ullval)) != DIS_SUCCESS && rc != DIS_OVERFLOW)
+			return rc;
+		if (rc == DIS_OVERFLOW || ullval > UINT_MAX) {
+			*value = UINT_MAX;
+			return (DIS_OVERFLOW);
+		}
+		*value = ullval;
+		return (DIS_SUCCESS);
+	}
 	if (++recursv > DIS_RECURSIVE_LIMIT)
 		return (DIS_PROTO);
 	/* dis_umaxd would be initialized by prior call to dis_init_tables */
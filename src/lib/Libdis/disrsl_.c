@@ -75,6 +75,19 @@ disrsl_(int stream, int *negate, unsigned long *value, unsigned long count, int
 	assert(count);
 	assert(stream >= 0);
 
+	if (recursv == 0 && dis_get_encoding(stream) == DIS_ENC_BINARY) {
+		u_Long ullval;
+		int rc;
+
+		if ((rc = dis_getvarint(stream, negate, &ullval)) != DIS_SUCCESS && rc != DIS_OVERFLOW)
+			return rc;
+		if (rc == DIS_OVERFLOW || ullval > ULONG_MAX) {
+			*value = ULONG_MAX;
+			return (DIS_OVERFLOW);
+		}
+		*value = ullval;
+		return (DIS_SUCCESS);
+	}
 	if (++recursv > DIS_RECURSIVE_LIMIT)
 		return (DIS_PROTO);
 
@@ -91,6 +91,8 @@ disrsll_(int stream, int *negate, u_Long *value, unsigned long count, int recurs
 	assert(count);
 	assert(stream >= 0);
 
+	if (recursv == 0 && dis_get_encoding(stream) == DIS_ENC_BINARY)
+		return dis_getvarint(stream, negate, value);
 	if (++recursv > DIS_RECURSIVE_LIMIT)
 		return (DIS_PROTO);
 
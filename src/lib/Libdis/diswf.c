@@ -94,6 +94,13 @@ diswf(int stream, double value)
 	/* Make zero a special case.  If we don't it will blow exponent		*/
 	/* calculation.								*/
 	if (value == 0.0) {
+		/* In binary mode both integers follow the negotiated	*/
+		/* encoding, like any other number (see diswsi).	*/
+		if (dis_get_encoding(stream) == DIS_ENC_BINARY) {
+			if ((retval = diswsi(stream, 0)) != DIS_SUCCESS)
+				return (retval);
+			return (diswsi(stream, 0));
+		}
 		return (dis_puts(stream, "+0+0", 4) != 4 ? DIS_PROTO : DIS_SUCCESS);
 	}
 	/* Extract the sign from the coefficient.				*/
@@ -148,6 +155,17 @@ diswf(int stream, double value)
 	/* coefficient.								*/
 	ndigs = ++ocp - cp;
 	expon -= ndigs - 1;
+	/* In binary mode the coefficient goes out as a varint.		*/
+	if (dis_get_encoding(stream) == DIS_ENC_BINARY) {
+		u_Long coef = 0;
+
+		while (cp < ocp)
+			coef = coef * 10 + (u_Long) (*cp++ - '0');
+		retval = dis_putvarint(stream, negate, coef);
+		if (retval == DIS_SUCCESS)
+			return (diswsi(stream, expon));
+		return retval;
+	}
 	/* Put the coefficient sign into the buffer, left of the coefficient.	*/
 	*--cp = negate ? '-' : '+';
 	/* Insert the necessary number of counts on the left.			*/
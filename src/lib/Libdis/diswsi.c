@@ -103,6 +103,8 @@ diswsi(int stream, int value)
 		uval = value;
 		c = '+';
 	}
+	if (dis_get_encoding(stream) == DIS_ENC_BINARY)
+		return dis_putvarint(stream, c == '-', uval);
 	cp = discui_(&dis_buffer[DIS_BUFSIZ], uval, &ndigs);
 	*--cp = c;
 	while (ndigs > 1)
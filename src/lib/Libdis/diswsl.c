@@ -103,6 +103,8 @@ diswsl(int stream, long value)
 		ulval = value;
 		c = '+';
 	}
+	if (dis_get_encoding(stream) == DIS_ENC_BINARY)
+		return dis_putvarint(stream, c == '-', ulval);
 	cp = discul_(&dis_buffer[DIS_BUFSIZ], ulval, &ndigs);
 	*--cp = c;
 	while (ndigs > 1)
@@ -69,6 +69,8 @@ diswui_(int stream, unsigned value)
 
 	assert(stream >= 0);
 
+	if (dis_get_encoding(stream) == DIS_ENC_BINARY)
+		return dis_putvarint(stream, FALSE, value);
 	cp = discui_(&dis_buffer[DIS_BUFSIZ], value, &ndigs);
 	*--cp = '+';
 	while (ndigs > 1)
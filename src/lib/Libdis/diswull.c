@@ -96,6 +96,8 @@ diswull(int stream, u_Long value)
 
 	assert(stream >= 0);
 
+	if (dis_get_encoding(stream) == DIS_ENC_BINARY)
+		return dis_putvarint(stream, FALSE, value);
 	cp = discull_(&dis_buffer[DIS_BUFSIZ], value, &ndigs);
 	*--cp = '+';
 	while (ndigs > 1)
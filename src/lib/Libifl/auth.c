@@ -362,7 +362,7 @@ tcp_send_auth_req(int sock, unsigned int port, const char *user, const char *aut
 	}
 
 	if (diswui(sock, port) || /* port (only used in resvport auth) */
-	    encode_DIS_ReqExtend(sock, NULL)) {
+	    encode_DIS_ReqExtend(sock, PBS_EXTEND_DIS_BINARY)) {
 		pbs_errno = PBSE_SYSTEM;
 		return -1;
 	}
@@ -387,6 +387,10 @@ tcp_send_auth_req(int sock, unsigned int port, const char *user, const char *aut
 		return -1;
 	}
 
+	/* server accepted binary integers, everything after this reply uses them */
+	if (reply->brp_auxcode == DIS_ENC_BINARY)
+		dis_set_encoding(sock, DIS_ENC_BINARY);
+
 	PBSD_FreeReply(reply);
 
 	return 0;
@@ -127,6 +127,12 @@ struct pbs_config pbs_conf = {
 	NULL,			    /* mom short name override */
 	0,			    /* high resolution timestamp logging */
 	0,			    /* number of scheduler threads */
+	0,			    /* io_uring event monitoring off by default */
+	0,			    /* pbs_comms used in configured order, not hashed */
+	NULL,			    /* TPP compression codec, zlib if unset */
+	NULL,			    /* TPP compression dictionary */
+	0,			    /* scatter multicast off until all pbs_comms support it */
+	0,			    /* pbs_comm forwards over the preferred route only */
 	NULL,			    /* default scheduler user */
 	NULL,			    /* default scheduler auth user */
 	{'\0'}			    /* current running user */
@@ -521,6 +527,24 @@ __pbs_loadconf(int reload)
 			} else if (!strcmp(conf_name, PBS_CONF_SCHED_THREADS)) {
 				if (sscanf(conf_value, "%u", &uvalue) == 1)
 					pbs_conf.pbs_sched_threads = uvalue;
+			} else if (!strcmp(conf_name, PBS_CONF_USE_IO_URING)) {
+				if (sscanf(conf_value, "%u", &uvalue) == 1)
+					pbs_conf.pbs_use_io_uring = ((uvalue > 0) ? 1 : 0);
+			} else if (!strcmp(conf_name, PBS_CONF_LEAF_ROUTER_HASH)) {
+				if (sscanf(conf_value, "%u", &uvalue) == 1)
+					pbs_conf.pbs_leaf_router_hash = ((uvalue > 0) ? 1 : 0);
+			} else if (!strcmp(conf_name, PBS_CONF_COMPRESSION_CODEC)) {
+				free(pbs_conf.pbs_compression_codec);
+				pbs_conf.pbs_compression_codec = strdup(conf_value);
+			} else if (!strcmp(conf_name, PBS_CONF_COMPRESSION_DICT)) {
+				free(pbs_conf.pbs_compression_dict);
+				pbs_conf.pbs_compression_dict = strdup(conf_value);
+			} else if (!strcmp(conf_name, PBS_CONF_MCAST_SCATTER)) {
+				if (sscanf(conf_value, "%u", &uvalue) == 1)
+					pbs_conf.pbs_mcast_scatter = ((uvalue > 0) ? 1 : 0);
+			} else if (!strcmp(conf_name, PBS_CONF_COMM_MULTIPATH)) {
+				if (sscanf(conf_value, "%u", &uvalue) == 1)
+					pbs_conf.pbs_comm_multipath = ((uvalue > 0) ? 1 : 0);
 			}
 #ifdef WIN32
 			else if (!strcmp(conf_name, PBS_CONF_REMOTE_VIEWER)) {
@@ -765,6 +789,30 @@ __pbs_loadconf(int reload)
 		if (sscanf(gvalue, "%u", &uvalue) == 1)
 			pbs_conf.pbs_sched_threads = uvalue;
 	}
+	if ((gvalue = getenv(PBS_CONF_USE_IO_URING)) != NULL) {
+		if (sscanf(gvalue, "%u", &uvalue) == 1)
+			pbs_conf.pbs_use_io_uring = ((uvalue > 0) ? 1 : 0);
+	}
+	if ((gvalue = getenv(PBS_CONF_LEAF_ROUTER_HASH)) != NULL) {
+		if (sscanf(gvalue, "%u", &uvalue) == 1)
+			pbs_conf.pbs_leaf_router_hash = ((uvalue > 0) ? 1 : 0);
+	}
+	if ((gvalue = getenv(PBS_CONF_COMPRESSION_CODEC)) != NULL) {
+		free(pbs_conf.pbs_compression_codec);
+		pbs_conf.pbs_compression_codec = strdup(gvalue);
+	}
+	if ((gvalue = getenv(PBS_CONF_COMPRESSION_DICT)) != NULL) {
+		free(pbs_conf.pbs_compression_dict);
+		pbs_conf.pbs_compression_dict = strdup(gvalue);
+	}
+	if ((gvalue = getenv(PBS_CONF_MCAST_SCATTER)) != NULL) {
+		if (sscanf(gvalue, "%u", &uvalue) == 1)
+			pbs_conf.pbs_mcast_scatter = ((uvalue > 0) ? 1 : 0);
+	}
+	if ((gvalue = getenv(PBS_CONF_COMM_MULTIPATH)) != NULL) {
+		if (sscanf(gvalue, "%u", &uvalue) == 1)
+			pbs_conf.pbs_comm_multipath = ((uvalue > 0) ? 1 : 0);
+	}
 
 	if ((gvalue = getenv(PBS_CONF_DAEMON_SERVICE_USER)) != NULL) {
 		free(pbs_conf.pbs_daemon_service_user);
@@ -278,4 +278,6 @@ DIS_tcp_funcs()
 	pfn_transport_set_chan = set_conn_chan;
 	pfn_transport_recv = tcp_recv;
 	pfn_transport_send = tcp_send;
+	pfn_transport_send_buf = NULL;
+	pfn_transport_send_scatter = NULL;
 }
@@ -39,6 +39,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <cjson/cJSON.h>
 #include "pbs_json.h"
 
@@ -236,3 +237,554 @@ pbs_json_delete(json_data *data)
 {
     cJSON_Delete((cJSON *) data);
 }
+
+/**
+ * @brief
+ *  keep the text of every number of a parsed document in its valuestring,
+ *  which cJSON leaves unused for numbers but frees and duplicates along
+ *  with the item, so that pbs_json_dumps() can give back what was read
+ *
+ * @param[in] item - parsed json structure
+ * @param[in,out] text - json text the structure was parsed from, advanced
+ *			 past the numbers seen so far
+ *
+ * @return void
+ *
+ */
+static void
+keep_number_text(cJSON *item, const char **text)
+{
+    cJSON *child;
+    const char *p;
+    const char *start;
+
+    if (cJSON_IsNumber(item)) {
+        /* numbers come in document order, skip strings, they may hold digits */
+        for (p = *text; *p != '\0'; p++) {
+            if (*p == '"') {
+                for (p++; *p != '\0' && *p != '"'; p++) {
+                    if (*p == '\\' && p[1] != '\0')
+                        p++;
+                }
+                if (*p == '\0')
+                    break;
+            } else if (*p == '-' || (*p >= '0' && *p <= '9'))
+                break;
+        }
+        for (start = p; *p != '\0' && strchr("+-.0123456789eE", *p) != NULL; p++)
+            ;
+        *text = p;
+        if (p > start && (item->valuestring = malloc(p - start + 1)) != NULL) {
+            memcpy(item->valuestring, start, p - start);
+            item->valuestring[p - start] = '\0';
+        }
+        return;
+    }
+    cJSON_ArrayForEach(child, item)
+        keep_number_text(child, text);
+}
+
+/**
+ * @brief
+ *  parse a json document
+ *
+ * @param[in] text - NUL-terminated json text
+ *
+ * @return - json_data
+ * @retval   NULL - Failure, text is not valid json
+ * @retval   json_data - Success, free with pbs_json_delete()
+ *
+ */
+json_data *
+pbs_json_parse(const char *text)
+{
+    cJSON *root;
+
+    if ((root = cJSON_ParseWithOpts(text, NULL, 1)) != NULL)
+        keep_number_text(root, &text);
+    return (json_data *) root;
+}
+
+/**
+ * @brief
+ *  get a member of a json object
+ *
+ * @param[in] obj - json object
+ * @param[in] key - member name
+ *
+ * @return - json_data
+ * @retval   NULL - obj is not an object or has no such member
+ * @retval   json_data - Success
+ *
+ */
+json_data *
+pbs_json_get_item(json_data *obj, const char *key)
+{
+    if (obj == NULL || !cJSON_IsObject((cJSON *) obj))
+        return NULL;
+    return (json_data *) cJSON_GetObjectItemCaseSensitive((cJSON *) obj, key);
+}
+
+/**
+ * @brief
+ *  get a boolean member of a json object
+ *
+ * @param[in] obj - json object
+ * @param[in] key - member name
+ * @param[in] dflt - value returned if the member is missing or not a boolean
+ *
+ * @return - int
+ * @retval   1 - true
+ * @retval   0 - false
+ *
+ */
+int
+pbs_json_get_bool(json_data *obj, const char *key, int dflt)
+{
+    cJSON *val = (cJSON *) pbs_json_get_item(obj, key);
+    if (!cJSON_IsBool(val))
+        return dflt;
+    return cJSON_IsTrue(val) ? 1 : 0;
+}
+
+/**
+ * @brief
+ *  get a number member of a json object
+ *
+ * @param[in] obj - json object
+ * @param[in] key - member name
+ * @param[in] dflt - value returned if the member is missing or not a number
+ *
+ * @return - double
+ *
+ */
+double
+pbs_json_get_number(json_data *obj, const char *key, double dflt)
+{
+    cJSON *val = (cJSON *) pbs_json_get_item(obj, key);
+    if (!cJSON_IsNumber(val))
+        return dflt;
+    return val->valuedouble;
+}
+
+/**
+ * @brief
+ *  get a string member of a json object
+ *
+ * @param[in] obj - json object
+ * @param[in] key - member name
+ *
+ * @return - string owned by the json structure
+ * @retval   NULL - the member is missing or not a string
+ *
+ */
+char *
+pbs_json_get_string(json_data *obj, const char *key)
+{
+    return pbs_json_string_value(pbs_json_get_item(obj, key));
+}
+
+/**
+ * @brief
+ *  get the number of elements of a json array
+ *
+ * @param[in] array - json array
+ *
+ * @return - int
+ * @retval   0 - array is empty or not an array
+ * @retval   >0 - number of elements
+ *
+ */
+int
+pbs_json_array_size(json_data *array)
+{
+    if (array == NULL || !cJSON_IsArray((cJSON *) array))
+        return 0;
+    return cJSON_GetArraySize((cJSON *) array);
+}
+
+/**
+ * @brief
+ *  get an element of a json array
+ *
+ * @param[in] array - json array
+ * @param[in] index - index of the element
+ *
+ * @return - json_data
+ * @retval   NULL - no such element
+ *
+ */
+json_data *
+pbs_json_array_item(json_data *array, int index)
+{
+    if (array == NULL || !cJSON_IsArray((cJSON *) array))
+        return NULL;
+    return (json_data *) cJSON_GetArrayItem((cJSON *) array, index);
+}
+
+/**
+ * @brief
+ *  get the value of a json string
+ *
+ * @param[in] item - json string
+ *
+ * @return - string owned by the json structure
+ * @retval   NULL - item is not a string
+ *
+ */
+char *
+pbs_json_string_value(json_data *item)
+{
+    if (!cJSON_IsString((cJSON *) item))
+        return NULL;
+    return ((cJSON *) item)->valuestring;
+}
+
+/**
+ * @brief
+ *  get the value of a json number
+ *
+ * @param[in] item - json number
+ * @param[out] value - the number
+ *
+ * @return - Error code
+ * @retval   1 - Failure, item is not a number
+ * @retval   0 - Success
+ *
+ */
+int
+pbs_json_number_value(json_data *item, double *value)
+{
+    if (!cJSON_IsNumber((cJSON *) item))
+        return 1;
+    *value = ((cJSON *) item)->valuedouble;
+    return 0;
+}
+
+/**
+ * @brief
+ *  merge the members of one json object into another, a member already
+ *  in the destination takes the value from the source
+ *
+ * @param[in] dst - json object merged into
+ * @param[in] src - json object merged from, left unchanged
+ *
+ * @return - Error code
+ * @retval   1 - Failure, not objects or out of memory
+ * @retval   0 - Success
+ *
+ */
+int
+pbs_json_merge(json_data *dst, json_data *src)
+{
+    cJSON *item;
+    cJSON *dup;
+
+    if (!cJSON_IsObject((cJSON *) dst) || !cJSON_IsObject((cJSON *) src))
+        return 1;
+    cJSON_ArrayForEach(item, (cJSON *) src) {
+        if ((dup = cJSON_Duplicate(item, 1)) == NULL)
+            return 1;
+        if (cJSON_GetObjectItemCaseSensitive((cJSON *) dst, item->string) != NULL) {
+            if (!cJSON_ReplaceItemInObjectCaseSensitive((cJSON *) dst, item->string, dup)) {
+                cJSON_Delete(dup);
+                return 1;
+            }
+        } else
+            cJSON_AddItemToObject((cJSON *) dst, item->string, dup);
+    }
+    return 0;
+}
+
+/**
+ * @brief
+ *  get the number of members of a json object
+ *
+ * @param[in] obj - json object
+ *
+ * @return - int
+ * @retval   -1 - obj is not an object
+ * @retval   >=0 - number of members
+ *
+ */
+int
+pbs_json_object_size(json_data *obj)
+{
+    if (!cJSON_IsObject((cJSON *) obj))
+        return -1;
+    return cJSON_GetArraySize((cJSON *) obj);
+}
+
+/**
+ * @brief
+ *  append bytes to a growing output buffer
+ *
+ * @param[in,out] buf - output buffer, reallocated as needed
+ * @param[in,out] size - allocated size of buf
+ * @param[in,out] len - bytes used in buf
+ * @param[in] text - bytes to append
+ * @param[in] n - number of bytes
+ *
+ * @return - Error code
+ * @retval   1 - Failure
+ * @retval   0 - Success
+ *
+ */
+static int
+dump_append(char **buf, size_t *size, size_t *len, const char *text, size_t n)
+{
+    if (*len + n + 1 > *size) {
+        size_t nsize = (*size > 0) ? *size : 256;
+        char *tmp;
+
+        while (*len + n + 1 > nsize)
+            nsize *= 2;
+        if ((tmp = realloc(*buf, nsize)) == NULL)
+            return 1;
+        *buf = tmp;
+        *size = nsize;
+    }
+    memcpy(*buf + *len, text, n);
+    *len += n;
+    (*buf)[*len] = '\0';
+    return 0;
+}
+
+/**
+ * @brief
+ *  dump a string as a quoted json string, non ascii characters escaped
+ *
+ * @param[in] str - UTF-8 string
+ * @param[in,out] buf - output buffer
+ * @param[in,out] size - allocated size of buf
+ * @param[in,out] len - bytes used in buf
+ *
+ * @return - Error code
+ * @retval   1 - Failure
+ * @retval   0 - Success
+ *
+ */
+static int
+dump_string(const unsigned char *str, char **buf, size_t *size, size_t *len)
+{
+    char esc[16];
+    const unsigned char *p;
+    unsigned long cp;
+    int extra;
+
+    if (dump_append(buf, size, len, "\"", 1))
+        return 1;
+    for (p = str; *p != '\0'; p++) {
+        const char *out = esc;
+        size_t n = 2;
+
+        switch (*p) {
+            case '"': out = "\\\""; break;
+            case '\\': out = "\\\\"; break;
+            case '\b': out = "\\b"; break;
+            case '\f': out = "\\f"; break;
+            case '\n': out = "\\n"; break;
+            case '\r': out = "\\r"; break;
+            case '\t': out = "\\t"; break;
+            default:
+                if (*p >= 0x20 && *p < 0x7f) {
+                    out = (const char *) p;
+                    n = 1;
+                    break;
+                }
+                cp = *p;
+                extra = 0;
+                if (*p >= 0xf0 && *p < 0xf8) {
+                    cp = *p & 0x07;
+                    extra = 3;
+                } else if (*p >= 0xe0) {
+                    cp = *p & 0x0f;
+                    extra = 2;
+                } else if (*p >= 0xc0) {
+                    cp = *p & 0x1f;
+                    extra = 1;
+                }
+                for (; extra > 0 && (p[1] & 0xc0) == 0x80; extra--)
+                    cp = (cp << 6) | (*++p & 0x3f);
+                if (cp >= 0x10000) {
+                    cp -= 0x10000;
+                    n = snprintf(esc, sizeof(esc), "\\u%04lx\\u%04lx",
+                                 0xd800 + (cp >> 10), 0xdc00 + (cp & 0x3ff));
+                } else
+                    n = snprintf(esc, sizeof(esc), "\\u%04lx", cp);
+                break;
+        }
+        if (dump_append(buf, size, len, out, n))
+            return 1;
+    }
+    return dump_append(buf, size, len, "\"", 1);
+}
+
+/**
+ * @brief
+ *  format a double the way Python's repr() does: the shortest digits that
+ *  read back as the same double, positional from 1e-4 up to 1e16 with at
+ *  least one fractional digit, scientific with a two digit exponent
+ *  otherwise, and json.dumps() names for the non finite values
+ *
+ * @param[in] d - value
+ * @param[out] num - text, at least 32 bytes
+ *
+ * @return void
+ *
+ */
+static void
+dump_float(double d, char *num)
+{
+    char tmp[32];
+    char digs[20];
+    int ndigs = 0;
+    int expon;
+    int i;
+    char *cp;
+
+    if (d != d) {
+        strcpy(num, "NaN");
+        return;
+    }
+    if (d - d != 0) {
+        strcpy(num, (d < 0) ? "-Infinity" : "Infinity");
+        return;
+    }
+    for (i = 0; i < 16; i++) {
+        snprintf(tmp, sizeof(tmp), "%.*e", i, d);
+        if (strtod(tmp, NULL) == d)
+            break;
+    }
+    if (i == 16)
+        snprintf(tmp, sizeof(tmp), "%.16e", d);
+    cp = tmp;
+    if (*cp == '-')
+        *num++ = *cp++;
+    for (; *cp != 'e'; cp++) {
+        if (*cp != '.')
+            digs[ndigs++] = *cp;
+    }
+    expon = atoi(cp + 1);
+    while (ndigs > 1 && digs[ndigs - 1] == '0')
+        ndigs--;
+    if (expon < -4 || expon >= 16) {
+        *num++ = digs[0];
+        if (ndigs > 1) {
+            *num++ = '.';
+            memcpy(num, digs + 1, ndigs - 1);
+            num += ndigs - 1;
+        }
+        sprintf(num, "e%c%02d", (expon < 0) ? '-' : '+', (expon < 0) ? -expon : expon);
+    } else if (expon < 0) {
+        *num++ = '0';
+        *num++ = '.';
+        for (i = -1; i > expon; i--)
+            *num++ = '0';
+        memcpy(num, digs, ndigs);
+        num[ndigs] = '\0';
+    } else {
+        for (i = 0; i <= expon; i++)
+            *num++ = (i < ndigs) ? digs[i] : '0';
+        *num++ = '.';
+        if (ndigs > expon + 1) {
+            memcpy(num, digs + expon + 1, ndigs - expon - 1);
+            num += ndigs - expon - 1;
+        } else
+            *num++ = '0';
+        *num = '\0';
+    }
+}
+
+/**
+ * @brief
+ *  dump a json structure, recursing into arrays and objects
+ *
+ * @param[in] item - json structure
+ * @param[in,out] buf - output buffer
+ * @param[in,out] size - allocated size of buf
+ * @param[in,out] len - bytes used in buf
+ *
+ * @return - Error code
+ * @retval   1 - Failure
+ * @retval   0 - Success
+ *
+ */
+static int
+dump_item(cJSON *item, char **buf, size_t *size, size_t *len)
+{
+    char num[64];
+    cJSON *child;
+    double d;
+
+    if (cJSON_IsNull(item))
+        return dump_append(buf, size, len, "null", 4);
+    if (cJSON_IsTrue(item))
+        return dump_append(buf, size, len, "true", 4);
+    if (cJSON_IsFalse(item))
+        return dump_append(buf, size, len, "false", 5);
+    if (cJSON_IsString(item))
+        return dump_string((unsigned char *) item->valuestring, buf, size, len);
+    if (cJSON_IsNumber(item)) {
+        const char *text = item->valuestring;
+
+        if (text != NULL && strpbrk(text, ".eE") == NULL) {
+            /* an int to Python, exact whatever its size, and -0 is 0 */
+            if (*text == '-' && strspn(text + 1, "0") == strlen(text + 1))
+                text = "0";
+            return dump_append(buf, size, len, text, strlen(text));
+        }
+        d = item->valuedouble;
+        if (text == NULL && d < 1e17 && d > -1e17 && d == (double) (long long) d)
+            snprintf(num, sizeof(num), "%.0f", d); /* set from C, integral is an int */
+        else
+            dump_float(d, num);
+        return dump_append(buf, size, len, num, strlen(num));
+    }
+    if (cJSON_IsArray(item) || cJSON_IsObject(item)) {
+        int obj = cJSON_IsObject(item);
+
+        if (dump_append(buf, size, len, obj ? "{" : "[", 1))
+            return 1;
+        cJSON_ArrayForEach(child, item) {
+            if (child != item->child && dump_append(buf, size, len, ", ", 2))
+                return 1;
+            if (obj) {
+                if (dump_string((unsigned char *) child->string, buf, size, len) ||
+                    dump_append(buf, size, len, ": ", 2))
+                    return 1;
+            }
+            if (dump_item(child, buf, size, len))
+                return 1;
+        }
+        return dump_append(buf, size, len, obj ? "}" : "]", 1);
+    }
+    return 1;
+}
+
+/**
+ * @brief
+ *  dump json data as text laid out the way Python's json.dumps() does,
+ *  into a buffer that can be reused from call to call
+ *
+ * @param[in] data - json data
+ * @param[in,out] buf - output buffer, reallocated as needed
+ * @param[in,out] size - allocated size of buf
+ * @param[in] offset - where in buf the text goes, the bytes before are kept
+ *
+ * @return - int
+ * @retval   -1 - Failure
+ * @retval   >=0 - length of the text, which is NUL terminated
+ *
+ */
+int
+pbs_json_dumps(json_data *data, char **buf, size_t *size, size_t offset)
+{
+    size_t len = offset;
+
+    if (data == NULL || dump_append(buf, size, &len, "", 0))
+        return -1;
+    if (dump_item((cJSON *) data, buf, size, &len))
+        return -1;
+    return (int) (len - offset);
+}
@@ -90,7 +90,6 @@
 #include <sys/time.h>
 #include <stdint.h>
 
-#include "pbs_idx.h"
 #include "libpbs.h"
 #include "tpp_internal.h"
 #include "dis.h"
@@ -144,7 +143,7 @@ typedef struct {
  * IO and APP. Some of the fields are set by the APP thread first time and then
  * on accessed/updated by the IO thread.
  */
-typedef struct {
+typedef struct stream {
 	unsigned char strm_type; /* normal stream or multicast stream */
 
 	unsigned int sd;	 /* source stream descriptor, APP thread assigns, IO thread uses */
@@ -170,6 +169,8 @@ typedef struct {
 	void (*close_func)(int); /* close function to be called when this stream is closed */
 
 	tpp_que_elem_t *timeout_node; /* pointer to myself in the timeout streams queue */
+
+	struct stream *hash_next; /* next stream in the same strm_hash bucket */
 } stream_t;
 
 /*
@@ -181,17 +182,40 @@ typedef struct {
 	int slot_state; /* state of the slot - used, free */
 	stream_t *strm; /* pointer to the stream structure at this slot */
 } stream_slot_t;
-stream_slot_t *strmarray = NULL; /* array of streams */
-pthread_rwlock_t strmarray_lock; /* global lock for the streams array and streams_idx (not for an individual stream) */
-unsigned int max_strms = 0;	 /* total number of streams allocated */
+
+/*
+ * The slots live in chunks of TPP_STRM_CHUNK that never move once allocated,
+ * reached through a directory of chunk pointers. When the directory fills, a
+ * larger copy is published and the old one is kept (till shutdown), so that
+ * get_strm_atomic() can look up a slot without taking any lock, RCU style.
+ * Changes to slots and to the directory are serialized by strmarray_lock.
+ */
+#define TPP_STRM_CHUNK 1024
+typedef struct strm_dir {
+	unsigned int nchunks;	/* chunks allocated, all usable by readers */
+	unsigned int size;	/* capacity of chunks[] */
+	struct strm_dir *prev;	/* smaller directory replaced by this one */
+	stream_slot_t *chunks[1];
+} strm_dir_t;
+static strm_dir_t *strm_dir = NULL; /* current directory of slot chunks */
+pthread_mutex_t strmarray_lock;	     /* serializes updates to stream slots and the directory */
+unsigned int max_strms = 0;	     /* total number of stream slots allocated */
 
 /* the following two variables are used to quickly find out a unused slot */
 unsigned int high_sd = UNINITIALIZED_INT; /* the highest stream sd used */
 tpp_que_t freed_sd_queue;		  /* last freed stream sd */
 int freed_queue_count = 0;
 
-/* index of streams - so that we can search faster inside it */
-void *streams_idx = NULL;
+/*
+ * Streams hashed by destination address, so that streams to a host can be
+ * found without walking all the streams. Each group of buckets has its own
+ * lock, so lookups from the APP and IO threads rarely contend.
+ */
+#define TPP_STRM_HASH_SIZE 4096 /* must be a power of 2 */
+#define TPP_STRM_HASH_LOCKS 64
+static stream_t *strm_hash[TPP_STRM_HASH_SIZE];
+static pthread_mutex_t strm_hash_locks[TPP_STRM_HASH_LOCKS];
+#define STRM_HASH_LOCK(b) (&strm_hash_locks[(b) % TPP_STRM_HASH_LOCKS])
 
 /* following common structure is used to do a timed action on a stream */
 typedef struct {
@@ -251,12 +275,166 @@ static int leaf_close_handler(int tfd, int error, void *ctx, void *extra);
 static int leaf_timer_handler(time_t now);
 static int leaf_post_connect_handler(int tfd, void *data, void *ctx, void *extra);
 
+/**
+ * @brief
+ *	Get the slot for a stream descriptor, without locking
+ *
+ * @param[in] sd - The stream descriptor
+ *
+ * @return - Slot pointer
+ * @retval NULL - sd beyond the slots allocated
+ * @retval !NULL - The slot
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static stream_slot_t *
+get_slot(unsigned int sd)
+{
+	strm_dir_t *dir = tpp_atomic_load_ptr(&strm_dir);
+
+	if (dir == NULL || sd / TPP_STRM_CHUNK >= tpp_atomic_load(&dir->nchunks))
+		return NULL;
+	return &dir->chunks[sd / TPP_STRM_CHUNK][sd % TPP_STRM_CHUNK];
+}
+
+/**
+ * @brief
+ *	Make sure slots are allocated up to the given stream descriptor
+ *
+ * @param[in] sd - The stream descriptor
+ *
+ * @return	Error code
+ * @retval -1	Failure
+ * @retval  0	Success
+ *
+ * @par MT-safe: No (caller holds strmarray_lock)
+ *
+ */
+static int
+grow_strmarray(unsigned int sd)
+{
+	strm_dir_t *dir = strm_dir;
+	strm_dir_t *newdir;
+	unsigned int need = sd / TPP_STRM_CHUNK + 1;
+	unsigned int size;
+
+	if (dir != NULL && need <= dir->nchunks)
+		return 0;
+
+	if (dir == NULL || need > dir->size) {
+		size = (dir != NULL) ? dir->size * 2 : 16;
+		while (size < need)
+			size *= 2;
+		newdir = calloc(1, sizeof(strm_dir_t) + (size - 1) * sizeof(stream_slot_t *));
+		if (newdir == NULL)
+			return -1;
+		newdir->size = size;
+		if (dir != NULL) {
+			memcpy(newdir->chunks, dir->chunks, dir->nchunks * sizeof(stream_slot_t *));
+			newdir->nchunks = dir->nchunks;
+		}
+		newdir->prev = dir; /* readers may still be looking at it */
+		tpp_atomic_store_ptr(&strm_dir, newdir);
+		dir = newdir;
+	}
+
+	while (dir->nchunks < need) {
+		stream_slot_t *chunk = calloc(TPP_STRM_CHUNK, sizeof(stream_slot_t));
+		if (chunk == NULL)
+			return -1;
+		dir->chunks[dir->nchunks] = chunk;
+		/* publish the chunk only after its pointer is in place */
+		tpp_atomic_store(&dir->nchunks, dir->nchunks + 1);
+		max_strms = dir->nchunks * TPP_STRM_CHUNK;
+	}
+	return 0;
+}
+
+/**
+ * @brief
+ *	Hash a destination address into a strm_hash bucket
+ *
+ * @param[in] addr - The destination address
+ *
+ * @return bucket index
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static unsigned int
+strm_hash_bucket(tpp_addr_t *addr)
+{
+	unsigned int h = 2166136261U;
+	int i;
+
+	for (i = 0; i < 4; i++)
+		h = (h ^ (unsigned int) addr->ip[i]) * 16777619U;
+	h = (h ^ (unsigned short) addr->port) * 16777619U;
+	return (h ^ (h >> 15)) & (TPP_STRM_HASH_SIZE - 1);
+}
+
+/**
+ * @brief
+ *	Add a stream to the destination hash
+ *
+ * @param[in] strm - The stream
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static void
+strm_hash_add(stream_t *strm)
+{
+	unsigned int b = strm_hash_bucket(&strm->dest_addr);
+
+	tpp_lock(STRM_HASH_LOCK(b));
+	strm->hash_next = strm_hash[b];
+	strm_hash[b] = strm;
+	tpp_unlock(STRM_HASH_LOCK(b));
+}
+
+/**
+ * @brief
+ *	Remove a stream from the destination hash
+ *
+ * @param[in] strm - The stream
+ *
+ * @return	1 if the stream was found and removed, 0 otherwise
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static int
+strm_hash_del(stream_t *strm)
+{
+	unsigned int b = strm_hash_bucket(&strm->dest_addr);
+	stream_t **pp;
+	int found = 0;
+
+	tpp_lock(STRM_HASH_LOCK(b));
+	for (pp = &strm_hash[b]; *pp; pp = &(*pp)->hash_next) {
+		if (*pp == strm) {
+			*pp = strm->hash_next;
+			strm->hash_next = NULL;
+			found = 1;
+			break;
+		}
+	}
+	tpp_unlock(STRM_HASH_LOCK(b));
+
+	return found;
+}
+
 /**
  * @brief
  *	Helper function to get a stream pointer and slot state in an atomic fashion
  *
  * @par Functionality:
- *	Acquire a lock on the strmarray lock and return the stream pointer
+ *	Looks up the slot without taking a lock. A slot's stream pointer is
+ *	set before the slot is marked busy and the slot is marked free before
+ *	the pointer is cleared, so a busy slot always yields the stream bound
+ *	to the descriptor (or NULL if it was freed in between).
  *
  * @param[in] sd - The stream descriptor
  *
@@ -273,19 +451,16 @@ static int leaf_post_connect_handler(int tfd, void *data, void *ctx, void *extra
 static stream_t *
 get_strm_atomic(unsigned int sd)
 {
-	stream_t *strm = NULL;
+	stream_slot_t *slot;
 
 	if (tpp_terminated_in_child == 1)
 		return NULL;
 
-	tpp_read_lock(&strmarray_lock); /* walking the array, so read lock */
-	if (sd < max_strms) {
-		if (strmarray[sd].slot_state == TPP_SLOT_BUSY)
-			strm = strmarray[sd].strm;
-	}
-	tpp_unlock_rwlock(&strmarray_lock);
-
-	return strm;
+	if ((slot = get_slot(sd)) == NULL)
+		return NULL;
+	if (tpp_atomic_load(&slot->slot_state) != TPP_SLOT_BUSY)
+		return NULL;
+	return tpp_atomic_load_ptr(&slot->strm);
 }
 
 /**
@@ -604,10 +779,17 @@ tpp_init(struct tpp_config *cnf)
 
 	tpp_log(LOG_CRIT, NULL, "TPP leaf node names = %s", tpp_conf->node_name);
 
-	tpp_init_rwlock(&strmarray_lock);
+	if (tpp_compr_init(tpp_conf) != 0) {
+		tpp_log(LOG_CRIT, __func__, "Failed to initialize compression");
+		return -1;
+	}
+
+	tpp_init_lock(&strmarray_lock);
 	tpp_init_lock(&strm_action_queue_lock);
+	for (i = 0; i < TPP_STRM_HASH_LOCKS; i++)
+		tpp_init_lock(&strm_hash_locks[i]);
 
-	if (tpp_mbox_init(&app_mbox, "app_mbox", TPP_MAX_MBOX_SIZE) != 0) {
+	if (tpp_mbox_init(&app_mbox, "app_mbox", TPP_MBOX_SLOTS) != 0) {
 		tpp_log(LOG_CRIT, __func__, "Failed to create application mbox");
 		return -1;
 	}
@@ -618,12 +800,6 @@ tpp_init(struct tpp_config *cnf)
 	TPP_QUE_CLEAR(&strm_action_queue);
 	TPP_QUE_CLEAR(&freed_sd_queue);
 
-	streams_idx = pbs_idx_create(PBS_IDX_DUPS_OK, sizeof(tpp_addr_t));
-	if (streams_idx == NULL) {
-		tpp_log(LOG_CRIT, __func__, "Failed to create index for leaves");
-		return -1;
-	}
-
 	/* get the addresses associated with this leaf */
 	leaf_addrs = tpp_get_addresses(tpp_conf->node_name, &leaf_addr_count);
 	if (!leaf_addrs) {
@@ -779,8 +955,7 @@ tpp_open(char *dest_host, unsigned int port)
 	char *dest;
 	tpp_addr_t *addrs, dest_addr;
 	int count;
-	void *pdest_addr = &dest_addr;
-	void *idx_ctx = NULL;
+	unsigned int b;
 
 	if ((dest = mk_hostname(dest_host, port)) == NULL) {
 		tpp_log(LOG_CRIT, __func__, "Out of memory opening stream");
@@ -796,7 +971,8 @@ tpp_open(char *dest_host, unsigned int port)
 	memcpy(&dest_addr, addrs, sizeof(tpp_addr_t));
 	free(addrs);
 
-	tpp_read_lock(&strmarray_lock); /* walking the idx, so read lock */
+	b = strm_hash_bucket(&dest_addr);
+	tpp_lock(STRM_HASH_LOCK(b));
 
 	/*
 	 * Just try to find a fully open stream to use, else fall through
@@ -804,21 +980,19 @@ tpp_open(char *dest_host, unsigned int port)
 	 * elsewhere, either when network first dropped or if any message
 	 * comes to such a half open stream
 	 */
-	while (pbs_idx_find(streams_idx, &pdest_addr, (void **) &strm, &idx_ctx) == PBS_IDX_RET_OK) {
-		if (memcmp(pdest_addr, &dest_addr, sizeof(tpp_addr_t)) != 0)
-			break;
+	for (strm = strm_hash[b]; strm; strm = strm->hash_next) {
+		if (memcmp(&strm->dest_addr, &dest_addr, sizeof(tpp_addr_t)) != 0)
+			continue;
 		if (strm->u_state == TPP_STRM_STATE_OPEN && strm->t_state == TPP_TRNS_STATE_OPEN && strm->used_locally == 1) {
-			tpp_unlock_rwlock(&strmarray_lock);
-			pbs_idx_free_ctx(idx_ctx);
+			tpp_unlock(STRM_HASH_LOCK(b));
 
 			TPP_DBPRT("Stream for dest[%s] returned = %u", dest, strm->sd);
 			free(dest);
 			return strm->sd;
 		}
 	}
-	pbs_idx_free_ctx(idx_ctx);
 
-	tpp_unlock_rwlock(&strmarray_lock);
+	tpp_unlock(STRM_HASH_LOCK(b));
 
 	/* by default use the first address of the host as the source address */
 	if ((strm = alloc_stream(&leaf_addrs[0], &dest_addr)) == NULL) {
@@ -882,7 +1056,40 @@ get_active_router()
 
 /**
  * @brief
- *	Sends data to a stream
+ *	Pick the codec for data sent on a stream, zlib unless every peer the
+ *	data goes to is known to decode the configured codec
+ *
+ * @param[in] strm - The stream, a multicast stream stands for its members
+ *
+ * @return	The codec, TPP_COMPR_*
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static int
+strm_compr_codec(stream_t *strm)
+{
+	stream_t *m;
+	int codec;
+	int i;
+
+	if (strm->strm_type != TPP_STRM_MCAST)
+		return tpp_compr_codec(&strm->dest_addr);
+
+	/* the codec is either the configured one or zlib */
+	codec = TPP_COMPR_ZLIB;
+	for (i = 0; i < strm->mcast_data->num_fds; i++) {
+		if ((m = get_strm_atomic(strm->mcast_data->strms[i])) == NULL)
+			return TPP_COMPR_ZLIB;
+		if ((codec = tpp_compr_codec(&m->dest_addr)) == TPP_COMPR_ZLIB)
+			return TPP_COMPR_ZLIB;
+	}
+	return codec;
+}
+
+/**
+ * @brief
+ *	Sends data to a stream, common routine for tpp_send and tpp_send_buf
  *
  * @par Functionality:
  *	Basically queues data to be sent by the IO thread to the desired
@@ -891,19 +1098,21 @@ get_active_router()
  * @param[in] sd - The stream descriptor to which to send data
  * @param[in] data - Pointer to the data block to be sent
  * @param[in] len - Length of the data block to be sent
+ * @param[in] own - The data block is malloc'ed and may be queued as is,
+ *		    instead of being duplicated
  *
  * @return  Error code
  * @retval  -1 - Failure
  * @retval   >=0 - Success - amount of data sent
  *
  * @par Side Effects:
- *	None
+ *	If own is set and the data block was used, *data is set to NULL
  *
  * @par MT-safe: Yes
  *
  */
-int
-tpp_send(int sd, void *data, int len)
+static int
+__tpp_send(int sd, void **data, int len, int own)
 {
 	stream_t *strm;
 	int rc = -1;
@@ -918,22 +1127,30 @@ tpp_send(int sd, void *data, int len)
 		return -1;
 	}
 
-	if ((tpp_conf->compress == 1) && (len > TPP_COMPR_SIZE)) {
-		data_dup = tpp_deflate(data, len, &to_send); /* creates a copy */
-		if (data_dup == NULL) {
-			tpp_log(LOG_CRIT, __func__, "tpp deflate failed");
-			return -1;
-		}
-	} else {
-		data_dup = malloc(len);
-		if (!data_dup) {
-			tpp_log(errno, __func__, "Failed to duplicate data");
-			return -1;
-		}
-		memcpy(data_dup, data, len);
+	data_dup = NULL;
+	if (tpp_conf->compress == 1) {
+		int codec = strm_compr_codec(strm);
+
+		if (tpp_compr_wanted(len, codec))
+			data_dup = tpp_compress(*data, len, &to_send, codec); /* creates a copy, NULL if not worth it */
+	}
+
+	if (data_dup == NULL) {
 		to_send = len;
+		if (own) {
+			/* queue the callers buffer itself, no copy required */
+			data_dup = *data;
+			*data = NULL;
+		} else {
+			data_dup = malloc(len);
+			if (!data_dup) {
+				tpp_log(errno, __func__, "Failed to duplicate data");
+				return -1;
+			}
+			memcpy(data_dup, *data, len);
+		}
 	}
-	/* we have created a copy of the data either way, compressed, or not */
+	/* we have our own copy of the data either way, compressed, or not */
 
 	tpp_log(LOG_DEBUG, __func__, "**** sd=%d, compr_len=%d, len=%d, dest_sd=%u", sd, to_send, len, strm->dest_sd);
 
@@ -960,6 +1177,7 @@ tpp_send(int sd, void *data, int len)
 	/* add the data chunk to the already created pkt */
 	if (!tpp_bld_pkt(pkt, data_dup, to_send, 0, NULL)) { /* data is already a duplicate buffer */
 		tpp_log(LOG_CRIT, __func__, "Failed to build packet");
+		free(data_dup);
 		return -1;
 	}
 
@@ -976,6 +1194,51 @@ tpp_send(int sd, void *data, int len)
 	return rc;
 }
 
+/**
+ * @brief
+ *	Sends data to a stream
+ *
+ * @param[in] sd - The stream descriptor to which to send data
+ * @param[in] data - Pointer to the data block to be sent
+ * @param[in] len - Length of the data block to be sent
+ *
+ * @return  Error code
+ * @retval  -1 - Failure
+ * @retval   >=0 - Success - amount of data sent
+ *
+ * @par MT-safe: Yes
+ *
+ */
+int
+tpp_send(int sd, void *data, int len)
+{
+	return __tpp_send(sd, &data, len, 0);
+}
+
+/**
+ * @brief
+ *	Sends a malloc'ed data block to a stream, handing the block over to
+ *	the transport instead of copying it, when it is not compressed
+ *
+ * @param[in] sd - The stream descriptor to which to send data
+ * @param[in,out] data - Pointer to the data block to be sent. Set to NULL
+ *			 if the block was taken over (it must not be used
+ *			 or freed by the caller after that)
+ * @param[in] len - Length of the data block to be sent
+ *
+ * @return  Error code
+ * @retval  -1 - Failure
+ * @retval   >=0 - Success - amount of data sent
+ *
+ * @par MT-safe: Yes
+ *
+ */
+int
+tpp_send_buf(int sd, void **data, int len)
+{
+	return __tpp_send(sd, data, len, 1);
+}
+
 /**
  * @brief
  *	poll function to check if any streams have a message/notification
@@ -1108,13 +1371,14 @@ static stream_t *
 alloc_stream(tpp_addr_t *src_addr, tpp_addr_t *dest_addr)
 {
 	stream_t *strm;
+	stream_slot_t *slot;
 	unsigned int sd = max_strms, i;
 	void *data;
 	unsigned int freed_sd = UNINITIALIZED_INT;
 
 	errno = 0;
 
-	tpp_write_lock(&strmarray_lock); /* updating the array + adding to idx, so WRITE lock */
+	tpp_lock(&strmarray_lock); /* updating the slots */
 
 	data = tpp_deque(&freed_sd_queue);
 	if (data) {
@@ -1122,7 +1386,7 @@ alloc_stream(tpp_addr_t *src_addr, tpp_addr_t *dest_addr)
 		freed_queue_count--;
 	}
 
-	if (freed_sd != UNINITIALIZED_INT && strmarray[freed_sd].slot_state == TPP_SLOT_FREE) {
+	if (freed_sd != UNINITIALIZED_INT && get_slot(freed_sd)->slot_state == TPP_SLOT_FREE) {
 		sd = freed_sd;
 	} else if (high_sd != UNINITIALIZED_INT && max_strms > 0 && high_sd < max_strms - 1) {
 		sd = high_sd + 1;
@@ -1132,7 +1396,7 @@ alloc_stream(tpp_addr_t *src_addr, tpp_addr_t *dest_addr)
 		TPP_DBPRT("***Searching for a free slot");
 		/* search for a free sd */
 		for (i = 0; i < max_strms; i++) {
-			if (strmarray[i].slot_state == TPP_SLOT_FREE) {
+			if (get_slot(i)->slot_state == TPP_SLOT_FREE) {
 				sd = i;
 				break;
 			}
@@ -1145,7 +1409,7 @@ alloc_stream(tpp_addr_t *src_addr, tpp_addr_t *dest_addr)
 
 	strm = calloc(1, sizeof(stream_t));
 	if (!strm) {
-		tpp_unlock_rwlock(&strmarray_lock);
+		tpp_unlock(&strmarray_lock);
 		tpp_log(LOG_CRIT, __func__, "Out of memory allocating stream");
 		return NULL;
 	}
@@ -1167,40 +1431,25 @@ alloc_stream(tpp_addr_t *src_addr, tpp_addr_t *dest_addr)
 	TPP_QUE_CLEAR(&strm->recv_queue); /* only APP thread accesses this queue, once created here, hence no lock */
 
 	/* set to stream array */
-	if (max_strms == 0 || sd > max_strms - 1) {
-		unsigned int newsize;
-		void *p;
-
-		/* resize strmarray */
-		newsize = sd + 100;
-		p = realloc(strmarray, sizeof(stream_slot_t) * newsize);
-		if (!p) {
-			free(strm);
-			tpp_unlock_rwlock(&strmarray_lock);
-			tpp_log(LOG_CRIT, __func__, "Out of memory resizing stream array");
-			return NULL;
-		}
-		strmarray = (stream_slot_t *) p;
-		memset(&strmarray[max_strms], 0, (newsize - max_strms) * sizeof(stream_slot_t));
-		max_strms = newsize;
+	if (grow_strmarray(sd) != 0) {
+		free(strm);
+		tpp_unlock(&strmarray_lock);
+		tpp_log(LOG_CRIT, __func__, "Out of memory resizing stream array");
+		return NULL;
 	}
 
-	strmarray[sd].slot_state = TPP_SLOT_BUSY;
-	strmarray[sd].strm = strm;
+	/* also add stream to the strm_hash with the dest as key */
+	if (dest_addr)
+		strm_hash_add(strm);
 
-	if (dest_addr) {
-		/* also add stream to the streams_idx with the dest as key */
-		if (pbs_idx_insert(streams_idx, &strm->dest_addr, strm) != PBS_IDX_RET_OK) {
-			tpp_log(LOG_CRIT, __func__, "Failed to add strm with sd=%u to streams", strm->sd);
-			free(strm);
-			tpp_unlock_rwlock(&strmarray_lock);
-			return NULL;
-		}
-	}
+	/* pointer first, then state, for the lockless readers in get_strm_atomic */
+	slot = get_slot(sd);
+	tpp_atomic_store_ptr(&slot->strm, strm);
+	tpp_atomic_store(&slot->slot_state, TPP_SLOT_BUSY);
 
 	TPP_DBPRT("*** Allocated new stream, sd=%u, src_magic=%u", strm->sd, strm->src_magic);
 
-	tpp_unlock_rwlock(&strmarray_lock);
+	tpp_unlock(&strmarray_lock);
 
 	return strm;
 }
@@ -1288,6 +1537,8 @@ tpp_shutdown()
 {
 	unsigned int i;
 	unsigned int sd;
+	stream_slot_t *slot;
+	strm_dir_t *dir;
 
 	TPP_DBPRT("from pid = %d", getpid());
 
@@ -1301,17 +1552,29 @@ tpp_shutdown()
 	DIS_tpp_funcs();
 
 	for (i = 0; i < max_strms; i++) {
-		if (strmarray[i].slot_state == TPP_SLOT_BUSY) {
-			sd = strmarray[i].strm->sd;
+		slot = get_slot(i);
+		if (slot->slot_state == TPP_SLOT_BUSY) {
+			sd = slot->strm->sd;
 			dis_destroy_chan(sd);
-			free_stream_resources(strmarray[i].strm);
+			free_stream_resources(slot->strm);
 			free_stream(sd);
 		}
 	}
 
-	if (strmarray)
-		free(strmarray);
-	tpp_destroy_rwlock(&strmarray_lock);
+	if ((dir = strm_dir) != NULL) {
+		for (i = 0; i < dir->nchunks; i++)
+			free(dir->chunks[i]);
+	}
+	while (dir) {
+		strm_dir_t *prev = dir->prev;
+		free(dir);
+		dir = prev;
+	}
+	strm_dir = NULL;
+	max_strms = 0;
+	tpp_destroy_lock(&strmarray_lock);
+	for (i = 0; i < TPP_STRM_HASH_LOCKS; i++)
+		tpp_destroy_lock(&strm_hash_locks[i]);
 
 	free_tpp_config(tpp_conf);
 }
@@ -1954,6 +2217,245 @@ err:
 	return rc;
 }
 
+/**
+ * @brief
+ *	Send a member's header and the shared body as one data packet on the
+ *	member stream, used when the pbs_comms cannot split scatter packets
+ *
+ * @param[in] strm  - The member stream
+ * @param[in] hdr   - The header meant for this member
+ * @param[in] hdr_len - Length of the header
+ * @param[in] body  - Shared buffer with the body, NULL if no body
+ * @param[in] body_len - Length of the body
+ *
+ * @return  Error code
+ * @retval  -1 - Failure
+ * @retval  -2 - transport buffers full
+ * @retval   0 - Success
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static int
+send_scatter_member(stream_t *strm, void *hdr, unsigned int hdr_len, tpp_shbuf_t *body, unsigned int body_len)
+{
+	tpp_data_pkt_hdr_t *dhdr = NULL;
+	tpp_packet_t *pkt;
+
+	pkt = tpp_bld_pkt(NULL, NULL, sizeof(tpp_data_pkt_hdr_t), 1, (void **) &dhdr);
+	if (!pkt) {
+		tpp_log(LOG_CRIT, __func__, "Failed to build packet");
+		return -1;
+	}
+	dhdr->type = TPP_DATA;
+	dhdr->src_sd = htonl(strm->sd);
+	dhdr->src_magic = htonl(strm->src_magic);
+	dhdr->dest_sd = htonl(strm->dest_sd);
+	dhdr->totlen = htonl(hdr_len + body_len);
+	memcpy(&dhdr->src_addr, &strm->src_addr, sizeof(tpp_addr_t));
+	memcpy(&dhdr->dest_addr, &strm->dest_addr, sizeof(tpp_addr_t));
+
+	if (hdr_len > 0 && !tpp_bld_pkt(pkt, hdr, hdr_len, 1, NULL)) {
+		tpp_log(LOG_CRIT, __func__, "Failed to build packet");
+		return -1;
+	}
+	if (body && !tpp_bld_pkt_shared(pkt, body, body_len)) {
+		tpp_log(LOG_CRIT, __func__, "Failed to build packet");
+		return -1;
+	}
+
+	return send_to_router(pkt);
+}
+
+/**
+ * @brief
+ *	Send a body shared by all members of a multicast channel, with a
+ *	different header in front of it for each member
+ *
+ * @par Functionality:
+ *	Every member receives its own header followed by the body, as a single
+ *	message, as if tpp_send had been called on the member stream with the
+ *	two concatenated. If pbs.conf has PBS_MCAST_SCATTER set, this goes out
+ *	as one scatter multicast packet and the pbs_comms split it, so the body
+ *	crosses the network once per pbs_comm rather than once per member.
+ *	Otherwise a data packet per member is sent, all referring to a single
+ *	copy of the body.
+ *
+ *	The data is not compressed, the headers are meant to be small and the
+ *	body is sent once in any case.
+ *
+ * @param[in] mtfd - The multicast channel to which to send data
+ * @param[in] body - The data shared by all members
+ * @param[in] body_len - Length of the shared data
+ * @param[in] hdrs - Header for each member, in the order members were added
+ * @param[in] hdr_lens - Length of the header for each member
+ *
+ * @return  Error code
+ * @retval  -1 - Failure
+ * @retval  -2 - transport buffers full
+ * @retval   >=0 - Success - length of the body sent
+ *
+ * @par Side Effects:
+ *	None
+ *
+ * @par MT-safe: Yes
+ *
+ */
+int
+tpp_mcast_send_scatter(int mtfd, void *body, unsigned int body_len, void **hdrs, unsigned int *hdr_lens)
+{
+	stream_t *mstrm = NULL;
+	stream_t *strm = NULL;
+	tpp_mcast_pkt_hdr_t *mhdr = NULL;
+	tpp_scatter_pkt_info_t sinfo;
+	tpp_packet_t *pkt = NULL;
+	tpp_shbuf_t *shbody = NULL;
+	void *info_buf = NULL;
+	void *def_ctx = NULL;
+	char *p;
+	unsigned int info_len;
+	unsigned int cmpr_len = 0;
+	int num_fds;
+	int rc = -1;
+	int i;
+
+	mstrm = get_strm_atomic(mtfd);
+	if (!mstrm || !mstrm->mcast_data) {
+		errno = ENOTCONN;
+		return -1;
+	}
+
+	num_fds = mstrm->mcast_data->num_fds;
+
+	if (tpp_conf->mcast_scatter == 0) {
+		if (body_len > 0 && (shbody = tpp_shbuf_create(body, body_len)) == NULL)
+			return -1;
+		for (i = 0; i < num_fds; i++) {
+			strm = get_strm_atomic(mstrm->mcast_data->strms[i]);
+			if (!strm) {
+				tpp_log(LOG_ERR, NULL, "Stream %d is not open", mstrm->mcast_data->strms[i]);
+				rc = -1;
+				break;
+			}
+			if ((rc = send_scatter_member(strm, hdrs[i], hdr_lens[i], shbody, body_len)) != 0)
+				break;
+		}
+		tpp_shbuf_release(shbody); /* packets still being sent hold their own references */
+		if (rc == 0)
+			return body_len;
+		tpp_log(LOG_ERR, __func__, "Failed to send to router");
+		tpp_mcast_notify_members(mtfd, TPP_CMD_NET_CLOSE);
+		return rc;
+	}
+
+	info_len = sizeof(tpp_scatter_pkt_info_t) * num_fds;
+	for (i = 0; i < num_fds; i++)
+		info_len += hdr_lens[i];
+
+	/* header data */
+	pkt = tpp_bld_pkt(NULL, NULL, sizeof(tpp_mcast_pkt_hdr_t), 1, (void **) &mhdr);
+	if (!pkt) {
+		tpp_log(LOG_CRIT, __func__, "Failed to build packet");
+		return -1;
+	}
+	mhdr->type = TPP_MCAST_SCATTER;
+	mhdr->hop = 0;
+	mhdr->totlen = htonl(body_len);
+	memcpy(&mhdr->src_addr, &mstrm->src_addr, sizeof(tpp_addr_t));
+	mhdr->num_streams = htonl(num_fds);
+	mhdr->info_len = htonl(info_len);
+
+	if (tpp_conf->compress == 1 && info_len > TPP_COMPR_SIZE) {
+		def_ctx = tpp_multi_deflate_init(info_len);
+		if (def_ctx == NULL)
+			goto err;
+	} else {
+		info_buf = malloc(info_len);
+		if (!info_buf) {
+			tpp_log(LOG_CRIT, __func__, "Out of memory allocating scatter buffer of %u bytes", info_len);
+			goto err;
+		}
+	}
+
+	/* the fixed size member infos first, then each member's header */
+	p = info_buf;
+	for (i = 0; i < num_fds; i++) {
+		strm = get_strm_atomic(mstrm->mcast_data->strms[i]);
+		if (!strm) {
+			tpp_log(LOG_ERR, NULL, "Stream %d is not open", mstrm->mcast_data->strms[i]);
+			goto err;
+		}
+
+		sinfo.minfo.src_sd = htonl(strm->sd);
+		sinfo.minfo.src_magic = htonl(strm->src_magic);
+		sinfo.minfo.dest_sd = htonl(strm->dest_sd);
+		memcpy(&sinfo.minfo.dest_addr, &strm->dest_addr, sizeof(tpp_addr_t));
+		sinfo.hdr_len = htonl(hdr_lens[i]);
+
+		if (def_ctx == NULL) {
+			memcpy(p, &sinfo, sizeof(tpp_scatter_pkt_info_t));
+			p += sizeof(tpp_scatter_pkt_info_t);
+		} else if (tpp_multi_deflate_do(def_ctx, 0, &sinfo, sizeof(tpp_scatter_pkt_info_t)) != 0) {
+			def_ctx = NULL; /* freed on failure */
+			goto err;
+		}
+	}
+	for (i = 0; i < num_fds; i++) {
+		if (def_ctx == NULL) {
+			memcpy(p, hdrs[i], hdr_lens[i]);
+			p += hdr_lens[i];
+		} else if (tpp_multi_deflate_do(def_ctx, 0, hdrs[i], hdr_lens[i]) != 0) {
+			def_ctx = NULL;
+			goto err;
+		}
+	}
+
+	if (def_ctx != NULL) {
+		if (tpp_multi_deflate_do(def_ctx, 1, NULL, 0) != 0) { /* finish the compression */
+			def_ctx = NULL;
+			goto err;
+		}
+		info_buf = tpp_multi_deflate_done(def_ctx, &cmpr_len);
+		def_ctx = NULL;
+		if (info_buf == NULL)
+			goto err;
+		mhdr->info_cmprsd_len = htonl(cmpr_len);
+	} else {
+		mhdr->info_cmprsd_len = 0;
+		cmpr_len = info_len;
+	}
+
+	if (!tpp_bld_pkt(pkt, info_buf, cmpr_len, 0, NULL)) { /* add info chunk */
+		tpp_log(LOG_CRIT, __func__, "Failed to build packet");
+		free(info_buf);
+		return -1;
+	}
+	info_buf = NULL;
+
+	if (body_len > 0 && !tpp_bld_pkt(pkt, body, body_len, 1, NULL)) { /* add a copy of the body */
+		tpp_log(LOG_CRIT, __func__, "Failed to build packet");
+		return -1;
+	}
+
+	TPP_DBPRT("*** sending scatter %d totlen", pkt->totlen);
+
+	rc = send_to_router(pkt);
+	if (rc == 0)
+		return body_len;
+
+	tpp_log(LOG_ERR, __func__, "Failed to send to router");
+	tpp_mcast_notify_members(mtfd, TPP_CMD_NET_CLOSE);
+	return rc;
+
+err:
+	tpp_mcast_notify_members(mtfd, TPP_CMD_NET_CLOSE);
+	if (def_ctx)
+		free(tpp_multi_deflate_done(def_ctx, &cmpr_len));
+	free(info_buf);
+	tpp_free_pkt(pkt);
+	return -1;
+}
+
 /**
  * @brief
  *	Close a multicast channel
@@ -2016,14 +2518,14 @@ queue_strm_close(stream_t *strm)
 	if (!r)
 		return;
 
-	tpp_write_lock(&strmarray_lock); /* already under lock, dont need get_strm_atomic */
+	tpp_lock(&strmarray_lock); /* already under lock, dont need get_strm_atomic */
 
-	if (strmarray[strm->sd].slot_state != TPP_SLOT_BUSY) {
-		tpp_unlock_rwlock(&strmarray_lock);
+	if (get_slot(strm->sd)->slot_state != TPP_SLOT_BUSY) {
+		tpp_unlock(&strmarray_lock);
 		return;
 	}
-	strmarray[strm->sd].slot_state = TPP_SLOT_DELETED;
-	tpp_unlock_rwlock(&strmarray_lock);
+	tpp_atomic_store(&get_slot(strm->sd)->slot_state, TPP_SLOT_DELETED);
+	tpp_unlock(&strmarray_lock);
 
 	TPP_DBPRT("Marked sd=%u DELETED", strm->sd);
 
@@ -2137,7 +2639,7 @@ send_app_strm_close(stream_t *strm, int cmd, int error)
 	strm->lasterr = error;
 	strm->t_state = TPP_TRNS_STATE_NET_CLOSED;
 
-	if (tpp_mbox_post(&app_mbox, strm->sd, cmd, NULL, 0) != 0) {
+	if (tpp_mbox_post(&app_mbox, strm->sd, cmd, NULL) != 0) {
 		tpp_log(LOG_CRIT, __func__, "Error writing to app mbox");
 		return -1;
 	}
@@ -2174,21 +2676,19 @@ send_app_strm_close(stream_t *strm, int cmd, int error)
 static stream_t *
 find_stream_with_dest(tpp_addr_t *dest_addr, unsigned int dest_sd, unsigned int dest_magic)
 {
-	void *idx_ctx = NULL;
-	void *idx_nkey = dest_addr;
+	unsigned int b = strm_hash_bucket(dest_addr);
 	stream_t *strm;
 
-	while (pbs_idx_find(streams_idx, &idx_nkey, (void **) &strm, &idx_ctx) == PBS_IDX_RET_OK) {
-		if (memcmp(idx_nkey, dest_addr, sizeof(tpp_addr_t)) != 0)
-			break;
+	tpp_lock(STRM_HASH_LOCK(b));
+	for (strm = strm_hash[b]; strm; strm = strm->hash_next) {
+		if (memcmp(&strm->dest_addr, dest_addr, sizeof(tpp_addr_t)) != 0)
+			continue;
 		TPP_DBPRT("sd=%u, dest_sd=%u, u_state=%d, t-state=%d, dest_magic=%u", strm->sd, strm->dest_sd, strm->u_state, strm->t_state, strm->dest_magic);
-		if (strm->dest_sd == dest_sd && strm->dest_magic == dest_magic) {
-			pbs_idx_free_ctx(idx_ctx);
-			return strm;
-		}
+		if (strm->dest_sd == dest_sd && strm->dest_magic == dest_magic)
+			break;
 	}
-	pbs_idx_free_ctx(idx_ctx);
-	return NULL;
+	tpp_unlock(STRM_HASH_LOCK(b));
+	return strm;
 }
 
 /**
@@ -2342,9 +2842,10 @@ send_pkt_to_app(stream_t *strm, unsigned char type, void *data, int sz, int totl
 		 */
 		if (sz != totlen) {
 			if (!(tmp = tpp_inflate(data, sz, totlen))) {
-				tpp_log(LOG_CRIT, __func__, "Decompression failed");
+				tpp_log(LOG_CRIT, __func__, "Decompression of data from %s failed", tpp_netaddr(&strm->dest_addr));
 				return -1;
 			}
+			tpp_compr_learn(&strm->dest_addr, data, sz);
 			data = tmp;
 		} else {
 			/* this is still the pointer to the data part of original buffer, must make copy */
@@ -2367,7 +2868,7 @@ send_pkt_to_app(stream_t *strm, unsigned char type, void *data, int sz, int totl
 	TPP_DBPRT("Sending cmd=%d to sd=%u", cmd, strm->sd);
 
 	/* since we received one packet, send notification to app */
-	rc = tpp_mbox_post(&app_mbox, strm->sd, cmd, obj, sz);
+	rc = tpp_mbox_post(&app_mbox, strm->sd, cmd, obj);
 	if (rc != 0) {
 		if (obj)
 			tpp_free_pkt(obj);
@@ -2437,13 +2938,13 @@ free_stream_resources(stream_t *strm)
 	if (!strm)
 		return;
 
-	tpp_write_lock(&strmarray_lock);
+	tpp_lock(&strmarray_lock);
 
 	TPP_DBPRT("Freeing stream resources for sd=%u", strm->sd);
 
-	strmarray[strm->sd].slot_state = TPP_SLOT_DELETED;
+	tpp_atomic_store(&get_slot(strm->sd)->slot_state, TPP_SLOT_DELETED);
 
-	tpp_unlock_rwlock(&strmarray_lock);
+	tpp_unlock(&strmarray_lock);
 
 	if (strm->mcast_data) {
 		if (strm->mcast_data->strms)
@@ -2473,38 +2974,21 @@ free_stream(unsigned int sd)
 
 	TPP_DBPRT("Freeing stream %u", sd);
 
-	tpp_write_lock(&strmarray_lock); /* updating stream, idx, so WRITE lock */
+	tpp_lock(&strmarray_lock); /* updating the slot */
 
-	strm = strmarray[sd].strm;
+	strm = get_slot(sd)->strm;
 	if (strm->strm_type != TPP_STRM_MCAST) {
-		void *idx_ctx = NULL;
-		int found = 0;
-		stream_t *t_strm = NULL;
-		void *pdest_addr = &strm->dest_addr;
-
-		while (pbs_idx_find(streams_idx, &pdest_addr, (void **) &t_strm, &idx_ctx) == PBS_IDX_RET_OK) {
-			if (memcmp(pdest_addr, &strm->dest_addr, sizeof(tpp_addr_t)) != 0)
-				break;
-			if (strm == t_strm) {
-				found = 1;
-				break;
-			}
-		}
-
-		if (!found) {
+		if (!strm_hash_del(strm)) {
 			/* this should not happen ever */
 			tpp_log(LOG_ERR, __func__, "Failed finding strm with dest=%s, strm=%p, sd=%u", tpp_netaddr(&strm->dest_addr), strm, strm->sd);
-			tpp_unlock_rwlock(&strmarray_lock);
-			pbs_idx_free_ctx(idx_ctx);
+			tpp_unlock(&strmarray_lock);
 			return;
 		}
-
-		pbs_idx_delete_byctx(idx_ctx);
-		pbs_idx_free_ctx(idx_ctx);
 	}
 
-	strmarray[sd].slot_state = TPP_SLOT_FREE;
-	strmarray[sd].strm = NULL;
+	/* state first, then pointer, for the lockless readers in get_strm_atomic */
+	tpp_atomic_store(&get_slot(sd)->slot_state, TPP_SLOT_FREE);
+	tpp_atomic_store_ptr(&get_slot(sd)->strm, NULL);
 	free(strm);
 
 	if (freed_queue_count < 100) {
@@ -2512,7 +2996,7 @@ free_stream(unsigned int sd)
 		freed_queue_count++;
 	}
 
-	tpp_unlock_rwlock(&strmarray_lock);
+	tpp_unlock(&strmarray_lock);
 
 	tpp_lock(&strm_action_queue_lock);
 	/* empty all strm actions from the strm action queue */
@@ -2578,7 +3062,7 @@ leaf_pkt_presend_handler(int tfd, tpp_packet_t *pkt, void *c, void *extra)
 		tpp_log(LOG_CRIT, NULL, "Connected to pbs_comm %s", r->router_name);
 
 		TPP_DBPRT("Sending cmd to call App net restore handler");
-		if (tpp_mbox_post(&app_mbox, UNINITIALIZED_INT, TPP_CMD_NET_RESTORE, NULL, 0) != 0) {
+		if (tpp_mbox_post(&app_mbox, UNINITIALIZED_INT, TPP_CMD_NET_RESTORE, NULL) != 0) {
 			tpp_log(LOG_CRIT, __func__, "Error writing to app mbox");
 			return -1;
 		}
@@ -2623,19 +3107,20 @@ static stream_t *
 check_strm_valid(unsigned int src_sd, tpp_addr_t *dest_addr, int dest_sd, char *msg, int sz)
 {
 	stream_t *strm = NULL;
+	stream_slot_t *slot;
+	int state;
 
-	if (strmarray == NULL || src_sd >= max_strms) {
+	if ((slot = get_slot(src_sd)) == NULL) {
 		TPP_DBPRT("Must be data for old instance, ignoring");
 		return NULL;
 	}
 
-	if (strmarray[src_sd].slot_state != TPP_SLOT_BUSY) {
-		snprintf(msg, sz, "Data to sd=%u which is %s", src_sd, (strmarray[src_sd].slot_state == TPP_SLOT_DELETED ? "deleted" : "freed"));
+	state = tpp_atomic_load(&slot->slot_state);
+	if (state != TPP_SLOT_BUSY || (strm = tpp_atomic_load_ptr(&slot->strm)) == NULL) {
+		snprintf(msg, sz, "Data to sd=%u which is %s", src_sd, (state == TPP_SLOT_DELETED ? "deleted" : "freed"));
 		return NULL;
 	}
 
-	strm = strmarray[src_sd].strm;
-
 	if (strm->t_state != TPP_TRNS_STATE_OPEN) {
 		snprintf(msg, sz, "Data to sd=%u whose transport is not open (t_state=%d)", src_sd, strm->t_state);
 		send_app_strm_close(strm, TPP_CMD_NET_CLOSE, 0);
@@ -2817,7 +3302,7 @@ again:
 
 			if (code == TPP_MSG_UPDATE) {
 				tpp_log(LOG_INFO, NULL, "Received UPDATE from pbs_comm");
-				if (tpp_mbox_post(&app_mbox, UNINITIALIZED_INT, TPP_CMD_NET_RESTORE, NULL, 0) != 0) {
+				if (tpp_mbox_post(&app_mbox, UNINITIALIZED_INT, TPP_CMD_NET_RESTORE, NULL) != 0) {
 					tpp_log(LOG_CRIT, __func__, "Error writing to app mbox");
 				}
 				return 0;
@@ -2839,32 +3324,31 @@ again:
 			PRTPKTHDR(__func__, hdr, 0);
 
 			/* bother only about leave */
-			tpp_read_lock(&strmarray_lock); /* walking stream idx, so read lock */
 			TPP_QUE_CLEAR(&send_close_queue);
 
 			/* go past the header and point to the list of addresses following it */
 			addrs = (tpp_addr_t *) (((char *) dhdr) + sizeof(tpp_leave_pkt_hdr_t));
 			for (i = 0; i < hdr->num_addrs; i++) {
-				void *idx_ctx = NULL;
-				void *paddr = &addrs[i];
+				unsigned int b = strm_hash_bucket(&addrs[i]);
+
+				/* it may come back running another version */
+				tpp_compr_forget(&addrs[i]);
 
-				while (pbs_idx_find(streams_idx, &paddr, (void **) &strm, &idx_ctx) == PBS_IDX_RET_OK) {
-					if (memcmp(paddr, &addrs[i], sizeof(tpp_addr_t)) != 0)
-						break;
+				tpp_lock(STRM_HASH_LOCK(b));
+				for (strm = strm_hash[b]; strm; strm = strm->hash_next) {
+					if (memcmp(&strm->dest_addr, &addrs[i], sizeof(tpp_addr_t)) != 0)
+						continue;
 					strm->lasterr = 0;
-					/* under lock already, can access directly */
-					if (strmarray[strm->sd].slot_state == TPP_SLOT_BUSY) {
+					if (tpp_atomic_load(&get_slot(strm->sd)->slot_state) == TPP_SLOT_BUSY) {
 						if (tpp_enque(&send_close_queue, strm) == NULL) {
 							tpp_log(LOG_CRIT, __func__, "Out of memory enqueing to send close queue");
-							tpp_unlock_rwlock(&strmarray_lock);
-							pbs_idx_free_ctx(idx_ctx);
+							tpp_unlock(STRM_HASH_LOCK(b));
 							return -1;
 						}
 					}
 				}
-				pbs_idx_free_ctx(idx_ctx);
+				tpp_unlock(STRM_HASH_LOCK(b));
 			}
-			tpp_unlock_rwlock(&strmarray_lock);
 
 			while ((strm = (stream_t *) tpp_deque(&send_close_queue))) {
 				TPP_DBPRT("received TPP_CTL_LEAVE, sending TPP_CMD_NET_CLOSE sd=%u", strm->sd);
@@ -2896,9 +3380,7 @@ again:
 			}
 
 			if (dest_sd == UNINITIALIZED_INT) {
-				tpp_read_lock(&strmarray_lock); /* walking stream idx, so read lock */
 				strm = find_stream_with_dest(&dhdr->src_addr, src_sd, src_magic);
-				tpp_unlock_rwlock(&strmarray_lock);
 				if (strm == NULL) {
 					TPP_DBPRT("No stream associated, Opening new stream");
 					/*
@@ -2918,9 +3400,7 @@ again:
 			}
 
 			/* In any case, check for the stream's validity */
-			tpp_read_lock(&strmarray_lock); /* walking stream idx, so read lock */
 			strm = check_strm_valid(dest_sd, &dhdr->src_addr, src_sd, msg, sizeof(msg));
-			tpp_unlock_rwlock(&strmarray_lock);
 			if (strm == NULL) {
 				if (type != TPP_CLOSE_STRM && sz == 0)
 					return 0; /* it is an ack packet, don't send noroute */
@@ -3018,18 +3498,19 @@ leaf_close_handler(int tfd, int error, void *c, void *extra)
 		tpp_log(LOG_CRIT, NULL, "Connection to pbs_comm %s down", r->router_name);
 
 		/* send individual net close messages to app */
-		tpp_read_lock(&strmarray_lock); /* walking stream idx, so read lock */
+		tpp_lock(&strmarray_lock); /* walking all the slots, keep them stable */
 		for (i = 0; i < max_strms; i++) {
-			if (strmarray[i].slot_state == TPP_SLOT_BUSY) {
-				strmarray[i].strm->t_state = TPP_TRNS_STATE_NET_CLOSED;
-				TPP_DBPRT("net down, sending TPP_CMD_NET_CLOSE sd=%u", strmarray[i].strm->sd);
-				send_app_strm_close(strmarray[i].strm, TPP_CMD_NET_CLOSE, 0);
+			stream_slot_t *slot = get_slot(i);
+			if (slot->slot_state == TPP_SLOT_BUSY) {
+				slot->strm->t_state = TPP_TRNS_STATE_NET_CLOSED;
+				TPP_DBPRT("net down, sending TPP_CMD_NET_CLOSE sd=%u", slot->strm->sd);
+				send_app_strm_close(slot->strm, TPP_CMD_NET_CLOSE, 0);
 			}
 		}
-		tpp_unlock_rwlock(&strmarray_lock);
+		tpp_unlock(&strmarray_lock);
 
 		if (the_app_net_down_handler) {
-			if (tpp_mbox_post(&app_mbox, UNINITIALIZED_INT, TPP_CMD_NET_DOWN, NULL, 0) != 0) {
+			if (tpp_mbox_post(&app_mbox, UNINITIALIZED_INT, TPP_CMD_NET_DOWN, NULL) != 0) {
 				tpp_log(LOG_CRIT, __func__, "Error writing to app mbox");
 				return -1;
 			}
@@ -3038,7 +3519,7 @@ leaf_close_handler(int tfd, int error, void *c, void *extra)
 		/* if we are connected to another router, make app layer realize they need to restart streams */
 		/* send a connection restore message, so app restarts streams on the alternate route */
 		if (get_active_router()) {
-			if (tpp_mbox_post(&app_mbox, UNINITIALIZED_INT, TPP_CMD_NET_RESTORE, NULL, 0) != 0) {
+			if (tpp_mbox_post(&app_mbox, UNINITIALIZED_INT, TPP_CMD_NET_RESTORE, NULL) != 0) {
 				tpp_log(LOG_CRIT, __func__, "Error writing to app mbox");
 				return -1;
 			}
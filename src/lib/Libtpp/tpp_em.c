@@ -66,6 +66,7 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <pthread.h>
+#include <sched.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <netdb.h>
@@ -109,6 +110,549 @@ tpp_em_wait(void *em_ctx, em_event_t **ev_array, int timeout)
 /****************************************** Linux EPOLL ************************************************/
 
 #if defined(PBS_USE_EPOLL)
+#ifdef PBS_HAVE_IO_URING
+/*
+ * io_uring flavour of the epoll event monitor, selected at run time with
+ * PBS_USE_IO_URING in pbs.conf. Each monitored descriptor has a one-shot
+ * IORING_OP_POLL_ADD outstanding; a descriptor that fired is re-armed at
+ * the start of the next wait, which gives the same level triggered view
+ * callers get from epoll. Registration changes are queued in the
+ * submission ring and sent to the kernel with the next wait, so a busy
+ * loop pays one io_uring_enter per iteration instead of one epoll_ctl per
+ * change. Removals are submitted immediately, since the pending poll holds
+ * a reference to the file until the kernel sees the cancel.
+ *
+ * Registration changes only take effect at the next wait, so a descriptor
+ * must be added, modified or removed by the thread that waits on the
+ * context (which is how tpp_transport.c and net_server.c use it).
+ */
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#define URING_SQ_ENTRIES 256
+#define URING_REMOVE_TAG UINT64_MAX
+#define URING_TAG(gen, fd) (((uint64_t) (gen) << 32) | (uint32_t) (fd))
+
+typedef struct {
+	int ring_fd;
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int *sq_array;
+	unsigned int sq_mask;
+	unsigned int sq_entries;
+	struct io_uring_sqe *sqes;
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int cq_mask;
+	struct io_uring_cqe *cqes;
+	void *sq_map;
+	size_t sq_map_sz;
+	void *cq_map;
+	size_t cq_map_sz;
+	size_t sqes_sz;
+	unsigned int queued; /* sqes filled in but not yet submitted */
+	pthread_mutex_t lock;
+	int fd_max;		/* size of the per fd tables below */
+	int *fd_mask;		/* events monitored for the fd, 0 if not monitored */
+	unsigned int *fd_gen;	/* generation of the poll armed for the fd */
+	char *fd_armed;		/* a poll request is outstanding for the fd */
+	char *fd_pending;	/* the fd is on the rearm list */
+	int *rearm;		/* fds to (re)arm before the next wait */
+	int nrearm;
+} uring_context_t;
+
+static int
+uring_enter(int ring_fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags, void *arg, size_t argsz)
+{
+	return (int) syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+/**
+ * @brief
+ *	Release the rings and tables of an io_uring event context
+ *
+ * @param[in] u - The io_uring context to destroy
+ *
+ * @par MT-safe: No
+ *
+ */
+static void
+uring_destroy(uring_context_t *u)
+{
+	if (u->sqes != NULL && u->sqes != MAP_FAILED)
+		munmap(u->sqes, u->sqes_sz);
+	if (u->cq_map != NULL && u->cq_map != MAP_FAILED && u->cq_map != u->sq_map)
+		munmap(u->cq_map, u->cq_map_sz);
+	if (u->sq_map != NULL && u->sq_map != MAP_FAILED)
+		munmap(u->sq_map, u->sq_map_sz);
+	if (u->ring_fd != -1)
+		close(u->ring_fd);
+	pthread_mutex_destroy(&u->lock);
+	free(u->fd_mask);
+	free(u->fd_gen);
+	free(u->fd_armed);
+	free(u->fd_pending);
+	free(u->rearm);
+	free(u);
+}
+
+/**
+ * @brief
+ *	Set up an io_uring instance to be used for event monitoring
+ *
+ * @param[in] max_events - max events that needs to be handled
+ *
+ * @return	io_uring context
+ * @retval  NULL Failure (io_uring unusable, caller should use epoll)
+ * @retval !NULL Success
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static uring_context_t *
+uring_init(int max_events)
+{
+	struct io_uring_params p;
+	uring_context_t *u;
+	char *sq;
+	char *cq;
+	int single;
+
+	if ((u = calloc(1, sizeof(uring_context_t))) == NULL)
+		return NULL;
+	u->ring_fd = -1;
+	pthread_mutex_init(&u->lock, NULL);
+
+	memset(&p, 0, sizeof(p));
+	p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+	p.cq_entries = (max_events > URING_SQ_ENTRIES) ? max_events * 2 : URING_SQ_ENTRIES * 2;
+	if ((u->ring_fd = (int) syscall(__NR_io_uring_setup, URING_SQ_ENTRIES, &p)) == -1)
+		goto err;
+
+	/*
+	 * need the timeout and sigmask on the wait, and completions must not
+	 * be dropped when more descriptors fire than the cq ring holds
+	 */
+	if (!(p.features & IORING_FEAT_EXT_ARG) || !(p.features & IORING_FEAT_NODROP))
+		goto err;
+	tpp_set_close_on_exec(u->ring_fd);
+
+	single = (p.features & IORING_FEAT_SINGLE_MMAP) ? 1 : 0;
+	u->sq_map_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	u->cq_map_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (single && u->cq_map_sz > u->sq_map_sz)
+		u->sq_map_sz = u->cq_map_sz;
+
+	u->sq_map = mmap(NULL, u->sq_map_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQ_RING);
+	if (u->sq_map == MAP_FAILED)
+		goto err;
+	if (single)
+		u->cq_map = u->sq_map;
+	else {
+		u->cq_map = mmap(NULL, u->cq_map_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_CQ_RING);
+		if (u->cq_map == MAP_FAILED)
+			goto err;
+	}
+	u->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+	u->sqes = mmap(NULL, u->sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQES);
+	if (u->sqes == MAP_FAILED)
+		goto err;
+
+	sq = u->sq_map;
+	u->sq_head = (unsigned int *) (sq + p.sq_off.head);
+	u->sq_tail = (unsigned int *) (sq + p.sq_off.tail);
+	u->sq_array = (unsigned int *) (sq + p.sq_off.array);
+	u->sq_mask = *(unsigned int *) (sq + p.sq_off.ring_mask);
+	u->sq_entries = p.sq_entries;
+
+	cq = u->cq_map;
+	u->cq_head = (unsigned int *) (cq + p.cq_off.head);
+	u->cq_tail = (unsigned int *) (cq + p.cq_off.tail);
+	u->cq_mask = *(unsigned int *) (cq + p.cq_off.ring_mask);
+	u->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+
+	return u;
+
+err:
+	uring_destroy(u);
+	return NULL;
+}
+
+/**
+ * @brief
+ *	Make the per fd tables large enough to hold the given fd
+ *
+ * @param[in] u - The io_uring context
+ * @param[in] fd - The file descriptor
+ *
+ * @return	Error code
+ * @retval -1	Failure
+ * @retval  0	Success
+ *
+ * @par MT-safe: No (caller holds u->lock)
+ *
+ */
+static int
+uring_grow(uring_context_t *u, int fd)
+{
+	int newmax;
+	int *mask;
+	unsigned int *gen;
+	char *armed;
+	char *pending;
+	int *rearm;
+
+	if (fd < u->fd_max)
+		return 0;
+
+	newmax = (u->fd_max > 0) ? u->fd_max * 2 : 64;
+	if (newmax <= fd)
+		newmax = fd + 1;
+
+	if ((mask = realloc(u->fd_mask, newmax * sizeof(int))) == NULL)
+		return -1;
+	u->fd_mask = mask;
+	if ((gen = realloc(u->fd_gen, newmax * sizeof(unsigned int))) == NULL)
+		return -1;
+	u->fd_gen = gen;
+	if ((armed = realloc(u->fd_armed, newmax)) == NULL)
+		return -1;
+	u->fd_armed = armed;
+	if ((pending = realloc(u->fd_pending, newmax)) == NULL)
+		return -1;
+	u->fd_pending = pending;
+	if ((rearm = realloc(u->rearm, newmax * sizeof(int))) == NULL)
+		return -1;
+	u->rearm = rearm;
+
+	memset(u->fd_mask + u->fd_max, 0, (newmax - u->fd_max) * sizeof(int));
+	memset(u->fd_gen + u->fd_max, 0, (newmax - u->fd_max) * sizeof(unsigned int));
+	memset(u->fd_armed + u->fd_max, 0, newmax - u->fd_max);
+	memset(u->fd_pending + u->fd_max, 0, newmax - u->fd_max);
+	u->fd_max = newmax;
+
+	return 0;
+}
+
+/**
+ * @brief
+ *	Hand all queued submission entries to the kernel
+ *
+ * @param[in] u - The io_uring context
+ *
+ * @return	Error code
+ * @retval -1	Failure
+ * @retval  0	Success
+ *
+ * @par MT-safe: No (caller holds u->lock)
+ *
+ */
+static int
+uring_submit(uring_context_t *u)
+{
+	int rc;
+
+	while (u->queued > 0) {
+		rc = uring_enter(u->ring_fd, u->queued, 0, 0, NULL, 0);
+		if (rc == -1) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (rc == 0)
+			break;
+		u->queued -= rc;
+	}
+	return 0;
+}
+
+/**
+ * @brief
+ *	Get a free submission entry, flushing the ring to the kernel if full
+ *
+ * @param[in] u - The io_uring context
+ *
+ * @return	Submission entry, already queued at the tail of the ring
+ * @retval  NULL Failure
+ *
+ * @par MT-safe: No (caller holds u->lock)
+ *
+ */
+static struct io_uring_sqe *
+uring_get_sqe(uring_context_t *u)
+{
+	struct io_uring_sqe *sqe;
+	unsigned int tail = *u->sq_tail;
+	unsigned int idx;
+
+	if (tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= u->sq_entries) {
+		if (uring_submit(u) == -1)
+			return NULL;
+		if (tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= u->sq_entries) {
+			errno = EBUSY;
+			return NULL;
+		}
+	}
+
+	idx = tail & u->sq_mask;
+	sqe = &u->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	u->sq_array[idx] = idx;
+	__atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	u->queued++;
+
+	return sqe;
+}
+
+/**
+ * @brief
+ *	Queue the fd to be armed at the start of the next wait
+ *
+ * @par MT-safe: No (caller holds u->lock)
+ *
+ */
+static void
+uring_rearm_later(uring_context_t *u, int fd)
+{
+	if (!u->fd_pending[fd]) {
+		u->fd_pending[fd] = 1;
+		u->rearm[u->nrearm++] = fd;
+	}
+}
+
+/**
+ * @brief
+ *	Cancel the outstanding poll on the fd (if any) and invalidate any of
+ *	its completions not yet reaped
+ *
+ * @return	Error code
+ * @retval -1	Failure
+ * @retval  0	Success
+ *
+ * @par MT-safe: No (caller holds u->lock)
+ *
+ */
+static int
+uring_cancel(uring_context_t *u, int fd)
+{
+	struct io_uring_sqe *sqe;
+
+	if (u->fd_armed[fd]) {
+		if ((sqe = uring_get_sqe(u)) == NULL)
+			return -1;
+		sqe->opcode = IORING_OP_POLL_REMOVE;
+		sqe->fd = -1;
+		sqe->addr = URING_TAG(u->fd_gen[fd], fd);
+		sqe->user_data = URING_REMOVE_TAG;
+		u->fd_armed[fd] = 0;
+	}
+	u->fd_gen[fd]++;
+	return 0;
+}
+
+/**
+ * @brief
+ *	Queue a one-shot poll for the events monitored on the fd
+ *
+ * @return	Error code
+ * @retval -1	Failure
+ * @retval  0	Success
+ *
+ * @par MT-safe: No (caller holds u->lock)
+ *
+ */
+static int
+uring_arm(uring_context_t *u, int fd)
+{
+	struct io_uring_sqe *sqe;
+	unsigned int events = (unsigned int) u->fd_mask[fd];
+
+	if ((sqe = uring_get_sqe(u)) == NULL)
+		return -1;
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd;
+#if __BYTE_ORDER == __BIG_ENDIAN
+	events = (events << 16) | (events >> 16);
+#endif
+	sqe->poll32_events = events;
+	sqe->user_data = URING_TAG(u->fd_gen[fd], fd);
+	u->fd_armed[fd] = 1;
+	return 0;
+}
+
+/**
+ * @brief
+ *	The epoll_ctl equivalent for the io_uring event context
+ *
+ * @param[in] u - The io_uring context
+ * @param[in] op - EPOLL_CTL_ADD, EPOLL_CTL_MOD or EPOLL_CTL_DEL
+ * @param[in] fd - The file descriptor
+ * @param[in] event_mask - A mask of events to monitor the fd for
+ *
+ * @return	Error code
+ * @retval -1	Failure (errno set as epoll_ctl would)
+ * @retval  0	Success
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static int
+uring_ctl(uring_context_t *u, int op, int fd, int event_mask)
+{
+	int rc = 0;
+
+	if (fd < 0) {
+		errno = EBADF;
+		return -1;
+	}
+
+	/* poll always reports errors and hangups, as epoll does */
+	event_mask |= EM_ERR | EM_HUP;
+
+	pthread_mutex_lock(&u->lock);
+	if (uring_grow(u, fd) == -1) {
+		pthread_mutex_unlock(&u->lock);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	switch (op) {
+		case EPOLL_CTL_ADD:
+			if (u->fd_mask[fd] != 0) {
+				errno = EEXIST;
+				rc = -1;
+				break;
+			}
+			u->fd_mask[fd] = event_mask;
+			uring_rearm_later(u, fd);
+			break;
+
+		case EPOLL_CTL_MOD:
+			if (u->fd_mask[fd] == 0) {
+				errno = ENOENT;
+				rc = -1;
+				break;
+			}
+			if (u->fd_mask[fd] == event_mask)
+				break;
+			u->fd_mask[fd] = event_mask;
+			rc = uring_cancel(u, fd);
+			uring_rearm_later(u, fd);
+			break;
+
+		case EPOLL_CTL_DEL:
+			if (u->fd_mask[fd] == 0) {
+				errno = ENOENT;
+				rc = -1;
+				break;
+			}
+			u->fd_mask[fd] = 0;
+			if ((rc = uring_cancel(u, fd)) == 0)
+				rc = uring_submit(u);
+			break;
+
+		default:
+			errno = EINVAL;
+			rc = -1;
+	}
+	pthread_mutex_unlock(&u->lock);
+
+	return rc;
+}
+
+/**
+ * @brief
+ *	Arm the pending polls and wait for completions on the io_uring
+ *	event context
+ *
+ * @param[in] ctx - The event monitor context
+ * @param[in] timeout - The timeout in milliseconds to wait for
+ * @param[in] sigmask - The signal mask to atomically unblock before sleeping
+ *
+ * @return	Number of events returned in ctx->events
+ * @retval -1	Failure
+ * @retval  0	Timeout
+ * @retval >0   Success (some events occured)
+ *
+ * @par MT-safe: No
+ *
+ */
+static int
+uring_pwait(epoll_context_t *ctx, int timeout, const sigset_t *sigmask)
+{
+	uring_context_t *u = ctx->uring;
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	struct io_uring_cqe *cqe;
+	unsigned int head;
+	unsigned int tail;
+	unsigned int gen;
+	int fd;
+	int i;
+	int n = 0;
+
+	pthread_mutex_lock(&u->lock);
+	for (i = 0; i < u->nrearm; i++) {
+		fd = u->rearm[i];
+		if (u->fd_mask[fd] != 0 && !u->fd_armed[fd]) {
+			if (uring_arm(u, fd) == -1)
+				break;
+		}
+		u->fd_pending[fd] = 0;
+	}
+	/* anything not armed stays queued for the next wait */
+	if (i < u->nrearm)
+		memmove(u->rearm, u->rearm + i, (u->nrearm - i) * sizeof(int));
+	u->nrearm -= i;
+	uring_submit(u);
+	pthread_mutex_unlock(&u->lock);
+
+	if (__atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE) == *u->cq_head) {
+		memset(&arg, 0, sizeof(arg));
+		if (sigmask) {
+			arg.sigmask = (uint64_t) (uintptr_t) sigmask;
+			arg.sigmask_sz = _NSIG / 8;
+		}
+		if (timeout >= 0) {
+			ts.tv_sec = timeout / 1000;
+			ts.tv_nsec = (timeout % 1000) * 1000000L;
+			arg.ts = (uint64_t) (uintptr_t) &ts;
+		}
+		if (uring_enter(u->ring_fd, 0, (timeout == 0) ? 0 : 1,
+				IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg)) == -1) {
+			if (errno != ETIME)
+				return -1;
+		}
+	}
+
+	pthread_mutex_lock(&u->lock);
+	head = *u->cq_head;
+	tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+	while (head != tail && n < ctx->max_nfds) {
+		cqe = &u->cqes[head & u->cq_mask];
+		head++;
+		if (cqe->user_data == URING_REMOVE_TAG)
+			continue;
+		fd = (int) (uint32_t) cqe->user_data;
+		gen = (unsigned int) (cqe->user_data >> 32);
+		if (fd >= u->fd_max || u->fd_mask[fd] == 0 || gen != u->fd_gen[fd])
+			continue; /* removed or modified since the poll was armed */
+
+		u->fd_armed[fd] = 0;
+		ctx->events[n].events = (cqe->res < 0) ? EM_ERR : (unsigned int) cqe->res;
+		ctx->events[n].data.fd = fd;
+		n++;
+		uring_rearm_later(u, fd);
+	}
+	__atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&u->lock);
+
+	return n;
+}
+#endif /* PBS_HAVE_IO_URING */
+
 /**
  * @brief
  *	Initialize event monitoring
@@ -137,6 +681,19 @@ tpp_em_init(int max_events)
 		free(ctx);
 		return NULL;
 	}
+	ctx->max_nfds = max_events;
+	ctx->init_pid = getpid();
+
+#ifdef PBS_HAVE_IO_URING
+	ctx->uring = NULL;
+	if (pbs_conf.pbs_use_io_uring) {
+		if ((ctx->uring = uring_init(max_events)) != NULL) {
+			ctx->epoll_fd = -1;
+			return ((void *) ctx);
+		}
+		/* kernel too old or io_uring disabled, fall back to epoll */
+	}
+#endif
 
 #if defined(EPOLL_CLOEXEC)
 	ctx->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
@@ -151,8 +708,6 @@ tpp_em_init(int max_events)
 		free(ctx);
 		return NULL;
 	}
-	ctx->max_nfds = max_events;
-	ctx->init_pid = getpid();
 
 	return ((void *) ctx);
 }
@@ -175,7 +730,12 @@ tpp_em_destroy(void *em_ctx)
 	epoll_context_t *ctx = (epoll_context_t *) em_ctx;
 
 	if (ctx != NULL) {
-		close(ctx->epoll_fd);
+#ifdef PBS_HAVE_IO_URING
+		if (ctx->uring != NULL)
+			uring_destroy(ctx->uring);
+		else
+#endif
+			close(ctx->epoll_fd);
 		free(ctx->events);
 		free(ctx);
 	}
@@ -214,6 +774,11 @@ tpp_em_add_fd(void *em_ctx, int fd, int event_mask)
 	if (ctx->init_pid != getpid())
 		return 0;
 
+#ifdef PBS_HAVE_IO_URING
+	if (ctx->uring != NULL)
+		return uring_ctl(ctx->uring, EPOLL_CTL_ADD, fd, event_mask);
+#endif
+
 	memset(&ev, 0, sizeof(ev));
 	ev.events = event_mask;
 	ev.data.fd = fd;
@@ -257,6 +822,11 @@ tpp_em_mod_fd(void *em_ctx, int fd, int event_mask)
 	if (ctx->init_pid != getpid())
 		return 0;
 
+#ifdef PBS_HAVE_IO_URING
+	if (ctx->uring != NULL)
+		return uring_ctl(ctx->uring, EPOLL_CTL_MOD, fd, event_mask);
+#endif
+
 	memset(&ev, 0, sizeof(ev));
 	ev.events = event_mask;
 	ev.data.fd = fd;
@@ -299,6 +869,11 @@ tpp_em_del_fd(void *em_ctx, int fd)
 	if (ctx->init_pid != getpid())
 		return 0;
 
+#ifdef PBS_HAVE_IO_URING
+	if (ctx->uring != NULL)
+		return uring_ctl(ctx->uring, EPOLL_CTL_DEL, fd, 0);
+#endif
+
 	memset(&ev, 0, sizeof(ev));
 	ev.data.fd = fd;
 	if (epoll_ctl(ctx->epoll_fd, EPOLL_CTL_DEL, fd, &ev) < 0)
@@ -334,6 +909,10 @@ tpp_em_pwait(void *em_ctx, em_event_t **ev_array, int timeout, const sigset_t *s
 {
 	epoll_context_t *ctx = (epoll_context_t *) em_ctx;
 	*ev_array = ctx->events;
+#ifdef PBS_HAVE_IO_URING
+	if (ctx->uring != NULL)
+		return uring_pwait(ctx, timeout, sigmask);
+#endif
 	return (epoll_pwait(ctx->epoll_fd, ctx->events, ctx->max_nfds, timeout, sigmask));
 }
 #else
@@ -344,6 +923,10 @@ tpp_em_pwait(void *em_ctx, em_event_t **ev_array, int timeout, const sigset_t *s
 	*ev_array = ctx->events;
 	sigset_t origmask;
 	int n;
+#ifdef PBS_HAVE_IO_URING
+	if (ctx->uring != NULL)
+		return uring_pwait(ctx, timeout, sigmask);
+#endif
 	sigprocmask(SIG_SETMASK, sigmask, &origmask);
 	n = epoll_wait(ctx->epoll_fd, ctx->events, ctx->max_nfds, timeout);
 	sigprocmask(SIG_SETMASK, &origmask, NULL);
@@ -906,12 +1489,34 @@ tpp_em_wait_win(void *em_ctx, em_event_t **ev_array, int timeout)
 /********************************** END OF MULTIPLEXING CODE *****************************************/
 
 /********************************** START OF MBOX CODE ***********************************************/
+/*
+ * An mbox is read by a single thread (the one that owns it) and posted to by
+ * any number of threads. Commands are kept in a bounded ring of slots, which
+ * producers claim with a compare-and-swap on the tail, and publish by setting
+ * the slot's sequence number. Only the reader moves the head.
+ *
+ * If the ring is full, commands go to a mutex protected overflow queue. Once
+ * anything is in the overflow queue, all posts go there till it is drained,
+ * so that commands from a thread are always read in the order posted.
+ *
+ * The eventfd (or pipe) is written only when the reader may be idle, that is,
+ * by the first post after the reader found the mbox empty. Later posts find
+ * "notified" set and do not write again.
+ */
+
+/* ring slot marked as cleared by tpp_mbox_clear, skipped by tpp_mbox_read */
+#define TPP_MBOX_CLEARED 0
+
+/* cache of free command structures for the overflow queues */
+static tpp_pool_t cmd_pool = TPP_POOL_INITIALIZER(sizeof(tpp_cmd_t), 1024);
+
 /**
  * @brief
  *	Initialize an mbox
  *
  * @param[in] - mbox   - The mbox to read from
- * @param[in] - size   - The total size allowed, or -1 for inifinite
+ * @param[in] - name   - Name of the mbox, for logging
+ * @param[in] - slots  - Number of slots in the ring, a power of 2
  *
  * @return  Error code
  * @retval  -1 - Failure
@@ -924,16 +1529,32 @@ tpp_em_wait_win(void *em_ctx, em_event_t **ev_array, int timeout)
  *
  */
 int
-tpp_mbox_init(tpp_mbox_t *mbox, char *name, int size)
+tpp_mbox_init(tpp_mbox_t *mbox, char *name, int slots)
 {
+	unsigned int i;
+
 	tpp_init_lock(&mbox->mbox_mutex);
 	tpp_lock(&mbox->mbox_mutex);
 
 	TPP_QUE_CLEAR(&mbox->mbox_queue);
+	mbox->mbox_overflow = 0;
 
 	snprintf(mbox->mbox_name, sizeof(mbox->mbox_name), "%s", name);
-	mbox->mbox_size = 0;
-	mbox->max_size = size;
+
+	mbox->mbox_ring = malloc(slots * sizeof(tpp_mbox_slot_t));
+	if (mbox->mbox_ring == NULL) {
+		tpp_log(LOG_CRIT, __func__, "Out of memory allocating %d slots for mbox=%s", slots, name);
+		tpp_unlock(&mbox->mbox_mutex);
+		return -1;
+	}
+	for (i = 0; i < (unsigned int) slots; i++)
+		mbox->mbox_ring[i].seq = i;
+	mbox->mbox_mask = slots - 1;
+	mbox->mbox_head = 0;
+	mbox->mbox_tail = 0;
+	mbox->mbox_notified = 0;
+	mbox->mbox_posters = 0;
+	mbox->mbox_closing = 0;
 
 #ifdef HAVE_SYS_EVENTFD_H
 	if ((mbox->mbox_eventfd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) == -1) {
@@ -995,6 +1616,11 @@ tpp_mbox_getfd(tpp_mbox_t *mbox)
  * @brief
  *	Destroy a message box
  *
+ *	Posts from now on fail. Posts already in progress may still write to
+ *	the ring and the eventfd, so wait for them to finish before freeing.
+ *	Commands left in the overflow queue are dropped, the caller clears
+ *	those it owns data of with tpp_mbox_clear first.
+ *
  * @param[in] mbox - The message box to destroy
  *
  * @par Side Effects:
@@ -1006,6 +1632,19 @@ tpp_mbox_getfd(tpp_mbox_t *mbox)
 void
 tpp_mbox_destroy(tpp_mbox_t *mbox)
 {
+	tpp_cmd_t *cmd;
+
+	tpp_atomic_store(&mbox->mbox_closing, 1);
+	while (tpp_atomic_load(&mbox->mbox_posters) > 0)
+		sched_yield();
+
+	free(mbox->mbox_ring);
+	mbox->mbox_ring = NULL;
+
+	while ((cmd = (tpp_cmd_t *) tpp_deque(&mbox->mbox_queue)))
+		tpp_pool_put(&cmd_pool, cmd);
+	mbox->mbox_overflow = 0;
+
 #ifdef HAVE_SYS_EVENTFD_H
 	close(mbox->mbox_eventfd);
 #else
@@ -1047,6 +1686,115 @@ tpp_mbox_monitor(void *em_ctx, tpp_mbox_t *mbox)
 	return 0;
 }
 
+/**
+ * @brief
+ *	Wake up the reader of the mbox, unless already done since it
+ *	last found the mbox empty
+ *
+ * @param[in] - mbox - The mbox
+ *
+ * @return Error code
+ * @retval -1 Failure
+ * @retval  0 Success
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static int
+mbox_notify(tpp_mbox_t *mbox)
+{
+	ssize_t s;
+#ifdef HAVE_SYS_EVENTFD_H
+	uint64_t u;
+#else
+	char b;
+#endif
+
+	if (tpp_atomic_xchg(&mbox->mbox_notified, 1) != 0)
+		return 0; /* reader is already awake */
+
+	while (1) {
+		/* send a notification to the thread */
+#ifdef HAVE_SYS_EVENTFD_H
+		u = 1;
+		s = write(mbox->mbox_eventfd, &u, sizeof(uint64_t));
+		if (s == sizeof(uint64_t))
+			break;
+#else
+		b = 1;
+		s = tpp_pipe_write(mbox->mbox_pipe[1], &b, sizeof(char));
+		if (s == sizeof(char))
+			break;
+#endif
+		if (s == -1) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				/* pipe is full, which is fine, anyway we behave like edge triggered */
+				break;
+			} else if (errno != EINTR) {
+				tpp_log(LOG_CRIT, __func__, "mbox post failed for mbox=%s, errno=%d", mbox->mbox_name, errno);
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief
+ *	Take the next command off the ring, or the overflow queue
+ *
+ * @param[in]  - mbox   - The mbox to read from
+ * @param[out] - tfd    - The Virtual file descriptor
+ * @param[out] - cmdval - The command or operation
+ * @param[out] - data   - Data associated, if any (or NULL)
+ *
+ * @return 1 if a command was read, 0 if mbox is empty
+ *
+ * @par MT-safe: No, only the mbox reader calls this
+ *
+ */
+static int
+mbox_take(tpp_mbox_t *mbox, unsigned int *tfd, int *cmdval, void **data)
+{
+	tpp_mbox_slot_t *slot;
+	tpp_cmd_t *cmd;
+
+	while (mbox->mbox_ring && mbox->mbox_head != tpp_atomic_load(&mbox->mbox_tail)) {
+		slot = &mbox->mbox_ring[mbox->mbox_head & mbox->mbox_mask];
+		if (tpp_atomic_load(&slot->seq) != mbox->mbox_head + 1)
+			return 0; /* next slot not published yet, its poster will notify */
+
+		*tfd = slot->tfd;
+		*cmdval = slot->cmdval;
+		*data = slot->data;
+
+		/* hand the slot back to producers for the next lap */
+		tpp_atomic_store(&slot->seq, mbox->mbox_head + mbox->mbox_mask + 1);
+		mbox->mbox_head++;
+
+		if (*cmdval != TPP_MBOX_CLEARED)
+			return 1;
+	}
+
+	if (tpp_atomic_load(&mbox->mbox_overflow) == 0)
+		return 0;
+
+	tpp_lock(&mbox->mbox_mutex);
+	cmd = (tpp_cmd_t *) tpp_deque(&mbox->mbox_queue);
+	if (cmd)
+		tpp_atomic_add(&mbox->mbox_overflow, -1);
+	tpp_unlock(&mbox->mbox_mutex);
+
+	if (cmd == NULL)
+		return 0;
+
+	*tfd = cmd->tfd;
+	*cmdval = cmd->cmdval;
+	*data = cmd->data;
+	tpp_pool_put(&cmd_pool, cmd);
+	return 1;
+}
+
 /**
  * @brief
  *	Read a command from the msg box.
@@ -1063,7 +1811,7 @@ tpp_mbox_monitor(void *em_ctx, tpp_mbox_t *mbox)
  * @par Side Effects:
  *	None
  *
- * @par MT-safe: Yes
+ * @par MT-safe: No, an mbox has a single reader
  *
  */
 int
@@ -1074,21 +1822,17 @@ tpp_mbox_read(tpp_mbox_t *mbox, unsigned int *tfd, int *cmdval, void **data)
 #else
 	char b;
 #endif
-	tpp_cmd_t *cmd = NULL;
-
-	if (cmdval)
-		*cmdval = -1;
+	unsigned int l_tfd;
+	int l_cmdval;
 
 	errno = 0;
 
-	tpp_lock(&mbox->mbox_mutex);
-
-	/* read the data from the mbox cmd queue head */
-	cmd = (tpp_cmd_t *) tpp_deque(&mbox->mbox_queue);
-
-	/* if no more data, clear all notifications */
-	if (cmd == NULL) {
-		mbox->mbox_size = 0;
+	if (!mbox_take(mbox, &l_tfd, &l_cmdval, data)) {
+		/*
+		 * mbox is empty, clear all notifications and let the
+		 * next post notify again. Check once more after that,
+		 * since a post could have raced with clearing the flag
+		 */
 #ifdef HAVE_SYS_EVENTFD_H
 		if (read(mbox->mbox_eventfd, &u, sizeof(uint64_t)) == -1)
 			;
@@ -1096,73 +1840,95 @@ tpp_mbox_read(tpp_mbox_t *mbox, unsigned int *tfd, int *cmdval, void **data)
 		while (tpp_pipe_read(mbox->mbox_pipe[0], &b, sizeof(char)) == sizeof(char))
 			;
 #endif
-	} else {
-		/* reduce from mbox size during read */
-		mbox->mbox_size -= cmd->sz;
-	}
+		tpp_atomic_xchg(&mbox->mbox_notified, 0);
 
-	tpp_unlock(&mbox->mbox_mutex);
-
-	if (cmd == NULL) {
-		errno = EWOULDBLOCK;
-		return -1;
+		if (!mbox_take(mbox, &l_tfd, &l_cmdval, data)) {
+			if (cmdval)
+				*cmdval = -1;
+			errno = EWOULDBLOCK;
+			return -1;
+		}
 	}
 
 	if (tfd)
-		*tfd = cmd->tfd;
+		*tfd = l_tfd;
 
 	if (cmdval)
-		*cmdval = cmd->cmdval;
+		*cmdval = l_cmdval;
 
-	*data = cmd->data;
-
-	free(cmd);
 	return 0;
 }
 
 /**
  * @brief
- *	Clear pending commands pertaining to a connection
+ *	Clear a pending command pertaining to a connection
  *	from this mbox
  *	Called usually when the connection got closed and
  *	the caller wants to clear the pending commands for
- *	that connection from this thread mbox
+ *	that connection from this thread mbox. Call repeatedly
+ *	till it fails to clear all of them.
  *
  * @param[in] - mbox   - The mbox to read from
- * @param[in] - n      - The node/position to start searching from
  * @param[in] - tfd    - The Virtual file descriptor
  * @param[out] - cmdval - Return the cmdval
  * @param[out] - data - Return any data associated
  *
+ * @return Error code
+ * @retval -1 No (more) commands for tfd
+ * @retval  0 A command was cleared
+ *
  * @par Side Effects:
  *	None
  *
- * @par MT-safe: Yes
+ * @par MT-safe: No, only the mbox reader may clear it
  *
  */
 int
-tpp_mbox_clear(tpp_mbox_t *mbox, tpp_que_elem_t **n, unsigned int tfd, short *cmdval, void **data)
+tpp_mbox_clear(tpp_mbox_t *mbox, unsigned int tfd, short *cmdval, void **data)
 {
+	tpp_mbox_slot_t *slot;
+	tpp_que_elem_t *n = NULL;
 	tpp_cmd_t *cmd;
+	unsigned int pos;
 	int ret = -1;
+
 	errno = 0;
 
+	/* published slots from the head on belong to the reader, mark the match as cleared */
+	for (pos = mbox->mbox_head; mbox->mbox_ring && pos != tpp_atomic_load(&mbox->mbox_tail); pos++) {
+		slot = &mbox->mbox_ring[pos & mbox->mbox_mask];
+		if (tpp_atomic_load(&slot->seq) != pos + 1)
+			continue;
+		if (slot->cmdval != TPP_MBOX_CLEARED && slot->tfd == tfd) {
+			if (cmdval)
+				*cmdval = slot->cmdval;
+			if (data)
+				*data = slot->data;
+			slot->cmdval = TPP_MBOX_CLEARED;
+			slot->data = NULL;
+			return 0;
+		}
+	}
+
+	if (tpp_atomic_load(&mbox->mbox_overflow) == 0)
+		return -1;
+
 	tpp_lock(&mbox->mbox_mutex);
 
-	while ((*n = TPP_QUE_NEXT(&mbox->mbox_queue, *n))) {
-		cmd = TPP_QUE_DATA(*n);
+	while ((n = TPP_QUE_NEXT(&mbox->mbox_queue, n))) {
+		cmd = TPP_QUE_DATA(n);
 		if (cmd && cmd->tfd == tfd) {
-			*n = tpp_que_del_elem(&mbox->mbox_queue, *n);
+			tpp_que_del_elem(&mbox->mbox_queue, n);
+			tpp_atomic_add(&mbox->mbox_overflow, -1);
 			if (cmdval)
 				*cmdval = cmd->cmdval;
 			if (data)
 				*data = cmd->data;
-			free(cmd);
+			tpp_pool_put(&cmd_pool, cmd);
 			ret = 0;
 			break;
 		}
 	}
-	mbox->mbox_size = 0;
 
 	tpp_unlock(&mbox->mbox_mutex);
 
@@ -1171,37 +1937,51 @@ tpp_mbox_clear(tpp_mbox_t *mbox, tpp_que_elem_t **n, unsigned int tfd, short *cm
 
 /**
  * @brief
- *	Send a command to the threads msg queue
+ *	Put a command in the ring of the mbox, or its overflow queue,
+ *	and wake up the reader
  *
  * @param[in] - mbox   - The mbox to post to
  * @param[in] - cmdval - The command or operation
  * @param[in] - tfd    - The Virtual file descriptor
  * @param[in] - data   - Any data pointer associated, if any (or NULL)
- * @param[in] - sz     - size of the data
  *
  * @return Error code
  * @retval -1 Failure
  * @retval  0 Success
  *
- * @par Side Effects:
- *	None
- *
- * @par MT-safe: Yes
+ * @par MT-safe: Yes, while the caller is counted in mbox_posters
  *
  */
-int
-tpp_mbox_post(tpp_mbox_t *mbox, unsigned int tfd, char cmdval, void *data, int sz)
+static int
+mbox_put(tpp_mbox_t *mbox, unsigned int tfd, char cmdval, void *data)
 {
+	tpp_mbox_slot_t *ring;
+	tpp_mbox_slot_t *slot;
 	tpp_cmd_t *cmd;
-	ssize_t s;
-#ifdef HAVE_SYS_EVENTFD_H
-	uint64_t u;
-#else
-	char b;
-#endif
+	unsigned int pos;
+	int diff;
 
 	errno = 0;
-	cmd = malloc(sizeof(tpp_cmd_t));
+
+	/* claim a slot in the ring, unless full or commands are waiting in overflow */
+	ring = mbox->mbox_ring;
+	while (ring && tpp_atomic_load(&mbox->mbox_overflow) == 0) {
+		pos = tpp_atomic_load(&mbox->mbox_tail);
+		slot = &ring[pos & mbox->mbox_mask];
+		diff = (int) (tpp_atomic_load(&slot->seq) - pos);
+		if (diff < 0)
+			break; /* ring is full */
+		if (diff == 0 && tpp_atomic_cas(&mbox->mbox_tail, pos, pos + 1)) {
+			slot->tfd = tfd;
+			slot->cmdval = cmdval;
+			slot->data = data;
+			tpp_atomic_store(&slot->seq, pos + 1); /* publish to the reader */
+			return mbox_notify(mbox);
+		}
+		/* lost the slot to another thread, retry */
+	}
+
+	cmd = tpp_pool_get(&cmd_pool);
 	if (!cmd) {
 		tpp_log(LOG_CRIT, __func__, "Out of memory in em_mbox_post for mbox=%s", mbox->mbox_name);
 		return -1;
@@ -1209,45 +1989,55 @@ tpp_mbox_post(tpp_mbox_t *mbox, unsigned int tfd, char cmdval, void *data, int s
 	cmd->cmdval = cmdval;
 	cmd->tfd = tfd;
 	cmd->data = data;
-	cmd->sz = sz;
 
-	/* add the cmd to the threads queue */
+	/* add the cmd to the overflow queue */
 	tpp_lock(&mbox->mbox_mutex);
 
 	if (tpp_enque(&mbox->mbox_queue, cmd) == NULL) {
 		tpp_unlock(&mbox->mbox_mutex);
-		free(cmd);
+		tpp_pool_put(&cmd_pool, cmd);
 		tpp_log(LOG_CRIT, __func__, "Out of memory in em_mbox_post for mbox=%s", mbox->mbox_name);
 		return -1;
 	}
-
-	/* add to the size to global size during enque */
-	mbox->mbox_size += sz;
+	tpp_atomic_add(&mbox->mbox_overflow, 1);
 
 	tpp_unlock(&mbox->mbox_mutex);
 
-	while (1) {
-		/* send a notification to the thread */
-#ifdef HAVE_SYS_EVENTFD_H
-		u = 1;
-		s = write(mbox->mbox_eventfd, &u, sizeof(uint64_t));
-		if (s == sizeof(uint64_t))
-			break;
-#else
-		b = 1;
-		s = tpp_pipe_write(mbox->mbox_pipe[1], &b, sizeof(char));
-		if (s == sizeof(char))
-			break;
-#endif
-		if (s == -1) {
-			if (errno == EAGAIN || errno == EWOULDBLOCK) {
-				/* pipe is full, which is fine, anyway we behave like edge triggered */
-				break;
-			} else if (errno != EINTR) {
-				tpp_log(LOG_CRIT, __func__, "mbox post failed for mbox=%s, errno=%d", mbox->mbox_name, errno);
-				return -1;
-			}
-		}
+	return mbox_notify(mbox);
+}
+
+/**
+ * @brief
+ *	Send a command to the threads msg queue
+ *
+ * @param[in] - mbox   - The mbox to post to
+ * @param[in] - cmdval - The command or operation
+ * @param[in] - tfd    - The Virtual file descriptor
+ * @param[in] - data   - Any data pointer associated, if any (or NULL)
+ *
+ * @return Error code
+ * @retval -1 Failure, errno EBADF if the mbox is being destroyed
+ * @retval  0 Success
+ *
+ * @par Side Effects:
+ *	None
+ *
+ * @par MT-safe: Yes
+ *
+ */
+int
+tpp_mbox_post(tpp_mbox_t *mbox, unsigned int tfd, char cmdval, void *data)
+{
+	int rc;
+
+	/* count in before looking at mbox_closing, see tpp_mbox_destroy */
+	tpp_atomic_add(&mbox->mbox_posters, 1);
+	if (tpp_atomic_load(&mbox->mbox_closing)) {
+		tpp_atomic_add(&mbox->mbox_posters, -1);
+		errno = EBADF;
+		return -1;
 	}
-	return 0;
+	rc = mbox_put(mbox, tfd, cmdval, data);
+	tpp_atomic_add(&mbox->mbox_posters, -1);
+	return rc;
 }
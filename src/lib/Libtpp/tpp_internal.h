@@ -57,6 +57,8 @@ extern "C" {
 
 #ifndef WIN32
 
+#include <sys/uio.h>
+
 #define tpp_pipe_cr(a) pipe(a)
 #define tpp_pipe_read(a, b, c) read(a, b, c)
 #define tpp_pipe_write(a, b, c) write(a, b, c)
@@ -69,6 +71,7 @@ extern "C" {
 #define tpp_sock_connect(a, b, c) connect(a, b, c)
 #define tpp_sock_recv(a, b, c, d) recv(a, b, c, d)
 #define tpp_sock_send(a, b, c, d) send(a, b, c, d)
+#define tpp_sock_writev(a, b, c) writev(a, b, c)
 #define tpp_sock_select(a, b, c, d, e) select(a, b, c, d, e)
 #define tpp_sock_close(a) close(a)
 #define tpp_sock_getsockopt(a, b, c, d, e) getsockopt(a, b, c, d, e)
@@ -91,6 +94,11 @@ int tpp_sock_bind(int, const struct sockaddr *, int);
 int tpp_sock_connect(int, const struct sockaddr *, int);
 int tpp_sock_recv(int, char *, int, int);
 int tpp_sock_send(int, const char *, int, int);
+struct iovec {
+	void *iov_base;
+	size_t iov_len;
+};
+int tpp_sock_writev(int, const struct iovec *, int);
 int tpp_sock_select(int, fd_set *, fd_set *, fd_set *, const struct timeval *);
 int tpp_sock_close(int);
 int tpp_sock_getsockopt(int, int, int, int *, int *);
@@ -134,13 +142,70 @@ typedef struct {
 	char family; /* Ipv4 or IPV6 etc */
 } tpp_addr_t;
 
+/*
+ * Reference counted data buffer, used when the same payload is part of
+ * several packets (for example, when a router fans out a multicast packet)
+ */
+typedef struct {
+	int refs;	/* number of chunks referring to this buffer */
+	char data[];	/* the payload */
+} tpp_shbuf_t;
+
 typedef struct {
 	pbs_list_link chunk_link;
-	char *data; /* pointer to the data buffer */
-	size_t len; /* length of the data buffer */
-	char *pos;  /* current position - till which data is consumed */
+	char *data;	     /* pointer to the data buffer */
+	size_t len;	     /* length of the data buffer */
+	char *pos;	     /* current position - till which data is consumed */
+	tpp_shbuf_t *shared; /* shared buffer data points into, if any */
 } tpp_chunk_t;
 
+/*
+ * Chunks are allocated with TPP_CHUNK_INLINE bytes of space right after
+ * the structure, so that packet headers and other small data need not be
+ * allocated separately
+ */
+#define TPP_CHUNK_INLINE 128
+#define TPP_CHUNK_INLINE_DATA(c) ((char *) (c) + sizeof(tpp_chunk_t))
+
+/*
+ * Atomic operations on ints (and pointers, the _ptr variants), all
+ * sequentially consistent
+ */
+#ifndef WIN32
+#define tpp_atomic_load(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define tpp_atomic_store(p, v) __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#define tpp_atomic_xchg(p, v) __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#define tpp_atomic_add(p, v) __atomic_add_fetch((p), (v), __ATOMIC_SEQ_CST)
+#define tpp_atomic_cas(p, o, n) __sync_bool_compare_and_swap((p), (o), (n))
+#define tpp_atomic_load_ptr(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define tpp_atomic_store_ptr(p, v) __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#else
+#define tpp_atomic_load(p) InterlockedCompareExchange((LONG volatile *) (p), 0, 0)
+#define tpp_atomic_store(p, v) InterlockedExchange((LONG volatile *) (p), (v))
+#define tpp_atomic_xchg(p, v) InterlockedExchange((LONG volatile *) (p), (v))
+#define tpp_atomic_add(p, v) (InterlockedExchangeAdd((LONG volatile *) (p), (v)) + (v))
+#define tpp_atomic_cas(p, o, n) (InterlockedCompareExchange((LONG volatile *) (p), (n), (o)) == (LONG) (o))
+#define tpp_atomic_load_ptr(p) InterlockedCompareExchangePointer((PVOID volatile *) (p), NULL, NULL)
+#define tpp_atomic_store_ptr(p, v) InterlockedExchangePointer((PVOID volatile *) (p), (v))
+#endif
+
+/* max number of iovecs gathered by a single writev */
+#define TPP_MAX_IOV 64
+
+/*
+ * Cache of free, fixed size objects shared by all threads.
+ * Free objects are linked through their first word.
+ */
+typedef struct {
+	pthread_mutex_t lock;
+	void *free_list;
+	int nfree;	 /* objects currently cached */
+	int max_free;	 /* max objects to cache, rest are freed */
+	size_t obj_size; /* size of each object, at least a pointer */
+} tpp_pool_t;
+
+#define TPP_POOL_INITIALIZER(sz, max) {PTHREAD_MUTEX_INITIALIZER, NULL, 0, (max), (sz)}
+
 /*
  * Packet structure used at various places to hold a data and the
  * current position to which data has been consumed or processed
@@ -251,13 +316,26 @@ typedef struct {
 	tpp_addr_t dest_addr;	/* dest host address of member */
 } tpp_mcast_pkt_info_t;
 
+/*
+ * Structure describing each member stream of a scatter multicast packet.
+ * A scatter packet has the mcast header, the info of every member, then
+ * the header meant for each member (in the same order, hdr_len bytes each)
+ * and finally the body shared by all members. Each member receives its
+ * own header followed by the body, as one message.
+ */
+typedef struct {
+	tpp_mcast_pkt_info_t minfo; /* member stream info, as for mcast */
+	unsigned int hdr_len;	    /* length of the header for this member */
+} tpp_scatter_pkt_info_t;
+
 #define SLOT_INC 1000
 
 #define TPP_SLOT_FREE 0
 #define TPP_SLOT_BUSY 1
 #define TPP_SLOT_DELETED 2
 
-#define TPP_MAX_MBOX_SIZE 640000
+#define TPP_MBOX_SLOTS 4096	 /* ring slots in the app and IO thread mboxes */
+#define TPP_SEND_MBOX_SLOTS 256 /* ring slots in the per connection send mboxes */
 
 /* tpp internal message header types */
 enum TPP_MSG_TYPES {
@@ -269,6 +347,7 @@ enum TPP_MSG_TYPES {
 	TPP_MCAST_DATA,
 	TPP_AUTH_CTX,
 	TPP_ENCRYPTED_DATA,
+	TPP_MCAST_SCATTER,
 	TPP_LAST_MSG
 };
 
@@ -287,6 +366,11 @@ enum TPP_MSG_TYPES {
 #define TPP_SEND_SIZE 8192
 #define TPP_COMPR_SIZE 8192
 
+/* codecs for data compression, see tpp_compress() */
+#define TPP_COMPR_ZLIB 0
+#define TPP_COMPR_LZ4 1
+#define TPP_COMPR_ZSTD 2
+
 /* tpp cmds used internally by the layer to notify messages between threads */
 #define TPP_CMD_SEND 1
 #define TPP_CMD_CLOSE 2
@@ -377,9 +461,19 @@ typedef struct {
 	unsigned int tfd;
 	char cmdval;
 	void *data;
-	int sz;
 } tpp_cmd_t;
 
+/*
+ * A slot in the mbox ring, seq tells whether the slot
+ * is free for producers or published for the reader
+ */
+typedef struct {
+	unsigned int seq;
+	unsigned int tfd;
+	char cmdval;
+	void *data;
+} tpp_mbox_slot_t;
+
 /*
  * mbox is the "message box" for each thread
  * When a thread wants to send a msg/cmd to another
@@ -389,10 +483,16 @@ typedef struct {
  */
 typedef struct {
 	char mbox_name[TPP_MBOX_NAME_SZ]; /* small price for debuggability */
-	pthread_mutex_t mbox_mutex;
-	tpp_que_t mbox_queue;
-	int max_size;
-	int mbox_size;
+	tpp_mbox_slot_t *mbox_ring;	  /* ring of commands */
+	unsigned int mbox_mask;		  /* number of ring slots - 1 */
+	unsigned int mbox_head;		  /* next slot to read, used by reader only */
+	unsigned int mbox_tail;		  /* next slot to claim by a poster */
+	int mbox_notified;		  /* reader woken up, and not idle since */
+	int mbox_posters;		  /* posts in progress, destroy waits for them */
+	int mbox_closing;		  /* set by destroy, turns new posts away */
+	pthread_mutex_t mbox_mutex;	  /* guards mbox_queue */
+	tpp_que_t mbox_queue;		  /* overflow queue, used when ring is full */
+	int mbox_overflow;		  /* number of commands in mbox_queue */
 #ifdef HAVE_SYS_EVENTFD_H
 	int mbox_eventfd;
 #else
@@ -412,6 +512,9 @@ typedef struct {
 typedef struct {
 	void *td;
 	char tppstaticbuf[TPP_GEN_BUF_SZ];
+	void *lz4_dctx;	 /* cached LZ4 decompression context */
+	void *zstd_cctx; /* cached zstd compression context */
+	void *zstd_dctx; /* cached zstd decompression context */
 } tpp_tls_t;
 
 typedef struct {
@@ -435,6 +538,7 @@ tpp_que_elem_t *tpp_que_ins_elem(tpp_que_t *, tpp_que_elem_t *, void *, int);
 /* End - routines and headers to manage FIFO queues */
 
 int tpp_send(int, void *, int);
+int tpp_send_buf(int, void **, int);
 int tpp_recv(int, void *, int);
 int tpp_ready_fds(int *, int);
 void *tpp_get_user_data(int);
@@ -446,6 +550,11 @@ tpp_tls_t *tpp_get_tls(void);
 char *mk_hostname(char *, int);
 struct sockaddr_in *tpp_localaddr(int);
 tpp_packet_t *tpp_bld_pkt(tpp_packet_t *, void *, int, int, void **);
+tpp_packet_t *tpp_bld_pkt_shared(tpp_packet_t *, tpp_shbuf_t *, int);
+tpp_shbuf_t *tpp_shbuf_create(void *, size_t);
+void tpp_shbuf_release(tpp_shbuf_t *);
+void *tpp_pool_get(tpp_pool_t *);
+void tpp_pool_put(tpp_pool_t *, void *);
 
 void tpp_router_terminate(void);
 void tpp_free_tls(void);
@@ -497,6 +606,12 @@ int tpp_set_keep_alive(int, struct tpp_config *);
 
 void *tpp_deflate(void *, unsigned int, unsigned int *);
 void *tpp_inflate(void *, unsigned int, unsigned int);
+int tpp_compr_init(struct tpp_config *);
+int tpp_compr_wanted(unsigned int, int);
+int tpp_compr_codec(tpp_addr_t *);
+void tpp_compr_learn(tpp_addr_t *, void *, unsigned int);
+void tpp_compr_forget(tpp_addr_t *);
+void *tpp_compress(void *, unsigned int, unsigned int *, int);
 void *tpp_multi_deflate_init(int);
 int tpp_multi_deflate_do(void *, int, void *, unsigned int);
 void *tpp_multi_deflate_done(void *, unsigned int *);
@@ -559,6 +674,9 @@ typedef struct {
 	int max_nfds;
 	pid_t init_pid;
 	em_event_t *events;
+#ifdef PBS_HAVE_IO_URING
+	void *uring; /* io_uring context, used instead of epoll_fd when set */
+#endif
 } epoll_context_t;
 
 #elif defined(PBS_USE_POLLSET)
@@ -601,8 +719,8 @@ int tpp_mbox_init(tpp_mbox_t *, char *, int);
 void tpp_mbox_destroy(tpp_mbox_t *);
 int tpp_mbox_monitor(void *, tpp_mbox_t *);
 int tpp_mbox_read(tpp_mbox_t *, unsigned int *, int *, void **);
-int tpp_mbox_clear(tpp_mbox_t *, tpp_que_elem_t **, unsigned int, short *, void **);
-int tpp_mbox_post(tpp_mbox_t *, unsigned int, char, void *, int);
+int tpp_mbox_clear(tpp_mbox_t *, unsigned int, short *, void **);
+int tpp_mbox_post(tpp_mbox_t *, unsigned int, char, void *);
 int tpp_mbox_getfd(tpp_mbox_t *);
 
 extern int tpp_going_down;
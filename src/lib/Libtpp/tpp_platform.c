@@ -371,6 +371,30 @@ tpp_sock_send(int s, const char *buf, int len, int flags)
 	return ret;
 }
 
+/*
+ * emulate writev() by sending the buffers one after the other,
+ * stopping at the first partial send, like writev() would
+ */
+int
+tpp_sock_writev(int s, const struct iovec *iov, int iovcnt)
+{
+	int i;
+	int ret;
+	int total = 0;
+
+	for (i = 0; i < iovcnt; i++) {
+		if (iov[i].iov_len == 0)
+			continue;
+		ret = tpp_sock_send(s, iov[i].iov_base, iov[i].iov_len, 0);
+		if (ret == -1)
+			return (total > 0) ? total : -1;
+		total += ret;
+		if (ret < (int) iov[i].iov_len)
+			break;
+	}
+	return total;
+}
+
 /*
  * wrapper to call windows select() and map windows
  * error code to errno and massage the return value
@@ -104,9 +104,10 @@ static int router_send_ctl_join(int tfd, void *data, void *c);
 static int router_pkt_presend_handler(int tfd, tpp_packet_t *pkt, void *c, void *extra);
 static int router_pkt_handler(int phy_fd, void *data, int len, void *c, void *extra);
 static int router_pkt_handler_inner(int tfd, void *buf, void **data_out, int len, void *c, void *extra);
+static int router_scatter(int tfd, tpp_mcast_pkt_hdr_t *mhdr, int len);
 static int router_close_handler(int phy_con, int error, void *c, void *extra);
 static int send_leaves_to_router(tpp_router_t *parent, tpp_router_t *target);
-static tpp_router_t *get_preferred_router(tpp_leaf_t *l, tpp_router_t *this_router, int *fd);
+static tpp_router_t *get_preferred_router(tpp_leaf_t *l, tpp_router_t *this_router, tpp_addr_t *src_host, unsigned int src_sd, int *fd);
 static int add_route_to_leaf(tpp_leaf_t *l, tpp_router_t *r, int index);
 static tpp_router_t *del_router_from_leaf(tpp_leaf_t *l, int tfd);
 static int leaf_get_router_index(tpp_leaf_t *l, tpp_router_t *r);
@@ -232,8 +233,11 @@ send_leaves_to_router(tpp_router_t *parent, tpp_router_t *target)
 			goto err;
 		}
 
-		/* create a new pkt and add the dhdr chunk first */
-		pkt = tpp_bld_pkt(NULL, NULL, sizeof(tpp_join_pkt_hdr_t), 1, (void **) &hdr);
+		/*
+		 * build the header and the addresses in a single chunk, a full
+		 * table sync sends one of these per leaf, so halve the chunks
+		 */
+		pkt = tpp_bld_pkt(NULL, NULL, sizeof(tpp_join_pkt_hdr_t) + sizeof(tpp_addr_t) * l->num_addrs, 1, (void **) &hdr);
 		if (!pkt) {
 			tpp_log(LOG_CRIT, __func__, "Failed to build packet");
 			goto err;
@@ -244,12 +248,7 @@ send_leaves_to_router(tpp_router_t *parent, tpp_router_t *target)
 		hdr->hop = 2;
 		hdr->index = index;
 		hdr->num_addrs = l->num_addrs;
-
-		/* add the addresses */
-		if (!tpp_bld_pkt(pkt, l->leaf_addrs, sizeof(tpp_addr_t) * l->num_addrs, 1, NULL)) {
-			tpp_log(LOG_CRIT, __func__, "Failed to build packet");
-			goto err;
-		}
+		memcpy((char *) hdr + sizeof(tpp_join_pkt_hdr_t), l->leaf_addrs, sizeof(tpp_addr_t) * l->num_addrs);
 
 		if (tpp_enque(&leaf_packets, pkt) == NULL) {
 			tpp_log(LOG_CRIT, __func__, "Out of memory enqueuing to leaf_packets");
@@ -280,6 +279,61 @@ err:
 	return -1;
 }
 
+/**
+ * @brief
+ *	Total length of an array of chunks
+ *
+ * @param[in] - chunks - Array of chunks
+ * @param[in] - count  - Number of chunks in the array
+ *
+ * @return	Sum of the chunk lengths
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static int
+chunks_len(tpp_chunk_t *chunks, int count)
+{
+	int j;
+	int len = 0;
+
+	for (j = 0; j < count; j++)
+		len += chunks[j].len;
+	return len;
+}
+
+/**
+ * @brief
+ *	Copy an array of chunks into one shared buffer, so that a message
+ *	fanned out to many peers is copied once rather than once per peer
+ *
+ * @param[in] - chunks - Array of chunks
+ * @param[in] - count  - Number of chunks in the array
+ *
+ * @return	The shared buffer, holding one reference for the caller
+ * @retval	NULL - Out of memory
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static tpp_shbuf_t *
+shbuf_from_chunks(tpp_chunk_t *chunks, int count)
+{
+	tpp_shbuf_t *buf;
+	char *p;
+	int j;
+
+	if ((buf = tpp_shbuf_create(NULL, chunks_len(chunks, count))) == NULL)
+		return NULL;
+
+	p = buf->data;
+	for (j = 0; j < count; j++) {
+		memcpy(p, chunks[j].data, chunks[j].len);
+		p += chunks[j].len;
+	}
+	return buf;
+}
+
 /**
  * @brief
  *	Broadcast the given data packet to all the routers connected to this
@@ -306,6 +360,8 @@ broadcast_to_my_routers(tpp_chunk_t *chunks, int count, int origin_tfd)
 	tpp_router_t *r;
 	tpp_que_t router_list;
 	void *idx_ctx = NULL;
+	tpp_shbuf_t *shbuf = NULL;
+	int shbuf_len = chunks_len(chunks, count);
 
 	TPP_QUE_CLEAR(&router_list);
 
@@ -322,15 +378,14 @@ broadcast_to_my_routers(tpp_chunk_t *chunks, int count, int origin_tfd)
 	pbs_idx_free_ctx(idx_ctx);
 
 	while ((r = (tpp_router_t *) tpp_deque(&router_list))) {
-		int j;
-		tpp_packet_t *pkt = NULL;
+		tpp_packet_t *pkt;
 
-		for (j = 0; j < count; j++) {
-			pkt = tpp_bld_pkt(pkt, chunks[j].data, chunks[j].len, 1, NULL);
-			if (!pkt) {
-				tpp_log(LOG_CRIT, __func__, "Failed to build packet");
-				goto err;
-			}
+		if (shbuf == NULL && (shbuf = shbuf_from_chunks(chunks, count)) == NULL)
+			goto err;
+
+		if ((pkt = tpp_bld_pkt_shared(NULL, shbuf, shbuf_len)) == NULL) {
+			tpp_log(LOG_CRIT, __func__, "Failed to build packet");
+			goto err;
 		}
 
 		if (tpp_transport_vsend(r->conn_fd, pkt) != 0) {
@@ -342,10 +397,12 @@ broadcast_to_my_routers(tpp_chunk_t *chunks, int count, int origin_tfd)
 			/* vsend will free packets even in case of failure */
 		}
 	}
+	tpp_shbuf_release(shbuf); /* packets still being sent hold their own references */
 	return 0;
 
 err:
 	tpp_log(LOG_CRIT, __func__, "Error broadcasting to my routers");
+	tpp_shbuf_release(shbuf);
 	while (tpp_deque(&router_list))
 		; /* drain the list, dont free packets, transport will free */
 	return -1;
@@ -383,6 +440,8 @@ broadcast_to_my_leaves(tpp_chunk_t *chunks, int count, int origin_tfd, int type)
 	void *traverse_idx = NULL;
 	void *idx_ctx = NULL;
 	tpp_que_t leaf_list;
+	tpp_shbuf_t *shbuf = NULL;
+	int shbuf_len = chunks_len(chunks, count);
 
 	TPP_QUE_CLEAR(&leaf_list);
 
@@ -412,15 +471,14 @@ broadcast_to_my_leaves(tpp_chunk_t *chunks, int count, int origin_tfd, int type)
 	pbs_idx_free_ctx(idx_ctx);
 
 	while ((l = (tpp_leaf_t *) tpp_deque(&leaf_list))) {
-		int j;
-		tpp_packet_t *pkt = NULL;
+		tpp_packet_t *pkt;
 
-		for (j = 0; j < count; j++) {
-			pkt = tpp_bld_pkt(pkt, chunks[j].data, chunks[j].len, 1, NULL);
-			if (!pkt) {
-				tpp_log(LOG_CRIT, __func__, "Failed to build packet");
-				goto err;
-			}
+		if (shbuf == NULL && (shbuf = shbuf_from_chunks(chunks, count)) == NULL)
+			goto err;
+
+		if ((pkt = tpp_bld_pkt_shared(NULL, shbuf, shbuf_len)) == NULL) {
+			tpp_log(LOG_CRIT, __func__, "Failed to build packet");
+			goto err;
 		}
 
 		if (tpp_transport_vsend(l->conn_fd, pkt) != 0) {
@@ -431,10 +489,12 @@ broadcast_to_my_leaves(tpp_chunk_t *chunks, int count, int origin_tfd, int type)
 			/* vsend will free packets even in case of failure */
 		}
 	}
+	tpp_shbuf_release(shbuf); /* packets still being sent hold their own references */
 	return 0;
 
 err:
 	tpp_log(LOG_CRIT, __func__, "Error broadcasting to my leaves");
+	tpp_shbuf_release(shbuf);
 	while (tpp_deque(&leaf_list))
 		; /* drain the list, dont free pacets, transport will free */
 	return -1;
@@ -1024,6 +1084,341 @@ router_pkt_presend_handler(int tfd, tpp_packet_t *pkt, void *c, void *extra)
 	return (tpp_encrypt_pkt(authdata, pkt));
 }
 
+/**
+ * @brief
+ *	Build the data packet for one member of a scatter multicast packet, made
+ *	of the member's own header followed by the shared body.
+ *
+ * @param[in] mhdr     - The scatter packet
+ * @param[in] info     - The info of the member
+ * @param[in] hdr      - The header of the member
+ * @param[in] shbody   - The shared body, or NULL if there is none
+ * @param[in] body_len - The length of the body
+ *
+ * @return Packet structure
+ * @retval NULL - Failure (Out of memory)
+ * @retval !NULL - Address of packet structure
+ *
+ * @par Side Effects:
+ *	None
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static tpp_packet_t *
+scatter_bld_member(tpp_mcast_pkt_hdr_t *mhdr, tpp_scatter_pkt_info_t *info, char *hdr, tpp_shbuf_t *shbody, unsigned int body_len)
+{
+	tpp_packet_t *pkt;
+	tpp_data_pkt_hdr_t *shdr = NULL;
+	unsigned int hdr_len = ntohl(info->hdr_len);
+
+	pkt = tpp_bld_pkt(NULL, NULL, sizeof(tpp_data_pkt_hdr_t), 1, (void **) &shdr);
+	if (!pkt)
+		return NULL;
+
+	shdr->type = TPP_DATA;
+	shdr->src_sd = info->minfo.src_sd;
+	shdr->src_magic = info->minfo.src_magic;
+	shdr->dest_sd = info->minfo.dest_sd;
+	shdr->totlen = htonl(hdr_len + body_len);
+	memcpy(&shdr->src_addr, &mhdr->src_addr, sizeof(tpp_addr_t));
+	memcpy(&shdr->dest_addr, &info->minfo.dest_addr, sizeof(tpp_addr_t));
+
+	/* a failed tpp_bld_pkt frees the packet built so far */
+	if (hdr_len > 0 && !tpp_bld_pkt(pkt, hdr, hdr_len, 1, NULL))
+		return NULL;
+	if (shbody && !tpp_bld_pkt_shared(pkt, shbody, body_len))
+		return NULL;
+
+	return pkt;
+}
+
+/**
+ * @brief
+ *	Build the smaller scatter packet carrying the members of a scatter
+ *	multicast packet that sit behind the same pbs_comm. It is sent on
+ *	uncompressed, with hop=1 so it is not split again.
+ *
+ * @param[in] mhdr     - The scatter packet
+ * @param[in] infos    - The infos of all members of the scatter packet
+ * @param[in] hdrs     - The headers of all members of the scatter packet
+ * @param[in] members  - The index of each member to carry
+ * @param[in] nmembers - The number of members to carry
+ * @param[in] info_len - The length of the infos and headers of these members
+ * @param[in] shbody   - The shared body, or NULL if there is none
+ * @param[in] body_len - The length of the body
+ *
+ * @return Packet structure
+ * @retval NULL - Failure (Out of memory)
+ * @retval !NULL - Address of packet structure
+ *
+ * @par Side Effects:
+ *	None
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static tpp_packet_t *
+scatter_bld_group(tpp_mcast_pkt_hdr_t *mhdr, tpp_scatter_pkt_info_t *infos, char **hdrs, int *members, int nmembers, unsigned int info_len, tpp_shbuf_t *shbody, unsigned int body_len)
+{
+	tpp_mcast_pkt_hdr_t *t_mhdr = NULL;
+	tpp_packet_t *pkt;
+	char *t_info;
+	char *p;
+	int k;
+	int m;
+
+	pkt = tpp_bld_pkt(NULL, mhdr, sizeof(tpp_mcast_pkt_hdr_t), 1, (void **) &t_mhdr);
+	if (!pkt)
+		return NULL;
+	t_mhdr->hop = 1;
+	t_mhdr->num_streams = htonl(nmembers);
+	t_mhdr->info_len = htonl(info_len);
+	t_mhdr->info_cmprsd_len = 0;
+
+	if ((t_info = malloc(info_len)) == NULL) {
+		tpp_log(LOG_CRIT, __func__, "Out of memory allocating scatter buffer of %u bytes", info_len);
+		tpp_free_pkt(pkt);
+		return NULL;
+	}
+	p = t_info;
+	for (m = 0; m < nmembers; m++) {
+		memcpy(p, &infos[members[m]], sizeof(tpp_scatter_pkt_info_t));
+		p += sizeof(tpp_scatter_pkt_info_t);
+	}
+	for (m = 0; m < nmembers; m++) {
+		k = members[m];
+		memcpy(p, hdrs[k], ntohl(infos[k].hdr_len));
+		p += ntohl(infos[k].hdr_len);
+	}
+
+	/* a failed tpp_bld_pkt frees the packet built so far */
+	if (!tpp_bld_pkt(pkt, t_info, info_len, 0, NULL)) {
+		free(t_info);
+		return NULL;
+	}
+	if (shbody && !tpp_bld_pkt_shared(pkt, shbody, body_len))
+		return NULL;
+
+	return pkt;
+}
+
+/**
+ * @brief
+ *	Split a scatter multicast packet. Members attached to this pbs_comm get
+ *	a data packet with their own header and the body, while members behind
+ *	other pbs_comms are grouped into one smaller scatter packet per pbs_comm.
+ *	Members that cannot be grouped, or whose group packet cannot be built,
+ *	are sent on to their pbs_comm as plain data packets instead.
+ *
+ * @param[in] tfd  - The physical connection over which the packet arrived
+ * @param[in] mhdr - The scatter packet
+ * @param[in] len  - The length of the scatter packet
+ *
+ * @return Error code
+ * @retval -1 - Failure, packet was malformed
+ * @retval  0 - Success
+ *
+ * @par Side Effects:
+ *	None
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static int
+router_scatter(int tfd, tpp_mcast_pkt_hdr_t *mhdr, int len)
+{
+	typedef struct {
+		int target_fd; /* target comm fd */
+		char *router_name;
+		int num_streams; /* number of members in members[] */
+		int *members;	 /* index of each member in the incoming packet */
+		unsigned int info_len;
+	} target_scatter_t;
+
+	target_scatter_t *rlist = NULL;
+	int rsize = 0;
+	int csize = 0;
+	tpp_router_t *target_router;
+	int target_fd = -1;
+	tpp_addr_t *src_host = &mhdr->src_addr;
+	unsigned char orig_hop = mhdr->hop;
+	tpp_scatter_pkt_info_t *infos;
+	void *info_base = NULL;
+	void *info_start = (char *) mhdr + sizeof(tpp_mcast_pkt_hdr_t);
+	char **hdrs = NULL;
+	void *body;
+	unsigned int body_len;
+	unsigned int hdrs_len = 0;
+	tpp_shbuf_t *shbody = NULL;
+	tpp_packet_t *pkt;
+	unsigned int cmprsd_len = ntohl(mhdr->info_cmprsd_len);
+	unsigned int num_streams = ntohl(mhdr->num_streams);
+	unsigned int info_len = ntohl(mhdr->info_len);
+	unsigned int region_len = (cmprsd_len > 0) ? cmprsd_len : info_len;
+	char msg[TPP_GEN_BUF_SZ];
+	void *tmp;
+	int rc = -1;
+	int i, k, m;
+
+	if (len < (int) sizeof(tpp_mcast_pkt_hdr_t) || region_len > len - sizeof(tpp_mcast_pkt_hdr_t) || num_streams > info_len / sizeof(tpp_scatter_pkt_info_t)) {
+		tpp_log(LOG_CRIT, __func__, "tfd=%d, Bad scatter packet from %s", tfd, tpp_netaddr(src_host));
+		return -1;
+	}
+	body_len = len - sizeof(tpp_mcast_pkt_hdr_t) - region_len;
+	body = (char *) info_start + region_len;
+
+	if (cmprsd_len > 0) {
+#ifdef PBS_COMPRESSION_ENABLED
+		info_base = tpp_inflate(info_start, cmprsd_len, info_len);
+#endif
+		if (info_base == NULL) {
+			tpp_log(LOG_CRIT, __func__, "Decompression of scatter hdr failed");
+			return -1;
+		}
+	} else
+		info_base = info_start;
+	infos = info_base;
+
+	tpp_log(LOG_INFO, NULL, "tfd=%d, SCATTER packet from %s, %u member streams, cmprsd_len=%u, info_len=%u, len=%u",
+		tfd, tpp_netaddr(src_host), num_streams, cmprsd_len, info_len, body_len);
+
+	/* the member headers follow the infos, locate each of them */
+	if (num_streams > 0 && (hdrs = malloc(sizeof(char *) * num_streams)) == NULL) {
+		tpp_log(LOG_CRIT, __func__, "Out of memory allocating scatter headers");
+		goto scatter_err;
+	}
+	hdrs_len = num_streams * sizeof(tpp_scatter_pkt_info_t);
+	for (k = 0; k < (int) num_streams; k++) {
+		unsigned int hdr_len = ntohl(infos[k].hdr_len);
+		if (hdr_len > info_len - hdrs_len)
+			break;
+		hdrs[k] = (char *) info_base + hdrs_len;
+		hdrs_len += hdr_len;
+	}
+	if (k < (int) num_streams || hdrs_len != info_len) {
+		tpp_log(LOG_CRIT, __func__, "tfd=%d, Bad scatter packet from %s", tfd, tpp_netaddr(src_host));
+		goto scatter_err;
+	}
+
+	if (body_len > 0 && (shbody = tpp_shbuf_create(body, body_len)) == NULL)
+		goto scatter_err;
+
+	rc = 0; /* from here on, failures affect delivery, not the connection */
+	for (k = 0; k < (int) num_streams; k++) {
+		tpp_mcast_pkt_info_t *minfo = &infos[k].minfo;
+		unsigned int hdr_len = ntohl(infos[k].hdr_len);
+		tpp_addr_t *dest_host = &minfo->dest_addr;
+		unsigned int src_sd = ntohl(minfo->src_sd);
+		tpp_leaf_t *l = NULL;
+		int found = -1;
+
+		tpp_read_lock(&router_lock);
+		pbs_idx_find(cluster_leaves_idx, (void **) &dest_host, (void **) &l, NULL);
+		if (l == NULL) {
+			tpp_unlock_rwlock(&router_lock);
+			snprintf(msg, sizeof(msg), "pbs_comm:%s: Dest not found at pbs_comm", tpp_netaddr(&this_router->router_addr));
+			log_noroute(src_host, dest_host, src_sd, msg);
+			tpp_send_ctl_msg(tfd, TPP_MSG_NOROUTE, src_host, dest_host, src_sd, 0, msg);
+			continue;
+		}
+
+		/* find a router that is still connected */
+		target_router = get_preferred_router(l, this_router, src_host, src_sd, &target_fd);
+		tpp_unlock_rwlock(&router_lock);
+
+		if (target_router == NULL) {
+			snprintf(msg, sizeof(msg), "pbs_comm:%s: No target pbs_comm found", tpp_netaddr(&this_router->router_addr));
+			log_noroute(src_host, dest_host, src_sd, msg);
+			tpp_send_ctl_msg(tfd, TPP_MSG_NOROUTE, src_host, dest_host, src_sd, 0, msg);
+			continue;
+		}
+
+		if (target_router != this_router) {
+			if (orig_hop != 0)
+				continue;
+
+			/* group by target comm, checking the most recently added first */
+			for (i = csize - 1; i >= 0; i--) {
+				if (rlist[i].target_fd == target_fd) {
+					found = i;
+					break;
+				}
+			}
+
+			if (found == -1) {
+				if (csize == rsize) {
+					tmp = realloc(rlist, sizeof(target_scatter_t) * (rsize + RLIST_INC));
+					if (tmp) {
+						rsize += RLIST_INC;
+						rlist = tmp;
+					}
+				}
+				if (csize < rsize && (rlist[csize].members = malloc(sizeof(int) * num_streams)) != NULL) {
+					found = csize++;
+					rlist[found].target_fd = target_fd;
+					rlist[found].router_name = target_router->router_name;
+					rlist[found].num_streams = 0;
+					rlist[found].info_len = 0;
+				} else
+					tpp_log(LOG_CRIT, __func__, "Out of memory grouping scatter members, sending member on by itself");
+			}
+			if (found != -1) {
+				rlist[found].members[rlist[found].num_streams++] = k;
+				rlist[found].info_len += sizeof(tpp_scatter_pkt_info_t) + hdr_len;
+				continue;
+			}
+		}
+
+		/* a leaf of this comm, or a member that could not be grouped */
+		if ((pkt = scatter_bld_member(mhdr, &infos[k], hdrs[k], shbody, body_len)) == NULL) {
+			tpp_log(LOG_CRIT, __func__, "Failed to build scatter indiv pkt for %s", tpp_netaddr(dest_host));
+			continue;
+		}
+		if (tpp_transport_vsend(target_fd, pkt) != 0) {
+			tpp_log(LOG_ERR, __func__, "Failed to send scatter indiv pkt");
+			if (target_router == this_router)
+				tpp_transport_close(target_fd);
+		}
+	}
+
+	for (i = 0; i < csize; i++) {
+		pkt = scatter_bld_group(mhdr, infos, hdrs, rlist[i].members, rlist[i].num_streams, rlist[i].info_len, shbody, body_len);
+		if (pkt) {
+			tpp_log(LOG_INFO, __func__, "Sending SCATTER packet to %s, num_streams=%d", rlist[i].router_name, rlist[i].num_streams);
+			if (tpp_transport_vsend(rlist[i].target_fd, pkt) != 0)
+				tpp_log(LOG_ERR, __func__, "send failed: errno = %d", errno);
+			continue;
+		}
+
+		/* the peer comm routes plain data packets like any others */
+		tpp_log(LOG_CRIT, __func__, "Failed to build SCATTER packet to %s, sending %d members on by themselves",
+			rlist[i].router_name, rlist[i].num_streams);
+		for (m = 0; m < rlist[i].num_streams; m++) {
+			k = rlist[i].members[m];
+			if ((pkt = scatter_bld_member(mhdr, &infos[k], hdrs[k], shbody, body_len)) == NULL) {
+				tpp_log(LOG_CRIT, __func__, "Failed to build scatter indiv pkt for %s", tpp_netaddr(&infos[k].minfo.dest_addr));
+				continue;
+			}
+			if (tpp_transport_vsend(rlist[i].target_fd, pkt) != 0) {
+				tpp_log(LOG_ERR, __func__, "send failed: errno = %d", errno);
+				break;
+			}
+		}
+	}
+
+scatter_err:
+	if (cmprsd_len > 0)
+		free(info_base);
+	free(hdrs);
+	tpp_shbuf_release(shbody); /* packets still being sent hold their own references */
+	for (i = 0; i < csize; i++)
+		free(rlist[i].members);
+	free(rlist);
+
+	return rc;
+}
+
 /**
  * @brief
  *	Wrapper function for the router to handle incoming data. This
@@ -1592,6 +1987,7 @@ again:
 			void *info_start = (char *) dhdr + sizeof(tpp_mcast_pkt_hdr_t);
 			unsigned int payload_len;
 			void *payload;
+			tpp_shbuf_t *shpayload = NULL; /* payload shared by all the outgoing packets */
 			unsigned int cmprsd_len = ntohl(mhdr->info_cmprsd_len);
 			unsigned int num_streams = ntohl(mhdr->num_streams);
 			unsigned int info_len = ntohl(mhdr->info_len);
@@ -1652,7 +2048,7 @@ again:
 				}
 
 				/* find a router that is still connected */
-				target_router = get_preferred_router(l, this_router, &target_fd);
+				target_router = get_preferred_router(l, this_router, src_host, src_sd, &target_fd);
 				tpp_unlock_rwlock(&router_lock);
 
 				if (target_router == NULL) {
@@ -1680,7 +2076,11 @@ again:
 					memcpy(&shdr->src_addr, &mhdr->src_addr, sizeof(tpp_addr_t));
 					memcpy(&shdr->dest_addr, &minfo->dest_addr, sizeof(tpp_addr_t));
 
-					if (!tpp_bld_pkt(pkt, payload, payload_len, 1, NULL)) {
+					if (shpayload == NULL && (shpayload = tpp_shbuf_create(payload, payload_len)) == NULL) {
+						tpp_free_pkt(pkt);
+						goto mcast_err;
+					}
+					if (!tpp_bld_pkt_shared(pkt, shpayload, payload_len)) {
 						tpp_log(LOG_CRIT, __func__, "Failed to build packet");
 						goto mcast_err;
 					}
@@ -1795,7 +2195,11 @@ again:
 						goto mcast_err;
 					}
 
-					if (!tpp_bld_pkt(pkt, payload, payload_len, 1, NULL)) {
+					if (shpayload == NULL && (shpayload = tpp_shbuf_create(payload, payload_len)) == NULL) {
+						tpp_free_pkt(pkt);
+						goto mcast_err;
+					}
+					if (!tpp_bld_pkt_shared(pkt, shpayload, payload_len)) {
 						tpp_log(LOG_CRIT, __func__, "Failed to build packet");
 						goto mcast_err;
 					}
@@ -1809,6 +2213,8 @@ again:
 			if (cmprsd_len > 0)
 				free(minfo_base);
 
+			tpp_shbuf_release(shpayload); /* packets still being sent hold their own references */
+
 			free(rlist); /* minfo_buf which was allocated will be freed when sent */
 
 			tpp_log(LOG_INFO, NULL, "mcast done");
@@ -1816,6 +2222,9 @@ again:
 			return 0;
 		} break; /* TPP_MCAST_DATA */
 
+		case TPP_MCAST_SCATTER:
+			return router_scatter(tfd, (tpp_mcast_pkt_hdr_t *) dhdr, len);
+
 		case TPP_DATA:
 		case TPP_CLOSE_STRM: {
 			tpp_leaf_t *l = NULL;
@@ -1839,7 +2248,7 @@ again:
 			}
 
 			/* find a router that is still connected */
-			target_router = get_preferred_router(l, this_router, &target_fd);
+			target_router = get_preferred_router(l, this_router, src_host, src_sd, &target_fd);
 			tpp_unlock_rwlock(&router_lock);
 
 			if (target_router == NULL) {
@@ -1888,7 +2297,7 @@ again:
 					return 0;
 				}
 				/* find a router that is still connected */
-				target_router = get_preferred_router(l, this_router, &target_fd);
+				target_router = get_preferred_router(l, this_router, NULL, 0, &target_fd);
 
 				tpp_unlock_rwlock(&router_lock);
 				if (target_router == NULL) {
@@ -1925,9 +2334,15 @@ again:
  *	If not, then search in the list of routes for the leaf starting from index
  *	0 (since its sorted on preference), finding a router that is still
  *	connected, i.e., r[i]->conn_fd is not -1.
+ *	With multipath forwarding on, a stream is instead pinned to one of
+ *	the connected routes by a hash of its source, so that the streams to
+ *	a leaf spread over every pbs_comm it is connected to while the
+ *	packets of each stream still stay in order.
  *
  * @param[in] - l 	- Pointer to the leaf for which to find route
  * @param[in] - this_router - Pointer to the local router
+ * @param[in] - src_host - Source of the stream, NULL for the preferred route
+ * @param[in] - src_sd - Source stream descriptor
  * @param[out] - fd - fd of the chosen router
  *
  * @return	Router to be used
@@ -1941,9 +2356,11 @@ again:
  *
  */
 static tpp_router_t *
-get_preferred_router(tpp_leaf_t *l, tpp_router_t *this_router, int *fd)
+get_preferred_router(tpp_leaf_t *l, tpp_router_t *this_router, tpp_addr_t *src_host, unsigned int src_sd, int *fd)
 {
 	int i;
+	int nconn = 0;
+	unsigned int flow;
 	tpp_router_t *r = NULL;
 
 	*fd = -1;
@@ -1961,13 +2378,33 @@ get_preferred_router(tpp_leaf_t *l, tpp_router_t *this_router, int *fd)
 			for (i = 0; i < l->tot_routers; i++) {
 				if (l->r[i]) {
 					if (l->r[i]->conn_fd != -1) {
-						r = l->r[i];
-						*fd = r->conn_fd;
-						break;
+						if (r == NULL) {
+							r = l->r[i];
+							*fd = r->conn_fd;
+						}
+						nconn++;
+						if (src_host == NULL || tpp_conf->multipath == 0)
+							break;
 					}
 				}
 			}
 		}
+		if (nconn > 1) {
+			/* FNV-1a over the stream's source, skipping struct padding */
+			flow = 2166136261U;
+			for (i = 0; i < 4; i++)
+				flow = (flow ^ (unsigned int) src_host->ip[i]) * 16777619U;
+			flow = (flow ^ (unsigned short) src_host->port) * 16777619U;
+			flow = (flow ^ src_sd) * 16777619U;
+			nconn = flow % nconn;
+			for (i = 0; i < l->tot_routers; i++) {
+				if (l->r[i] && l->r[i]->conn_fd != -1 && nconn-- == 0) {
+					r = l->r[i];
+					*fd = r->conn_fd;
+					break;
+				}
+			}
+		}
 	}
 	return r;
 }
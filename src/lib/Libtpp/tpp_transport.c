@@ -169,6 +169,17 @@ typedef struct {
 	int need_resvport; /* bind to resv port? */
 } conn_param_t;
 
+/* how many bytes of queued packets to coalesce into one write at most */
+#define TPP_SEND_BATCH_BYTES (256 * 1024)
+
+/* counters of how well sends to a connection were coalesced */
+typedef struct {
+	unsigned long pkts;   /* packets sent */
+	unsigned long writes; /* writev calls that sent data */
+	unsigned long bytes;  /* bytes sent */
+	int max_batch;	      /* most packets completed by one writev */
+} tpp_send_stats_t;
+
 /*
  * Structure that holds information about each TCP connection between leaves and
  * router or between routers and routers. A single IO thread can handle multiple
@@ -185,7 +196,10 @@ typedef struct {
 
 	tpp_mbox_t send_mbox;	     /* mbox of pkts to send */
 	tpp_chunk_t scratch;	     /* scratch to work on incoming data */
-	tpp_packet_t *curr_send_pkt; /* current packet dequed from send_mbox to be sent out  */
+	tpp_packet_t *send_batch[TPP_MAX_IOV]; /* packets dequed from send_mbox, being sent out, in order */
+	int send_batch_cnt;		       /* number of packets in send_batch */
+	size_t send_batch_len;		       /* bytes of send_batch not yet sent */
+	tpp_send_stats_t stats;		       /* send coalescing statistics */
 	thrd_data_t *td;	     /* connections controller thread */
 
 	tpp_context_t *ctx; /* upper layers context information */
@@ -589,7 +603,7 @@ tpp_transport_init(struct tpp_config *conf)
 		}
 
 		snprintf(mbox_name, sizeof(mbox_name), "Th_%d", (char) i);
-		if (tpp_mbox_init(&thrd_pool[i]->mbox, mbox_name, -1) != 0) {
+		if (tpp_mbox_init(&thrd_pool[i]->mbox, mbox_name, TPP_MBOX_SLOTS) != 0) {
 			tpp_log(LOG_CRIT, __func__, "tpp_mbox_init() error, errno=%d", errno);
 			return -1;
 		}
@@ -719,7 +733,7 @@ alloc_conn(int tfd)
 	conn->extra = NULL;
 
 	snprintf(mbox_name, sizeof(mbox_name), "Conn_%d", conn->sock_fd);
-	if (tpp_mbox_init(&conn->send_mbox, mbox_name, TPP_MAX_MBOX_SIZE) != 0) {
+	if (tpp_mbox_init(&conn->send_mbox, mbox_name, TPP_SEND_MBOX_SLOTS) != 0) {
 		free(conn);
 		tpp_log(LOG_CRIT, __func__, "tpp_mbox_init() error, errno=%d", errno);
 		return NULL;
@@ -923,7 +937,7 @@ get_transport_atomic(int tfd, int *slot_state)
 
 /**
  * @brief
- *	Lock the strmarray lock and send post data on the
+ *	Lock the cons array lock and send post data on the
  *	threads mbox. The check for the tfd being up,
  *	and the posting of data into the manager thread's mbox
  *	are done as an atomic operation, i.e., under the cons_array_lock.
@@ -964,13 +978,13 @@ tpp_post_cmd(int tfd, char cmd, tpp_packet_t *pkt)
 	if (cmd == TPP_CMD_SEND) {
 		/* data associated that needs to be sent out, put directly into target mbox */
 		/* write to worker threads send pipe */
-		rc = tpp_mbox_post(&conn->send_mbox, tfd, cmd, (void *) pkt, pkt->totlen);
+		rc = tpp_mbox_post(&conn->send_mbox, tfd, cmd, (void *) pkt);
 		if (rc != 0)
 			return rc;
 	}
 
 	/* write to worker threads send pipe, to wakeup thread */
-	rc = tpp_mbox_post(&td->mbox, tfd, cmd, NULL, 0);
+	rc = tpp_mbox_post(&td->mbox, tfd, cmd, NULL);
 	return rc;
 }
 
@@ -1147,7 +1161,7 @@ assign_to_worker(int tfd, int delay, thrd_data_t *td)
 	} else
 		conn->td = td;
 
-	if (tpp_mbox_post(&conn->td->mbox, tfd, TPP_CMD_ASSIGN, (void *) (long) delay, 0) != 0)
+	if (tpp_mbox_post(&conn->td->mbox, tfd, TPP_CMD_ASSIGN, (void *) (long) delay) != 0)
 		tpp_log(LOG_CRIT, __func__, "tfd=%d, Error writing to mbox", tfd);
 
 	return 0;
@@ -1698,7 +1712,6 @@ handle_disconnect(phy_conn_t *conn)
 	int tfd;
 	tpp_packet_t *pkt;
 	pbs_socklen_t len = sizeof(error);
-	tpp_que_elem_t *n = NULL;
 
 	if (conn == NULL || conn->net_state == TPP_CONN_DISCONNECTED)
 		return 1;
@@ -1714,6 +1727,11 @@ handle_disconnect(phy_conn_t *conn)
 	conn->net_state = TPP_CONN_DISCONNECTED;
 	conn->lasterr = error;
 
+	if (conn->stats.writes > 0)
+		tpp_log(LOG_DEBUG, NULL, "tfd=%d, sent %lu pkts, %lu bytes in %lu writes, %.1f pkts per write, max %d",
+			conn->sock_fd, conn->stats.pkts, conn->stats.bytes, conn->stats.writes,
+			(double) conn->stats.pkts / conn->stats.writes, conn->stats.max_batch);
+
 	tfd = conn->sock_fd; /* store this since close_handler could unset this */
 
 	if (the_close_handler)
@@ -1730,8 +1748,7 @@ handle_disconnect(phy_conn_t *conn)
 	 * mbox (since this thread is the connection's manager
 	 *
 	 */
-	n = NULL;
-	while (tpp_mbox_clear(&conn->td->mbox, &n, tfd, &cmd, (void **) &pkt) == 0)
+	while (tpp_mbox_clear(&conn->td->mbox, tfd, &cmd, (void **) &pkt) == 0)
 		tpp_free_pkt(pkt);
 
 	conns_array[tfd].slot_state = TPP_SLOT_FREE;
@@ -1897,8 +1914,16 @@ add_pkt(phy_conn_t *conn)
 
 /**
  * @brief
- *	Loop over the list of queued data and send out packet by packet
- *	Stop if sending would block.
+ *	Loop over the list of queued data and send it out, coalescing the
+ *	packets queued so far into one writev (up to TPP_MAX_IOV chunks and
+ *	TPP_SEND_BATCH_BYTES bytes). Stop if sending would block.
+ *
+ * @par Functionality:
+ *	Nothing is held back waiting for more packets, so this adds no delay,
+ *	but small packets queued while the thread was busy or the socket was
+ *	full go out together. Packets are taken off the send_mbox into the
+ *	connection's send batch, calling the presend handler for each as it
+ *	is taken, and are freed as soon as they are fully written.
  *
  * @param[in] conn - The physical connection
  *
@@ -1911,11 +1936,14 @@ add_pkt(phy_conn_t *conn)
 static void
 send_data(phy_conn_t *conn)
 {
-	tpp_chunk_t *p = NULL;
+	tpp_chunk_t *c;
 	tpp_packet_t *pkt = NULL;
 	ssize_t rc;
-	int curr_pkt_done = 0;
 	size_t tosend;
+	struct iovec iov[TPP_MAX_IOV];
+	int niov;
+	int npkts;
+	int i;
 
 	/*
 	 * if a socket is still connecting, we will wait to send out data,
@@ -1925,69 +1953,88 @@ send_data(phy_conn_t *conn)
 		return;
 
 	while ((conn->ev_mask & EM_OUT) == 0) {
-		rc = 0;
-		curr_pkt_done = 0;
-
-		pkt = conn->curr_send_pkt;
-		if (!pkt) {
-			/* get the next packet from send_mbox */
-			if (tpp_mbox_read(&conn->send_mbox, NULL, NULL, (void **) &conn->curr_send_pkt) != 0) {
+		/* top up the batch with packets queued since */
+		while (conn->send_batch_cnt < TPP_MAX_IOV && conn->send_batch_len < TPP_SEND_BATCH_BYTES) {
+			if (tpp_mbox_read(&conn->send_mbox, NULL, NULL, (void **) &pkt) != 0) {
 				if (!(errno == EAGAIN || errno == EWOULDBLOCK))
 					tpp_log(LOG_ERR, __func__, "tpp_mbox_read failed");
-				return;
+				break;
+			}
+
+			/* presend handler could change pkt contents, a failure drops the packet */
+			if (the_pkt_presend_handler && the_pkt_presend_handler(conn->sock_fd, pkt, conn->ctx, conn->extra) != 0) {
+				tpp_free_pkt(pkt);
+				continue;
 			}
-			pkt = conn->curr_send_pkt;
+			if (pkt->curr_chunk == NULL) {
+				tpp_free_pkt(pkt);
+				continue;
+			}
+			for (c = pkt->curr_chunk; c; c = GET_NEXT(c->chunk_link))
+				conn->send_batch_len += c->len - (c->pos - c->data);
+			conn->send_batch[conn->send_batch_cnt++] = pkt;
 		}
-		p = pkt->curr_chunk;
 
-		/* data available, first byte, presend handler present, call handler */
-		if ((p == GET_NEXT(pkt->chunks)) && (p->pos == p->data) && the_pkt_presend_handler) {
-			if ((rc = the_pkt_presend_handler(conn->sock_fd, pkt, conn->ctx, conn->extra)) == 0) {
-				p = pkt->curr_chunk; /* presend handler could change pkt contents */
+		if (conn->send_batch_cnt == 0)
+			return;
+
+		/* gather the unsent parts of the batched packets into one writev */
+		niov = 0;
+		for (i = 0; i < conn->send_batch_cnt && niov < TPP_MAX_IOV; i++) {
+			for (c = conn->send_batch[i]->curr_chunk; c && niov < TPP_MAX_IOV; c = GET_NEXT(c->chunk_link)) {
+				iov[niov].iov_base = c->pos;
+				iov[niov].iov_len = c->len - (c->pos - c->data);
+				niov++;
 			}
 		}
 
-		if (p && (rc == 0)) {
-			tosend = p->len - (p->pos - p->data);
-			while (tosend > 0) {
-				rc = tpp_sock_send(conn->sock_fd, p->pos, tosend, 0);
-				if (rc < 0) {
-					if (errno == EWOULDBLOCK || errno == EAGAIN) {
-						/* set this socket in POLLOUT */
-						conn->ev_mask |= EM_OUT;
-						TPP_DBPRT("EWOULDBLOCK, added EM_OUT to ev_mask, now=%x", conn->ev_mask);
-						if (tpp_em_mod_fd(conn->td->em_context, conn->sock_fd, conn->ev_mask) == -1) {
-							tpp_log(LOG_ERR, __func__, "Multiplexing failed");
-							return;
-						}
-					} else {
-						handle_disconnect(conn);
-						return;
-					}
-					break;
+		rc = tpp_sock_writev(conn->sock_fd, iov, niov);
+		if (rc < 0) {
+			if (errno == EWOULDBLOCK || errno == EAGAIN) {
+				/* set this socket in POLLOUT */
+				conn->ev_mask |= EM_OUT;
+				TPP_DBPRT("EWOULDBLOCK, added EM_OUT to ev_mask, now=%x", conn->ev_mask);
+				if (tpp_em_mod_fd(conn->td->em_context, conn->sock_fd, conn->ev_mask) == -1) {
+					tpp_log(LOG_ERR, __func__, "Multiplexing failed");
+					return;
 				}
-				TPP_DBPRT("tfd=%d, tosend=%d, sent=%d bytes", conn->sock_fd, tosend, rc);
-				p->pos += rc;
-				tosend -= rc;
+			} else {
+				handle_disconnect(conn);
+				return;
 			}
-
-			if (tosend == 0) {
-				p = GET_NEXT(p->chunk_link);
-				if (p)
-					pkt->curr_chunk = p;
-				else
-					curr_pkt_done = 1;
+			continue;
+		}
+		TPP_DBPRT("tfd=%d, pkts=%d, iovs=%d, sent=%d bytes", conn->sock_fd, conn->send_batch_cnt, niov, rc);
+
+		conn->send_batch_len -= rc;
+		conn->stats.writes++;
+		conn->stats.bytes += rc;
+
+		/* advance the chunk positions over the data sent, freeing the packets done */
+		npkts = 0;
+		while (npkts < conn->send_batch_cnt) {
+			pkt = conn->send_batch[npkts];
+			c = pkt->curr_chunk;
+			tosend = c->len - (c->pos - c->data);
+			if ((size_t) rc < tosend) {
+				c->pos += rc;
+				break;
 			}
-		} else
-			curr_pkt_done = 1;
-
-		if (pkt && curr_pkt_done) {
-			/*
-			* all data in this packet has been sent or done with.
-			* delete this node and get next node in queue
-			*/
-			tpp_free_pkt(pkt);
-			conn->curr_send_pkt = NULL;
+			c->pos += tosend;
+			rc -= tosend;
+			pkt->curr_chunk = GET_NEXT(c->chunk_link);
+			if (pkt->curr_chunk == NULL) {
+				/* all data in this packet has been sent */
+				tpp_free_pkt(pkt);
+				npkts++;
+			}
+		}
+		if (npkts > 0) {
+			conn->send_batch_cnt -= npkts;
+			memmove(conn->send_batch, conn->send_batch + npkts, conn->send_batch_cnt * sizeof(tpp_packet_t *));
+			conn->stats.pkts += npkts;
+			if (npkts > conn->stats.max_batch)
+				conn->stats.max_batch = npkts;
 		}
 	}
 }
@@ -2007,7 +2054,6 @@ send_data(phy_conn_t *conn)
 static void
 free_phy_conn(phy_conn_t *conn)
 {
-	tpp_que_elem_t *n = NULL;
 	tpp_packet_t *pkt;
 	short cmd;
 
@@ -2020,7 +2066,10 @@ free_phy_conn(phy_conn_t *conn)
 		free(conn->conn_params);
 	}
 
-	while (tpp_mbox_clear(&conn->send_mbox, &n, conn->sock_fd, &cmd, (void **) &pkt) == 0) {
+	while (conn->send_batch_cnt > 0)
+		tpp_free_pkt(conn->send_batch[--conn->send_batch_cnt]);
+
+	while (tpp_mbox_clear(&conn->send_mbox, conn->sock_fd, &cmd, (void **) &pkt) == 0) {
 		if (cmd == TPP_CMD_SEND)
 			tpp_free_pkt(pkt);
 	}
@@ -2055,7 +2104,7 @@ tpp_transport_shutdown()
 	tpp_log(LOG_INFO, NULL, "Shutting down TPP transport Layer");
 
 	for (i = 0; i < num_threads; i++) {
-		tpp_mbox_post(&thrd_pool[i]->mbox, 0, TPP_CMD_EXIT, NULL, 0);
+		tpp_mbox_post(&thrd_pool[i]->mbox, 0, TPP_CMD_EXIT, NULL);
 	}
 
 	for (i = 0; i < num_threads; i++) {
@@ -72,6 +72,12 @@
 #include "dis.h"
 #ifdef PBS_COMPRESSION_ENABLED
 #include <zlib.h>
+#ifdef PBS_HAVE_LZ4
+#include <lz4frame.h>
+#endif
+#ifdef PBS_HAVE_ZSTD
+#include <zstd.h>
+#endif
 #endif
 
 #define BACKTRACE_SIZE 100
@@ -157,6 +163,8 @@ DIS_tpp_funcs()
 	pfn_transport_set_chan = (int (*)(int, pbs_tcp_chan_t *)) & tpp_set_user_data;
 	pfn_transport_recv = tpp_recv;
 	pfn_transport_send = tpp_send;
+	pfn_transport_send_buf = tpp_send_buf;
+	pfn_transport_send_scatter = tpp_mcast_send_scatter;
 }
 
 /**
@@ -218,6 +226,95 @@ tpp_log(int level, const char *routine, const char *fmt, ...)
 	va_end(args);
 }
 
+/**
+ * @brief
+ *	FNV-1a hash of a string, finished with a 64 bit mixer so that names
+ *	differing only in the last few characters still spread well
+ *
+ * @param[in] - seed - Value to start hashing from
+ * @param[in] - str  - The string to hash
+ *
+ * @return	The hash value
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static uint64_t
+tpp_str_hash(uint64_t seed, const char *str)
+{
+	uint64_t h = seed ^ 0xcbf29ce484222325ULL;
+
+	while (*str) {
+		h ^= (unsigned char) *str++;
+		h *= 0x100000001b3ULL;
+	}
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+/**
+ * @brief
+ *	Order the list of pbs_comms by rendezvous (highest random weight) hash
+ *	of this node's name and each pbs_comm name.
+ *
+ * @par Functionality:
+ *	A leaf prefers the pbs_comms in the order they are listed, and reports
+ *	that order to them as its per-router preference index. When every
+ *	node lists the same pbs_comms, all leaves pile onto the first one.
+ *	Sorting the list by a per-node hash instead spreads the primary (and
+ *	each backup) position evenly across the pbs_comms, and adding or
+ *	removing one pbs_comm only moves the leaves that hashed to it.
+ *
+ * @param[in,out] - routers - NULL terminated array of pbs_comm names
+ * @param[in] - key - Name of this node
+ *
+ * @par MT-safe: No
+ *
+ */
+static void
+tpp_hash_order_routers(char **routers, char *key)
+{
+	uint64_t seed;
+	uint64_t *score;
+	int n;
+	int i, j;
+
+	for (n = 0; routers[n]; n++)
+		;
+	if (n < 2)
+		return;
+
+	if ((score = malloc(n * sizeof(uint64_t))) == NULL) {
+		tpp_log(LOG_WARNING, __func__, "Out of memory, using configured pbs_comm order");
+		return;
+	}
+
+	seed = tpp_str_hash(0, key);
+	for (i = 0; i < n; i++)
+		score[i] = tpp_str_hash(seed, routers[i]);
+
+	/* insertion sort, highest score first; lists are a handful long */
+	for (i = 1; i < n; i++) {
+		uint64_t sc = score[i];
+		char *r = routers[i];
+
+		for (j = i - 1; j >= 0 && score[j] < sc; j--) {
+			score[j + 1] = score[j];
+			routers[j + 1] = routers[j];
+		}
+		score[j + 1] = sc;
+		routers[j + 1] = r;
+	}
+	free(score);
+
+	for (i = 0; i < n; i++)
+		tpp_log(LOG_INFO, NULL, "pbs_comm preference %d: %s", i, routers[i]);
+}
+
 /**
  * @brief
  *	Helper function called by PBS daemons to set the tpp configuration to
@@ -372,6 +469,33 @@ set_tpp_config(struct pbs_config *pbs_conf, struct tpp_config *tpp_conf, char *n
 #else
 	tpp_conf->compress = 0;
 #endif
+	tpp_conf->compress_codec = TPP_COMPR_ZLIB;
+	tpp_conf->compress_dict = NULL;
+	if (pbs_conf->pbs_compression_codec) {
+		if (strcasecmp(pbs_conf->pbs_compression_codec, "zstd") == 0) {
+#ifdef PBS_HAVE_ZSTD
+			tpp_conf->compress_codec = TPP_COMPR_ZSTD;
+#else
+			tpp_log(LOG_WARNING, NULL, "zstd compression not available, using zlib");
+#endif
+		} else if (strcasecmp(pbs_conf->pbs_compression_codec, "lz4") == 0) {
+#ifdef PBS_HAVE_LZ4
+			tpp_conf->compress_codec = TPP_COMPR_LZ4;
+#else
+			tpp_log(LOG_WARNING, NULL, "lz4 compression not available, using zlib");
+#endif
+		} else if (strcasecmp(pbs_conf->pbs_compression_codec, "zlib") != 0)
+			tpp_log(LOG_WARNING, NULL, "Unknown compression codec %s, using zlib", pbs_conf->pbs_compression_codec);
+	}
+	if (pbs_conf->pbs_compression_dict) {
+		if ((tpp_conf->compress_dict = strdup(pbs_conf->pbs_compression_dict)) == NULL) {
+			tpp_log(LOG_CRIT, __func__, "Out of memory while making copy of compression dictionary path");
+			return -1;
+		}
+	}
+
+	tpp_conf->mcast_scatter = pbs_conf->pbs_mcast_scatter;
+	tpp_conf->multipath = pbs_conf->pbs_comm_multipath;
 
 	/* set default parameters for keepalive */
 	tpp_conf->tcp_keepalive = 1;
@@ -465,6 +589,9 @@ set_tpp_config(struct pbs_config *pbs_conf, struct tpp_config *tpp_conf, char *n
 				p++;
 		}
 
+		if (pbs_conf->pbs_leaf_router_hash)
+			tpp_hash_order_routers(tpp_conf->routers, tpp_conf->node_name);
+
 	} else {
 		tpp_conf->routers = NULL;
 	}
@@ -495,6 +622,7 @@ free_tpp_config(struct tpp_config *tpp_conf)
 	free(tpp_conf->routers);
 	free_string_array(tpp_conf->supported_auth_methods);
 	free(tpp_conf->node_name);
+	free(tpp_conf->compress_dict);
 	free_auth_config(tpp_conf->auth_config);
 }
 
@@ -647,10 +775,190 @@ tpp_handle_auth_handshake(int tfd, int conn_fd, conn_auth_t *authdata, int for_e
 	return 1;
 }
 
+/*
+ * Caches of free chunk and packet structures. Packets are mostly built by
+ * the app thread and freed by the IO threads once sent, so the caches are
+ * shared by all threads and guarded by a lock.
+ */
+static tpp_pool_t chunk_pool = TPP_POOL_INITIALIZER(sizeof(tpp_chunk_t) + TPP_CHUNK_INLINE, 4096);
+static tpp_pool_t pkt_pool = TPP_POOL_INITIALIZER(sizeof(tpp_packet_t), 1024);
+
+/**
+ * @brief
+ *	Get an object from a pool, allocating a new one if the pool is empty
+ *
+ * @param[in] - pool - The pool to get the object from
+ *
+ * @return Pointer to the object
+ * @retval NULL - Failure (Out of memory)
+ *
+ * @par Side Effects:
+ *	None
+ *
+ * @par MT-safe: Yes
+ *
+ */
+void *
+tpp_pool_get(tpp_pool_t *pool)
+{
+	void *obj;
+
+	tpp_lock(&pool->lock);
+	obj = pool->free_list;
+	if (obj) {
+		pool->free_list = *((void **) obj);
+		pool->nfree--;
+	}
+	tpp_unlock(&pool->lock);
+
+	if (obj == NULL)
+		obj = malloc(pool->obj_size);
+	return obj;
+}
+
+/**
+ * @brief
+ *	Return an object to a pool. The object is freed if the pool
+ *	already caches its max number of objects
+ *
+ * @param[in] - pool - The pool to return the object to
+ * @param[in] - obj  - The object
+ *
+ * @par Side Effects:
+ *	None
+ *
+ * @par MT-safe: Yes
+ *
+ */
+void
+tpp_pool_put(tpp_pool_t *pool, void *obj)
+{
+	if (obj == NULL)
+		return;
+
+	tpp_lock(&pool->lock);
+	if (pool->nfree < pool->max_free) {
+		*((void **) obj) = pool->free_list;
+		pool->free_list = obj;
+		pool->nfree++;
+		obj = NULL;
+	}
+	tpp_unlock(&pool->lock);
+
+	free(obj);
+}
+
+/**
+ * @brief
+ *	Create a reference counted buffer holding a copy of the given data
+ *
+ * @param[in] - data - The data to copy into the buffer
+ * @param[in] - len  - Length of the data
+ *
+ * @return The buffer, with one reference held by the caller
+ * @retval NULL - Failure (Out of memory)
+ *
+ * @par Side Effects:
+ *	None
+ *
+ * @par MT-safe: Yes
+ *
+ */
+tpp_shbuf_t *
+tpp_shbuf_create(void *data, size_t len)
+{
+	tpp_shbuf_t *buf;
+
+	if ((buf = malloc(sizeof(tpp_shbuf_t) + len)) == NULL) {
+		tpp_log(LOG_CRIT, __func__, "Out of memory allocating shared buffer of %lu bytes", (unsigned long) len);
+		return NULL;
+	}
+	buf->refs = 1;
+	if (data)
+		memcpy(buf->data, data, len);
+	return buf;
+}
+
+/**
+ * @brief
+ *	Drop a reference to a shared buffer, freeing it on the last one
+ *
+ * @param[in] - buf - The shared buffer
+ *
+ * @par Side Effects:
+ *	None
+ *
+ * @par MT-safe: Yes
+ *
+ */
+void
+tpp_shbuf_release(tpp_shbuf_t *buf)
+{
+	if (buf == NULL)
+		return;
+	if (tpp_atomic_add(&buf->refs, -1) == 0)
+		free(buf);
+}
+
+/**
+ * @brief
+ *	Get a chunk from the chunk pool and add it to the given packet,
+ *	creating the packet if required
+ *
+ * @param[in] - pkt  - Pointer to packet to add chunk, or create new packet if NULL
+ * @param[in] - data - Data the chunk points to
+ * @param[in] - len  - Length of data
+ *
+ * @return The chunk added
+ * @retval NULL - Failure (Out of memory), pkt is freed
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static tpp_chunk_t *
+add_chunk(tpp_packet_t **pkt, void *data, int len)
+{
+	tpp_chunk_t *chunk;
+
+	if ((chunk = tpp_pool_get(&chunk_pool)) == NULL) {
+		tpp_log(LOG_CRIT, __func__, "Failed to build chunk");
+		tpp_free_pkt(*pkt);
+		return NULL;
+	}
+	chunk->data = data;
+	chunk->pos = chunk->data;
+	chunk->len = len;
+	chunk->shared = NULL;
+	CLEAR_LINK(chunk->chunk_link);
+
+	/* add chunk to packet */
+	/* if packet NULL, create packet now and add chunk */
+	if (*pkt == NULL) {
+		if ((*pkt = tpp_pool_get(&pkt_pool)) == NULL) {
+			tpp_pool_put(&chunk_pool, chunk);
+			tpp_log(LOG_CRIT, __func__, "Out of memory allocating packet");
+			return NULL;
+		}
+		CLEAR_HEAD((*pkt)->chunks);
+		(*pkt)->ref_count = 1;
+		(*pkt)->totlen = 0;
+		(*pkt)->curr_chunk = chunk;
+	}
+
+	(*pkt)->totlen += len;
+	append_link(&(*pkt)->chunks, &chunk->chunk_link, chunk);
+
+	return chunk;
+}
+
 /**
  * @brief
  *	Create a packet structure from the inputs provided
  *
+ * @par Functionality:
+ *	Chunks and packets come from the chunk and packet pools. Small
+ *	duplicated data (like packet headers) is kept inline in the chunk.
+ *
  * @param[in] - pkt  - Pointer to packet to add chunk, or create new packet if NULL
  * @param[in] - data - pointer to data buffer (if NULL provided, no copy happens)
  * @param[in] - len  - Lentgh of data buffer
@@ -673,49 +981,65 @@ tpp_bld_pkt(tpp_packet_t *pkt, void *data, int len, int dup, void **dup_data)
 	tpp_chunk_t *chunk;
 	void *d = data;
 
-	/* first create the requested chunk for the packet */
-	if ((chunk = malloc(sizeof(tpp_chunk_t))) == NULL) {
-		tpp_log(LOG_CRIT, __func__, "Failed to build chunk");
-		tpp_free_pkt(pkt);
-		return NULL;
-	}
-	/* dup flag was provided, so allocate space */
-	if (dup) {
+	/* dup flag was provided, allocate space unless it fits inline */
+	if (dup && len > TPP_CHUNK_INLINE) {
 		d = malloc(len);
 		if (!d) {
 			tpp_log(LOG_CRIT, __func__, "Out of memory allocating packet duplicate data for chunk");
-			free(chunk);
 			tpp_free_pkt(pkt);
 			return NULL;
 		}
-		if (data)
-			memcpy(d, data, len);
-		if (dup_data)
-			*dup_data = d; /* return allocated data ptr */
 	}
-	chunk->data = d;
-	chunk->pos = chunk->data;
-	chunk->len = len;
-	CLEAR_LINK(chunk->chunk_link);
 
-	/* add chunk to packet */
-	/* if packet NULL, create packet now and add chunk */
-	if (pkt == NULL) {
-		if ((pkt = malloc(sizeof(tpp_packet_t))) == NULL) {
-			if (d != data)
-				free(d);
-			tpp_free_pkt(pkt);
-			tpp_log(LOG_CRIT, __func__, "Out of memory allocating packet");
-			return NULL;
+	if ((chunk = add_chunk(&pkt, d, len)) == NULL) {
+		if (d != data)
+			free(d);
+		return NULL;
+	}
+
+	if (dup) {
+		if (len <= TPP_CHUNK_INLINE) {
+			chunk->data = TPP_CHUNK_INLINE_DATA(chunk);
+			chunk->pos = chunk->data;
 		}
-		CLEAR_HEAD(pkt->chunks);
-		pkt->ref_count = 1;
-		pkt->totlen = 0;
-		pkt->curr_chunk = chunk;
+		if (data)
+			memcpy(chunk->data, data, len);
+		if (dup_data)
+			*dup_data = chunk->data; /* return allocated data ptr */
 	}
 
-	pkt->totlen += len;
-	append_link(&pkt->chunks, &chunk->chunk_link, chunk);
+	return pkt;
+}
+
+/**
+ * @brief
+ *	Add a chunk referring to a shared buffer to a packet. The chunk takes
+ *	its own reference on the buffer, so the data is not copied.
+ *
+ * @param[in] - pkt  - Pointer to packet to add chunk, or create new packet if NULL
+ * @param[in] - buf  - The shared buffer
+ * @param[in] - len  - Length of data in the shared buffer
+ *
+ * @return Packet structure
+ * @retval NULL - Failure (Out of memory)
+ * @retval !NULL - Address of packet structure
+ *
+ * @par Side Effects:
+ *	None
+ *
+ * @par MT-safe: Yes
+ *
+ */
+tpp_packet_t *
+tpp_bld_pkt_shared(tpp_packet_t *pkt, tpp_shbuf_t *buf, int len)
+{
+	tpp_chunk_t *chunk;
+
+	if ((chunk = add_chunk(&pkt, buf->data, len)) == NULL)
+		return NULL;
+
+	tpp_atomic_add(&buf->refs, 1);
+	chunk->shared = buf;
 
 	return pkt;
 }
@@ -737,8 +1061,11 @@ tpp_free_chunk(tpp_chunk_t *chunk)
 {
 	if (chunk) {
 		delete_link(&chunk->chunk_link);
-		free(chunk->data);
-		free(chunk);
+		if (chunk->shared)
+			tpp_shbuf_release(chunk->shared);
+		else if (chunk->data != TPP_CHUNK_INLINE_DATA(chunk))
+			free(chunk->data);
+		tpp_pool_put(&chunk_pool, chunk);
 	}
 }
 
@@ -764,7 +1091,7 @@ tpp_free_pkt(tpp_packet_t *pkt)
 			tpp_chunk_t *chunk;
 			while ((chunk = GET_NEXT(pkt->chunks)))
 				tpp_free_chunk(chunk);
-			free(pkt);
+			tpp_pool_put(&pkt_pool, pkt);
 		}
 	}
 }
@@ -1538,6 +1865,32 @@ mk_hostname(char *host, int port)
 	return node_name;
 }
 
+/**
+ * @brief
+ *	Destructor of the TLS key, frees the data of an exiting thread
+ *	along with the codec contexts cached in it
+ *
+ * @param[in] p - The tpp_tls_t of the thread
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static void
+tpp_destroy_tls(void *p)
+{
+	tpp_tls_t *ptr = p;
+
+#ifdef PBS_HAVE_LZ4
+	if (ptr->lz4_dctx)
+		LZ4F_freeDecompressionContext(ptr->lz4_dctx);
+#endif
+#ifdef PBS_HAVE_ZSTD
+	ZSTD_freeCCtx(ptr->zstd_cctx);
+	ZSTD_freeDCtx(ptr->zstd_dctx);
+#endif
+	free(ptr);
+}
+
 /**
  * @brief
  *	Once function for initializing TLS key
@@ -1555,7 +1908,7 @@ mk_hostname(char *host, int port)
 static void
 tpp_init_tls_key_once(void)
 {
-	if (pthread_key_create(&tpp_key_tls, NULL) != 0) {
+	if (pthread_key_create(&tpp_key_tls, tpp_destroy_tls) != 0) {
 		fprintf(stderr, "Failed to initialize TLS key\n");
 	}
 }
@@ -1623,6 +1976,592 @@ struct def_ctx {
 	int len;
 };
 
+/*
+ * Fast codecs and adaptive compression for TPP data packets.
+ *
+ * Compressed data carries no codec id on the wire (the receiver only sees
+ * that the compressed length differs from the total length), so each codec
+ * is told apart by the magic number its frame format starts with: LZ4
+ * frames with 0x184D2204, zstd frames with 0xFD2FB528, anything else is a
+ * zlib stream. A receiver decodes whatever codecs it was built with.
+ *
+ * Nothing on the wire says what a peer can decode, so a peer gets the
+ * configured fast codec only once it has been seen sending data in that
+ * codec (for zstd, made with the same dictionary): peers running an older
+ * version, built without the codec or configured otherwise keep getting
+ * zlib. tpp_compr_learn() records the peers, tpp_compr_codec() picks the
+ * codec for one and tpp_compr_forget() drops a peer that left.
+ *
+ * tpp_compr_wanted() backs off when compression does not pay: every
+ * TPP_COMPR_WINDOW packets the ratio and the cpu time spent per byte saved
+ * are checked, and if either is poor the next packets are sent uncompressed,
+ * doubling the backoff each time up to TPP_COMPR_MAX_BACKOFF packets.
+ */
+#define TPP_COMPR_WINDOW 64	      /* packets per evaluation window */
+#define TPP_COMPR_MAX_RATIO 90	      /* back off if output exceeds 90% of the input */
+#define TPP_COMPR_MAX_NS_PER_BYTE 25 /* back off if a byte saved costs more cpu than this */
+#define TPP_COMPR_MAX_BACKOFF 4096   /* max packets sent uncompressed before trying again */
+#define TPP_ZSTD_LEVEL 1
+
+#define TPP_LZ4_MAGIC 0x184D2204
+#define TPP_ZSTD_MAGIC 0xFD2FB528
+
+static struct {
+	pthread_mutex_t lock;
+	int codec;		 /* codec used for compression */
+	unsigned int min_len;	 /* smallest packet worth compressing with codec */
+	unsigned long long in;	 /* bytes compressed in this window */
+	unsigned long long out;	 /* compressed bytes produced in this window */
+	unsigned long long nsec; /* cpu time spent in this window */
+	unsigned int samples;	 /* packets compressed in this window */
+	unsigned int skip;	 /* packets still to be sent uncompressed */
+	unsigned int backoff;	 /* length of the last backoff */
+} compr = {PTHREAD_MUTEX_INITIALIZER, TPP_COMPR_ZLIB, TPP_COMPR_SIZE, 0, 0, 0, 0, 0, 0};
+
+#ifdef PBS_HAVE_ZSTD
+static ZSTD_CDict *zstd_cdict = NULL;
+static ZSTD_DDict *zstd_ddict = NULL;
+static unsigned int zstd_dict_id = 0; /* id of the dictionary, 0 if none */
+#endif
+
+/* a peer seen sending fast codec data, keyed by its address */
+typedef struct {
+	tpp_addr_t addr;      /* address of the peer */
+	unsigned int codecs;  /* bit (1 << codec) of each codec it sent */
+	unsigned int dict_id; /* dictionary id of its zstd frames */
+} compr_peer_t;
+
+static pthread_mutex_t compr_peers_lock = PTHREAD_MUTEX_INITIALIZER;
+static void *compr_peers_idx = NULL;
+static char *codec_names[] = {"zlib", "lz4", "zstd"};
+
+/**
+ * @brief
+ *	Get the cpu time used by the calling thread, in nanoseconds
+ *
+ * @return cpu time, 0 if not available
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static unsigned long long
+compr_cpu_nsec(void)
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+		return ((unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+#endif
+	return 0;
+}
+
+#ifdef PBS_HAVE_ZSTD
+/**
+ * @brief
+ *	Load a zstd dictionary (as produced by zstd --train) used to compress
+ *	and decompress TPP data
+ *
+ * @param[in] path - Path of the dictionary file
+ *
+ * @return	Error code
+ * @retval -1	Failure
+ * @retval  0	Success
+ *
+ * @par MT-safe: No
+ *
+ */
+static int
+zstd_load_dict(char *path)
+{
+	FILE *fp;
+	void *buf;
+	long sz;
+
+	if ((fp = fopen(path, "rb")) == NULL) {
+		tpp_log(LOG_ERR, __func__, "Failed to open compression dictionary %s, errno=%d", path, errno);
+		return -1;
+	}
+	if (fseek(fp, 0, SEEK_END) != 0 || (sz = ftell(fp)) <= 0 || fseek(fp, 0, SEEK_SET) != 0) {
+		tpp_log(LOG_ERR, __func__, "Failed to size compression dictionary %s", path);
+		fclose(fp);
+		return -1;
+	}
+	if ((buf = malloc(sz)) == NULL) {
+		tpp_log(LOG_CRIT, __func__, "Out of memory loading compression dictionary %s", path);
+		fclose(fp);
+		return -1;
+	}
+	if (fread(buf, 1, sz, fp) != (size_t) sz) {
+		tpp_log(LOG_ERR, __func__, "Failed to read compression dictionary %s", path);
+		free(buf);
+		fclose(fp);
+		return -1;
+	}
+	fclose(fp);
+
+	zstd_cdict = ZSTD_createCDict(buf, sz, TPP_ZSTD_LEVEL);
+	zstd_ddict = ZSTD_createDDict(buf, sz);
+	free(buf);
+	if (zstd_cdict == NULL || zstd_ddict == NULL) {
+		tpp_log(LOG_ERR, __func__, "Invalid compression dictionary %s", path);
+		ZSTD_freeCDict(zstd_cdict);
+		ZSTD_freeDDict(zstd_ddict);
+		zstd_cdict = NULL;
+		zstd_ddict = NULL;
+		return -1;
+	}
+	zstd_dict_id = ZSTD_getDictID_fromDDict(zstd_ddict);
+	tpp_log(LOG_INFO, NULL, "Loaded compression dictionary %s, id %u", path, zstd_dict_id);
+	return 0;
+}
+#endif
+
+/**
+ * @brief
+ *	Tell the codec of a compressed payload from the magic it starts with
+ *
+ * @param[in] buf - The compressed data
+ * @param[in] len - Its length
+ *
+ * @return	TPP_COMPR_LZ4, TPP_COMPR_ZSTD or TPP_COMPR_ZLIB
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static int
+compr_frame_codec(void *buf, unsigned int len)
+{
+	unsigned char *p = buf;
+	unsigned int magic;
+
+	if (len < 4)
+		return TPP_COMPR_ZLIB;
+	magic = p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+	if (magic == TPP_LZ4_MAGIC)
+		return TPP_COMPR_LZ4;
+	if (magic == TPP_ZSTD_MAGIC)
+		return TPP_COMPR_ZSTD;
+	return TPP_COMPR_ZLIB;
+}
+
+/**
+ * @brief
+ *	Record that a peer sent data compressed with a fast codec, which it
+ *	therefore decodes
+ *
+ * @param[in] peer - Address of the peer
+ * @param[in] data - The compressed data received from it
+ * @param[in] len - Its length
+ *
+ * @par MT-safe: Yes
+ *
+ */
+void
+tpp_compr_learn(tpp_addr_t *peer, void *data, unsigned int len)
+{
+	int codec = compr_frame_codec(data, len);
+	unsigned int dict_id = 0;
+	compr_peer_t *cp = NULL;
+	tpp_addr_t *key = peer;
+	int learnt = 0;
+
+	if (codec == TPP_COMPR_ZLIB)
+		return;
+#ifdef PBS_HAVE_ZSTD
+	if (codec == TPP_COMPR_ZSTD)
+		dict_id = ZSTD_getDictID_fromFrame(data, len);
+#endif
+
+	tpp_lock(&compr_peers_lock);
+	if (compr_peers_idx == NULL && (compr_peers_idx = pbs_idx_create(0, sizeof(tpp_addr_t))) == NULL) {
+		tpp_unlock(&compr_peers_lock);
+		return;
+	}
+	if (pbs_idx_find(compr_peers_idx, (void **) &key, (void **) &cp, NULL) != PBS_IDX_RET_OK) {
+		if ((cp = calloc(1, sizeof(compr_peer_t))) == NULL) {
+			tpp_unlock(&compr_peers_lock);
+			return;
+		}
+		memcpy(&cp->addr, peer, sizeof(tpp_addr_t));
+		if (pbs_idx_insert(compr_peers_idx, &cp->addr, cp) != PBS_IDX_RET_OK) {
+			free(cp);
+			tpp_unlock(&compr_peers_lock);
+			return;
+		}
+	}
+	if (!(cp->codecs & (1 << codec)) || (codec == TPP_COMPR_ZSTD && cp->dict_id != dict_id)) {
+		cp->codecs |= (1 << codec);
+		if (codec == TPP_COMPR_ZSTD)
+			cp->dict_id = dict_id;
+		learnt = 1;
+	}
+	tpp_unlock(&compr_peers_lock);
+
+	if (learnt)
+		tpp_log(LOG_INFO, NULL, "%s sends %s data (dictionary id %u)", tpp_netaddr(peer), codec_names[codec], dict_id);
+}
+
+/**
+ * @brief
+ *	Forget what was learnt about a peer, which may come back running
+ *	another version or configuration
+ *
+ * @param[in] peer - Address of the peer
+ *
+ * @par MT-safe: Yes
+ *
+ */
+void
+tpp_compr_forget(tpp_addr_t *peer)
+{
+	compr_peer_t *cp = NULL;
+	tpp_addr_t *key = peer;
+
+	tpp_lock(&compr_peers_lock);
+	if (compr_peers_idx && pbs_idx_find(compr_peers_idx, (void **) &key, (void **) &cp, NULL) == PBS_IDX_RET_OK) {
+		pbs_idx_delete(compr_peers_idx, &cp->addr);
+		free(cp);
+	}
+	tpp_unlock(&compr_peers_lock);
+}
+
+/**
+ * @brief
+ *	Pick the codec for data sent to a peer: the configured one if the
+ *	peer is known to decode it, zlib otherwise
+ *
+ * @param[in] peer - Address of the peer
+ *
+ * @return	The codec, TPP_COMPR_*
+ *
+ * @par MT-safe: Yes
+ *
+ */
+int
+tpp_compr_codec(tpp_addr_t *peer)
+{
+	compr_peer_t *cp = NULL;
+	tpp_addr_t *key = peer;
+	int codec = TPP_COMPR_ZLIB;
+
+	if (compr.codec == TPP_COMPR_ZLIB)
+		return TPP_COMPR_ZLIB;
+
+	tpp_lock(&compr_peers_lock);
+	if (compr_peers_idx && pbs_idx_find(compr_peers_idx, (void **) &key, (void **) &cp, NULL) == PBS_IDX_RET_OK &&
+	    (cp->codecs & (1 << compr.codec))) {
+		codec = compr.codec;
+#ifdef PBS_HAVE_ZSTD
+		if (codec == TPP_COMPR_ZSTD && cp->dict_id != zstd_dict_id)
+			codec = TPP_COMPR_ZLIB;
+#endif
+	}
+	tpp_unlock(&compr_peers_lock);
+
+	return codec;
+}
+
+/**
+ * @brief
+ *	Set up the codec used to compress data packets, as configured
+ *
+ * @param[in] cnf - The tpp configuration
+ *
+ * @return	Error code
+ * @retval -1	Failure
+ * @retval  0	Success
+ *
+ * @par MT-safe: No
+ *
+ */
+int
+tpp_compr_init(struct tpp_config *cnf)
+{
+	compr.codec = cnf->compress_codec;
+	switch (compr.codec) {
+#ifdef PBS_HAVE_LZ4
+		case TPP_COMPR_LZ4:
+			compr.min_len = TPP_COMPR_SIZE / 8;
+			break;
+#endif
+#ifdef PBS_HAVE_ZSTD
+		case TPP_COMPR_ZSTD:
+			compr.min_len = TPP_COMPR_SIZE / 4;
+			if (cnf->compress_dict && zstd_cdict == NULL) {
+				if (zstd_load_dict(cnf->compress_dict) != 0)
+					return -1;
+				/* a dictionary makes small, repetitive payloads worth compressing */
+				compr.min_len = TPP_COMPR_SIZE / 16;
+			}
+			break;
+#endif
+		default:
+			compr.codec = TPP_COMPR_ZLIB;
+			compr.min_len = TPP_COMPR_SIZE;
+	}
+	if (cnf->compress)
+		tpp_log(LOG_INFO, NULL, "TPP compression codec = %s%s", codec_names[compr.codec],
+			(compr.codec != TPP_COMPR_ZLIB) ? ", zlib to peers not known to decode it" : "");
+	return 0;
+}
+
+/**
+ * @brief
+ *	Decide whether a data packet of the given length should be compressed
+ *
+ * @param[in] len - Length of the data
+ * @param[in] codec - Codec it would be compressed with, see tpp_compr_codec()
+ *
+ * @return	1 if the data should be compressed, 0 if sent as is
+ *
+ * @par MT-safe: Yes
+ *
+ */
+int
+tpp_compr_wanted(unsigned int len, int codec)
+{
+	int rc = 1;
+
+	if (len <= ((codec == compr.codec) ? compr.min_len : TPP_COMPR_SIZE))
+		return 0;
+
+	tpp_lock(&compr.lock);
+	if (compr.skip > 0) {
+		compr.skip--;
+		rc = 0;
+	}
+	tpp_unlock(&compr.lock);
+
+	return rc;
+}
+
+/**
+ * @brief
+ *	Account one compressed packet and back off if compression is not
+ *	paying for itself over the current window
+ *
+ * @param[in] in - Uncompressed length
+ * @param[in] out - Compressed length
+ * @param[in] nsec - cpu time spent compressing
+ *
+ * @par MT-safe: Yes
+ *
+ */
+static void
+compr_account(unsigned int in, unsigned int out, unsigned long long nsec)
+{
+	unsigned long long saved;
+	unsigned long long w_in = 0;
+	unsigned long long w_out = 0;
+	unsigned int backoff = 0;
+
+	tpp_lock(&compr.lock);
+	compr.in += in;
+	compr.out += out;
+	compr.nsec += nsec;
+	if (++compr.samples >= TPP_COMPR_WINDOW) {
+		saved = (compr.in > compr.out) ? compr.in - compr.out : 0;
+		if ((compr.out * 100 > compr.in * TPP_COMPR_MAX_RATIO) || (compr.nsec > saved * TPP_COMPR_MAX_NS_PER_BYTE)) {
+			compr.backoff = (compr.backoff > 0) ? compr.backoff * 2 : TPP_COMPR_WINDOW;
+			if (compr.backoff > TPP_COMPR_MAX_BACKOFF)
+				compr.backoff = TPP_COMPR_MAX_BACKOFF;
+			compr.skip = compr.backoff;
+			backoff = compr.backoff;
+			w_in = compr.in;
+			w_out = compr.out;
+		} else
+			compr.backoff = 0;
+		compr.in = 0;
+		compr.out = 0;
+		compr.nsec = 0;
+		compr.samples = 0;
+	}
+	tpp_unlock(&compr.lock);
+
+	if (backoff > 0)
+		tpp_log(LOG_DEBUG, __func__, "Compression reduced %llu bytes to %llu, sending next %u packets uncompressed",
+			w_in, w_out, backoff);
+}
+
+#ifdef PBS_HAVE_LZ4
+static void *
+lz4_compress(void *inbuf, unsigned int inlen, unsigned int *outlen)
+{
+	LZ4F_preferences_t prefs;
+	size_t bound;
+	size_t n;
+	void *data;
+
+	memset(&prefs, 0, sizeof(prefs));
+	bound = LZ4F_compressFrameBound(inlen, &prefs);
+	if ((data = malloc(bound)) == NULL) {
+		tpp_log(LOG_CRIT, __func__, "Out of memory allocating compression buffer %lu bytes", (unsigned long) bound);
+		return NULL;
+	}
+	n = LZ4F_compressFrame(data, bound, inbuf, inlen, &prefs);
+	if (LZ4F_isError(n)) {
+		tpp_log(LOG_CRIT, __func__, "LZ4 compression failed: %s", LZ4F_getErrorName(n));
+		free(data);
+		return NULL;
+	}
+	*outlen = n;
+	return data;
+}
+
+static int
+lz4_decompress(void *inbuf, unsigned int inlen, void *outbuf, unsigned int totlen)
+{
+	tpp_tls_t *tls = tpp_get_tls();
+	LZ4F_dctx *dctx;
+	size_t dst = totlen;
+	size_t src = inlen;
+	size_t rc;
+
+	if (tls == NULL)
+		return -1;
+	if (tls->lz4_dctx == NULL) {
+		if (LZ4F_isError(LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION)))
+			return -1;
+		tls->lz4_dctx = dctx;
+	}
+	dctx = tls->lz4_dctx;
+
+	rc = LZ4F_decompress(dctx, outbuf, &dst, inbuf, &src, NULL);
+	if (rc != 0 || dst != totlen) {
+		tpp_log(LOG_CRIT, __func__, "LZ4 decompression failed: %s", LZ4F_isError(rc) ? LZ4F_getErrorName(rc) : "truncated frame");
+		/* context is left mid frame, start afresh next time */
+		LZ4F_freeDecompressionContext(dctx);
+		tls->lz4_dctx = NULL;
+		return -1;
+	}
+	return 0;
+}
+#endif
+
+#ifdef PBS_HAVE_ZSTD
+static void *
+zstd_compress(void *inbuf, unsigned int inlen, unsigned int *outlen)
+{
+	tpp_tls_t *tls = tpp_get_tls();
+	size_t bound;
+	size_t n;
+	void *data;
+
+	if (tls == NULL)
+		return NULL;
+	if (tls->zstd_cctx == NULL && (tls->zstd_cctx = ZSTD_createCCtx()) == NULL)
+		return NULL;
+
+	bound = ZSTD_compressBound(inlen);
+	if ((data = malloc(bound)) == NULL) {
+		tpp_log(LOG_CRIT, __func__, "Out of memory allocating compression buffer %lu bytes", (unsigned long) bound);
+		return NULL;
+	}
+	if (zstd_cdict)
+		n = ZSTD_compress_usingCDict(tls->zstd_cctx, data, bound, inbuf, inlen, zstd_cdict);
+	else
+		n = ZSTD_compressCCtx(tls->zstd_cctx, data, bound, inbuf, inlen, TPP_ZSTD_LEVEL);
+	if (ZSTD_isError(n)) {
+		tpp_log(LOG_CRIT, __func__, "zstd compression failed: %s", ZSTD_getErrorName(n));
+		free(data);
+		return NULL;
+	}
+	*outlen = n;
+	return data;
+}
+
+static int
+zstd_decompress(void *inbuf, unsigned int inlen, void *outbuf, unsigned int totlen)
+{
+	tpp_tls_t *tls = tpp_get_tls();
+	size_t n;
+
+	unsigned int dict_id;
+
+	if (tls == NULL)
+		return -1;
+	if (tls->zstd_dctx == NULL && (tls->zstd_dctx = ZSTD_createDCtx()) == NULL)
+		return -1;
+
+	/* a frame made with a dictionary can only be decoded with the same one */
+	dict_id = ZSTD_getDictID_fromFrame(inbuf, inlen);
+	if (dict_id != 0 && dict_id != zstd_dict_id) {
+		if (zstd_dict_id == 0)
+			tpp_log(LOG_ERR, __func__, "Received zstd data made with compression dictionary id %u, "
+						   "but no PBS_COMPRESSION_DICT is set here",
+				dict_id);
+		else
+			tpp_log(LOG_ERR, __func__, "Received zstd data made with compression dictionary id %u, "
+						   "but PBS_COMPRESSION_DICT here has id %u",
+				dict_id, zstd_dict_id);
+		return -1;
+	}
+
+	if (zstd_ddict)
+		n = ZSTD_decompress_usingDDict(tls->zstd_dctx, outbuf, totlen, inbuf, inlen, zstd_ddict);
+	else
+		n = ZSTD_decompressDCtx(tls->zstd_dctx, outbuf, totlen, inbuf, inlen);
+	if (ZSTD_isError(n) || n != totlen) {
+		tpp_log(LOG_CRIT, __func__, "zstd decompression failed: %s", ZSTD_isError(n) ? ZSTD_getErrorName(n) : "length mismatch");
+		return -1;
+	}
+	return 0;
+}
+#endif
+
+/**
+ * @brief
+ *	Compress a data packet
+ *
+ * @param[in] inbuf   - Ptr to buffer to compress
+ * @param[in] inlen   - The size of input buffer
+ * @param[out] outlen - The size of the compressed data
+ * @param[in] codec   - Codec to use, see tpp_compr_codec()
+ *
+ * @return	Ptr to the compressed data buffer
+ * @retval  !NULL - Success
+ * @retval   NULL - Failure, or the data did not shrink; send it as is
+ *
+ * @par MT-safe: Yes
+ *
+ */
+void *
+tpp_compress(void *inbuf, unsigned int inlen, unsigned int *outlen, int codec)
+{
+	unsigned long long start;
+	void *data;
+
+	*outlen = 0;
+	start = compr_cpu_nsec();
+	switch (codec) {
+#ifdef PBS_HAVE_LZ4
+		case TPP_COMPR_LZ4:
+			data = lz4_compress(inbuf, inlen, outlen);
+			break;
+#endif
+#ifdef PBS_HAVE_ZSTD
+		case TPP_COMPR_ZSTD:
+			data = zstd_compress(inbuf, inlen, outlen);
+			break;
+#endif
+		default:
+			data = tpp_deflate(inbuf, inlen, outlen);
+	}
+	if (data == NULL)
+		return NULL;
+
+	compr_account(inlen, *outlen, compr_cpu_nsec() - start);
+
+	/* the receiver treats a packet whose length is unchanged as uncompressed */
+	if (*outlen >= inlen) {
+		free(data);
+		*outlen = 0;
+		return NULL;
+	}
+	return data;
+}
+
 /**
  * @brief
  *	Initialize a multi step deflation
@@ -1887,6 +2826,8 @@ tpp_inflate(void *inbuf, unsigned int inlen, unsigned int totlen)
 	int ret;
 	z_stream strm;
 	void *outbuf = NULL;
+	unsigned char *p = inbuf;
+	unsigned int magic;
 
 	/*
 	 * in some rare cases totlen < compressed_len (inlen)
@@ -1898,6 +2839,30 @@ tpp_inflate(void *inbuf, unsigned int inlen, unsigned int totlen)
 		return NULL;
 	}
 
+	/* frames of the fast codecs are told apart from zlib streams by their magic */
+	if (inlen >= 4) {
+		magic = p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+		if (magic == TPP_LZ4_MAGIC || magic == TPP_ZSTD_MAGIC) {
+			ret = -2;
+#ifdef PBS_HAVE_LZ4
+			if (magic == TPP_LZ4_MAGIC)
+				ret = lz4_decompress(inbuf, inlen, outbuf, totlen);
+#endif
+#ifdef PBS_HAVE_ZSTD
+			if (magic == TPP_ZSTD_MAGIC)
+				ret = zstd_decompress(inbuf, inlen, outbuf, totlen);
+#endif
+			if (ret != 0) {
+				if (ret == -2)
+					tpp_log(LOG_CRIT, __func__, "Received data compressed with %s, which this node was built without",
+						(magic == TPP_LZ4_MAGIC) ? "lz4" : "zstd");
+				free(outbuf);
+				return NULL;
+			}
+			return outbuf;
+		}
+	}
+
 	/* allocate inflate state */
 	strm.zalloc = Z_NULL;
 	strm.zfree = Z_NULL;
@@ -1962,6 +2927,41 @@ tpp_inflate(void *inbuf, unsigned int inlen, unsigned int totlen)
 	tpp_log(LOG_CRIT, __func__, "TPP compression disabled");
 	return NULL;
 }
+
+int
+tpp_compr_init(struct tpp_config *cnf)
+{
+	return 0;
+}
+
+int
+tpp_compr_wanted(unsigned int len, int codec)
+{
+	return 0;
+}
+
+int
+tpp_compr_codec(tpp_addr_t *peer)
+{
+	return TPP_COMPR_ZLIB;
+}
+
+void
+tpp_compr_learn(tpp_addr_t *peer, void *data, unsigned int len)
+{
+}
+
+void
+tpp_compr_forget(tpp_addr_t *peer)
+{
+}
+
+void *
+tpp_compress(void *inbuf, unsigned int inlen, unsigned int *outlen, int codec)
+{
+	tpp_log(LOG_CRIT, __func__, "TPP compression disabled");
+	return NULL;
+}
 #endif
 
 /**
@@ -1992,6 +2992,7 @@ tpp_validate_hdr(int tfd, char *pkt_start)
 	    (data_len > TPP_SEND_SIZE &&
 	     type != TPP_DATA &&
 	     type != TPP_MCAST_DATA &&
+	     type != TPP_MCAST_SCATTER &&
 	     type != TPP_ENCRYPTED_DATA &&
 	     type != TPP_AUTH_CTX)) {
 		tpp_log(LOG_CRIT, __func__, "tfd=%d, Received invalid packet type with type=%d? data_len=%d", tfd, type, data_len);
@@ -2456,7 +3457,7 @@ print_packet_hdr(const char *fnc, void *data, int len)
 {
 	tpp_ctl_pkt_hdr_t *hdr = (tpp_ctl_pkt_hdr_t *) data;
 
-	char str_types[][20] = {"TPP_CTL_JOIN", "TPP_CTL_LEAVE", "TPP_DATA", "TPP_CTL_MSG", "TPP_CLOSE_STRM", "TPP_MCAST_DATA"};
+	char str_types[][20] = {"TPP_CTL_JOIN", "TPP_CTL_LEAVE", "TPP_DATA", "TPP_CTL_MSG", "TPP_CLOSE_STRM", "TPP_MCAST_DATA", "TPP_AUTH_CTX", "TPP_ENCRYPTED_DATA", "TPP_MCAST_SCATTER"};
 	unsigned char type = hdr->type;
 
 	if (type == TPP_CTL_JOIN) {
@@ -2465,7 +3466,7 @@ print_packet_hdr(const char *fnc, void *data, int len)
 	} else if (type == TPP_CTL_LEAVE) {
 		tpp_addr_t *addrs = (tpp_addr_t *) (((char *) data) + sizeof(tpp_leave_pkt_hdr_t));
 		tpp_log(LOG_CRIT, __func__, "%s message arrived from src_host = %s", str_types[type - 1], tpp_netaddr(addrs));
-	} else if (type == TPP_MCAST_DATA) {
+	} else if (type == TPP_MCAST_DATA || type == TPP_MCAST_SCATTER) {
 		tpp_mcast_pkt_hdr_t *mhdr = (tpp_mcast_pkt_hdr_t *) data;
 		tpp_log(LOG_CRIT, __func__, "%s message arrived from src_host = %s", str_types[type - 1], tpp_netaddr(&mhdr->src_addr));
 	} else if ((type == TPP_DATA) || (type == TPP_CLOSE_STRM)) {
@@ -41,21 +41,199 @@
 
 #include "pbs_idx.h"
 #include "avltree.h"
+#include <ctype.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+
+/*
+ * An index is either an AVL tree, which keeps its keys in order, or with
+ * PBS_IDX_HASH an open addressing hash table with linear probing. Deleted
+ * slots of the hash table are left as tombstones until the table is rebuilt
+ * on a later insert, so that deleting while iterating does not move entries.
+ */
+
+#define IDX_HASH_MINSZ 16 /* initial number of slots in a hash table */
+
+/* entry of a hash table */
+typedef struct _hash_ent {
+	void *data;	    /* data of entry */
+	unsigned int hval;  /* hash of key */
+	char key[1];	    /* copy of key, keylen bytes or a string */
+} hash_ent;
+
+static hash_ent hash_tomb; /* marks a slot whose entry was deleted */
+#define HASH_TOMB (&hash_tomb)
+
+/* index structure, opaque to application */
+typedef struct _pbs_idx {
+	int flags;		/* PBS_IDX_* flags given at creation */
+	int keylen;		/* length of key, 0 for strings */
+	AVL_IX_DESC avl;	/* the tree, unless PBS_IDX_HASH */
+	hash_ent **slots;	/* the hash table, if PBS_IDX_HASH */
+	unsigned int size;	/* number of slots, a power of 2 */
+	unsigned int count;	/* number of entries */
+	unsigned int used;	/* number of entries and tombstones */
+} pbs_idx_t;
 
 /* iteration context structure, opaque to application */
 typedef struct _iter_ctx {
-	AVL_IX_DESC *idx; /* pointer to idx */
-	AVL_IX_REC *pkey; /* pointer to key used while iteration */
+	pbs_idx_t *idx;	   /* pointer to idx */
+	AVL_IX_REC *pkey;  /* pointer to key used while iteration (AVL) */
+	unsigned int slot; /* slot of current entry (hash) */
 } iter_ctx;
 
+/**
+ * @brief
+ *	hash a key of the index, FNV-1a finished with a 64 bit mixer
+ *
+ * @param[in] - pidx - pointer to index
+ * @param[in] - key  - key to hash
+ *
+ * @return unsigned int
+ * @retval hash value
+ *
+ */
+static unsigned int
+hash_key(pbs_idx_t *pidx, const void *key)
+{
+	const unsigned char *p = key;
+	uint64_t h = 0xcbf29ce484222325ULL;
+	int i;
+
+	if (pidx->keylen != 0) {
+		for (i = 0; i < pidx->keylen; i++) {
+			h ^= p[i];
+			h *= 0x100000001b3ULL;
+		}
+	} else if (pidx->flags & PBS_IDX_ICASE_CMP) {
+		for (; *p; p++) {
+			h ^= (unsigned char) tolower(*p);
+			h *= 0x100000001b3ULL;
+		}
+	} else {
+		for (; *p; p++) {
+			h ^= *p;
+			h *= 0x100000001b3ULL;
+		}
+	}
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return (unsigned int) h;
+}
+
+/**
+ * @brief
+ *	compare a key with the key of a hash table entry
+ *
+ * @param[in] - pidx - pointer to index
+ * @param[in] - pe   - entry
+ * @param[in] - key  - key to compare
+ * @param[in] - hval - hash of key
+ *
+ * @return int
+ * @retval 1 - keys are equal
+ * @retval 0 - keys differ
+ *
+ */
+static int
+hash_key_eq(pbs_idx_t *pidx, hash_ent *pe, const void *key, unsigned int hval)
+{
+	if (pe->hval != hval)
+		return 0;
+	if (pidx->keylen != 0)
+		return memcmp(pe->key, key, pidx->keylen) == 0;
+	if (pidx->flags & PBS_IDX_ICASE_CMP)
+		return strcasecmp(pe->key, key) == 0;
+	return strcmp(pe->key, key) == 0;
+}
+
+/**
+ * @brief
+ *	find the slot of the first entry of a key in a hash table
+ *
+ * @param[in] - pidx - pointer to index
+ * @param[in] - key  - key of the entry
+ *
+ * @return int
+ * @retval >=0 - slot of entry
+ * @retval -1  - not found
+ *
+ */
+static int
+hash_find_slot(pbs_idx_t *pidx, const void *key)
+{
+	unsigned int hval;
+	unsigned int mask;
+	unsigned int i;
+	hash_ent *pe;
+
+	if (pidx->count == 0)
+		return -1;
+
+	hval = hash_key(pidx, key);
+	mask = pidx->size - 1;
+	for (i = hval & mask; (pe = pidx->slots[i]) != NULL; i = (i + 1) & mask) {
+		if (pe != HASH_TOMB && hash_key_eq(pidx, pe, key, hval))
+			return (int) i;
+	}
+	return -1;
+}
+
+/**
+ * @brief
+ *	rebuild a hash table without tombstones, sized so that it is at most
+ *	half full after adding one more entry
+ *
+ * @param[in] - pidx - pointer to index
+ *
+ * @return int
+ * @retval PBS_IDX_RET_OK   - success
+ * @retval PBS_IDX_RET_FAIL - failure
+ *
+ */
+static int
+hash_rebuild(pbs_idx_t *pidx)
+{
+	hash_ent **slots;
+	unsigned int size = IDX_HASH_MINSZ;
+	unsigned int mask;
+	unsigned int i;
+	unsigned int j;
+
+	while (size < (pidx->count + 1) * 2)
+		size *= 2;
+
+	slots = calloc(size, sizeof(hash_ent *));
+	if (slots == NULL)
+		return PBS_IDX_RET_FAIL;
+
+	mask = size - 1;
+	for (i = 0; i < pidx->size; i++) {
+		hash_ent *pe = pidx->slots[i];
+
+		if (pe == NULL || pe == HASH_TOMB)
+			continue;
+		for (j = pe->hval & mask; slots[j] != NULL; j = (j + 1) & mask)
+			;
+		slots[j] = pe;
+	}
+	free(pidx->slots);
+	pidx->slots = slots;
+	pidx->size = size;
+	pidx->used = pidx->count;
+	return PBS_IDX_RET_OK;
+}
+
 /**
  * @brief
  *	Create an empty index
  *
- * @param[in] - flags  - index flags like duplicates allowed, or case insensitive compare
+ * @param[in] - flags  - index flags like duplicates allowed, case insensitive
+ *			 compare, or hash table instead of AVL tree
  * @param[in] - keylen - length of key in index (can be 0 for default size)
  *
  * @return void *
@@ -66,18 +244,25 @@ typedef struct _iter_ctx {
 void *
 pbs_idx_create(int flags, int keylen)
 {
-	void *idx = NULL;
+	pbs_idx_t *pidx;
 
-	idx = malloc(sizeof(AVL_IX_DESC));
-	if (idx == NULL)
+	pidx = calloc(1, sizeof(pbs_idx_t));
+	if (pidx == NULL)
 		return NULL;
 
-	if (avl_create_index(idx, flags, keylen)) {
-		free(idx);
+	pidx->flags = flags;
+	pidx->keylen = keylen;
+	if (flags & PBS_IDX_HASH) {
+		if (keylen < 0 || hash_rebuild(pidx) != PBS_IDX_RET_OK) {
+			free(pidx);
+			return NULL;
+		}
+	} else if (avl_create_index(&pidx->avl, flags, keylen)) {
+		free(pidx);
 		return NULL;
 	}
 
-	return idx;
+	return pidx;
 }
 
 /**
@@ -92,9 +277,19 @@ pbs_idx_create(int flags, int keylen)
 void
 pbs_idx_destroy(void *idx)
 {
-	if (idx != NULL) {
-		avl_destroy_index(idx);
-		free(idx);
+	pbs_idx_t *pidx = (pbs_idx_t *) idx;
+	unsigned int i;
+
+	if (pidx != NULL) {
+		if (pidx->flags & PBS_IDX_HASH) {
+			for (i = 0; i < pidx->size; i++) {
+				if (pidx->slots[i] != HASH_TOMB)
+					free(pidx->slots[i]);
+			}
+			free(pidx->slots);
+		} else
+			avl_destroy_index(&pidx->avl);
+		free(pidx);
 		idx = NULL;
 	}
 }
@@ -115,17 +310,57 @@ pbs_idx_destroy(void *idx)
 int
 pbs_idx_insert(void *idx, void *key, void *data)
 {
+	pbs_idx_t *pidx = (pbs_idx_t *) idx;
 	AVL_IX_REC *pkey;
 
-	if (idx == NULL || key == NULL)
+	if (pidx == NULL || key == NULL)
 		return PBS_IDX_RET_FAIL;
 
-	pkey = avlkey_create(idx, key);
+	if (pidx->flags & PBS_IDX_HASH) {
+		hash_ent *pe;
+		size_t klen = pidx->keylen ? (size_t) pidx->keylen : strlen(key) + 1;
+		unsigned int hval = hash_key(pidx, key);
+		unsigned int mask;
+		unsigned int i;
+		int tomb = -1;
+
+		/* keep at least a quarter of the slots empty */
+		if ((pidx->used + 1) * 4 > pidx->size * 3) {
+			if (hash_rebuild(pidx) != PBS_IDX_RET_OK)
+				return PBS_IDX_RET_FAIL;
+		}
+
+		mask = pidx->size - 1;
+		for (i = hval & mask; (pe = pidx->slots[i]) != NULL; i = (i + 1) & mask) {
+			if (pe == HASH_TOMB) {
+				if (tomb == -1)
+					tomb = (int) i;
+			} else if (!(pidx->flags & PBS_IDX_DUPS_OK) && hash_key_eq(pidx, pe, key, hval))
+				return PBS_IDX_RET_FAIL;
+		}
+
+		pe = malloc(offsetof(hash_ent, key) + klen);
+		if (pe == NULL)
+			return PBS_IDX_RET_FAIL;
+		pe->data = data;
+		pe->hval = hval;
+		memcpy(pe->key, key, klen);
+
+		if (tomb != -1)
+			i = (unsigned int) tomb;
+		else
+			pidx->used++;
+		pidx->slots[i] = pe;
+		pidx->count++;
+		return PBS_IDX_RET_OK;
+	}
+
+	pkey = avlkey_create(&pidx->avl, key);
 	if (pkey == NULL)
 		return PBS_IDX_RET_FAIL;
 
 	pkey->recptr = data;
-	if (avl_add_key(pkey, idx) != AVL_IX_OK) {
+	if (avl_add_key(pkey, &pidx->avl) != AVL_IX_OK) {
 		free(pkey);
 		return PBS_IDX_RET_FAIL;
 	}
@@ -148,17 +383,29 @@ pbs_idx_insert(void *idx, void *key, void *data)
 int
 pbs_idx_delete(void *idx, void *key)
 {
+	pbs_idx_t *pidx = (pbs_idx_t *) idx;
 	AVL_IX_REC *pkey;
 
-	if (idx == NULL || key == NULL)
+	if (pidx == NULL || key == NULL)
 		return PBS_IDX_RET_FAIL;
 
-	pkey = avlkey_create(idx, key);
+	if (pidx->flags & PBS_IDX_HASH) {
+		int slot = hash_find_slot(pidx, key);
+
+		if (slot != -1) {
+			free(pidx->slots[slot]);
+			pidx->slots[slot] = HASH_TOMB;
+			pidx->count--;
+		}
+		return PBS_IDX_RET_OK;
+	}
+
+	pkey = avlkey_create(&pidx->avl, key);
 	if (pkey == NULL)
 		return PBS_IDX_RET_FAIL;
 
 	pkey->recptr = NULL;
-	avl_delete_key(pkey, idx);
+	avl_delete_key(pkey, &pidx->avl);
 	free(pkey);
 	return PBS_IDX_RET_OK;
 }
@@ -180,10 +427,97 @@ pbs_idx_delete_byctx(void *ctx)
 {
 	iter_ctx *pctx = (iter_ctx *) ctx;
 
-	if (pctx == NULL || pctx->idx == NULL || pctx->pkey == NULL)
+	if (pctx == NULL || pctx->idx == NULL)
+		return PBS_IDX_RET_FAIL;
+
+	if (pctx->idx->flags & PBS_IDX_HASH) {
+		pbs_idx_t *pidx = pctx->idx;
+
+		if (pctx->slot >= pidx->size || pidx->slots[pctx->slot] == NULL ||
+		    pidx->slots[pctx->slot] == HASH_TOMB)
+			return PBS_IDX_RET_FAIL;
+		free(pidx->slots[pctx->slot]);
+		pidx->slots[pctx->slot] = HASH_TOMB;
+		pidx->count--;
+		return PBS_IDX_RET_OK;
+	}
+
+	if (pctx->pkey == NULL)
 		return PBS_IDX_RET_FAIL;
 
-	avl_delete_key(pctx->pkey, pctx->idx);
+	avl_delete_key(pctx->pkey, &pctx->idx->avl);
+	return PBS_IDX_RET_OK;
+}
+
+/**
+ * @brief
+ *	find or iterate entry in a hash table index, see pbs_idx_find()
+ *
+ * @param[in]     - pidx - pointer to index
+ * @param[in/out] - key  - key of the entry
+ * @param[in/out] - data - data of the entry
+ * @param[in/out] - ctx  - context to be set for iteration
+ *
+ * @return int
+ * @retval PBS_IDX_RET_OK   - success
+ * @retval PBS_IDX_RET_FAIL - failure
+ *
+ */
+static int
+hash_find(pbs_idx_t *pidx, void **key, void **data, void **ctx)
+{
+	iter_ctx *pctx;
+	unsigned int i;
+	int slot = -1;
+
+	*data = NULL;
+	if (ctx != NULL && *ctx != NULL) {
+		pctx = (iter_ctx *) *ctx;
+
+		if (key)
+			*key = NULL;
+
+		if (pctx->idx != pidx)
+			return PBS_IDX_RET_FAIL;
+
+		for (i = pctx->slot + 1; i < pidx->size; i++) {
+			if (pidx->slots[i] != NULL && pidx->slots[i] != HASH_TOMB)
+				break;
+		}
+		if (i >= pidx->size)
+			return PBS_IDX_RET_FAIL;
+
+		pctx->slot = i;
+		*data = pidx->slots[i]->data;
+		if (key)
+			*key = pidx->slots[i]->key;
+		return PBS_IDX_RET_OK;
+	}
+
+	if (key != NULL && *key != NULL)
+		slot = hash_find_slot(pidx, *key);
+	else if (pidx->count != 0) {
+		for (i = 0; i < pidx->size; i++) {
+			if (pidx->slots[i] != NULL && pidx->slots[i] != HASH_TOMB) {
+				slot = (int) i;
+				break;
+			}
+		}
+	}
+	if (slot == -1)
+		return PBS_IDX_RET_FAIL;
+
+	*data = pidx->slots[slot]->data;
+	if (key != NULL && *key == NULL)
+		*key = pidx->slots[slot]->key;
+	if (ctx != NULL) {
+		pctx = (iter_ctx *) calloc(1, sizeof(iter_ctx));
+		if (pctx == NULL)
+			return PBS_IDX_RET_FAIL;
+		pctx->idx = pidx;
+		pctx->slot = (unsigned int) slot;
+		*ctx = (void *) pctx;
+	}
 	return PBS_IDX_RET_OK;
 }
 
@@ -209,17 +543,26 @@ pbs_idx_delete_byctx(void *ctx)
  * @note
  * 	ctx should be free'd after use, using pbs_idx_free_ctx()
  *
+ * @note
+ *	A PBS_IDX_HASH index is iterated in no particular order, and the
+ *	iteration started from a given key goes on with unrelated entries.
+ *	Entries must not be added to it while iterating.
+ *
  */
 int
 pbs_idx_find(void *idx, void **key, void **data, void **ctx)
 {
+	pbs_idx_t *pidx = (pbs_idx_t *) idx;
 	iter_ctx *pctx;
 	AVL_IX_REC *pkey;
 	int rc = AVL_IX_FAIL;
 
-	if (idx == NULL || data == NULL)
+	if (pidx == NULL || data == NULL)
 		return PBS_IDX_RET_FAIL;
 
+	if (pidx->flags & PBS_IDX_HASH)
+		return hash_find(pidx, key, data, ctx);
+
 	if (ctx != NULL && *ctx != NULL) {
 		pctx = (iter_ctx *) *ctx;
 
@@ -227,10 +570,10 @@ pbs_idx_find(void *idx, void **key, void **data, void **ctx)
 		if (key)
 			*key = NULL;
 
-		if (pctx->idx != idx || pctx->pkey == NULL)
+		if (pctx->idx != pidx || pctx->pkey == NULL)
 			return PBS_IDX_RET_FAIL;
 
-		if (avl_next_key(pctx->pkey, pctx->idx) != AVL_IX_OK)
+		if (avl_next_key(pctx->pkey, &pidx->avl) != AVL_IX_OK)
 			return PBS_IDX_RET_FAIL;
 
 		*data = pctx->pkey->recptr;
@@ -240,15 +583,15 @@ pbs_idx_find(void *idx, void **key, void **data, void **ctx)
 		return PBS_IDX_RET_OK;
 	} else {
 		*data = NULL;
-		pkey = avlkey_create(idx, key ? *key : NULL);
+		pkey = avlkey_create(&pidx->avl, key ? *key : NULL);
 		if (pkey == NULL)
 			return PBS_IDX_RET_FAIL;
 
 		if (key != NULL && *key != NULL) {
-			rc = avl_find_key(pkey, idx);
+			rc = avl_find_key(pkey, &pidx->avl);
 		} else {
-			avl_first_key(idx);
-			rc = avl_next_key(pkey, idx);
+			avl_first_key(&pidx->avl);
+			rc = avl_next_key(pkey, &pidx->avl);
 		}
 
 		if (rc == AVL_IX_OK) {
@@ -256,12 +599,12 @@ pbs_idx_find(void *idx, void **key, void **data, void **ctx)
 			if (key != NULL && *key == NULL)
 				*key = &pkey->key;
 			if (ctx != NULL) {
-				pctx = (iter_ctx *) malloc(sizeof(iter_ctx));
+				pctx = (iter_ctx *) calloc(1, sizeof(iter_ctx));
 				if (pctx == NULL) {
 					free(pkey);
 					return PBS_IDX_RET_FAIL;
 				}
-				pctx->idx = idx;
+				pctx->idx = pidx;
 				pctx->pkey = pkey;
 				*ctx = (void *) pctx;
 
@@ -309,6 +652,9 @@ pbs_idx_is_empty(void *idx)
 	void *idx_ctx = NULL;
 	char **data = NULL;
 
+	if (idx != NULL && (((pbs_idx_t *) idx)->flags & PBS_IDX_HASH))
+		return ((pbs_idx_t *) idx)->count == 0;
+
 	if (pbs_idx_find(idx, NULL, (void **) &data, &idx_ctx) == PBS_IDX_RET_OK)
 		return 0;
 
@@ -965,6 +965,9 @@ init_abort_jobs(int recover, pbs_list_head *multinode_jobs)
 
 	CLEAR_HEAD((*multinode_jobs));
 
+	/* bring the job and task files up to date before reading them */
+	job_journal_replay();
+
 	dir = opendir(path_jobs);
 	if (dir == NULL) {
 		log_event(PBSEVENT_ERROR, PBS_EVENTCLASS_SERVER, LOG_ALERT,
@@ -46,9 +46,21 @@
  *
  *	The data is recorded in a file whose name is the job_id.
  *
+ *	When $job_state_journal is enabled, saves of a job whose file
+ *	already exists, and saves of its tasks, are appended as records to
+ *	a single per-MoM journal instead of rewriting the job and task
+ *	files.  The journal is folded back into those files by a periodic
+ *	checkpoint, and replayed into them at MoM start up before the jobs
+ *	are recovered.
+ *
  *	The following public functions are provided:
  *		job_save_fs() -		save the disk image
  *		job_recov_fs() -		recover (read) job from disk
+ *		job_journal_task() -	journal a task save
+ *		job_journal_purge() -	journal the removal of a job
+ *		job_journal_stamp() -	stamp a directly written job or task file
+ *		job_journal_replay() -	apply the journal to the job files
+ *		job_journal_checkpoint() - fold the journal into the job files
  */
 
 #include <pbs_config.h> /* the master config generated by configure */
@@ -79,49 +91,275 @@
 #include "svrfunc.h"
 #include <memory.h>
 #include "libutil.h"
+#include "mom_mach.h"
+#include "mom_func.h"
 
 #define MAX_SAVE_TRIES 3
 
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+#define JNL_FILE_NAME "journal"
+#define JNL_MAGIC 0x4a4e4c31			  /* "JNL1" */
+#define JNL_CHECKPOINT_SIZE (4 * 1024 * 1024) /* bytes */
+#define JNL_CHECKPOINT_INTERVAL 300		  /* seconds */
+
+/* journal record types */
+
+enum jnl_rec_type {
+	JNL_REC_QUICK = 1, /* job fixed and extended areas */
+	JNL_REC_FULL,	   /* complete job file image */
+	JNL_REC_TASK,	   /* task fixed area */
+	JNL_REC_PURGE	   /* job and its tasks removed */
+};
+
+/*
+ * Every journal record starts with this header, followed by jr_len
+ * bytes of data.  A full record is written with a zero length which
+ * is filled in once the image is complete, so a record cut short by
+ * a crash is recognized and dropped on replay.
+ *
+ * Job and task files written directly, by a forked child or when the
+ * journal cannot be used, get their modification time set to the time
+ * of the write (see job_journal_stamp()).  Replay skips any record
+ * stamped before the file it applies to was last written.
+ */
+struct jnl_rec {
+	int jr_magic;
+	int jr_type;
+	off_t jr_len;
+	struct timespec jr_stamp;	    /* time the record was appended */
+	char jr_fbase[PBS_MAXSVRJOBID + 1]; /* job file prefix or job id */
+};
+
 /* global data items */
 
 extern char *path_jobs;
 extern time_t time_now;
 extern char pbs_recov_filename[];
+extern char task_fmt[];
+extern pbs_list_head svr_alljobs;
 
 /* data global only to this file */
 
 static const size_t fixedsize = sizeof(struct jobfix);
 static const size_t extndsize = sizeof(union jobextend);
 
+static int jnl_fd = -1;		  /* journal, open while journaling */
+static pid_t jnl_owner = -1;	  /* process allowed to checkpoint */
+static off_t jnl_size = 0;	  /* current end of the journal */
+static time_t jnl_ckpt_time = 0; /* time of last checkpoint */
+
 /**
  * @brief
- *		Saves (or updates) a job structure image on disk
+ *		Return the base name used for the files of a job.
  *
- *		Save does either - a quick update for state changes only,
- *			 - a full update for an existing file, or
- *			 - a full write for a new job
+ * @param[in]	pjob - pointer to job
  *
- *		For a quick update, the data written is less than a disk block
- *		size and no size change occurs.
+ * @return	file prefix if set, otherwise the job id
+ */
+static char *
+job_fbase(job *pjob)
+{
+	if (*pjob->ji_qs.ji_fileprefix != '\0')
+		return (pjob->ji_qs.ji_fileprefix);
+	return (pjob->ji_qs.ji_jobid);
+}
+
+/**
+ * @brief
+ *		Get the current time, as used for journal record stamps.
  *
- *		No need of O_SYNC flag as this will improve the performance.
- *		This might lead to data loss from file system in case of system
- *		crash. This is not an issue as data is mostly recovered from the
- *		database.
+ * @param[out]	ts - the current time
+ */
+static void
+jnl_now(struct timespec *ts)
+{
+	if (clock_gettime(CLOCK_REALTIME, ts) == -1) {
+		ts->tv_sec = time(NULL);
+		ts->tv_nsec = 0;
+	}
+}
+
+/**
+ * @brief
+ *		Set the modification time of a job or task file that was just
+ *		written directly, so that journal records appended before the
+ *		write are not replayed over it.
  *
- *		For a new file write, first time, the data is written directly to
- *		the file.
+ *		Forked children write the files directly and cannot append to
+ *		the journal, so this is done whether or not this process owns
+ *		the journal.
+ *
+ * @param[in]	fd - the file, still open
+ */
+void
+job_journal_stamp(int fd)
+{
+#ifndef WIN32
+	struct timespec times[2];
+
+	if (!mom_job_journal && (jnl_fd == -1))
+		return;
+	jnl_now(&times[1]);
+	times[0] = times[1];
+	if (futimens(fd, times) == -1)
+		log_err(errno, __func__, "futimens");
+#endif
+}
+
+/**
+ * @brief
+ *		Open the journal if journaling is enabled.
+ *
+ *		Only the process which opened the journal appends to it, a
+ *		forked child falls back to writing the job and task files.
+ *
+ * @return	int
+ * @retval	0	journal is open for appending
+ * @retval	-1	journaling is off or the journal cannot be used
+ */
+static int
+jnl_open(void)
+{
+	char path[MAXPATHLEN + 1];
+
+	if (!mom_job_journal)
+		return (-1);
+	if (jnl_fd != -1)
+		return ((jnl_owner == getpid()) ? 0 : -1);
+
+	snprintf(path, sizeof(path), "%s%s", path_jobs, JNL_FILE_NAME);
+	jnl_fd = open(path, O_WRONLY | O_CREAT | O_CLOEXEC, 0600);
+	if (jnl_fd == -1) {
+		log_errf(errno, __func__, "Failed to open %s", path);
+		return (-1);
+	}
+#ifdef WIN32
+	secure_file(path, "Administrators",
+		    READS_MASK | WRITES_MASK | STANDARD_RIGHTS_REQUIRED);
+	setmode(jnl_fd, O_BINARY);
+#endif
+	jnl_size = lseek(jnl_fd, (off_t) 0, SEEK_END);
+	jnl_owner = getpid();
+	jnl_ckpt_time = time_now;
+	return (0);
+}
+
+/**
+ * @brief
+ *		Drop a partially written record from the end of the journal.
+ */
+static void
+jnl_undo(void)
+{
+	if (ftruncate(jnl_fd, jnl_size) == -1)
+		log_err(errno, __func__, "ftruncate");
+	(void) lseek(jnl_fd, jnl_size, SEEK_SET);
+}
+
+/**
+ * @brief
+ *		Append a record of fixed size data to the journal.
+ *
+ * @param[in]	type - record type, JNL_REC_*
+ * @param[in]	fbase - job file base name
+ * @param[in]	data1 - first data area, may be NULL
+ * @param[in]	len1 - size of data1
+ * @param[in]	data2 - second data area, may be NULL
+ * @param[in]	len2 - size of data2
+ *
+ * @return	int
+ * @retval	0	Success
+ * @retval	-1	Failure, nothing was added to the journal
+ */
+static int
+jnl_append(int type, char *fbase, char *data1, size_t len1, char *data2, size_t len2)
+{
+	struct jnl_rec rec;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.jr_magic = JNL_MAGIC;
+	rec.jr_type = type;
+	rec.jr_len = len1 + len2;
+	jnl_now(&rec.jr_stamp);
+	pbs_strncpy(rec.jr_fbase, fbase, sizeof(rec.jr_fbase));
+
+	save_setup(jnl_fd);
+	if ((save_struct((char *) &rec, sizeof(rec)) != 0) ||
+	    ((len1 > 0) && (save_struct(data1, len1) != 0)) ||
+	    ((len2 > 0) && (save_struct(data2, len2) != 0)) ||
+	    (save_flush() != 0)) {
+		log_err(errno, __func__, "error writing journal");
+		jnl_undo();
+		return (-1);
+	}
+	jnl_size += sizeof(rec) + rec.jr_len;
+	return (0);
+}
+
+/**
+ * @brief
+ *		Append a full image of a job, as it would be written to the
+ *		job file, to the journal.
+ *
+ * @param[in]	pjob - pointer to job
+ *
+ * @return	int
+ * @retval	0	Success
+ * @retval	-1	Failure, nothing was added to the journal
+ */
+static int
+jnl_append_full(job *pjob)
+{
+	struct jnl_rec rec;
+	off_t end;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.jr_magic = JNL_MAGIC;
+	rec.jr_type = JNL_REC_FULL;
+	jnl_now(&rec.jr_stamp);
+	pbs_strncpy(rec.jr_fbase, job_fbase(pjob), sizeof(rec.jr_fbase));
+
+	save_setup(jnl_fd);
+	if ((save_struct((char *) &rec, sizeof(rec)) != 0) ||
+	    (save_struct((char *) &pjob->ji_qs, fixedsize) != 0) ||
+	    (save_struct((char *) &pjob->ji_extended, extndsize) != 0) ||
+	    (save_attr_fs(job_attr_def, pjob->ji_wattr, (int) JOB_ATR_LAST) != 0) ||
+	    (save_flush() != 0)) {
+		log_err(errno, __func__, "error writing journal");
+		jnl_undo();
+		return (-1);
+	}
+
+	/* now that the image is complete, commit it by setting its length */
+	end = lseek(jnl_fd, (off_t) 0, SEEK_CUR);
+	rec.jr_len = end - jnl_size - sizeof(rec);
+	if ((lseek(jnl_fd, jnl_size, SEEK_SET) == -1) ||
+	    (write(jnl_fd, (char *) &rec, sizeof(rec)) != sizeof(rec)) ||
+	    (lseek(jnl_fd, end, SEEK_SET) == -1)) {
+		log_err(errno, __func__, "error committing journal record");
+		jnl_undo();
+		return (-1);
+	}
+	jnl_size = end;
+	return (0);
+}
+
+/**
+ * @brief
+ *		Write a job to its job file.
  *
  * @param[in]	pjob - Pointer to the job structure to save
+ * @param[in]	quick - if set, only rewrite the fixed and extended areas
  *
  * @return      Error code
  * @retval	 0  - Success
  * @retval	-1  - Failure
- *
  */
-
-int
-job_save_fs(job *pjob)
+static int
+job_write_fs(job *pjob, int quick)
 {
 	int fds;
 	int i;
@@ -131,7 +369,6 @@ job_save_fs(job *pjob)
 	int openflags;
 	int redo;
 	int pmode;
-	int quick = 1;
 
 #ifdef WIN32
 	pmode = _S_IWRITE | _S_IREAD;
@@ -140,26 +377,10 @@ job_save_fs(job *pjob)
 #endif
 
 	(void) strcpy(namebuf1, path_jobs); /* job directory path */
-	if (*pjob->ji_qs.ji_fileprefix != '\0')
-		(void) strcat(namebuf1, pjob->ji_qs.ji_fileprefix);
-	else
-		(void) strcat(namebuf1, pjob->ji_qs.ji_jobid);
+	(void) strcat(namebuf1, job_fbase(pjob));
 	(void) strcpy(namebuf2, namebuf1); /* setup for later */
 	(void) strcat(namebuf1, JOB_FILE_SUFFIX);
 
-	if (pjob->ji_qs.ji_jsversion != JSVERSION) {
-		/* version of job structure changed, force full write */
-		pjob->ji_qs.ji_jsversion = JSVERSION;
-		quick = 0;
-	}
-
-	for (i = 0; i < JOB_ATR_LAST; i++) {
-		if ((get_jattr(pjob, i))->at_flags & ATR_VFLAG_MODIFY) {
-			quick = 0;
-			break;
-		}
-	}
-
 	if (quick) {
 		openflags = O_WRONLY;
 		fds = open(namebuf1, openflags, pmode);
@@ -179,6 +400,7 @@ job_save_fs(job *pjob)
 		if ((save_struct((char *) &pjob->ji_qs, fixedsize) == 0) &&
 		    (save_struct((char *) &pjob->ji_extended, extndsize) == 0) &&
 		    (save_flush() == 0)) {
+			job_journal_stamp(fds);
 			(void) close(fds);
 		} else {
 			log_err(errno, "job_save", "error quickwrite");
@@ -187,9 +409,6 @@ job_save_fs(job *pjob)
 		}
 
 	} else {
-		/* an attribute changed,  update mtime */
-		set_jattr_l_slim(pjob, JOB_ATR_mtime, time_now, SET);
-
 		/*
 		 * write the whole structure to the file.
 		 * For a update, this is done to a new file to protect the
@@ -246,6 +465,8 @@ job_save_fs(job *pjob)
 				break;
 		}
 
+		if (i < MAX_SAVE_TRIES)
+			job_journal_stamp(fds); /* kept by the rename */
 		(void) close(fds);
 		if (i >= MAX_SAVE_TRIES)
 			return (-1);
@@ -270,9 +491,89 @@ job_save_fs(job *pjob)
 		}
 #endif
 	}
+	pjob->ji_jnlflags |= JOB_JNL_FILE;
 	return (0);
 }
 
+/**
+ * @brief
+ *		Saves (or updates) a job structure image on disk
+ *
+ *		Save does either - a quick update for state changes only,
+ *			 - a full update for an existing file, or
+ *			 - a full write for a new job
+ *
+ *		For a quick update, the data written is less than a disk block
+ *		size and no size change occurs.
+ *
+ *		No need of O_SYNC flag as this will improve the performance.
+ *		This might lead to data loss from file system in case of system
+ *		crash. This is not an issue as data is mostly recovered from the
+ *		database.
+ *
+ *		For a new file write, first time, the data is written directly to
+ *		the file.  Once the file exists and journaling is enabled, the
+ *		update is appended to the journal instead.
+ *
+ * @param[in]	pjob - Pointer to the job structure to save
+ *
+ * @return      Error code
+ * @retval	 0  - Success
+ * @retval	-1  - Failure
+ *
+ */
+
+int
+job_save_fs(job *pjob)
+{
+	int i;
+	int quick = 1;
+	int rc;
+
+	if (pjob->ji_qs.ji_jsversion != JSVERSION) {
+		/* version of job structure changed, force full write */
+		pjob->ji_qs.ji_jsversion = JSVERSION;
+		quick = 0;
+	}
+
+	for (i = 0; i < JOB_ATR_LAST; i++) {
+		if ((get_jattr(pjob, i))->at_flags & ATR_VFLAG_MODIFY) {
+			quick = 0;
+			break;
+		}
+	}
+
+	/* an attribute changed,  update mtime */
+	if (!quick)
+		set_jattr_l_slim(pjob, JOB_ATR_mtime, time_now, SET);
+
+	if ((pjob->ji_jnlflags & JOB_JNL_FILE) && (jnl_open() == 0)) {
+		if (quick)
+			rc = jnl_append(JNL_REC_QUICK, job_fbase(pjob),
+					(char *) &pjob->ji_qs, fixedsize,
+					(char *) &pjob->ji_extended, extndsize);
+		else
+			rc = jnl_append_full(pjob);
+		if (rc == 0) {
+			pjob->ji_jnlflags |= JOB_JNL_PEND;
+			if (!quick)
+				pjob->ji_jnlflags |= JOB_JNL_FULL;
+			job_journal_checkpoint(0);
+			return (0);
+		}
+	}
+
+	/*
+	 * The file is stamped as it is written, so journal records of the
+	 * job appended before now are not replayed over it, also when this
+	 * is a forked child which cannot checkpoint the journal.
+	 */
+	rc = job_write_fs(pjob, quick);
+	if ((rc == 0) && !quick)
+		pjob->ji_jnlflags &= ~JOB_JNL_FULL;
+	return (rc);
+}
+
 /**
  * @brief
  *		recover (read in) a job from its save file
@@ -458,5 +759,416 @@ job_recov_fs(char *filename)
 	(void) rename(basen, pbs_recov_filename);
 #endif
 
+	pj->ji_jnlflags = JOB_JNL_FILE;
 	return (pj);
 }
+
+/**
+ * @brief
+ *		Append the critical information of a task to the journal.
+ *
+ *		Tasks are only journaled once their job has a job file, which
+ *		is also when the job's task directory exists.
+ *
+ * @param[in]	ptask - task to save
+ *
+ * @return	int
+ * @retval	0	task was journaled
+ * @retval	-1	task was not journaled, the caller writes the task file
+ */
+int
+job_journal_task(pbs_task *ptask)
+{
+	job *pjob = ptask->ti_job;
+
+	if (((pjob->ji_jnlflags & JOB_JNL_FILE) == 0) || (jnl_open() != 0))
+		return (-1);
+	if (jnl_append(JNL_REC_TASK, job_fbase(pjob), (char *) &ptask->ti_qs,
+		       sizeof(ptask->ti_qs), NULL, 0) != 0)
+		return (-1);
+	pjob->ji_jnlflags |= JOB_JNL_PEND;
+	job_journal_checkpoint(0);
+	return (0);
+}
+
+/**
+ * @brief
+ *		Record in the journal that a job is being purged, so that
+ *		replaying earlier records does not bring its files back.
+ *		Called before the job's files are removed.
+ *
+ *		If the purge record cannot be appended, the journal is
+ *		checkpointed instead, which drops the older records.  A forked
+ *		child can do neither, replay then relies on the job file being
+ *		gone, as records of a job without a job file are skipped.
+ *
+ * @param[in]	pjob - job being purged
+ */
+void
+job_journal_purge(job *pjob)
+{
+	if ((pjob->ji_jnlflags & JOB_JNL_PEND) == 0 || (jnl_fd == -1))
+		return;
+	if (jnl_owner != getpid())
+		return;
+	if (jnl_append(JNL_REC_PURGE, job_fbase(pjob), NULL, 0, NULL, 0) == 0) {
+		pjob->ji_jnlflags &= ~(JOB_JNL_PEND | JOB_JNL_FULL);
+		return;
+	}
+
+	/* the checkpoint clears JOB_JNL_PEND once the journal is truncated */
+	job_journal_checkpoint(1);
+	if (pjob->ji_jnlflags & JOB_JNL_PEND)
+		log_event(PBSEVENT_ERROR, PBS_EVENTCLASS_JOB, LOG_ERR,
+			  pjob->ji_qs.ji_jobid,
+			  "purge could not be journaled, journal records of the job are kept");
+}
+
+/**
+ * @brief
+ *		Fold the journal into the job and task files.
+ *
+ *		Every job with journaled records is written out from memory,
+ *		after which the journal is truncated.  Unless forced, this is
+ *		only done once the journal has grown past JNL_CHECKPOINT_SIZE
+ *		or JNL_CHECKPOINT_INTERVAL seconds have passed.  When
+ *		journaling has been turned off, the journal is removed.
+ *
+ * @param[in]	force - if set, checkpoint now
+ */
+void
+job_journal_checkpoint(int force)
+{
+	job *pjob;
+	pbs_task *ptask;
+	int errs = 0;
+	char path[MAXPATHLEN + 1];
+
+	if ((jnl_fd == -1) || (jnl_owner != getpid()))
+		return;
+	if (!force && mom_job_journal && (jnl_size < JNL_CHECKPOINT_SIZE) &&
+	    ((time_now - jnl_ckpt_time) < JNL_CHECKPOINT_INTERVAL))
+		return;
+
+	jnl_ckpt_time = time_now;
+	if (jnl_size > 0) {
+		for (pjob = (job *) GET_NEXT(svr_alljobs);
+		     pjob != NULL;
+		     pjob = (job *) GET_NEXT(pjob->ji_alljobs)) {
+			if ((pjob->ji_jnlflags & JOB_JNL_PEND) == 0)
+				continue;
+			if (job_write_fs(pjob, (pjob->ji_jnlflags & JOB_JNL_FULL) == 0) != 0) {
+				errs++;
+				continue;
+			}
+			for (ptask = (pbs_task *) GET_NEXT(pjob->ji_tasks);
+			     ptask != NULL;
+			     ptask = (pbs_task *) GET_NEXT(ptask->ti_jobtask)) {
+				if (task_write(ptask) != 0)
+					errs++;
+			}
+		}
+		if (errs) {
+			/* keep the journal, it is replayed on restart */
+			log_event(PBSEVENT_ERROR, PBS_EVENTCLASS_SERVER, LOG_ERR,
+				  __func__, "journal checkpoint incomplete");
+			return;
+		}
+		if (ftruncate(jnl_fd, (off_t) 0) == -1) {
+			log_err(errno, __func__, "ftruncate");
+			return;
+		}
+		(void) lseek(jnl_fd, (off_t) 0, SEEK_SET);
+		jnl_size = 0;
+
+		/* only now are the files all there is to replay */
+		for (pjob = (job *) GET_NEXT(svr_alljobs);
+		     pjob != NULL;
+		     pjob = (job *) GET_NEXT(pjob->ji_alljobs))
+			pjob->ji_jnlflags &= ~(JOB_JNL_PEND | JOB_JNL_FULL);
+	}
+
+	if (!mom_job_journal) {
+		(void) close(jnl_fd);
+		jnl_fd = -1;
+		snprintf(path, sizeof(path), "%s%s", path_jobs, JNL_FILE_NAME);
+		(void) unlink(path);
+	}
+}
+
+/**
+ * @brief
+ *		Read the data of a journal record.
+ *
+ * @param[in]	fd - journal
+ * @param[out]	buf - buffer for the data
+ * @param[in]	len - length of the data
+ *
+ * @return	int
+ * @retval	0	Success
+ * @retval	-1	the journal ends early
+ */
+static int
+jnl_read(int fd, char *buf, size_t len)
+{
+	ssize_t i;
+
+	while (len > 0) {
+		i = read(fd, buf, len);
+		if (i <= 0) {
+			if ((i == -1) && (errno == EINTR))
+				continue;
+			return (-1);
+		}
+		buf += i;
+		len -= i;
+	}
+	return (0);
+}
+
+/**
+ * @brief
+ *		Set the modification time of a file written on replay to the
+ *		stamp of the record written to it, so later records still
+ *		apply.
+ *
+ * @param[in]	fd - the file, still open
+ * @param[in]	stamp - stamp of the record
+ */
+static void
+jnl_set_mtime(int fd, struct timespec *stamp)
+{
+#ifndef WIN32
+	struct timespec times[2];
+
+	times[0] = *stamp;
+	times[1] = *stamp;
+	(void) futimens(fd, times);
+#endif
+}
+
+/**
+ * @brief
+ *		Check whether a file was written after a journal record was
+ *		appended, in which case the record must not be replayed.
+ *
+ * @param[in]	path - file the record applies to
+ * @param[in]	stamp - stamp of the record
+ *
+ * @return	int
+ * @retval	1	the file is newer than the record
+ * @retval	0	the file is older than the record
+ * @retval	-1	the file does not exist
+ */
+static int
+jnl_file_newer(char *path, struct timespec *stamp)
+{
+	struct stat sb;
+
+	if (stat(path, &sb) == -1)
+		return (-1);
+#ifdef WIN32
+	return (sb.st_mtime > stamp->tv_sec);
+#else
+	if (sb.st_mtim.tv_sec != stamp->tv_sec)
+		return (sb.st_mtim.tv_sec > stamp->tv_sec);
+	return (sb.st_mtim.tv_nsec > stamp->tv_nsec);
+#endif
+}
+
+/**
+ * @brief
+ *		Write data to a file, replacing its start.
+ *
+ * @param[in]	path - file to write
+ * @param[in]	flags - additional open flags
+ * @param[in]	buf - data
+ * @param[in]	len - length of data
+ * @param[in]	stamp - stamp of the record the data comes from
+ *
+ * @return	int
+ * @retval	0	Success
+ * @retval	-1	Failure
+ */
+static int
+jnl_write_file(char *path, int flags, char *buf, size_t len, struct timespec *stamp)
+{
+	int fds;
+	int rc = 0;
+
+	fds = open(path, O_WRONLY | flags, 0600);
+	if (fds == -1) {
+		if (errno != ENOENT)
+			log_errf(errno, __func__, "Failed to open %s", path);
+		return (-1);
+	}
+#ifdef WIN32
+	setmode(fds, O_BINARY);
+#endif
+	if (write(fds, buf, len) != (ssize_t) len) {
+		log_errf(errno, __func__, "Failed to write %s", path);
+		rc = -1;
+	} else
+		jnl_set_mtime(fds, stamp);
+	(void) close(fds);
+	return (rc);
+}
+
+/**
+ * @brief
+ *		Apply the journal to the job and task files.
+ *
+ *		Called at MoM start up, before the job files are recovered.
+ *		The records are applied in order, which leaves the files as
+ *		they would have been had journaling been off.  Records of a
+ *		job whose job file is gone, or that are older than the file
+ *		they apply to, are skipped: the file was written directly
+ *		after the record, by a forked child or when the journal could
+ *		not be used.  A record cut short at the end of the journal is
+ *		discarded.  The journal is removed afterwards.
+ */
+void
+job_journal_replay(void)
+{
+	int fd;
+	int fds;
+	int nrec = 0;
+	int nskip = 0;
+	int torn = 0;
+	int werr;
+	int skip;
+	off_t left;
+	ssize_t amt;
+	struct jnl_rec rec;
+	char jpath[MAXPATHLEN + 1];
+	char path[MAXPATHLEN + 1];
+	char jobfile[MAXPATHLEN + 1];
+	char copy[MAXPATHLEN + 1];
+	char buf[4096];
+
+	snprintf(jpath, sizeof(jpath), "%s%s", path_jobs, JNL_FILE_NAME);
+	fd = open(jpath, O_RDONLY, 0);
+	if (fd == -1)
+		return;
+#ifdef WIN32
+	setmode(fd, O_BINARY);
+#endif
+
+	while ((amt = read(fd, (char *) &rec, sizeof(rec))) != 0) {
+		if ((amt != sizeof(rec)) || (rec.jr_magic != JNL_MAGIC) ||
+		    (rec.jr_len < 0) ||
+		    ((rec.jr_type != JNL_REC_FULL) && (rec.jr_len > (off_t) sizeof(buf)))) {
+			torn = 1;
+			break;
+		}
+		rec.jr_fbase[sizeof(rec.jr_fbase) - 1] = '\0';
+		snprintf(path, sizeof(path), "%s%s", path_jobs, rec.jr_fbase);
+		strcpy(jobfile, path);
+		strcat(jobfile, JOB_FILE_SUFFIX);
+		skip = (rec.jr_type != JNL_REC_PURGE) && (jnl_file_newer(jobfile, &rec.jr_stamp) != 0);
+
+		switch (rec.jr_type) {
+			case JNL_REC_QUICK:
+				if ((rec.jr_len != (off_t) (fixedsize + extndsize)) ||
+				    (jnl_read(fd, buf, rec.jr_len) != 0)) {
+					torn = 1;
+					break;
+				}
+				if (!skip)
+					(void) jnl_write_file(jobfile, 0, buf, rec.jr_len, &rec.jr_stamp);
+				break;
+
+			case JNL_REC_FULL:
+				if (rec.jr_len == 0) {
+					torn = 1;
+					break;
+				}
+				if (skip) {
+					if (lseek(fd, rec.jr_len, SEEK_CUR) == -1)
+						torn = 1;
+					break;
+				}
+				snprintf(copy, sizeof(copy), "%s%s", path, JOB_FILE_COPY);
+				strcat(path, JOB_FILE_SUFFIX);
+				fds = open(copy, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+				werr = (fds == -1);
+				if (werr)
+					log_errf(errno, __func__, "Failed to open %s", copy);
+#ifdef WIN32
+				else
+					setmode(fds, O_BINARY);
+#endif
+				for (left = rec.jr_len; left > 0; left -= amt) {
+					amt = (left > (off_t) sizeof(buf)) ? (ssize_t) sizeof(buf) : (ssize_t) left;
+					if (jnl_read(fd, buf, amt) != 0) {
+						torn = 1;
+						break;
+					}
+					if (!werr && (write(fds, buf, amt) != amt)) {
+						log_errf(errno, __func__, "Failed to write %s", copy);
+						werr = 1;
+					}
+				}
+				if (fds == -1)
+					break;
+				if (!torn && !werr)
+					jnl_set_mtime(fds, &rec.jr_stamp);
+				(void) close(fds);
+				if (torn || werr || (rename(copy, path) == -1)) {
+					if (!torn && !werr)
+						log_errf(errno, __func__, "Failed to rename %s", copy);
+					(void) unlink(copy);
+				}
+				break;
+
+			case JNL_REC_TASK:
+				if ((rec.jr_len != (off_t) sizeof(struct taskfix)) ||
+				    (jnl_read(fd, buf, rec.jr_len) != 0)) {
+					torn = 1;
+					break;
+				}
+				/* while the job file is there, the task file decides */
+				if (jnl_file_newer(jobfile, &rec.jr_stamp) == -1)
+					break;
+				skip = 0;
+				strcat(path, JOB_TASKDIR_SUFFIX);
+				if ((mkdir(path, 0700) == -1) && (errno != EEXIST)) {
+					log_errf(errno, __func__, "Failed to create %s", path);
+					break;
+				}
+				sprintf(path + strlen(path), task_fmt,
+					((struct taskfix *) buf)->ti_task);
+				if (jnl_file_newer(path, &rec.jr_stamp) == 1)
+					skip = 1;
+				else
+					(void) jnl_write_file(path, O_CREAT, buf, rec.jr_len, &rec.jr_stamp);
+				break;
+
+			case JNL_REC_PURGE:
+				strcpy(copy, path);
+				strcat(path, JOB_FILE_SUFFIX);
+				(void) unlink(path);
+				strcat(copy, JOB_TASKDIR_SUFFIX);
+				(void) remtree(copy);
+				break;
+
+			default:
+				torn = 1;
+				break;
+		}
+		if (torn)
+			break;
+		if (skip)
+			nskip++;
+		else
+			nrec++;
+	}
+	(void) close(fd);
+
+	if (torn)
+		log_event(PBSEVENT_ERROR, PBS_EVENTCLASS_SERVER, LOG_WARNING,
+			  __func__, "discarded incomplete record at end of journal");
+	log_eventf(PBSEVENT_SYSTEM, PBS_EVENTCLASS_SERVER, LOG_INFO, __func__,
+		   "applied %d journal records, skipped %d older than their files", nrec, nskip);
+	(void) unlink(jpath);
+}
@@ -0,0 +1,799 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+/**
+ * @file	mom_cgroup.c
+ *
+ * @brief
+ *	Native cgroup v2 job containment.
+ *
+ *	When $cgroup_manager is set, MoM creates a cgroup for each job under
+ *	<cgroup2 mount>/<cgroup_prefix>/<job id> before the job's first task
+ *	is started, limits its cpuset and memory, moves every task of the job
+ *	into it, and removes it when the job is purged.  The settings are
+ *	taken from the configuration file of the pbs_cgroups hook,
+ *	PBS_HOME/mom_priv/hooks/pbs_cgroups.CF, so the hook can be disabled
+ *	without configuring containment twice.  Job usage is then read from
+ *	the cgroup by mom_set_use().
+ */
+
+#include <pbs_config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "pbs_ifl.h"
+#include "log.h"
+#include "job.h"
+#include "resource.h"
+#include "hook.h"
+#include "mom_func.h"
+#include "pbs_json.h"
+
+extern char *msg_err_malloc;
+
+#define CG_CONFIG_FILE "pbs_cgroups"
+#define CG_DEFAULT_PREFIX "pbs_jobs"
+#define CG_MAXCPUS 4096
+#define CG_CPUBYTES (CG_MAXCPUS / 8)
+
+#define CG_CPU_SET(m, c) ((m)[(c) >> 3] |= (1 << ((c) &7)))
+#define CG_CPU_ISSET(m, c) ((m)[(c) >> 3] & (1 << ((c) &7)))
+
+extern char *path_hooks;
+extern char mom_host[];
+extern char mom_short_name[];
+
+/* settings read from pbs_cgroups.CF */
+static struct cg_config {
+	struct timespec cc_mtim;	     /* mtime of the file loaded */
+	off_t cc_size;			     /* size of the file loaded */
+	ino_t cc_ino;			     /* inode of the file loaded */
+	int cc_loaded;			     /* a config file was read */
+	int cc_enabled;			     /* containment applies to this host */
+	char cc_prefix[MAXPATHLEN + 1];	     /* cgroup_prefix */
+	int cc_cpuset;			     /* cgroup.cpuset.enabled */
+	unsigned char cc_excl_cpus[CG_CPUBYTES]; /* cgroup.cpuset.exclude_cpus */
+	int cc_memory;			     /* cgroup.memory.enabled */
+	int cc_mem_soft;		     /* cgroup.memory.soft_limit */
+	long long cc_mem_default;	     /* cgroup.memory.default if enforced, in kb */
+	int cc_memsw;			     /* cgroup.memsw.enabled */
+	long long cc_memsw_default;	     /* cgroup.memsw.default if enforced, in kb */
+} cg_conf;
+
+/* a job cgroup created by this MoM */
+struct cg_job {
+	char cj_jobid[PBS_MAXSVRJOBID + 1];
+	unsigned char cj_cpus[CG_CPUBYTES]; /* cpus given to the job */
+	struct cg_job *cj_next;
+};
+
+static struct cg_job *cg_jobs = NULL;
+static char cg_mount[MAXPATHLEN + 1]; /* where cgroup2 is mounted */
+static int cg_scanned = 0;	      /* existing job cgroups were looked at */
+
+/**
+ * @brief
+ *	Parse a cpu list such as "0-3,8,10-11" into a cpu mask.
+ *
+ * @param[in]	list - cpu list
+ * @param[out]	mask - cpu mask, CG_CPUBYTES long
+ */
+static void
+cg_parse_cpus(char *list, unsigned char *mask)
+{
+	char *p = list;
+	char *end;
+	long lo;
+	long hi;
+
+	memset(mask, 0, CG_CPUBYTES);
+	while (*p != '\0') {
+		lo = strtol(p, &end, 10);
+		if (end == p)
+			break;
+		hi = lo;
+		if (*end == '-') {
+			p = end + 1;
+			hi = strtol(p, &end, 10);
+			if (end == p)
+				break;
+		}
+		for (; (lo <= hi) && (lo < CG_MAXCPUS); lo++)
+			if (lo >= 0)
+				CG_CPU_SET(mask, lo);
+		p = end;
+		while ((*p == ',') || (*p == '\n') || (*p == ' '))
+			p++;
+	}
+}
+
+/**
+ * @brief
+ *	Format a cpu mask as a cpu list.
+ *
+ * @param[in]	mask - cpu mask
+ * @param[out]	buf - buffer for the list
+ * @param[in]	len - size of buf
+ */
+static void
+cg_format_cpus(unsigned char *mask, char *buf, size_t len)
+{
+	size_t used = 0;
+	int c;
+	int start;
+
+	buf[0] = '\0';
+	for (c = 0; c < CG_MAXCPUS; c++) {
+		if (!CG_CPU_ISSET(mask, c))
+			continue;
+		start = c;
+		while ((c + 1 < CG_MAXCPUS) && CG_CPU_ISSET(mask, c + 1))
+			c++;
+		if (start == c)
+			used += snprintf(buf + used, len - used, "%s%d", used ? "," : "", c);
+		else
+			used += snprintf(buf + used, len - used, "%s%d-%d", used ? "," : "", start, c);
+		if (used >= len) {
+			buf[len - 1] = '\0';
+			return;
+		}
+	}
+}
+
+/**
+ * @brief
+ *	Read the first line of a cgroup file.
+ *
+ * @param[in]	dir - cgroup directory
+ * @param[in]	file - file in the directory
+ * @param[out]	buf - buffer for the line
+ * @param[in]	len - size of buf
+ *
+ * @return	int
+ * @retval	0	success
+ * @retval	-1	failure
+ */
+static int
+cg_read(char *dir, char *file, char *buf, size_t len)
+{
+	char path[MAXPATHLEN + 1];
+	ssize_t n;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, file);
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return -1;
+	n = read(fd, buf, len - 1);
+	close(fd);
+	if (n < 0)
+		return -1;
+	buf[n] = '\0';
+	buf[strcspn(buf, "\n")] = '\0';
+	return 0;
+}
+
+/**
+ * @brief
+ *	Write a value to a cgroup file.
+ *
+ * @param[in]	dir - cgroup directory
+ * @param[in]	file - file in the directory
+ * @param[in]	val - value to write
+ *
+ * @return	int
+ * @retval	0	success
+ * @retval	-1	failure, errno is set
+ */
+static int
+cg_write(char *dir, char *file, char *val)
+{
+	char path[MAXPATHLEN + 1];
+	ssize_t n;
+	int fd;
+	int save_errno;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, file);
+	if ((fd = open(path, O_WRONLY)) == -1)
+		return -1;
+	n = write(fd, val, strlen(val));
+	save_errno = errno;
+	close(fd);
+	errno = save_errno;
+	return ((n == (ssize_t) strlen(val)) ? 0 : -1);
+}
+
+/**
+ * @brief
+ *	Find where the cgroup v2 hierarchy is mounted.
+ *
+ * @return	int
+ * @retval	0	found, cg_mount is set
+ * @retval	-1	no cgroup2 mount
+ */
+static int
+cg_find_mount(void)
+{
+	FILE *fp;
+	char line[MAXPATHLEN * 2];
+	char dev[MAXPATHLEN + 1];
+	char dir[MAXPATHLEN + 1];
+	char type[64];
+
+	if (cg_mount[0] != '\0')
+		return 0;
+	if ((fp = fopen("/proc/self/mounts", "r")) == NULL)
+		return -1;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (sscanf(line, "%1024s %1024s %63s", dev, dir, type) != 3)
+			continue;
+		if (strcmp(type, "cgroup2") == 0) {
+			pbs_strncpy(cg_mount, dir, sizeof(cg_mount));
+			break;
+		}
+	}
+	fclose(fp);
+	return ((cg_mount[0] != '\0') ? 0 : -1);
+}
+
+/**
+ * @brief
+ *	Return whether a json array of host names names this MoM.
+ *
+ * @param[in]	hosts - json array
+ *
+ * @return	int
+ * @retval	1	this host is listed
+ * @retval	0	it is not
+ */
+static int
+cg_host_listed(json_data *hosts)
+{
+	char *name;
+	int i;
+
+	for (i = 0; i < pbs_json_array_size(hosts); i++) {
+		name = pbs_json_string_value(pbs_json_array_item(hosts, i));
+		if ((name != NULL) &&
+		    ((strcmp(name, mom_short_name) == 0) || (strcmp(name, mom_host) == 0)))
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * @brief
+ *	Read the default limit of a memory controller section, in kb.
+ *
+ * @param[in]	sect - "memory" or "memsw" section of the config
+ *
+ * @return	long long
+ * @retval	0	no default limit
+ */
+static long long
+cg_default_limit(json_data *sect)
+{
+	char *val;
+
+	if (!pbs_json_get_bool(sect, "enforce_default", 1))
+		return 0;
+	if ((val = pbs_json_get_string(sect, "default")) == NULL)
+		return 0;
+	return (to_kbsize(val));
+}
+
+/**
+ * @brief
+ *	(Re)load pbs_cgroups.CF if it changed since it was last read.
+ *
+ * @return	int
+ * @retval	0	cg_conf is usable
+ * @retval	-1	no usable configuration, containment is off
+ */
+static int
+cg_load_config(void)
+{
+	char path[MAXPATHLEN + 1];
+	struct stat sb;
+	char *buf;
+	char *val;
+	json_data *root;
+	json_data *cgroup;
+	json_data *sect;
+	json_data *cpus;
+	double num;
+	int fd;
+	int i;
+
+	snprintf(path, sizeof(path), "%s%s%s", path_hooks, CG_CONFIG_FILE, HOOK_CONFIG_SUFFIX);
+	if (stat(path, &sb) == -1) {
+		if (cg_conf.cc_loaded)
+			log_errf(errno, __func__, "cannot stat %s, cgroup containment disabled", path);
+		cg_conf.cc_loaded = 0;
+		return -1;
+	}
+	/* a rewrite within the same second still changes the size or the nanoseconds */
+	if (cg_conf.cc_loaded && (sb.st_mtim.tv_sec == cg_conf.cc_mtim.tv_sec) &&
+	    (sb.st_mtim.tv_nsec == cg_conf.cc_mtim.tv_nsec) &&
+	    (sb.st_size == cg_conf.cc_size) && (sb.st_ino == cg_conf.cc_ino))
+		return (cg_conf.cc_enabled ? 0 : -1);
+
+	cg_conf.cc_loaded = 0;
+	if ((buf = malloc(sb.st_size + 1)) == NULL) {
+		log_err(errno, __func__, msg_err_malloc);
+		return -1;
+	}
+	if (((fd = open(path, O_RDONLY)) == -1) ||
+	    (read(fd, buf, sb.st_size) != sb.st_size)) {
+		log_errf(errno, __func__, "cannot read %s", path);
+		if (fd != -1)
+			close(fd);
+		free(buf);
+		return -1;
+	}
+	close(fd);
+	buf[sb.st_size] = '\0';
+	root = pbs_json_parse(buf);
+	free(buf);
+	if (root == NULL) {
+		log_errf(-1, __func__, "%s is not valid JSON, cgroup containment disabled", path);
+		return -1;
+	}
+
+	memset(&cg_conf, 0, sizeof(cg_conf));
+	cg_conf.cc_mtim = sb.st_mtim;
+	cg_conf.cc_size = sb.st_size;
+	cg_conf.cc_ino = sb.st_ino;
+	cg_conf.cc_loaded = 1;
+	cg_conf.cc_enabled = 1;
+
+	if (cg_host_listed(pbs_json_get_item(root, "exclude_hosts")))
+		cg_conf.cc_enabled = 0;
+	if ((pbs_json_array_size(pbs_json_get_item(root, "run_only_on_hosts")) > 0) &&
+	    !cg_host_listed(pbs_json_get_item(root, "run_only_on_hosts")))
+		cg_conf.cc_enabled = 0;
+
+	val = pbs_json_get_string(root, "cgroup_prefix");
+	pbs_strncpy(cg_conf.cc_prefix, ((val != NULL) && (val[0] != '\0')) ? val : CG_DEFAULT_PREFIX,
+		    sizeof(cg_conf.cc_prefix));
+
+	cgroup = pbs_json_get_item(root, "cgroup");
+
+	sect = pbs_json_get_item(cgroup, "cpuset");
+	cg_conf.cc_cpuset = pbs_json_get_bool(sect, "enabled", 0) &&
+			    !cg_host_listed(pbs_json_get_item(sect, "exclude_hosts"));
+	cpus = pbs_json_get_item(sect, "exclude_cpus");
+	for (i = 0; i < pbs_json_array_size(cpus); i++) {
+		if ((pbs_json_number_value(pbs_json_array_item(cpus, i), &num) == 0) &&
+		    (num >= 0) && (num < CG_MAXCPUS))
+			CG_CPU_SET(cg_conf.cc_excl_cpus, (int) num);
+	}
+
+	sect = pbs_json_get_item(cgroup, "memory");
+	cg_conf.cc_memory = pbs_json_get_bool(sect, "enabled", 0) &&
+			    !cg_host_listed(pbs_json_get_item(sect, "exclude_hosts"));
+	cg_conf.cc_mem_soft = pbs_json_get_bool(sect, "soft_limit", 0);
+	cg_conf.cc_mem_default = cg_default_limit(sect);
+
+	sect = pbs_json_get_item(cgroup, "memsw");
+	cg_conf.cc_memsw = pbs_json_get_bool(sect, "enabled", 0) &&
+			   !cg_host_listed(pbs_json_get_item(sect, "exclude_hosts"));
+	cg_conf.cc_memsw_default = cg_default_limit(sect);
+
+	if (pbs_json_get_bool(pbs_json_get_item(cgroup, "devices"), "enabled", 0) ||
+	    pbs_json_get_bool(pbs_json_get_item(cgroup, "hugetlb"), "enabled", 0))
+		log_event(PBSEVENT_ADMIN, PBS_EVENTCLASS_SERVER, LOG_WARNING, __func__,
+			  "devices and hugetlb controllers are not managed by $cgroup_manager");
+	pbs_json_delete(root);
+
+	log_eventf(PBSEVENT_DEBUG, PBS_EVENTCLASS_SERVER, LOG_INFO, __func__,
+		   "loaded %s: %s, prefix %s, cpuset %d, memory %d, memsw %d", path,
+		   cg_conf.cc_enabled ? "enabled" : "excluded on this host",
+		   cg_conf.cc_prefix, cg_conf.cc_cpuset, cg_conf.cc_memory, cg_conf.cc_memsw);
+	return (cg_conf.cc_enabled ? 0 : -1);
+}
+
+/**
+ * @brief
+ *	Return whether the cgroup manager is active on this host.
+ *
+ * @return	int
+ * @retval	1	active
+ * @retval	0	not active
+ */
+static int
+cg_active(void)
+{
+	if (!mom_cgroup_manager)
+		return 0;
+	if (cg_load_config() != 0)
+		return 0;
+	if (cg_find_mount() != 0) {
+		log_err(-1, __func__, "no cgroup2 file system mounted");
+		return 0;
+	}
+	return 1;
+}
+
+/**
+ * @brief
+ *	Find the cgroup record of a job.
+ *
+ * @param[in]	jobid - job id
+ *
+ * @return	struct cg_job *
+ * @retval	NULL	the job has no cgroup
+ */
+static struct cg_job *
+cg_find_job(char *jobid)
+{
+	struct cg_job *cj;
+
+	for (cj = cg_jobs; cj != NULL; cj = cj->cj_next)
+		if (strcmp(cj->cj_jobid, jobid) == 0)
+			return cj;
+	return NULL;
+}
+
+/**
+ * @brief
+ *	Add a cgroup record for a job.
+ *
+ * @param[in]	jobid - job id
+ * @param[in]	cpus - cpus given to the job
+ *
+ * @return	struct cg_job *
+ * @retval	NULL	out of memory
+ */
+static struct cg_job *
+cg_add_job(char *jobid, unsigned char *cpus)
+{
+	struct cg_job *cj;
+
+	if ((cj = calloc(1, sizeof(struct cg_job))) == NULL) {
+		log_err(errno, __func__, msg_err_malloc);
+		return NULL;
+	}
+	pbs_strncpy(cj->cj_jobid, jobid, sizeof(cj->cj_jobid));
+	memcpy(cj->cj_cpus, cpus, CG_CPUBYTES);
+	cj->cj_next = cg_jobs;
+	cg_jobs = cj;
+	return cj;
+}
+
+/**
+ * @brief
+ *	Look at the job cgroups that already exist, as after a MoM restart.
+ *	Cgroups of known jobs are recorded so their cpus stay assigned,
+ *	cgroups left behind by purged jobs are removed.
+ *
+ * @param[in]	base - <mount>/<prefix>
+ */
+static void
+cg_scan(char *base)
+{
+	char dir[MAXPATHLEN + 1];
+	char buf[CG_MAXCPUS * 2];
+	unsigned char cpus[CG_CPUBYTES];
+	struct dirent *dent;
+	struct stat sb;
+	DIR *dp;
+
+	if ((dp = opendir(base)) == NULL)
+		return;
+	while ((dent = readdir(dp)) != NULL) {
+		if (dent->d_name[0] == '.')
+			continue;
+		if ((snprintf(dir, sizeof(dir), "%s/%s", base, dent->d_name) >= (int) sizeof(dir)) ||
+		    (stat(dir, &sb) == -1) || !S_ISDIR(sb.st_mode))
+			continue;
+		if (find_job(dent->d_name) == NULL) {
+			(void) cg_write(dir, "cgroup.kill", "1");
+			if (rmdir(dir) == 0)
+				log_eventf(PBSEVENT_DEBUG, PBS_EVENTCLASS_JOB, LOG_INFO, dent->d_name,
+					   "removed stale cgroup %s", dir);
+			continue;
+		}
+		if (cg_find_job(dent->d_name) != NULL)
+			continue;
+		memset(cpus, 0, sizeof(cpus));
+		if (cg_read(dir, "cpuset.cpus", buf, sizeof(buf)) == 0)
+			cg_parse_cpus(buf, cpus);
+		(void) cg_add_job(dent->d_name, cpus);
+	}
+	closedir(dp);
+	cg_scanned = 1;
+}
+
+/**
+ * @brief
+ *	Enable the controllers MoM uses in the children of a cgroup.
+ *	Controllers the kernel does not offer are left alone.
+ *
+ * @param[in]	dir - cgroup directory
+ */
+static void
+cg_enable_controllers(char *dir)
+{
+	static char *ctls[] = {"+cpu", "+cpuset", "+memory", "+pids", NULL};
+	int i;
+
+	for (i = 0; ctls[i] != NULL; i++)
+		(void) cg_write(dir, "cgroup.subtree_control", ctls[i]);
+}
+
+/**
+ * @brief
+ *	Pick the cpus for a job: the first 'ncpus' cpus of this host that
+ *	are not excluded and not given to another job.
+ *
+ * @param[in]	base - <mount>/<prefix>
+ * @param[in]	ncpus - number of cpus wanted
+ * @param[out]	cpus - the cpus picked
+ *
+ * @return	int
+ * @retval	0	success
+ * @retval	-1	not enough free cpus
+ */
+static int
+cg_pick_cpus(char *base, int ncpus, unsigned char *cpus)
+{
+	char buf[CG_MAXCPUS * 2];
+	unsigned char avail[CG_CPUBYTES];
+	struct cg_job *cj;
+	int c;
+	int i;
+
+	if ((cg_read(base, "cpuset.cpus.effective", buf, sizeof(buf)) == -1) &&
+	    (cg_read("/sys/devices/system/cpu", "online", buf, sizeof(buf)) == -1))
+		return -1;
+	cg_parse_cpus(buf, avail);
+	for (i = 0; i < CG_CPUBYTES; i++) {
+		avail[i] &= ~cg_conf.cc_excl_cpus[i];
+		for (cj = cg_jobs; cj != NULL; cj = cj->cj_next)
+			avail[i] &= ~cj->cj_cpus[i];
+	}
+
+	memset(cpus, 0, CG_CPUBYTES);
+	for (c = 0; (c < CG_MAXCPUS) && (ncpus > 0); c++) {
+		if (CG_CPU_ISSET(avail, c)) {
+			CG_CPU_SET(cpus, c);
+			ncpus--;
+		}
+	}
+	return ((ncpus == 0) ? 0 : -1);
+}
+
+/**
+ * @brief
+ *	Get the cgroup directory of a job managed by $cgroup_manager.
+ *
+ * @param[in]	pjob - job pointer
+ * @param[out]	buf - buffer for the path
+ * @param[in]	len - size of buf
+ *
+ * @return	int
+ * @retval	0	the job's cgroup path is in buf
+ * @retval	-1	cgroups are not managed by MoM
+ */
+int
+cgroup_job_dir(job *pjob, char *buf, size_t len)
+{
+	if (!mom_cgroup_manager)
+		return -1;
+	/* jobs recovered at startup are sampled before any job is started */
+	if (!cg_conf.cc_loaded)
+		(void) cg_active();
+	if (!cg_conf.cc_enabled || (cg_mount[0] == '\0'))
+		return -1;
+	snprintf(buf, len, "%s/%s/%s", cg_mount, cg_conf.cc_prefix, pjob->ji_qs.ji_jobid);
+	return 0;
+}
+
+/**
+ * @brief
+ *	Create the cgroup of a job, unless it already has one, and set
+ *	its cpuset and memory limits from the job's resources on this host.
+ *	Called in MoM before starting a task of the job.
+ *
+ * @param[in]	pjob - job pointer
+ *
+ * @return	int
+ * @retval	0	success, or cgroups are not managed by MoM
+ * @retval	-1	failure, message in log_buffer
+ */
+int
+cgroup_job_create(job *pjob)
+{
+	char base[MAXPATHLEN + 1];
+	char dir[MAXPATHLEN + 1];
+	char val[CG_MAXCPUS * 2];
+	unsigned char cpus[CG_CPUBYTES];
+	resc_limit_t *lim;
+	long long mem;
+	long long memsw;
+
+	if (!cg_active())
+		return 0;
+	if (cg_find_job(pjob->ji_qs.ji_jobid) != NULL)
+		return 0;
+
+	if (snprintf(base, sizeof(base), "%s/%s", cg_mount, cg_conf.cc_prefix) >= (int) sizeof(base)) {
+		snprintf(log_buffer, LOG_BUF_SIZE, "cgroup_prefix too long for %s", cg_mount);
+		return -1;
+	}
+	if ((mkdir(base, 0755) == -1) && (errno != EEXIST)) {
+		snprintf(log_buffer, LOG_BUF_SIZE, "cannot create cgroup %s: %s", base, strerror(errno));
+		return -1;
+	}
+	if (!cg_scanned)
+		cg_scan(base);
+	cg_enable_controllers(cg_mount);
+	cg_enable_controllers(base);
+
+	lim = &pjob->ji_hosts[pjob->ji_nodeid].hn_nrlimit;
+	memset(cpus, 0, sizeof(cpus));
+	if (cg_conf.cc_cpuset && (lim->rl_ncpus > 0) &&
+	    (cg_pick_cpus(base, lim->rl_ncpus, cpus) == -1)) {
+		snprintf(log_buffer, LOG_BUF_SIZE, "no %d free cpus for job cgroup", lim->rl_ncpus);
+		return -1;
+	}
+
+	if (snprintf(dir, sizeof(dir), "%s/%s", base, pjob->ji_qs.ji_jobid) >= (int) sizeof(dir)) {
+		snprintf(log_buffer, LOG_BUF_SIZE, "job cgroup path too long under %s", base);
+		return -1;
+	}
+	if ((mkdir(dir, 0755) == -1) && (errno != EEXIST)) {
+		snprintf(log_buffer, LOG_BUF_SIZE, "cannot create cgroup %s: %s", dir, strerror(errno));
+		return -1;
+	}
+
+	val[0] = '\0';
+	if (cg_conf.cc_cpuset && (lim->rl_ncpus > 0)) {
+		cg_format_cpus(cpus, val, sizeof(val));
+		if (cg_write(dir, "cpuset.cpus", val) == -1) {
+			snprintf(log_buffer, LOG_BUF_SIZE, "cannot set cpuset.cpus of %s: %s", dir, strerror(errno));
+			(void) rmdir(dir);
+			return -1;
+		}
+	}
+
+	/* limits are in kb, cgroup files take bytes */
+	mem = lim->rl_mem ? lim->rl_mem : cg_conf.cc_mem_default;
+	if (cg_conf.cc_memory && (mem > 0)) {
+		char num[32];
+
+		snprintf(num, sizeof(num), "%lld", mem << 10);
+		if (cg_write(dir, cg_conf.cc_mem_soft ? "memory.high" : "memory.max", num) == -1) {
+			snprintf(log_buffer, LOG_BUF_SIZE, "cannot set memory limit of %s: %s", dir, strerror(errno));
+			(void) rmdir(dir);
+			return -1;
+		}
+		/* memsw is memory plus swap, the kernel limits swap alone */
+		memsw = lim->rl_vmem ? lim->rl_vmem : cg_conf.cc_memsw_default;
+		if (cg_conf.cc_memsw && (memsw > 0)) {
+			snprintf(num, sizeof(num), "%lld", (memsw > mem) ? ((memsw - mem) << 10) : 0);
+			if (cg_write(dir, "memory.swap.max", num) == -1)
+				log_joberr(errno, __func__, "cannot set memory.swap.max", pjob->ji_qs.ji_jobid);
+		}
+	}
+
+	if (cg_add_job(pjob->ji_qs.ji_jobid, cpus) == NULL) {
+		snprintf(log_buffer, LOG_BUF_SIZE, "%s", msg_err_malloc);
+		(void) rmdir(dir);
+		return -1;
+	}
+	log_eventf(PBSEVENT_DEBUG, PBS_EVENTCLASS_JOB, LOG_INFO, pjob->ji_qs.ji_jobid,
+		   "created cgroup %s cpus=%s mem=%lldkb", dir, val, cg_conf.cc_memory ? mem : 0LL);
+	return 0;
+}
+
+/**
+ * @brief
+ *	Move the calling process into the cgroup of its job.  Called in the
+ *	child that becomes a task of the job, before it execs.
+ *
+ * @param[in]	pjob - job pointer
+ *
+ * @return	int
+ * @retval	0	success, or the job has no cgroup
+ * @retval	-1	the process could not be moved
+ */
+int
+cgroup_job_attach(job *pjob)
+{
+	char dir[MAXPATHLEN + 1];
+	char pid[32];
+
+	if (cg_find_job(pjob->ji_qs.ji_jobid) == NULL)
+		return 0;
+	if (cgroup_job_dir(pjob, dir, sizeof(dir)) == -1)
+		return 0;
+	snprintf(pid, sizeof(pid), "%d", (int) getpid());
+	if (cg_write(dir, "cgroup.procs", pid) == -1) {
+		log_joberr(errno, __func__, "cannot join job cgroup", pjob->ji_qs.ji_jobid);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief
+ *	Kill whatever is left in the cgroup of a job and remove it.
+ *	A cgroup that cannot be removed yet is removed by the next scan.
+ *
+ * @param[in]	pjob - job pointer
+ */
+void
+cgroup_job_remove(job *pjob)
+{
+	char dir[MAXPATHLEN + 1];
+	struct cg_job *cj;
+	struct cg_job **prev;
+
+	for (prev = &cg_jobs; (cj = *prev) != NULL; prev = &cj->cj_next) {
+		if (strcmp(cj->cj_jobid, pjob->ji_qs.ji_jobid) == 0) {
+			*prev = cj->cj_next;
+			free(cj);
+			break;
+		}
+	}
+	if ((cj == NULL) || (cgroup_job_dir(pjob, dir, sizeof(dir)) == -1))
+		return;
+
+	/* cgroup.kill is only present on kernels 5.14 and newer */
+	(void) cg_write(dir, "cgroup.kill", "1");
+	if (rmdir(dir) == -1) {
+		if (errno != ENOENT) {
+			log_joberr(errno, __func__, "cannot remove job cgroup yet", pjob->ji_qs.ji_jobid);
+			cg_scanned = 0;
+		}
+		return;
+	}
+	log_event(PBSEVENT_DEBUG, PBS_EVENTCLASS_JOB, LOG_INFO, pjob->ji_qs.ji_jobid,
+		  "removed job cgroup");
+}
@@ -127,7 +127,18 @@ static long hz;
 /* convert between jiffies and seconds */
 #define JTOS(x) (((x) + (hz / 2)) / hz)
 
-static char *choose_procflagsfmt(void);
+/* usage read from a job's cgroup v2 directory */
+typedef struct cgroup_sample {
+	unsigned long long cs_cpu_usec; /* cpu.stat usage_usec */
+	unsigned long long cs_mem;	/* memory.peak or memory.current */
+	unsigned long long cs_swap;	/* memory.swap.peak or memory.swap.current */
+	int cs_populated;		/* cgroup.events populated */
+} cgroup_sample_t;
+
+static int proc_sample(void);
+static int refresh_proc_sample(void);
+static void proc_fd_init(void);
+static void proc_fd_cleanup(void);
 
 proc_stat_t *proc_info = NULL;
 int nproc = 0;
@@ -183,8 +194,45 @@ unsigned long totalmem;
 
 static int myproc_max = 0;    /* entries in Proc_lnks  */
 pbs_plinks *Proc_lnks = NULL; /* process links table head */
+static int *ptree_hash = NULL; /* pid to Proc_lnks index, see bld_ptree */
+static int ptree_hash_size = 0;
+
+/*
+ * Session index of proc_info, rebuilt after every walk of /proc so the
+ * processes of a session are found without scanning the whole table.
+ */
+static int *sess_hash = NULL; /* first proc_info index of each bucket */
+static int *sess_link = NULL; /* next proc_info index in the same bucket */
+static int sess_hash_size = 0;
+static int sess_link_size = 0;
+#define SESS_HASH(sid) ((unsigned int) (sid) & (sess_hash_size - 1))
 static time_t sampletime_ceil;
 static time_t sampletime_floor;
+static int proc_sample_stale = 0; /* proc_info must be reread before use */
+
+/*
+ * Cache of open /proc/<pid>/stat descriptors which are reread with pread()
+ * on every sample instead of being reopened.  The descriptors are moved
+ * above PROC_FD_RESERVE so they never take the low numbered descriptors
+ * needed for sockets, so the cache is only enabled when the open file
+ * limit leaves room for it.
+ */
+#define PROC_FD_RESERVE 1024
+#define PROC_FD_CACHE_MAX 8192
+#define PROC_STAT_BUFSIZE 1024
+
+typedef struct proc_fd_ent {
+	pid_t pf_pid;	     /* process id */
+	int pf_fd;	     /* open /proc/<pid>/stat, -1 if process is gone */
+	unsigned int pf_gen; /* last sample which read this entry */
+} proc_fd_ent_t;
+
+static proc_fd_ent_t *pfc_ent = NULL; /* cache entries */
+static int pfc_used = 0;	      /* entries in use */
+static int pfc_max = 0;		      /* size of pfc_ent, 0 if disabled */
+static int *pfc_hash = NULL;	      /* pid to pfc_ent index */
+static int pfc_hash_size = 0;
+static unsigned int pfc_gen = 0; /* current sample generation */
 
 /*
  ** local resource array
@@ -235,33 +283,6 @@ proc_get_btime(void)
 	return;
 }
 
-static char stat_str_pre[] =
-	"%%d "	    /* 1  pid %d The process id */
-	"(%%[^)]) " /* 2  comm %s The filename of the executable */
-	"%%c "	    /* 3  state %c "RSDZTW" */
-	"%%d "	    /* 4  ppid %d The PID of the parent */
-	"%%d "	    /* 5  pgrp %d The process group ID */
-	"%%d "	    /* 6  session %d The session ID */
-	"%%*d "	    /* 7  ignored:  tty_nr */
-	"%%*d "	    /* 8  ignored:  tpgid */
-	"%s "	    /* 9  flags - %u or %lu */
-	"%%*lu "    /* 10 ignored:  minflt */
-	"%%*lu "    /* 11 ignored:  cminflt */
-	"%%*lu "    /* 12 ignored:  majflt */
-	"%%*lu "    /* 13 ignored:  cmajflt */
-	"%%lu "	    /* 14 utime %lu */
-	"%%lu "	    /* 15 stime %lu */
-	"%%ld "	    /* 16 cutime %ld */
-	"%%ld "	    /* 17 cstime %ld */
-	"%%*ld "    /* 18 ignored:  priority %ld */
-	"%%*ld "    /* 19 ignored:  nice %ld */
-	"%%*ld "    /* 20 ignored:  num_threads %ld */
-	"%%*ld "    /* 21 ignored:  itrealvalue %ld - no longer maintained */
-	"%%llu "    /* 22 starttime (was %lu before Linux 2.6 - see proc(5) for conversion details */
-	"%%lu "	    /* 23 vsize (bytes) */
-	"%%ld "	    /* 24 rss (number of pages) */
-	;
-
 /**
  * @brief
  *	returns the process memory (used,free,total).
@@ -445,27 +466,117 @@ dep_cleanup(void)
 
 /**
  * @brief
- *	 Scan a list of tasks and return true if one of them matches sid
+ *	Build the session index of proc_info after a walk of /proc.
+ *
+ * @return	Void
+ *
+ */
+static void
+build_sess_index(void)
+{
+	int i;
+	int size;
+	void *hold;
+
+	for (size = 64; size < nproc; size <<= 1)
+		;
+	if (size > sess_hash_size) {
+		hold = realloc(sess_hash, size * sizeof(int));
+		assert(hold != NULL);
+		sess_hash = (int *) hold;
+		sess_hash_size = size;
+	}
+	if (max_proc > sess_link_size) {
+		hold = realloc(sess_link, max_proc * sizeof(int));
+		assert(hold != NULL);
+		sess_link = (int *) hold;
+		sess_link_size = max_proc;
+	}
+
+	for (i = 0; i < sess_hash_size; i++)
+		sess_hash[i] = -1;
+
+	/* insert backwards so each chain is in proc_info order */
+	for (i = nproc - 1; i >= 0; i--) {
+		int b = SESS_HASH(proc_info[i].session);
+
+		sess_link[i] = sess_hash[b];
+		sess_hash[b] = i;
+	}
+}
+
+/**
+ * @brief
+ *	Return the first process of a session in proc_info.
  *
- * @param[in] pjob - job pointer
  * @param[in] sid - session id
  *
+ * @return	int
+ * @retval	index into proc_info
+ * @retval	-1	no process in the session
+ *
+ */
+static int
+sess_first(pid_t sid)
+{
+	int i;
+
+	if (sess_hash_size == 0)
+		return -1;
+	for (i = sess_hash[SESS_HASH(sid)]; i != -1; i = sess_link[i]) {
+		if (proc_info[i].session == sid)
+			return i;
+	}
+	return -1;
+}
+
+/**
+ * @brief
+ *	Return the next process in proc_info in the same session as
+ *	proc_info[idx].
+ *
+ * @param[in] idx - index into proc_info returned by sess_first/sess_next
+ *
+ * @return	int
+ * @retval	index into proc_info
+ * @retval	-1	no more processes in the session
+ *
+ */
+static int
+sess_next(int idx)
+{
+	pid_t sid = proc_info[idx].session;
+	int i;
+
+	for (i = sess_link[idx]; i != -1; i = sess_link[i]) {
+		if (proc_info[i].session == sid)
+			return i;
+	}
+	return -1;
+}
+
+/**
+ * @brief
+ *	Check whether a task earlier in the job's task list than ptask has
+ *	the same session, so that the session's processes are counted once.
+ *
+ * @param[in] pjob - job pointer
+ * @param[in] ptask - task pointer
+ *
  * @return	Bool
- * @retval	TRUE
- * @retval	FALSE	Error
+ * @retval	TRUE	session already seen
+ * @retval	FALSE	first task with this session
  *
  */
 static int
-injob(job *pjob, pid_t sid)
+sess_seen(job *pjob, task *ptask)
 {
-	task *ptask;
+	task *pt;
 
-	for (ptask = (task *) GET_NEXT(pjob->ji_tasks);
-	     ptask;
-	     ptask = (task *) GET_NEXT(ptask->ti_jobtask)) {
-		if (ptask->ti_qs.ti_sid <= 1)
-			continue;
-		if (ptask->ti_qs.ti_sid == sid)
+	for (pt = (task *) GET_NEXT(pjob->ji_tasks);
+	     pt != NULL && pt != ptask;
+	     pt = (task *) GET_NEXT(pt->ti_jobtask)) {
+		if (pt->ti_qs.ti_sid == ptask->ti_qs.ti_sid)
 			return TRUE;
 	}
 	return FALSE;
@@ -507,13 +618,9 @@ cput_sum(job *pjob)
 		active_tasks++;
 		tcput = 0;
 		taskprocs = 0;
-		for (i = 0; i < nproc; i++) {
+		for (i = sess_first(ptask->ti_qs.ti_sid); i != -1; i = sess_next(i)) {
 			ps = &proc_info[i];
 
-			/* is this process part of the task? */
-			if (ptask->ti_qs.ti_sid != ps->session)
-				continue;
-
 			/*
 			 * is the owner of this process the job owner?
 			 * prevents random PID matches after reboot/restart
@@ -660,18 +767,21 @@ mem_sum(job *pjob)
 	int i;
 	unsigned long segadd;
 	proc_stat_t *ps;
+	task *ptask;
 
 	segadd = 0;
 
-	for (i = 0; i < nproc; i++) {
-
-		ps = &proc_info[i];
-
-		if (!injob(pjob, ps->session))
+	for (ptask = (task *) GET_NEXT(pjob->ji_tasks);
+	     ptask != NULL;
+	     ptask = (task *) GET_NEXT(ptask->ti_jobtask)) {
+		if (ptask->ti_qs.ti_sid <= 1 || sess_seen(pjob, ptask))
 			continue;
-		segadd += ps->vsize;
-		DBPRT(("%s: pid: %d  pr_size: %lu  total: %lu\n",
-		       __func__, ps->pid, (unsigned long) ps->vsize, segadd))
+		for (i = sess_first(ptask->ti_qs.ti_sid); i != -1; i = sess_next(i)) {
+			ps = &proc_info[i];
+			segadd += ps->vsize;
+			DBPRT(("%s: pid: %d  pr_size: %lu  total: %lu\n",
+			       __func__, ps->pid, (unsigned long) ps->vsize, segadd))
+		}
 	}
 
 	return (segadd);
@@ -694,21 +804,148 @@ resi_sum(job *pjob)
 	int i;
 	unsigned long resisize;
 	proc_stat_t *ps;
+	task *ptask;
 
 	resisize = 0;
-	for (i = 0; i < nproc; i++) {
-
-		ps = &proc_info[i];
-
-		if (!injob(pjob, ps->session))
+	for (ptask = (task *) GET_NEXT(pjob->ji_tasks);
+	     ptask != NULL;
+	     ptask = (task *) GET_NEXT(ptask->ti_jobtask)) {
+		if (ptask->ti_qs.ti_sid <= 1 || sess_seen(pjob, ptask))
 			continue;
-
-		resisize += ps->rss * pagesize;
+		for (i = sess_first(ptask->ti_qs.ti_sid); i != -1; i = sess_next(i)) {
+			ps = &proc_info[i];
+			resisize += ps->rss * pagesize;
+		}
 	}
 
 	return (resisize);
 }
 
+/**
+ * @brief
+ *	Read an unsigned value from a file in a cgroup directory.
+ *
+ * @param[in] dirfd - open descriptor of the cgroup directory
+ * @param[in] file - name of the file relative to dirfd
+ * @param[in] key - if not NULL, the name of the "key value" line to
+ *		    read, otherwise the first token of the file is read
+ * @param[out] val - the value read
+ *
+ * @return	int
+ * @retval	0	Success
+ * @retval	-1	file or key not found
+ *
+ */
+static int
+cgroup_read_value(int dirfd, const char *file, const char *key,
+		  unsigned long long *val)
+{
+	char buf[1024];
+	char *p;
+	char *end;
+	ssize_t len;
+	size_t klen;
+	int fd;
+
+	if ((fd = openat(dirfd, file, O_RDONLY)) == -1)
+		return -1;
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len <= 0)
+		return -1;
+	buf[len] = '\0';
+
+	p = buf;
+	if (key != NULL) {
+		klen = strlen(key);
+		while (strncmp(p, key, klen) != 0 || p[klen] != ' ') {
+			if ((p = strchr(p, '\n')) == NULL)
+				return -1;
+			p++;
+		}
+		p += klen;
+	}
+	if (strncmp(p, "max", 3) == 0)
+		return -1;
+	*val = strtoull(p, &end, 10);
+	if (end == p)
+		return -1;
+	return 0;
+}
+
+/**
+ * @brief
+ *	Collect the usage of a job from its cgroup v2 directory found
+ *	under $cgroup_sample_root, or from the cgroup created for it by
+ *	$cgroup_manager.
+ *
+ * @param[in] pjob - job pointer
+ * @param[out] cs - usage read from the cgroup
+ *
+ * @return	int
+ * @retval	0	Success
+ * @retval	-1	the job has no readable cgroup, use /proc instead
+ *
+ */
+static int
+cgroup_get_sample(job *pjob, cgroup_sample_t *cs)
+{
+	char path[MAXPATHLEN + 1];
+	unsigned long long populated;
+	int dfd;
+
+	if (cgroup_sample_root[0] != '\0')
+		snprintf(path, sizeof(path), "%s/%s", cgroup_sample_root,
+			 pjob->ji_qs.ji_jobid);
+	else if (cgroup_job_dir(pjob, path, sizeof(path)) == -1)
+		return -1;
+	if ((dfd = open(path, O_RDONLY | O_DIRECTORY)) == -1)
+		return -1;
+
+	memset(cs, 0, sizeof(cgroup_sample_t));
+	if (cgroup_read_value(dfd, "cpu.stat", "usage_usec", &cs->cs_cpu_usec) == -1) {
+		close(dfd);
+		return -1;
+	}
+	/* memory.peak is only present on kernels 5.19 and newer */
+	if ((cgroup_read_value(dfd, "memory.peak", NULL, &cs->cs_mem) == -1) &&
+	    (cgroup_read_value(dfd, "memory.current", NULL, &cs->cs_mem) == -1))
+		cs->cs_mem = 0;
+	if ((cgroup_read_value(dfd, "memory.swap.peak", NULL, &cs->cs_swap) == -1) &&
+	    (cgroup_read_value(dfd, "memory.swap.current", NULL, &cs->cs_swap) == -1))
+		cs->cs_swap = 0;
+	if (cgroup_read_value(dfd, "cgroup.events", "populated", &populated) == 0)
+		cs->cs_populated = (populated != 0);
+	else
+		cs->cs_populated = 1;
+	close(dfd);
+
+	return 0;
+}
+
+/**
+ * @brief
+ *	Compute the cpu time of a job from its cgroup usage.
+ *
+ * @param[in] pjob - job pointer
+ * @param[in] cs - usage read from the job's cgroup
+ *
+ * @return	unsigned long
+ * @retval	cpu time consumed by the job in seconds, adjusted by cputfactor
+ *
+ */
+static unsigned long
+cgroup_cput_sum(job *pjob, cgroup_sample_t *cs)
+{
+	unsigned long cputime;
+
+	cputime = (unsigned long) ((cs->cs_cpu_usec + 500000) / 1000000);
+	DBPRT(("%s: %s cgroup cputime %lu\n", __func__,
+	       pjob->ji_qs.ji_jobid, cputime))
+
+	return ((unsigned long) ((double) cputime * cputfactor));
+}
+
 /**
  * @brief
  * 	Establish system-enforced limits for the job.
@@ -835,6 +1072,10 @@ mom_set_limits(job *pjob, int set_mode)
 			if (setrlimit(RLIMIT_CPU, &reslim) < 0)
 				return (error("RLIMIT_CPU", PBSE_SYSTEM));
 		}
+
+		/* join the job cgroup created by $cgroup_manager, if any */
+		if (cgroup_job_attach(pjob) == -1)
+			return (PBSE_SYSTEM);
 	}
 	return (PBSE_NONE);
 }
@@ -903,6 +1144,7 @@ mom_open_poll(void)
 		return (PBSE_SYSTEM);
 	}
 	max_proc = TBL_INC;
+	proc_fd_init();
 
 	return (PBSE_NONE);
 }
@@ -911,6 +1153,12 @@ mom_open_poll(void)
  * @brief
  * 	Declare start of polling loop.
  *
+ * @par
+ *	When $cgroup_sample_root or $cgroup_manager is set, jobs are sampled
+ *	from their cgroup
+ *	in mom_set_use() and the walk of /proc is deferred until some caller
+ *	actually needs the process table, see refresh_proc_sample().
+ *
  * @return	int
  * @retval	PBSE_INTERNAL	Dir pdir in NULL
  * @retval	PBSE_NONE	Success
@@ -918,41 +1166,390 @@ mom_open_poll(void)
  */
 int
 mom_get_sample(void)
+{
+	extern time_t time_last_sample;
+
+	/* There are no job tasks created in mock run mode, so no need to walk the proc table */
+	if (mock_run)
+		return PBSE_NONE;
+
+	DBPRT(("%s: entered\n", __func__))
+	if (pdir == NULL)
+		return PBSE_INTERNAL;
+
+	if (hz == 0)
+		hz = sysconf(_SC_CLK_TCK);
+	time_last_sample = time(0);
+	sampletime_floor = time_last_sample;
+	sampletime_ceil = time_last_sample;
+
+	if ((cgroup_sample_root[0] != '\0') || mom_cgroup_manager) {
+		proc_sample_stale = 1;
+		return (PBSE_NONE);
+	}
+	return (proc_sample());
+}
+
+/**
+ * @brief
+ *	Read the process table if mom_get_sample() deferred it.
+ *
+ * @return	int
+ * @retval	PBSE_INTERNAL	Dir pdir in NULL
+ * @retval	PBSE_NONE	Success
+ *
+ */
+static int
+refresh_proc_sample(void)
+{
+	if (!proc_sample_stale)
+		return (PBSE_NONE);
+	proc_sample_stale = 0;
+	return (proc_sample());
+}
+
+/**
+ * @brief
+ *	Take a fresh sample and make sure the process table is populated.
+ *	Used by the resource monitor requests which read proc_info directly.
+ *
+ * @return	int
+ * @retval	PBSE_INTERNAL	Dir pdir in NULL
+ * @retval	PBSE_NONE	Success
+ *
+ */
+static int
+get_proc_sample(void)
+{
+	int rc;
+
+	if ((rc = mom_get_sample()) != PBSE_NONE)
+		return rc;
+	return (refresh_proc_sample());
+}
+
+/**
+ * @brief
+ *	Size the /proc/<pid>/stat descriptor cache from the open file limit.
+ *
+ * @return	Void
+ *
+ */
+static void
+proc_fd_init(void)
+{
+	struct rlimit rl;
+	rlim_t avail;
+	int i;
+
+	if (pfc_ent != NULL)
+		return;
+
+	if (getrlimit(RLIMIT_NOFILE, &rl) == -1)
+		return;
+	if (rl.rlim_cur == RLIM_INFINITY)
+		avail = PROC_FD_CACHE_MAX;
+	else if (rl.rlim_cur > PROC_FD_RESERVE)
+		avail = (rl.rlim_cur - PROC_FD_RESERVE) / 2;
+	else
+		avail = 0;
+	if (avail > PROC_FD_CACHE_MAX)
+		avail = PROC_FD_CACHE_MAX;
+	if (avail == 0)
+		return;
+
+	for (pfc_hash_size = 64; pfc_hash_size < 2 * (int) avail; pfc_hash_size <<= 1)
+		;
+	pfc_ent = (proc_fd_ent_t *) malloc(avail * sizeof(proc_fd_ent_t));
+	pfc_hash = (int *) malloc(pfc_hash_size * sizeof(int));
+	if ((pfc_ent == NULL) || (pfc_hash == NULL)) {
+		log_err(errno, __func__, "malloc");
+		free(pfc_ent);
+		free(pfc_hash);
+		pfc_ent = NULL;
+		pfc_hash = NULL;
+		pfc_hash_size = 0;
+		return;
+	}
+	for (i = 0; i < pfc_hash_size; i++)
+		pfc_hash[i] = -1;
+	pfc_max = (int) avail;
+	pfc_used = 0;
+}
+
+/**
+ * @brief
+ *	Close every cached /proc descriptor and free the cache.
+ *
+ * @return	Void
+ *
+ */
+static void
+proc_fd_cleanup(void)
+{
+	int i;
+
+	for (i = 0; i < pfc_used; i++) {
+		if (pfc_ent[i].pf_fd != -1)
+			close(pfc_ent[i].pf_fd);
+	}
+	free(pfc_ent);
+	free(pfc_hash);
+	pfc_ent = NULL;
+	pfc_hash = NULL;
+	pfc_used = 0;
+	pfc_max = 0;
+	pfc_hash_size = 0;
+}
+
+/**
+ * @brief
+ *	Find the hash slot of a pid in the /proc descriptor cache.
+ *
+ * @param[in] pid - process id
+ *
+ * @return	int
+ * @retval	slot holding the pid, or the empty slot where it belongs
+ *
+ */
+static int
+proc_fd_slot(pid_t pid)
+{
+	int h = (unsigned int) pid & (pfc_hash_size - 1);
+
+	while ((pfc_hash[h] != -1) && (pfc_ent[pfc_hash[h]].pf_pid != pid))
+		h = (h + 1) & (pfc_hash_size - 1);
+	return h;
+}
+
+/**
+ * @brief
+ *	Drop the cache entries of processes not seen by the last sample
+ *	and rebuild the hash.
+ *
+ * @return	Void
+ *
+ */
+static void
+proc_fd_prune(void)
+{
+	int i, j;
+
+	for (i = 0, j = 0; i < pfc_used; i++) {
+		if ((pfc_ent[i].pf_gen != pfc_gen) || (pfc_ent[i].pf_fd == -1)) {
+			if (pfc_ent[i].pf_fd != -1)
+				close(pfc_ent[i].pf_fd);
+			continue;
+		}
+		pfc_ent[j++] = pfc_ent[i];
+	}
+	if (j == pfc_used)
+		return;
+	pfc_used = j;
+
+	for (i = 0; i < pfc_hash_size; i++)
+		pfc_hash[i] = -1;
+	for (i = 0; i < pfc_used; i++)
+		pfc_hash[proc_fd_slot(pfc_ent[i].pf_pid)] = i;
+}
+
+/**
+ * @brief
+ *	Read /proc/<pid>/stat, through the descriptor cache when possible.
+ *
+ * @param[in] dfd - descriptor of /proc
+ * @param[in] name - name of the process directory in /proc
+ * @param[in] pid - process id
+ * @param[out] buf - buffer for the contents, null terminated
+ * @param[in] len - size of buf
+ * @param[out] cached - set to 1 if the contents came from a cached descriptor
+ *
+ * @return	ssize_t
+ * @retval	number of bytes read	Success
+ * @retval	-1			Error
+ *
+ */
+static ssize_t
+proc_read_stat(int dfd, char *name, pid_t pid, char *buf, size_t len, int *cached)
+{
+	char path[MAXPATHLEN + 1];
+	ssize_t n;
+	int slot = -1;
+	int idx = -1;
+	int fd;
+	int nfd;
+
+	*cached = 0;
+	if (pfc_max > 0) {
+		slot = proc_fd_slot(pid);
+		idx = pfc_hash[slot];
+	}
+	if ((idx != -1) && (pfc_ent[idx].pf_fd != -1)) {
+		n = pread(pfc_ent[idx].pf_fd, buf, len - 1, 0);
+		if (n > 0) {
+			buf[n] = '\0';
+			pfc_ent[idx].pf_gen = pfc_gen;
+			*cached = 1;
+			return n;
+		}
+		/* the process went away, the pid may have been reused */
+		close(pfc_ent[idx].pf_fd);
+		pfc_ent[idx].pf_fd = -1;
+	}
+
+	snprintf(path, sizeof(path), "%s/stat", name);
+	if ((fd = openat(dfd, path, O_RDONLY | O_CLOEXEC)) == -1)
+		return -1;
+	n = read(fd, buf, len - 1);
+	if (n <= 0) {
+		close(fd);
+		return -1;
+	}
+	buf[n] = '\0';
+
+	if ((slot == -1) || ((idx == -1) && (pfc_used == pfc_max))) {
+		close(fd);
+		return n;
+	}
+	nfd = fcntl(fd, F_DUPFD_CLOEXEC, PROC_FD_RESERVE);
+	close(fd);
+	if (nfd == -1)
+		return n;
+	if (idx == -1) {
+		idx = pfc_used++;
+		pfc_ent[idx].pf_pid = pid;
+		pfc_hash[slot] = idx;
+	}
+	pfc_ent[idx].pf_fd = nfd;
+	pfc_ent[idx].pf_gen = pfc_gen;
+	return n;
+}
+
+/**
+ * @brief
+ *	Get the next numeric field of a /proc/<pid>/stat line.
+ *
+ * @param[in,out] pp - current position, advanced past the field
+ * @param[out] val - value of the field
+ *
+ * @return	int
+ * @retval	0	Success
+ * @retval	-1	no more fields
+ *
+ */
+static int
+proc_stat_field(char **pp, unsigned long long *val)
+{
+	char *end;
+
+	if (**pp != ' ')
+		return -1;
+	(*pp)++;
+	*val = strtoull(*pp, &end, 10);
+	if (end == *pp)
+		return -1;
+	*pp = end;
+	return 0;
+}
+
+/**
+ * @brief
+ *	Parse the fields MoM uses out of a /proc/<pid>/stat line, see proc(5).
+ *
+ * @param[in] buf - contents of /proc/<pid>/stat
+ * @param[out] ps - process entry to fill in
+ * @param[out] starttime - start time of the process in jiffies after boot
+ *
+ * @return	int
+ * @retval	0	Success
+ * @retval	-1	malformed line
+ *
+ */
+static int
+parse_proc_stat(char *buf, proc_stat_t *ps, unsigned long long *starttime)
+{
+	unsigned long long val[25];
+	char *comm;
+	char *p;
+	int i;
+
+	/* 1 pid */
+	ps->pid = (pid_t) strtol(buf, &p, 10);
+	if ((p == buf) || (strncmp(p, " (", 2) != 0))
+		return -1;
+
+	/* 2 comm, which may itself contain spaces and parentheses */
+	comm = p + 2;
+	if ((p = strrchr(comm, ')')) == NULL)
+		return -1;
+	snprintf(ps->comm, sizeof(ps->comm), "%.*s",
+		 (int) MIN(p - comm, (long) sizeof(ps->comm) - 1), comm);
+	p++;
+
+	/* 3 state */
+	if ((p[0] != ' ') || (p[1] == '\0'))
+		return -1;
+	ps->state = p[1];
+	p += 2;
+
+	/* 4 ppid through 24 rss */
+	for (i = 4; i <= 24; i++) {
+		if (proc_stat_field(&p, &val[i]) == -1)
+			return -1;
+	}
+	ps->ppid = (pid_t) val[4];
+	ps->pgrp = (pid_t) val[5];
+	ps->session = (pid_t) val[6];
+	ps->flags = (unsigned long) val[9];
+	ps->utime = (unsigned long) val[14];
+	ps->stime = (unsigned long) val[15];
+	ps->cutime = (unsigned long) val[16];
+	ps->cstime = (unsigned long) val[17];
+	*starttime = val[22];
+	ps->vsize = (unsigned long) val[23];
+	ps->rss = (unsigned long) val[24];
+	return 0;
+}
+
+/**
+ * @brief
+ *	Walk /proc and load proc_info with every non-root process.
+ *
+ * @par
+ *	Processes are looked up relative to the /proc directory descriptor
+ *	and the stat file of a process already seen is reread through its
+ *	cached descriptor.
+ *
+ * @return	int
+ * @retval	PBSE_INTERNAL	Dir pdir in NULL
+ * @retval	PBSE_NONE	Success
+ *
+ */
+static int
+proc_sample(void)
 {
 	struct dirent *dent = NULL;
-	FILE *fd = NULL;
-	static char path[MAXPATHLEN + 1];
-	char procname[MAXPATHLEN + 1]; /* space for dent->d_name plus extra */
-	char procid[MAXPATHLEN + 1];
+	char statbuf[PROC_STAT_BUFSIZE];
 	struct stat sb;
 	proc_stat_t *ps = NULL;
+	int dfd;
 	int nprocs = 0;
 	int ncached = 0;
 	int ncantstat = 0;
 	int nnomem = 0;
 	unsigned long long starttime;
 	int nskipped = 0;
-	extern time_t time_last_sample;
-	char *stat_str = NULL;
-
-	/* There are no job tasks created in mock run mode, so no need to walk the proc table */
-	if (mock_run)
-		return PBSE_NONE;
 
-	DBPRT(("%s: entered\n", __func__))
 	if (pdir == NULL)
 		return PBSE_INTERNAL;
 
+	dfd = dirfd(pdir);
 	rewinddir(pdir);
 	nproc = 0;
-	fd = NULL;
-	if (hz == 0)
-		hz = sysconf(_SC_CLK_TCK);
-	time_last_sample = time(0);
-	sampletime_floor = time_last_sample;
+	pfc_gen++;
 	while (errno = 0, (dent = readdir(pdir)) != NULL) {
 		int nomem = 0;
-		struct stat sbuf;
+		int cached;
 
 		nprocs++;
 
@@ -966,62 +1563,25 @@ mom_get_sample(void)
 			} else
 				continue;
 		}
-		snprintf(procid, sizeof(procid), "/proc/%s", dent->d_name);
-		if ((stat(procid, &sbuf) == -1) || (sbuf.st_uid == 0)) {
+		if ((fstatat(dfd, dent->d_name, &sb, 0) == -1) || (sb.st_uid == 0)) {
 			/* ignore root-owned processes */
 			nskipped++;
 			continue;
 		}
-		snprintf(procname, sizeof(procname), "/proc/%s/stat", dent->d_name);
 
-		if ((fd = fopen(procname, "r")) == NULL) {
+		if (proc_read_stat(dfd, dent->d_name, (pid_t) atoi(dent->d_name + nomem),
+				   statbuf, sizeof(statbuf), &cached) == -1) {
 			ncantstat++;
 			continue;
 		}
+		ncached += cached;
 
 		ps = &proc_info[nproc];
-		stat_str = choose_procflagsfmt();
-		if (stat_str == NULL) {
-			log_err(errno, __func__, "choose_procflagsfmt allocation failed");
-			return PBSE_INTERNAL;
-		}
-		if (fscanf(fd, stat_str,
-			   &ps->pid,	 /* "%d "	1  pid %d The process id */
-			   path,	 /* "(%[^)]) "	2  comm %s The filename of the executable */
-			   &ps->state,	 /* "%c "	3  state %c "RSDZTW" */
-			   &ps->ppid,	 /* "%d "	4  ppid %d The PID of the parent */
-			   &ps->pgrp,	 /* "%d "	5  pgrp %d The process group ID */
-			   &ps->session, /* "%d "	6  session %d The session ID */
-			   /* "%*d "	7  ignored:  tty_nr */
-			   /* "%*d "	8  ignored:  tpgid */
-			   &ps->flags, /* "%u or %lu"	9  flags */
-			   /* "%*lu "	10 ignored:  minflt */
-			   /* "%*lu "	11 ignored:  cminflt */
-			   /* "%*lu "	12 ignored:  majflt */
-			   /* "%*lu "	13 ignored:  cmajflt */
-			   &ps->utime,	/* "%lu "	14 utime %lu */
-			   &ps->stime,	/* "%lu "	15 stime %lu */
-			   &ps->cutime, /* "%ld "	16 cutime %ld */
-			   &ps->cstime, /* "%ld "	17 cstime %ld */
-			   /* "%*ld "	18 ignored:  priority %ld */
-			   /* "%*ld "	19 ignored:  nice %ld */
-			   /* "%*ld "	20 ignored:  num_threads %ld */
-			   /* "%*ld "	21 ignored:  itrealvalue %ld - no longer maintained */
-			   &starttime, /* "%llu "	22 starttime (was %lu before Linux 2.6 - see proc(5) for conversion details */
-			   &ps->vsize, /* "%lu "	23 vsize (bytes) */
-			   &ps->rss    /* "%ld "	24 rss (number of pages) */
-			   ) != 14) {
+		if (parse_proc_stat(statbuf, ps, &starttime) == -1) {
 			ncantstat++;
-			fclose(fd);
-			continue;
-		}
-
-		if (fstat(fileno(fd), &sb) == -1) {
-			fclose(fd);
 			continue;
 		}
 		ps->uid = sb.st_uid;
-		fclose(fd);
 
 		/*
 		 ** A .pid thread shows the memory of the process
@@ -1033,8 +1593,6 @@ mom_get_sample(void)
 		}
 
 		ps->start_time = linux_time + (starttime / hz);
-		snprintf(ps->comm, sizeof(ps->comm), "%.*s",
-			 (int) (sizeof(ps->comm) - 1), path);
 
 		ps->utime = JTOS(ps->utime);
 		ps->stime = JTOS(ps->stime);
@@ -1052,7 +1610,8 @@ mom_get_sample(void)
 	}
 	if (errno != 0 && errno != ENOENT)
 		log_err(errno, __func__, "readdir");
-	sampletime_ceil = time_last_sample;
+	proc_fd_prune();
+	build_sess_index();
 	sprintf(log_buffer,
 		"nprocs:  %d, cantstat:  %d, nomem:  %d, skipped:  %d, "
 		"cached:  %d",
@@ -1090,6 +1649,8 @@ mom_set_use(job *pjob)
 	u_Long *lp_sz, lnum_sz;
 	unsigned long *lp, lnum, oldcput;
 	long ncpus_req;
+	cgroup_sample_t cs;
+	int use_cgroup = 0;
 
 	assert(pjob != NULL);
 	at = get_jattr(pjob, JOB_ATR_resc_used);
@@ -1100,6 +1661,15 @@ mom_set_use(job *pjob)
 
 	DBPRT(("%s: entered %s\n", __func__, pjob->ji_qs.ji_jobid))
 
+	/*
+	 * An empty cgroup means the job's processes are gone, fall back
+	 * to /proc so cput_sum() can notice the exited tasks.
+	 */
+	if ((cgroup_get_sample(pjob, &cs) == 0) && cs.cs_populated)
+		use_cgroup = 1;
+	else
+		(void) refresh_proc_sample();
+
 	at->at_flags |= (ATR_VFLAG_MODIFY | ATR_VFLAG_SET);
 
 	rd = &svr_resc_def[RESC_NCPUS];
@@ -1134,7 +1704,10 @@ mom_set_use(job *pjob)
 	}
 	lp = (unsigned long *) &pres->rs_value.at_val.at_long;
 	oldcput = *lp;
-	lnum = cput_sum(pjob);
+	if (use_cgroup)
+		lnum = cgroup_cput_sum(pjob, &cs);
+	else
+		lnum = cput_sum(pjob);
 	lnum = MAX(*lp, lnum);
 	if ((pres->rs_value.at_flags & ATR_VFLAG_HOOK) == 0) {
 		/* don't conflict with hook setting a value */
@@ -1166,7 +1739,10 @@ mom_set_use(job *pjob)
 		pres->rs_value.at_val.at_size.atsv_units = ATR_SV_BYTESZ;
 	} else if ((pres->rs_value.at_flags & ATR_VFLAG_HOOK) == 0) {
 		lp_sz = &pres->rs_value.at_val.at_size.atsv_num;
-		lnum_sz = (mem_sum(pjob) + 1023) >> 10; /* as KB */
+		if (use_cgroup)
+			lnum_sz = (cs.cs_mem + cs.cs_swap + 1023) >> 10; /* as KB */
+		else
+			lnum_sz = (mem_sum(pjob) + 1023) >> 10; /* as KB */
 		*lp_sz = MAX(*lp_sz, lnum_sz);
 	}
 
@@ -1183,7 +1759,10 @@ mom_set_use(job *pjob)
 		pres->rs_value.at_val.at_size.atsv_units = ATR_SV_BYTESZ;
 	} else if ((pres->rs_value.at_flags & ATR_VFLAG_HOOK) == 0) {
 		lp_sz = &pres->rs_value.at_val.at_size.atsv_num;
-		lnum_sz = (resi_sum(pjob) + 1023) >> 10; /* as KB */
+		if (use_cgroup)
+			lnum_sz = (cs.cs_mem + 1023) >> 10; /* as KB */
+		else
+			lnum_sz = (resi_sum(pjob) + 1023) >> 10; /* as KB */
 		*lp_sz = MAX(*lp_sz, lnum_sz);
 	}
 
@@ -1211,6 +1790,10 @@ bld_ptree(pid_t sid)
 {
 	int myproc_ct; /* count of processes in a session */
 	int i, j;
+	int size;
+	unsigned int h;
+
+	(void) refresh_proc_sample();
 
 	if (Proc_lnks == NULL) {
 		Proc_lnks = (pbs_plinks *) malloc(TBL_INC * sizeof(pbs_plinks));
@@ -1224,43 +1807,68 @@ bld_ptree(pid_t sid)
 	 */
 
 	myproc_ct = 0;
-	for (i = 0; i < nproc; i++) {
+	for (i = sess_first(sid); i != -1; i = sess_next(i)) {
 		if (PBS_PROC_PID(i) <= 1)
 			continue;
-		if ((int) PBS_PROC_SID(i) == sid) {
-			Proc_lnks[myproc_ct].pl_pid = PBS_PROC_PID(i);
-			Proc_lnks[myproc_ct].pl_ppid = PBS_PROC_PPID(i);
-			Proc_lnks[myproc_ct].pl_parent = -1;
-			Proc_lnks[myproc_ct].pl_sib = -1;
-			Proc_lnks[myproc_ct].pl_child = -1;
-			Proc_lnks[myproc_ct].pl_done = 0;
-			if (++myproc_ct == myproc_max) {
-				void *hold;
-
-				myproc_max += TBL_INC;
-				hold = realloc((void *) Proc_lnks,
-					       myproc_max * sizeof(pbs_plinks));
-				assert(hold != NULL);
-				Proc_lnks = (pbs_plinks *) hold;
-			}
+		Proc_lnks[myproc_ct].pl_pid = PBS_PROC_PID(i);
+		Proc_lnks[myproc_ct].pl_ppid = PBS_PROC_PPID(i);
+		Proc_lnks[myproc_ct].pl_parent = -1;
+		Proc_lnks[myproc_ct].pl_sib = -1;
+		Proc_lnks[myproc_ct].pl_child = -1;
+		Proc_lnks[myproc_ct].pl_done = 0;
+		if (++myproc_ct == myproc_max) {
+			void *hold;
+
+			myproc_max += TBL_INC;
+			hold = realloc((void *) Proc_lnks,
+				       myproc_max * sizeof(pbs_plinks));
+			assert(hold != NULL);
+			Proc_lnks = (pbs_plinks *) hold;
 		}
 	}
 
-	/* Now build the tree for those processes */
+	if (myproc_ct == 0)
+		return 0;
 
+	/*
+	 * Now build the tree for those processes.  Index them by pid
+	 * (open addressing, at most half full) so that each process finds
+	 * its parent with a single lookup.
+	 */
+	for (size = 64; size < 2 * myproc_ct; size <<= 1)
+		;
+	if (size > ptree_hash_size) {
+		void *hold;
+
+		hold = realloc((void *) ptree_hash, size * sizeof(int));
+		assert(hold != NULL);
+		ptree_hash = (int *) hold;
+		ptree_hash_size = size;
+	}
+	for (h = 0; h < (unsigned int) ptree_hash_size; h++)
+		ptree_hash[h] = -1;
 	for (i = 0; i < myproc_ct; i++) {
+		h = (unsigned int) Proc_lnks[i].pl_pid & (ptree_hash_size - 1);
+		while (ptree_hash[h] != -1 &&
+		       Proc_lnks[ptree_hash[h]].pl_pid != Proc_lnks[i].pl_pid)
+			h = (h + 1) & (ptree_hash_size - 1);
+		if (ptree_hash[h] == -1)
+			ptree_hash[h] = i;
+	}
+
+	for (j = 0; j < myproc_ct; j++) {
 		/*
-		 * Find all the children for this process, establish links.
+		 * Find the parent of this process, establish links.
 		 */
-		for (j = 0; j < myproc_ct; j++) {
-			if (j == i)
-				continue;
-			if (Proc_lnks[j].pl_ppid == Proc_lnks[i].pl_pid) {
-				Proc_lnks[j].pl_parent = i;
-				Proc_lnks[j].pl_sib = Proc_lnks[i].pl_child;
-				Proc_lnks[i].pl_child = j;
-			}
-		}
+		h = (unsigned int) Proc_lnks[j].pl_ppid & (ptree_hash_size - 1);
+		while ((i = ptree_hash[h]) != -1 &&
+		       Proc_lnks[i].pl_pid != Proc_lnks[j].pl_ppid)
+			h = (h + 1) & (ptree_hash_size - 1);
+		if (i == -1 || i == j)
+			continue;
+		Proc_lnks[j].pl_parent = i;
+		Proc_lnks[j].pl_sib = Proc_lnks[i].pl_child;
+		Proc_lnks[i].pl_child = j;
 	}
 	return (myproc_ct); /* number of processes in session */
 }
@@ -1398,6 +2006,18 @@ mom_close_poll(void)
 		(void) free(proc_info);
 		proc_info = NULL;
 		max_proc = 0;
+		nproc = 0;
+	}
+	proc_fd_cleanup();
+	if (sess_hash) {
+		free(sess_hash);
+		sess_hash = NULL;
+		sess_hash_size = 0;
+	}
+	if (sess_link) {
+		free(sess_link);
+		sess_link = NULL;
+		sess_link_size = 0;
 	}
 
 	return (PBSE_NONE);
@@ -1451,7 +2071,7 @@ getprocs(void)
 	if (lastproc == reqnum) /* don't need new proc table */
 		return 1;
 
-	if (mom_get_sample() != PBSE_NONE)
+	if (get_proc_sample() != PBSE_NONE)
 		return 0;
 
 	lastproc = reqnum;
@@ -1479,13 +2099,11 @@ cput_job(pid_t jobid)
 	double cputime, addtime;
 	proc_stat_t *ps;
 
+	(void) refresh_proc_sample();
 	cputime = 0.0;
-	for (i = 0; i < nproc; i++) {
+	for (i = sess_first(jobid); i != -1; i = sess_next(i)) {
 
 		ps = &proc_info[i];
-		if (jobid != ps->session)
-			continue;
-
 		found = 1;
 		addtime = dsecs(ps->cutime) + dsecs(ps->cstime);
 
@@ -1520,7 +2138,7 @@ cput_proc(pid_t pid)
 	double cputime;
 	proc_stat_t *ps = NULL;
 
-	mom_get_sample();
+	get_proc_sample();
 	for (i = 0; i < nproc; i++) {
 		ps = &proc_info[i];
 		if (ps->pid == pid)
@@ -1599,13 +2217,10 @@ mem_job(pid_t sid)
 
 	memsize = 0;
 
-	mom_get_sample();
-	for (i = 0; i < nproc; i++) {
+	get_proc_sample();
+	for (i = sess_first(sid); i != -1; i = sess_next(i)) {
 
 		ps = &proc_info[i];
-
-		if (sid != ps->session)
-			continue;
 		memsize += ps->vsize;
 	}
 
@@ -1635,7 +2250,7 @@ mem_proc(pid_t pid)
 	int i;
 	proc_stat_t *ps = NULL;
 
-	mom_get_sample();
+	get_proc_sample();
 	for (i = 0; i < nproc; i++) {
 		ps = &proc_info[i];
 		if (ps->pid == pid)
@@ -1713,15 +2328,11 @@ resi_job(pid_t jobid)
 	proc_stat_t *ps;
 
 	resisize = 0;
-	mom_get_sample();
+	get_proc_sample();
 
-	for (i = 0; i < nproc; i++) {
+	for (i = sess_first(jobid); i != -1; i = sess_next(i)) {
 
 		ps = &proc_info[i];
-
-		if (jobid != ps->session)
-			continue;
-
 		found = 1;
 		resisize += ps->rss;
 	}
@@ -1752,7 +2363,7 @@ resi_proc(pid_t pid)
 	int i;
 	proc_stat_t *ps = NULL;
 
-	mom_get_sample();
+	get_proc_sample();
 	for (i = 0; i < nproc; i++) {
 		ps = &proc_info[i];
 		if (ps->pid == pid)
@@ -1843,7 +2454,7 @@ sessions(struct rm_attribute *attrib)
 		return NULL;
 	}
 
-	mom_get_sample();
+	get_proc_sample();
 
 	/*
 	 ** Search for members of session
@@ -1958,7 +2569,7 @@ pids(struct rm_attribute *attrib)
 		return NULL;
 	}
 
-	mom_get_sample();
+	get_proc_sample();
 
 	/*
 	 ** Search for members of session
@@ -1966,13 +2577,11 @@ pids(struct rm_attribute *attrib)
 	fmt = ret_string;
 	num_pids = 0;
 
-	for (i = 0; i < nproc; i++) {
+	for (i = sess_first(jobid); i != -1; i = sess_next(i)) {
 
 		ps = &proc_info[i];
 		DBPRT(("%s[%d]: pid: %d sid %d\n",
 		       __func__, num_pids, ps->pid, ps->session))
-		if (jobid != ps->session)
-			continue;
 
 		sprintf(fmt, "%d ", ps->pid);
 		fmt += strlen(fmt);
@@ -2018,7 +2627,7 @@ nusers(struct rm_attribute *attrib)
 		return NULL;
 	}
 
-	mom_get_sample();
+	get_proc_sample();
 	for (i = 0; i < nproc; i++) {
 		ps = &proc_info[i];
 
@@ -2147,137 +2756,6 @@ availmem(struct rm_attribute *attrib)
 	return ret_string;
 }
 
-/**
- * @brief	find and remember the current Linux release number
- * @param[in]	struct utsname *
- *
- * @return	value returned by uname(2)'s utsname release[] member
- */
-static char *
-uname2release(struct utsname *u)
-{
-	static char *u_release = NULL;
-
-	if (u_release != NULL)
-		return (u_release);
-	else if ((u_release = malloc(strlen(u->release) + 1)) != NULL) {
-		memcpy(u_release, u->release, strlen(u->release) + 1);
-		sprintf(log_buffer, "uname release:  %s", u_release);
-		log_event(PBSEVENT_DEBUG4, 0, LOG_DEBUG, __func__, log_buffer);
-		return (u_release);
-	} else
-		return NULL;
-}
-
-/**
- * @brief	choose the format for the /proc "flags" field
- * @param[in]	release
- * @param[out]	stdio format string
- *
- * @return	"%lu" for /proc before Linux version 2.6.22
- * @return	"%u" for  /proc Linux version 2.6.22 and later
- * *
- * @note	To derive release information, we're at the mercy of whoever
- *		configures the kernel's UTS_RELEASE value when it's built.
- *		We hope that the version information is in the format
- *		<major>.<minor>.<micro>, or - if not - that at least we can
- *		depend on sscanf() to throw away extraneous characters and
- *		derive a number for the "micro" version that can be used to
- *		leverage proc(5)'s "%u (%lu before Linux 2.6.22)" flags
- *		field format specification.
- *
- *		This code is not designed to work for Linux versions < 2.
- *
- * @par MT-Safe:	yes
- */
-static char *
-procflagsfmt(char *release)
-{
-	char *p;
-	char *ver_begin = release;
-	char rfseparator_dot = '.';
-	char rfseparator_dash = '-';
-	int nseparators_seen = 0;
-	int major, minor, micro, ver;
-	static char before[] = "%lu";
-	static char after[] = "%u";
-
-	for (p = release; *p != '\0'; p++) {
-		if ((*p == rfseparator_dot) || (*p == rfseparator_dash)) {
-			p++;
-			if (sscanf(ver_begin, "%d", &ver) == 1) {
-				if (nseparators_seen == 0) {
-					major = ver;
-					if (major > 2)
-						return (after);
-				} else if (nseparators_seen == 1) {
-					minor = ver;
-					if (minor > 6)
-						return (after);
-				} else {
-					micro = ver;
-					/* "flags %u (%lu before Linux 2.6.22)" */
-					if ((minor == 6) && (micro >= 22))
-						return (after);
-					else
-						return (before);
-				}
-			}
-			ver_begin = p;
-			nseparators_seen++;
-		}
-	}
-
-	return NULL;
-}
-
-/**
- * @brief	return the stdio format directive for the /proc flags field
- *
- * @param[out]	format string for the /proc flags field
- *
- * @return	static char *
- *
- * @see	procflagsfmt
- * @see	uname2release
- */
-static char *
-choose_procflagsfmt(void)
-{
-	char buf[1024];
-	static char *fmtstr = NULL;
-	static int initialized = 0;
-	struct utsname u;
-
-	if (initialized)
-		return (fmtstr);
-
-	if (uname(&u) == -1) {
-		log_err(errno, __func__, "uname");
-		return NULL;
-	} else {
-		char *release;
-		char *fffs; /* the flags field format string */
-
-		if ((release = uname2release(&u)) == NULL) {
-			log_err(-1, __func__, "uname2release returned NULL");
-			return NULL;
-		} else if ((fffs = procflagsfmt(release)) == NULL) {
-			log_err(-1, __func__, "procflagsfmt returned NULL");
-			return NULL;
-		} else {
-			sprintf(buf, stat_str_pre, fffs);
-			if ((fmtstr = strdup(buf)) == NULL) {
-				log_err(-1, __func__, "strdup returned NULL");
-				return NULL;
-			} else {
-				initialized = 1;
-				return (fmtstr);
-			}
-		}
-	}
-}
-
 #else /* PBSMOM_HTUNIT */
 
 /*
@@ -2836,7 +3314,7 @@ walltime(struct rm_attribute *attrib)
 		rm_errno = RM_ERR_SYSTEM;
 		return NULL;
 	}
-	mom_get_sample();
+	get_proc_sample();
 
 	start = now;
 	for (i = 0; i < nproc; i++) {
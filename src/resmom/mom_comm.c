@@ -222,6 +222,8 @@ eventent *event_dup(eventent *ep, job *pjob, hnodent *pnode);
 /**
  * @brief
  *	Save the critical information associated with a task to disk.
+ *	The task is appended to the job state journal when that is in
+ *	use, otherwise its task file is written.
  *
  * @param[in]   ptask - structure handle holding task info to be saved
  *
@@ -232,6 +234,27 @@ eventent *event_dup(eventent *ep, job *pjob, hnodent *pnode);
  */
 int
 task_save(pbs_task *ptask)
+{
+	if (job_journal_task(ptask) == 0)
+		return (0);
+	/* the file is stamped so older journal records are not replayed over it */
+	return (task_write(ptask));
+}
+
+/**
+ * @brief
+ *	Write the critical information associated with a task to its
+ *	task file.
+ *
+ * @param[in]   ptask - structure handle holding task info to be saved
+ *
+ * @return   Error code
+ * @retval   0 Success
+ * @retval  -1 Failure
+ *
+ */
+int
+task_write(pbs_task *ptask)
 {
 	job *pjob = ptask->ti_job;
 	int fds;
@@ -279,6 +302,7 @@ task_save(pbs_task *ptask)
 			return (-1);
 		}
 	}
+	job_journal_stamp(fds);
 	(void) close(fds);
 	return (0);
 }
@@ -1724,6 +1748,793 @@ send_sisters(job *pjob, int com, pbs_jobndstm_t command_func)
 	return (send_sisters_inner(pjob, com, command_func, NULL));
 }
 
+/*
+ * Join acks (IM_JOIN_TREE) that reached me before the JOIN_JOB
+ * from Mother Superior did.  They are merged when the job shows
+ * up and dropped once they grow stale.
+ */
+typedef struct tree_early {
+	struct tree_early *te_next;
+	char te_jobid[PBS_MAXSVRJOBID + 1];
+	char *te_cookie;
+	time_t te_time;
+	int te_nnodes;
+	tm_node_id *te_nodes;
+} tree_early_t;
+
+static tree_early_t *tree_early_acks = NULL;
+
+#define TREE_EARLY_MAXAGE 600
+#define TREE_MAX_NODES 1000000 /* sanity limit on a JOIN_TREE node list */
+
+/**
+ * @brief
+ *	Find the children of a node in the fanout tree of a job.
+ *
+ * @param[in]	pjob - job pointer
+ * @param[in]	fanout - children per node
+ * @param[in]	idx - host index of the node, 0 being Mother Superior
+ * @param[out]	first - if not NULL, set to the index of the first child
+ *
+ * @return int
+ * @retval number of children, 0 for a leaf
+ */
+static int
+tree_children(job *pjob, int fanout, int idx, int *first)
+{
+	long lo, hi;
+
+	if (fanout < 2)
+		return 0;
+	lo = (long) idx * fanout + 1;
+	hi = lo + fanout;
+	if (lo >= pjob->ji_numnodes)
+		return 0;
+	if (hi > pjob->ji_numnodes)
+		hi = pjob->ji_numnodes;
+	if (first != NULL)
+		*first = (int) lo;
+	return ((int) (hi - lo));
+}
+
+/**
+ * @brief
+ *	Wrapper of tree_children() for a job which has its fanout tree set up.
+ *
+ * @param[in]	pjob - job pointer
+ * @param[in]	idx - host index of the node
+ * @param[out]	first - if not NULL, set to the index of the first child
+ *
+ * @return int
+ * @retval number of children of node idx
+ */
+int
+sister_tree_children(job *pjob, int idx, int *first)
+{
+	if (pjob->ji_tree == NULL)
+		return 0;
+	return (tree_children(pjob, pjob->ji_tree->st_fanout, idx, first));
+}
+
+/**
+ * @brief
+ *	Allocate the fanout tree state of a job.
+ *
+ * @param[in]	pjob - job pointer
+ * @param[in]	fanout - children per node
+ *
+ * @return sister_tree_t *
+ * @retval NULL - malloc failure
+ */
+static sister_tree_t *
+sister_tree_alloc(job *pjob, int fanout)
+{
+	sister_tree_t *tp;
+
+	sister_tree_free(pjob);
+	if ((tp = (sister_tree_t *) calloc(1, sizeof(sister_tree_t))) == NULL) {
+		log_err(errno, __func__, MALLOC_ERR_MSG);
+		return NULL;
+	}
+	tp->st_fanout = fanout;
+	tp->st_pollstream = -1;
+	pjob->ji_tree = tp;
+	return tp;
+}
+
+/**
+ * @brief
+ *	Free the fanout tree state of a job, if any.
+ *
+ * @param[in]	pjob - job pointer
+ *
+ * @return void
+ */
+void
+sister_tree_free(job *pjob)
+{
+	int i;
+
+	if (pjob->ji_tree == NULL)
+		return;
+	free(pjob->ji_tree->st_nodes);
+	if (pjob->ji_tree->st_used != NULL) {
+		for (i = 0; i < pjob->ji_numnodes; i++)
+			free_attrlist(&pjob->ji_tree->st_used[i]);
+		free(pjob->ji_tree->st_used);
+	}
+	free(pjob->ji_tree);
+	pjob->ji_tree = NULL;
+}
+
+/**
+ * @brief
+ *	Called by Mother Superior before sending JOIN_JOB to decide if
+ *	the sisters should gather their acknowledgements and resource
+ *	usage up a tree of $sister_tree_fanout children per node.
+ *
+ * @par
+ *	The tree is not used for jobs that tolerate node failures, since
+ *	those track each sister individually, nor when a job_join_ack
+ *	function adds per node data to the JOIN reply.
+ *
+ * @param[in]	pjob - job pointer
+ *
+ * @return tm_task_id
+ * @retval the fanout, to be sent as the taskid of the JOIN_JOB request
+ * @retval TM_NULL_TASK - every sister replies directly
+ */
+tm_task_id
+sister_tree_setup(job *pjob)
+{
+	sister_tree_free(pjob);
+	if ((sister_tree_fanout < 2) ||
+	    (pjob->ji_numnodes - 1 <= sister_tree_fanout) ||
+	    do_tolerate_node_failures(pjob) ||
+	    (job_join_ack != NULL) || (job_join_read != NULL))
+		return TM_NULL_TASK;
+
+	if (sister_tree_alloc(pjob, sister_tree_fanout) == NULL)
+		return TM_NULL_TASK;
+
+	log_eventf(PBSEVENT_JOB, PBS_EVENTCLASS_JOB, LOG_DEBUG, pjob->ji_qs.ji_jobid,
+		   "sisters join through a tree of fanout %d", sister_tree_fanout);
+	return ((tm_task_id) sister_tree_fanout);
+}
+
+/**
+ * @brief
+ *	Send the list of joined nodes of my subtree to my parent in the
+ *	fanout tree.  If my parent cannot be reached, or no tree is in use,
+ *	the list goes to Mother Superior directly.
+ *
+ * @param[in]	pjob - job pointer
+ * @param[in]	nodes - host indices of the joined nodes
+ * @param[in]	nnodes - number of entries in nodes
+ *
+ * @return int
+ * @retval 0 - sent
+ * @retval -1 - failure, logged
+ */
+static int
+tree_join_send(job *pjob, tm_node_id *nodes, int nnodes)
+{
+	hnodent *np;
+	int fanout;
+	int parent;
+	int i;
+	int ret;
+
+	fanout = (pjob->ji_tree != NULL) ? pjob->ji_tree->st_fanout : 0;
+	parent = (fanout >= 2) ? (pjob->ji_nodeid - 1) / fanout : 0;
+
+	for (;;) {
+		np = &pjob->ji_hosts[parent];
+		if (np->hn_stream == -1)
+			np->hn_stream = tpp_open(np->hn_host, np->hn_port);
+		ret = DIS_PROTO;
+		if (np->hn_stream >= 0) {
+			ret = im_compose(np->hn_stream, pjob->ji_qs.ji_jobid,
+					 get_jattr_str(pjob, JOB_ATR_Cookie),
+					 IM_JOIN_TREE, TM_NULL_EVENT, (tm_task_id) fanout,
+					 IM_OLD_PROTOCOL_VER);
+			if (ret == DIS_SUCCESS)
+				ret = diswsi(np->hn_stream, nnodes);
+			for (i = 0; (ret == DIS_SUCCESS) && (i < nnodes); i++)
+				ret = diswsi(np->hn_stream, nodes[i]);
+			if ((ret == DIS_SUCCESS) && (dis_flush(np->hn_stream) == -1))
+				ret = DIS_PROTO;
+		}
+		if (ret == DIS_SUCCESS)
+			return 0;
+
+		log_eventf(PBSEVENT_ERROR, PBS_EVENTCLASS_JOB, LOG_NOTICE, pjob->ji_qs.ji_jobid,
+			   "failed to send JOIN_TREE of %d nodes to %s", nnodes,
+			   np->hn_host ? np->hn_host : "node");
+		if (parent == 0)
+			return -1;
+		parent = 0;
+	}
+}
+
+/**
+ * @brief
+ *	Add joined nodes reported by a child to my subtree, and pass the
+ *	subtree on to my parent once all my children have reported.
+ *	Reports that come after the subtree went up, or for a job which
+ *	joined without a tree, are passed on as they are.
+ *
+ * @param[in]	pjob - job pointer
+ * @param[in]	nodes - host indices of the joined nodes
+ * @param[in]	nnodes - number of entries in nodes
+ *
+ * @return void
+ */
+static void
+sister_tree_join(job *pjob, tm_node_id *nodes, int nnodes)
+{
+	sister_tree_t *tp = pjob->ji_tree;
+	tm_node_id *tmp;
+
+	if ((tp == NULL) || tp->st_joinsent) {
+		(void) tree_join_send(pjob, nodes, nnodes);
+		return;
+	}
+
+	tmp = (tm_node_id *) realloc(tp->st_nodes,
+				     (tp->st_nnodes + nnodes) * sizeof(tm_node_id));
+	if (tmp == NULL) {
+		log_err(errno, __func__, MALLOC_ERR_MSG);
+		(void) tree_join_send(pjob, nodes, nnodes);
+	} else {
+		memcpy(tmp + tp->st_nnodes, nodes, nnodes * sizeof(tm_node_id));
+		tp->st_nodes = tmp;
+		tp->st_nnodes += nnodes;
+	}
+	if (--tp->st_joinwait > 0)
+		return;
+
+	(void) tree_join_send(pjob, tp->st_nodes, tp->st_nnodes);
+	tp->st_joinsent = 1;
+	free(tp->st_nodes);
+	tp->st_nodes = NULL;
+	tp->st_nnodes = 0;
+}
+
+/**
+ * @brief
+ *	Keep a join ack for a job I have not joined yet, or drop stale ones.
+ *
+ * @param[in]	jobid - job id, NULL to only drop stale entries
+ * @param[in]	cookie - job cookie
+ * @param[in]	nodes - host indices, ownership passes to the list
+ * @param[in]	nnodes - number of entries in nodes
+ *
+ * @return void
+ */
+static void
+tree_early_add(char *jobid, char *cookie, tm_node_id *nodes, int nnodes)
+{
+	tree_early_t **pte;
+	tree_early_t *te;
+
+	for (pte = &tree_early_acks; (te = *pte) != NULL;) {
+		if ((time_now - te->te_time) > TREE_EARLY_MAXAGE) {
+			log_event(PBSEVENT_DEBUG, PBS_EVENTCLASS_JOB, LOG_DEBUG,
+				  te->te_jobid, "dropping stale JOIN_TREE");
+			*pte = te->te_next;
+			free(te->te_cookie);
+			free(te->te_nodes);
+			free(te);
+		} else
+			pte = &te->te_next;
+	}
+	if (jobid == NULL)
+		return;
+
+	if (((te = (tree_early_t *) calloc(1, sizeof(tree_early_t))) == NULL) ||
+	    ((te->te_cookie = strdup(cookie)) == NULL)) {
+		log_err(errno, __func__, MALLOC_ERR_MSG);
+		free(te);
+		free(nodes);
+		return;
+	}
+	pbs_strncpy(te->te_jobid, jobid, sizeof(te->te_jobid));
+	te->te_time = time_now;
+	te->te_nodes = nodes;
+	te->te_nnodes = nnodes;
+	te->te_next = tree_early_acks;
+	tree_early_acks = te;
+}
+
+/**
+ * @brief
+ *	Called by a sister which is about to drop a job because Mother
+ *	Superior sent JOIN_JOB again.  Join acks my children already sent
+ *	me are kept for the new instance of the job.
+ *
+ * @param[in]	pjob - job pointer
+ *
+ * @return void
+ */
+static void
+sister_tree_stash(job *pjob)
+{
+	sister_tree_t *tp = pjob->ji_tree;
+	tm_node_id *nodes;
+	int i, n = 0;
+
+	if ((tp == NULL) || tp->st_joinsent || (tp->st_nnodes == 0) ||
+	    !(is_jattr_set(pjob, JOB_ATR_Cookie)))
+		return;
+	if ((nodes = (tm_node_id *) malloc(tp->st_nnodes * sizeof(tm_node_id))) == NULL) {
+		log_err(errno, __func__, MALLOC_ERR_MSG);
+		return;
+	}
+	for (i = 0; i < tp->st_nnodes; i++) {
+		if (tp->st_nodes[i] != pjob->ji_nodeid)
+			nodes[n++] = tp->st_nodes[i];
+	}
+	if (n == 0) {
+		free(nodes);
+		return;
+	}
+	tree_early_add(pjob->ji_qs.ji_jobid, get_jattr_str(pjob, JOB_ATR_Cookie), nodes, n);
+}
+
+/**
+ * @brief
+ *	Called by a sister which has just joined a job.  If JOIN_JOB
+ *	carried a fanout, start my subtree with myself, fold in any acks
+ *	from children that came early, and report up if I am a leaf or
+ *	all my children are already in.  Without a fanout, acks that came
+ *	early are passed on to Mother Superior.
+ *
+ * @param[in]	pjob - job pointer
+ * @param[in]	fanout - children per node, taskid of the JOIN_JOB
+ *
+ * @return int
+ * @retval 0 - the join is handled through the tree
+ * @retval -1 - reply directly to Mother Superior
+ */
+static int
+sister_tree_start(job *pjob, tm_task_id fanout)
+{
+	sister_tree_t *tp = NULL;
+	tree_early_t **pte;
+	tree_early_t *te;
+	char *cookie;
+	tm_node_id me = pjob->ji_nodeid;
+
+	if ((fanout >= 2) && (fanout <= INT_MAX) && (job_join_ack == NULL)) {
+		/* count myself as a child, the join below accounts for it */
+		if ((tp = sister_tree_alloc(pjob, (int) fanout)) != NULL)
+			tp->st_joinwait = tree_children(pjob, tp->st_fanout, me, NULL) + 1;
+	}
+
+	cookie = get_jattr_str(pjob, JOB_ATR_Cookie);
+	for (pte = &tree_early_acks; (te = *pte) != NULL;) {
+		if ((strcmp(te->te_jobid, pjob->ji_qs.ji_jobid) == 0) &&
+		    (strcmp(te->te_cookie, cookie) == 0)) {
+			*pte = te->te_next;
+			sister_tree_join(pjob, te->te_nodes, te->te_nnodes);
+			free(te->te_cookie);
+			free(te->te_nodes);
+			free(te);
+		} else
+			pte = &te->te_next;
+	}
+	if (tp == NULL)
+		return -1;
+
+	sister_tree_join(pjob, &me, 1);
+	return 0;
+}
+
+/**
+ * @brief
+ *	Send a request to my children in the fanout tree of a job.
+ *	Used for IM_POLL_JOB, the children answer for their whole subtree.
+ *	Requests of an earlier round still outstanding are retired.
+ *
+ * @param[in]	pjob - job pointer
+ * @param[in]	com - IM command
+ *
+ * @return int
+ * @retval number of children the request was sent to
+ */
+int
+send_sisters_tree(job *pjob, int com)
+{
+	sister_tree_t *tp = pjob->ji_tree;
+	eventent *ep, *nep = NULL, *next;
+	char *cookie;
+	int first = 0;
+	int nchild;
+	int i, num = 0;
+
+	if ((tp == NULL) || !(is_jattr_set(pjob, JOB_ATR_Cookie)))
+		return 0;
+	cookie = get_jattr_str(pjob, JOB_ATR_Cookie);
+
+	nchild = tree_children(pjob, tp->st_fanout, pjob->ji_nodeid, &first);
+	for (i = first; i < first + nchild; i++) {
+		hnodent *np = &pjob->ji_hosts[i];
+
+		for (ep = (eventent *) GET_NEXT(np->hn_events); ep != NULL; ep = next) {
+			next = (eventent *) GET_NEXT(ep->ee_next);
+			if ((ep->ee_command == com) &&
+			    (ep->ee_taskid == (tm_task_id) tp->st_fanout)) {
+				delete_link(&ep->ee_next);
+				free(ep);
+			}
+		}
+
+		if (pjob->ji_nodekill == TM_ERROR_NODE)
+			pjob->ji_nodekill = np->hn_node;
+
+		if (np->hn_sister != SISTER_OKAY) /* sis is gone? */
+			continue;
+
+		if (np->hn_stream == -1)
+			np->hn_stream = tpp_open(np->hn_host, np->hn_port);
+		if (np->hn_stream == -1)
+			continue;
+
+		np->hn_sister = SISTER_EOF;
+		if (nep == NULL) {
+			nep = event_alloc(pjob, com, -1, np, TM_NULL_EVENT,
+					  (tm_task_id) tp->st_fanout);
+			ep = nep;
+		} else
+			ep = event_dup(nep, pjob, np);
+		if (ep == NULL)
+			continue;
+
+		if (im_compose(np->hn_stream, pjob->ji_qs.ji_jobid, cookie, com,
+			       ep->ee_event, (tm_task_id) tp->st_fanout,
+			       IM_OLD_PROTOCOL_VER) != DIS_SUCCESS)
+			continue;
+		if (dis_flush(np->hn_stream) == -1)
+			continue;
+
+		if (pjob->ji_nodekill == np->hn_node)
+			pjob->ji_nodekill = TM_ERROR_NODE;
+		np->hn_sister = SISTER_OKAY;
+		num++;
+	}
+	return num;
+}
+
+/**
+ * @brief
+ *	Build the list of resources_used values of a job that were set in
+ *	a mom hook, leaving out 'cput', 'mem' and 'cpupercent' which are
+ *	sent to MS anyway.
+ *
+ * @param[in]	pjob - job pointer
+ * @param[out]	phead - list to fill, possibly left empty
+ *
+ * @return int
+ * @retval  0	success
+ * @retval -1	error, the list is left empty
+ */
+static int
+resc_used_hook_list(job *pjob, pbs_list_head *phead)
+{
+	extern int resc_access_perm;
+	attribute *at;
+	attribute_def *ad;
+	svrattrl *pal;
+	svrattrl *nxpal;
+	pbs_list_head lhead;
+
+	memset(phead, 0, sizeof(*phead));
+	CLEAR_HEAD((*phead));
+
+	at = get_jattr(pjob, JOB_ATR_resc_used);
+	if (at->at_type != ATR_TYPE_RESC)
+		return (-1);
+	ad = &job_attr_def[(int) JOB_ATR_resc_used];
+	resc_access_perm = ATR_DFLAG_MGRD;
+
+	memset(&lhead, 0, sizeof(lhead));
+	CLEAR_HEAD(lhead);
+
+	(void) ad->at_encode(at, &lhead, ad->at_name, NULL, ATR_ENCODE_CLIENT, NULL);
+
+	pal = (svrattrl *) GET_NEXT(lhead);
+	while (pal != NULL) {
+		nxpal = (struct svrattrl *) GET_NEXT(pal->al_link);
+
+		/* no need to track the resources automatically sent to MS */
+		/* like 'cput', 'mem', and 'cpupercent',but only those */
+		/* resources that are set in a mom hook */
+		if ((pal->al_flags & ATR_VFLAG_HOOK) != 0 &&
+		    strcmp(pal->al_resc, "cput") != 0 &&
+		    strcmp(pal->al_resc, "mem") != 0 &&
+		    strcmp(pal->al_resc, "cpupercent") != 0) {
+			if (add_to_svrattrl_list(phead, pal->al_name, pal->al_resc,
+						 pal->al_value, pal->al_op, NULL) == -1) {
+				free_attrlist(phead);
+				free_attrlist(&lhead);
+				return (-1);
+			}
+		}
+		pal = nxpal;
+	}
+	free_attrlist(&lhead);
+	return (0);
+}
+
+/**
+ * @brief
+ *	Send the hook-set resources_used of my subtree after a tree poll
+ *	answer: mine and those my children forwarded in this round, each
+ *	tagged with the host index of the node it belongs to so that MS
+ *	can keep it in that node's slot.
+ *
+ * @par	Format
+ *	count uint, then count times (host index uint, svrattrl list)
+ *
+ * @param[in]	pjob - job pointer
+ * @param[in]	stream - stream to write to
+ *
+ * @return int
+ * @retval DIS_SUCCESS	all written
+ * @retval other	DIS error
+ */
+static int
+sister_tree_send_used(job *pjob, int stream)
+{
+	sister_tree_t *tp = pjob->ji_tree;
+	pbs_list_head own;
+	unsigned int n = 0;
+	int i;
+	int ret;
+
+	if (resc_used_hook_list(pjob, &own) == -1)
+		CLEAR_HEAD(own);
+	if (GET_NEXT(own) != NULL)
+		n++;
+	if (tp->st_used != NULL) {
+		for (i = 0; i < pjob->ji_numnodes; i++) {
+			if (GET_NEXT(tp->st_used[i]) != NULL)
+				n++;
+		}
+	}
+
+	ret = diswui(stream, n);
+	if ((ret == DIS_SUCCESS) && (GET_NEXT(own) != NULL)) {
+		ret = diswui(stream, (unsigned int) pjob->ji_nodeid);
+		if (ret == DIS_SUCCESS)
+			ret = encode_DIS_svrattrl(stream,
+						  (svrattrl *) GET_NEXT(own));
+	}
+	free_attrlist(&own);
+	if (tp->st_used == NULL)
+		return ret;
+	for (i = 0; (ret == DIS_SUCCESS) && (i < pjob->ji_numnodes); i++) {
+		if (GET_NEXT(tp->st_used[i]) == NULL)
+			continue;
+		ret = diswui(stream, (unsigned int) i);
+		if (ret == DIS_SUCCESS)
+			ret = encode_DIS_svrattrl(stream,
+						  (svrattrl *) GET_NEXT(tp->st_used[i]));
+	}
+	return ret;
+}
+
+/**
+ * @brief
+ *	Read the hook-set resources_used a child sent after its tree poll
+ *	answer (see sister_tree_send_used).  At MS each list replaces the
+ *	slot of the node it belongs to, elsewhere it is kept to be passed
+ *	up with my own answer.
+ *
+ * @param[in]	pjob - job pointer
+ * @param[in]	stream - stream to read from
+ *
+ * @return int
+ * @retval  0	success
+ * @retval -1	error
+ */
+static int
+sister_tree_recv_used(job *pjob, int stream)
+{
+	sister_tree_t *tp = pjob->ji_tree;
+	int ms = (pjob->ji_qs.ji_svrflags & JOB_SVFLG_HERE) != 0;
+	unsigned int n;
+	unsigned int idx;
+	int ret;
+
+	n = disrui(stream, &ret);
+	if (ret != DIS_SUCCESS)
+		return (-1);
+	for (; n > 0; n--) {
+		idx = disrui(stream, &ret);
+		if (ret != DIS_SUCCESS)
+			return (-1);
+		if ((idx == 0) || (idx >= (unsigned int) pjob->ji_numnodes))
+			return (-1);
+		if (ms) {
+			if ((int) idx - 1 >= pjob->ji_numrescs)
+				return (-1);
+			if (recv_resc_used_from_sister(stream, pjob, idx - 1) != 0)
+				return (-1);
+		} else {
+			if (tp->st_used == NULL)
+				return (-1);
+			free_attrlist(&tp->st_used[idx]);
+			if (decode_DIS_svrattrl(stream, &tp->st_used[idx]) != DIS_SUCCESS)
+				return (-1);
+		}
+	}
+	return (0);
+}
+
+/**
+ * @brief
+ *	Answer the pending tree poll of a job with the usage summed over
+ *	my subtree.  Children that have not answered yet are left out.
+ *
+ * @param[in]	pjob - job pointer
+ *
+ * @return void
+ */
+static void
+sister_tree_poll_reply(job *pjob)
+{
+	sister_tree_t *tp = pjob->ji_tree;
+	int stream;
+	int ret;
+
+	if ((tp == NULL) || (tp->st_pollstream == -1))
+		return;
+	stream = tp->st_pollstream;
+	tp->st_pollstream = -1;
+	tp->st_pollwait = 0;
+
+	ret = im_compose(stream, pjob->ji_qs.ji_jobid,
+			 get_jattr_str(pjob, JOB_ATR_Cookie), IM_ALL_OKAY,
+			 tp->st_pollevent, (tm_task_id) tp->st_fanout,
+			 IM_OLD_PROTOCOL_VER);
+	if (ret == DIS_SUCCESS)
+		ret = diswsi(stream, tp->st_pollkill);
+	if (ret == DIS_SUCCESS)
+		ret = diswul(stream, tp->st_cput);
+	if (ret == DIS_SUCCESS)
+		ret = diswul(stream, tp->st_mem);
+	if (ret == DIS_SUCCESS)
+		ret = diswul(stream, tp->st_cpupct);
+	if (ret == DIS_SUCCESS)
+		ret = sister_tree_send_used(pjob, stream);
+	if ((ret == DIS_SUCCESS) && (dis_flush(stream) == -1))
+		ret = DIS_PROTO;
+	if (ret != DIS_SUCCESS)
+		log_joberr(-1, __func__, "failed to answer tree POLL_JOB",
+			   pjob->ji_qs.ji_jobid);
+}
+
+/**
+ * @brief
+ *	Handle a tree poll at a sister with children: start a round with
+ *	my own usage and forward the poll to my children.
+ *	A round that never completed is answered with what it has first.
+ *
+ * @param[in]	pjob - job pointer
+ * @param[in]	stream - stream the poll came in on
+ * @param[in]	event - event of the poll
+ *
+ * @return int
+ * @retval 1 - the poll is answered by the tree
+ * @retval 0 - I am a leaf, answer the poll directly
+ */
+static int
+sister_tree_poll(job *pjob, int stream, tm_event_t event)
+{
+	sister_tree_t *tp = pjob->ji_tree;
+	int i;
+
+	if (tree_children(pjob, tp->st_fanout, pjob->ji_nodeid, NULL) == 0)
+		return 0;
+
+	if (tp->st_pollstream != -1)
+		sister_tree_poll_reply(pjob);
+
+	if (tp->st_used == NULL) {
+		tp->st_used = (pbs_list_head *) calloc(pjob->ji_numnodes,
+						       sizeof(pbs_list_head));
+		if (tp->st_used == NULL) {
+			log_err(errno, __func__, MALLOC_ERR_MSG);
+			return 0;
+		}
+		for (i = 0; i < pjob->ji_numnodes; i++)
+			CLEAR_HEAD(tp->st_used[i]);
+	}
+	for (i = 0; i < pjob->ji_numnodes; i++)
+		free_attrlist(&tp->st_used[i]);
+
+	tp->st_pollstream = stream;
+	tp->st_pollevent = event;
+	tp->st_pollkill = (pjob->ji_qs.ji_svrflags &
+			   (JOB_SVFLG_OVERLMT1 | JOB_SVFLG_OVERLMT2)) ? 1 : 0;
+	tp->st_cput = resc_used(pjob, "cput", gettime);
+	tp->st_mem = resc_used(pjob, "mem", getsize);
+	tp->st_cpupct = resc_used(pjob, "cpupercent", gettime);
+	tp->st_pollwait = send_sisters_tree(pjob, IM_POLL_JOB);
+	if (tp->st_pollwait <= 0)
+		sister_tree_poll_reply(pjob);
+	return 1;
+}
+
+/**
+ * @brief
+ *	Account the answer of a child to the pending tree poll.
+ *	A failed child (ok == 0) only counts as having answered.
+ *	The hook-set resources_used of the child's subtree were already
+ *	kept by sister_tree_recv_used.
+ *
+ * @param[in]	pjob - job pointer
+ * @param[in]	ok - nonzero if the values below are valid
+ * @param[in]	pollkill - kill recommendation of the child's subtree
+ * @param[in]	cput - cput of the child's subtree
+ * @param[in]	mem - mem of the child's subtree
+ * @param[in]	cpupct - cpupercent of the child's subtree
+ *
+ * @return void
+ */
+static void
+sister_tree_poll_child(job *pjob, int ok, int pollkill, u_long cput, u_long mem, u_long cpupct)
+{
+	sister_tree_t *tp = pjob->ji_tree;
+
+	if ((tp == NULL) || (tp->st_pollstream == -1))
+		return;
+	if (ok) {
+		tp->st_pollkill |= pollkill;
+		tp->st_cput += cput;
+		tp->st_mem += mem;
+		tp->st_cpupct += cpupct;
+	}
+	if (--tp->st_pollwait <= 0)
+		sister_tree_poll_reply(pjob);
+}
+
+/**
+ * @brief
+ *	Called by Mother Superior after storing the subtree usage reported
+ *	by node idx in its slot: zero the slots of the nodes below it so
+ *	that summing ji_resources counts them once.
+ *
+ * @param[in]	pjob - job pointer
+ * @param[in]	idx - host index of the node which answered
+ *
+ * @return void
+ */
+static void
+sister_tree_clear(job *pjob, int idx)
+{
+	long k = pjob->ji_tree->st_fanout;
+	long lo = idx;
+	long hi = idx;
+	long i;
+
+	for (;;) {
+		lo = lo * k + 1;
+		hi = hi * k + k;
+		if (lo >= pjob->ji_numnodes)
+			break;
+		if (hi >= pjob->ji_numnodes)
+			hi = pjob->ji_numnodes - 1;
+		for (i = lo; (i <= hi) && (i - 1 < pjob->ji_numrescs); i++) {
+			pjob->ji_resources[i - 1].nr_cput = 0;
+			pjob->ji_resources[i - 1].nr_mem = 0;
+			pjob->ji_resources[i - 1].nr_cpupercent = 0;
+		}
+	}
+}
+
 #define SEND_ERR(err)                                                                                     \
 	if (reply) {                                                                                      \
 		(void) im_compose(stream, jobid, cookie, IM_ERROR, event, fromtask, IM_OLD_PROTOCOL_VER); \
@@ -2090,6 +2901,16 @@ node_bailout(job *pjob, hnodent *np)
 
 					++ep->ee_retry; /* retry count */
 
+					/*
+					 * A sister joining late cannot rely on its
+					 * tree neighbors, have it answer directly
+					 * and poll everybody directly from now on.
+					 */
+					if (pjob->ji_tree != NULL) {
+						ep->ee_taskid = TM_NULL_TASK;
+						sister_tree_free(pjob);
+					}
+
 					/* resend JOIN_JOB to this sister */
 					i = np - pjob->ji_hosts;
 					DBPRT(("%s: JOIN_JOB %s host %s port %d jjretry %d i %d new stream %d\n", __func__, pjob->ji_qs.ji_jobid, np->hn_host, np->hn_port, ep->ee_retry, i, np->hn_stream))
@@ -2206,8 +3027,13 @@ node_bailout(job *pjob, hnodent *np)
 			case IM_POLL_JOB:
 				/*
 				 ** I must be Mother Superior for the job and
-				 ** this is an error reply to a poll request.
+				 ** this is an error reply to a poll request,
+				 ** or a sister polling her fanout subtree.
 				 */
+				if ((pjob->ji_qs.ji_svrflags & JOB_SVFLG_HERE) == 0) {
+					sister_tree_poll_child(pjob, 0, 0, 0, 0, 0);
+					break;
+				}
 				if (do_tolerate_node_failures(pjob)) {
 
 					snprintf(log_buffer, sizeof(log_buffer),
@@ -2697,12 +3523,6 @@ static char bail_format[] = "dis read failed: %s";
 int
 send_resc_used_to_ms(int stream, job *pjob)
 {
-	extern int resc_access_perm;
-	attribute *at;
-	attribute_def *ad;
-	svrattrl *pal;
-	svrattrl *nxpal;
-	pbs_list_head lhead;
 	pbs_list_head send_head;
 	svrattrl *psatl;
 	int ret;
@@ -2710,40 +3530,8 @@ send_resc_used_to_ms(int stream, job *pjob)
 	if (pjob == NULL || stream == -1)
 		return (-1);
 
-	at = get_jattr(pjob, JOB_ATR_resc_used);
-	if (at->at_type != ATR_TYPE_RESC)
+	if (resc_used_hook_list(pjob, &send_head) == -1)
 		return (-1);
-	ad = &job_attr_def[(int) JOB_ATR_resc_used];
-	resc_access_perm = ATR_DFLAG_MGRD;
-
-	memset(&lhead, 0, sizeof(lhead));
-	CLEAR_HEAD(lhead);
-
-	(void) ad->at_encode(at, &lhead, ad->at_name, NULL, ATR_ENCODE_CLIENT, NULL);
-	memset(&send_head, 0, sizeof(send_head));
-	CLEAR_HEAD(send_head);
-
-	pal = (svrattrl *) GET_NEXT(lhead);
-	while (pal != NULL) {
-		nxpal = (struct svrattrl *) GET_NEXT(pal->al_link);
-
-		/* no need to track the resources automatically sent to MS */
-		/* like 'cput', 'mem', and 'cpupercent',but only those */
-		/* resources that are set in a mom hook */
-		if ((pal->al_flags & ATR_VFLAG_HOOK) != 0 &&
-		    strcmp(pal->al_resc, "cput") != 0 &&
-		    strcmp(pal->al_resc, "mem") != 0 &&
-		    strcmp(pal->al_resc, "cpupercent") != 0) {
-			if (add_to_svrattrl_list(&send_head, pal->al_name, pal->al_resc,
-						 pal->al_value, pal->al_op, NULL) == -1) {
-				free_attrlist(&send_head);
-				free_attrlist(&lhead);
-				return (-1);
-			}
-		}
-		pal = nxpal;
-	}
-	free_attrlist(&lhead);
 
 	psatl = (svrattrl *) GET_NEXT(send_head);
 	if (psatl == NULL) {
@@ -2954,6 +3742,7 @@ im_request(int stream, int version)
 	unsigned int		hook_fail_action = 0;
 	char			*nodehost = NULL;
 	char			timebuf[TIMEBUF_SIZE] = {0};
+	tm_node_id		*tree_nodes = NULL;
   	char			*delete_job_msg = NULL;
 
 	DBPRT(("%s: stream %d version %d\n", __func__, stream, version))
@@ -3016,6 +3805,104 @@ im_request(int stream, int version)
 			pjob->ji_qs.ji_un.ji_momt.ji_exgid = pjob->ji_grpcache->gc_gid;
 			pjob->ji_msconnected = 1;
 			goto done;
+
+		case IM_JOIN_TREE:
+			/*
+			 ** Sender is a sister in the fanout tree of a wide
+			 ** job ($sister_tree_fanout) saying she and the nodes
+			 ** below her have joined the job.  There is no reply.
+			 ** If I'm mother superior, this stands for the JOIN
+			 ** replies of all the nodes listed.
+			 **
+			 ** auxiliary info (
+			 **	number of nodes	int;
+			 **	node id		int; <repeated>
+			 ** )
+			 */
+			reply = 0;
+			np = NULL;
+			num = disrsi(stream, &ret);
+			BAIL("JOINTREE count")
+			if ((num <= 0) || (num > TREE_MAX_NODES)) {
+				sprintf(log_buffer, "JOIN_TREE bad node count %d", num);
+				goto err;
+			}
+			tree_nodes = (tm_node_id *)malloc(num * sizeof(tm_node_id));
+			if (tree_nodes == NULL) {
+				log_err(errno, __func__, MALLOC_ERR_MSG);
+				goto done;
+			}
+			for (i = 0; i < num; i++) {
+				tree_nodes[i] = disrsi(stream, &ret);
+				BAIL("JOINTREE node")
+			}
+
+			pjob = find_job(jobid);
+			if ((pjob == NULL) ||
+				!(is_jattr_set(pjob, JOB_ATR_Cookie)) ||
+				(strcmp(get_jattr_str(pjob, JOB_ATR_Cookie), cookie) != 0)) {
+				if ((pjob == NULL) ||
+					((pjob->ji_qs.ji_svrflags & JOB_SVFLG_HERE) == 0)) {
+					/* my own JOIN_JOB has not come yet */
+					tree_early_add(jobid, cookie, tree_nodes, num);
+					tree_nodes = NULL;
+				}
+				goto done;
+			}
+
+			if ((pjob->ji_qs.ji_svrflags & JOB_SVFLG_HERE) == 0) {
+				sister_tree_join(pjob, tree_nodes, num);
+				goto done;
+			}
+
+			DBPRT(("%s: JOIN_TREE %s %d nodes\n", __func__, jobid, num))
+			hnodenum = 0;	/* JOIN replies this message stands for */
+			for (i = 0; i < num; i++) {
+				eventent	*nxt;
+
+				nodeidx = tree_nodes[i];
+				if ((nodeidx <= 0) || (nodeidx >= pjob->ji_numnodes))
+					continue;
+				if (((nodeidx-1) < pjob->ji_numrescs) &&
+					(pjob->ji_resources[nodeidx-1].nodehost == NULL))
+					pjob->ji_resources[nodeidx-1].nodehost = strdup(pjob->ji_hosts[nodeidx].hn_host);
+				for (ep = (eventent *)GET_NEXT(pjob->ji_hosts[nodeidx].hn_events);
+					ep != NULL; ep = nxt) {
+					nxt = (eventent *)GET_NEXT(ep->ee_next);
+					if (ep->ee_command == IM_JOIN_JOB) {
+						delete_link(&ep->ee_next);
+						free(ep);
+						hnodenum++;
+					}
+				}
+			}
+			if (hnodenum == 0)
+				goto done;
+
+			for (i=0; i<pjob->ji_numnodes; i++) {
+				if (GET_NEXT(pjob->ji_hosts[i].hn_events) != NULL)
+					goto done;
+			}
+
+			/*
+			 ** All the JOIN messages have come in.
+			 */
+			switch (pre_finish_exec(pjob, 1)) {
+				case PRE_FINISH_SUCCESS:
+					finish_exec(pjob);
+					break;
+				case PRE_FINISH_SUCCESS_JOB_SETUP_SEND:
+				case PRE_FINISH_FAIL_JOIN_EXTRA:
+					break;
+				case PRE_FINISH_FAIL_JOB_SETUP_SEND:
+					sprintf(log_buffer, "could not send setup");
+					goto err;
+				default:
+					sprintf(log_buffer, "pre_finish_exec failed");
+					goto err;
+			}
+			goto done;
+
 		case IM_JOIN_JOB:
 			/*
 			 ** Sender is mom superior sending a job structure to me.
@@ -3042,6 +3929,7 @@ im_request(int stream, int version)
 			/* does job already exist? */
 			pjob = find_job(jobid);
 			if (pjob) {	/* job is here */
+				sister_tree_stash(pjob);
 				kill_job(pjob, SIGKILL);
 				mom_deljob(pjob);
 			}
@@ -3394,7 +4282,14 @@ im_request(int stream, int version)
 			 ** At this point, we have done all the job setup.
 			 ** Any error from now on is a problem sending the
 			 ** reply to MS.  We don't need to call SEND_ERR.
+			 **
+			 ** If MS asked for a fanout tree (in fromtask), the
+			 ** reply goes up the tree with those of my subtree.
 			 */
+			if (sister_tree_start(pjob, fromtask) == 0) {
+				tpp_eom(stream);
+				goto fini;
+			}
 			ret = im_compose(stream, jobid, cookie, IM_ALL_OKAY,
 				event, fromtask, IM_OLD_PROTOCOL_VER);
 			if (ret != DIS_SUCCESS)
@@ -3502,6 +4397,10 @@ join_err:
 				 * along with their associated tm_spawn events
 				 */
 				goto done;
+			} else if ((pjob->ji_tree != NULL) &&
+				(fromtask == (tm_task_id)pjob->ji_tree->st_fanout)) {
+				/* late answer to a retired tree poll */
+				goto done;
 			} else {
 				sprintf(log_buffer, "event %d taskid %8.8X not found",
 					event, fromtask);
@@ -4124,10 +5023,25 @@ join_err:
 					sleep(90);
 			}
 
-			if (check_ms(stream, pjob))
-				goto fini;
+			/*
+			 ** A poll carrying the fanout (in fromtask) comes down
+			 ** the tree, possibly from a sister.  If I have children
+			 ** I pass it on and answer for my subtree when they do.
+			 */
+			if ((pjob->ji_tree == NULL) ||
+				(fromtask != (tm_task_id)pjob->ji_tree->st_fanout) ||
+				((pjob->ji_nodeid - 1) / pjob->ji_tree->st_fanout == 0)) {
+				if (check_ms(stream, pjob))
+					goto fini;
+			}
 			pjob->ji_polltime = time_now;
 			DBPRT(("%s: POLL_JOB %s\n", __func__, jobid))
+			if ((pjob->ji_tree != NULL) &&
+				(fromtask == (tm_task_id)pjob->ji_tree->st_fanout) &&
+				sister_tree_poll(pjob, stream, event)) {
+				reply = 0;
+				break;
+			}
 			ret = im_compose(stream, jobid, cookie, IM_ALL_OKAY,
 				event, fromtask, IM_OLD_PROTOCOL_VER);
 			if (ret != DIS_SUCCESS)
@@ -4150,8 +5064,15 @@ join_err:
 			if (ret != DIS_SUCCESS)
 				break;
 			ret = diswul(stream, resc_used(pjob, "cpupercent", gettime));
+			if (ret != DIS_SUCCESS)
+				break;
 
-			send_resc_used_to_ms(stream, pjob);
+			/* a tree answer tags the hook values with my index */
+			if ((pjob->ji_tree != NULL) &&
+				(fromtask == (tm_task_id)pjob->ji_tree->st_fanout))
+				ret = sister_tree_send_used(pjob, stream);
+			else
+				send_resc_used_to_ms(stream, pjob);
 			break;
 
 #ifdef PMIX
@@ -4829,8 +5750,27 @@ join_err:
 					 ** )
 					 */
 					if ((pjob->ji_qs.ji_svrflags & JOB_SVFLG_HERE) == 0) {
-						sprintf(log_buffer, "got POLL_JOB and I'm not MS");
-						goto err;
+						u_long	cput, mem, cpupct;
+
+						if (pjob->ji_tree == NULL) {
+							sprintf(log_buffer, "got POLL_JOB and I'm not MS");
+							goto err;
+						}
+						/* a child answering for her subtree */
+						exitval = disrsi(stream, &ret);
+						BAIL("OK-POLL_JOB exitval")
+						cput = disrul(stream, &ret);
+						BAIL("OK-POLL_JOB cput")
+						mem = disrul(stream, &ret);
+						BAIL("OK-POLL_JOB mem")
+						cpupct = disrul(stream, &ret);
+						BAIL("OK-POLL_JOB cpupercent")
+						if (sister_tree_recv_used(pjob, stream) != 0)
+							log_joberr(-1, __func__,
+								"bad resources_used in tree POLL_JOB answer",
+								pjob->ji_qs.ji_jobid);
+						sister_tree_poll_child(pjob, 1, exitval, cput, mem, cpupct);
+						break;
 					}
 					exitval = disrsi(stream, &ret);
 					BAIL("OK-POLL_JOB exitval")
@@ -4840,7 +5780,16 @@ join_err:
 					BAIL("OK-POLL_JOB mem")
 					pjob->ji_resources[nodeidx - 1].nr_cpupercent = disrul(stream, &ret);
 					BAIL("OK-POLL_JOB cpupercent")
-					recv_resc_used_from_sister(stream, pjob, nodeidx - 1);
+					/* a tree answer covers the nodes below too */
+					if ((pjob->ji_tree != NULL) &&
+						(event_task == (tm_task_id)pjob->ji_tree->st_fanout)) {
+						sister_tree_clear(pjob, nodeidx);
+						if (sister_tree_recv_used(pjob, stream) != 0)
+							log_joberr(-1, __func__,
+								"bad resources_used in tree POLL_JOB answer",
+								pjob->ji_qs.ji_jobid);
+					} else
+						recv_resc_used_from_sister(stream, pjob, nodeidx - 1);
 					DBPRT(("%s: POLL_JOB %s OKAY kill %d cpu %lu mem %lu\n",
 					       __func__, jobid, exitval,
 					       pjob->ji_resources[nodeidx - 1].nr_cput,
@@ -5248,6 +6197,11 @@ join_err:
 					 ** this is an error reply to a poll request.
 					 */
 					if ((pjob->ji_qs.ji_svrflags & JOB_SVFLG_HERE) == 0) {
+						if (pjob->ji_tree != NULL) {
+							/* a child of my subtree failed */
+							sister_tree_poll_child(pjob, 0, 0, 0, 0, 0);
+							break;
+						}
 						sprintf(log_buffer,
 							"POLL_JOB ERROR and I'm not MS");
 						goto err;
@@ -5450,6 +6404,7 @@ fini:
 	free(info);
 	free(errmsg);
 	free(nodehost);
+	free(tree_nodes);
 }
 
 // clang-format on
@@ -6689,7 +7644,7 @@ send_join_job_restart(int com, eventent *ep, int nth, job *pjob, pbs_list_head *
 	/* send message header */
 	im_compose(stream, pjob->ji_qs.ji_jobid,
 		   get_jattr_str(pjob, JOB_ATR_Cookie),
-		   com, ep->ee_event, TM_NULL_TASK, IM_OLD_PROTOCOL_VER);
+		   com, ep->ee_event, ep->ee_taskid, IM_OLD_PROTOCOL_VER);
 
 	if (com == IM_JOIN_JOB) {
 		/* for JOIN_JOB send body of message */
@@ -6756,7 +7711,7 @@ send_join_job_restart_mcast(int mtfd, int com, eventent *ep, int nth, job *pjob,
 	/* send message header */
 	im_compose(stream, pjob->ji_qs.ji_jobid,
 		   get_jattr_str(pjob, JOB_ATR_Cookie),
-		   com, ep->ee_event, TM_NULL_TASK, IM_OLD_PROTOCOL_VER);
+		   com, ep->ee_event, ep->ee_taskid, IM_OLD_PROTOCOL_VER);
 
 	if (com == IM_JOIN_JOB) {
 		/* for JOIN_JOB send body of message */
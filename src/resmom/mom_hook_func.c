@@ -85,6 +85,10 @@
 #include "tpp.h"
 #include "dis.h"
 #include <openssl/sha.h>
+#ifndef WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
 
 #define RESCASSN_NCPUS "resources_assigned.ncpus"
 #define RESCASSN_MEM "resources_assigned.mem"
@@ -95,6 +99,11 @@
 
 /* Global Data items */
 static int run_exit = 0; /* run exit of child */
+#ifndef WIN32
+static pid_t hook_executor_pid = 0;	/* pid of the running hook executor */
+static time_t hook_executor_started = 0; /* when it was last started */
+#define HOOK_EXECUTOR_RESTART 10	/* secs between executor restarts */
+#endif
 
 extern int exiting_tasks;
 extern int resc_access_perm;
@@ -209,6 +218,192 @@ run_hook_alarm(void)
 	run_exit = -3;
 }
 
+#ifndef WIN32
+/**
+ * @brief
+ *	Get the path of the hook executor socket.
+ *
+ * @param[out]	buf - buffer for the path
+ * @param[in]	len - size of buf
+ */
+static void
+hook_executor_path(char *buf, size_t len)
+{
+	snprintf(buf, len, "%s%s", path_hooks_workdir, HOOK_EXECUTOR_SOCK);
+}
+
+/**
+ * @brief
+ *	Called when the hook executor process exits.
+ *
+ * @param[in]	ptask - work task of the executor process
+ */
+static void
+post_hook_executor(struct work_task *ptask)
+{
+	if ((pid_t) ptask->wt_event == hook_executor_pid)
+		hook_executor_pid = 0;
+	log_eventf(PBSEVENT_DEBUG, PBS_EVENTCLASS_HOOK, LOG_INFO, __func__,
+		   "hook executor pid %ld exited, status=%d", ptask->wt_event, ptask->wt_aux);
+}
+
+/**
+ * @brief
+ *	Stop the hook executor, if running.
+ */
+void
+hook_executor_stop(void)
+{
+	char sockpath[MAXPATHLEN + 1];
+
+	if (hook_executor_pid <= 0)
+		return;
+	(void) kill(hook_executor_pid, SIGTERM);
+	hook_executor_pid = 0;
+	hook_executor_path(sockpath, sizeof(sockpath));
+	(void) unlink(sockpath);
+	log_event(PBSEVENT_DEBUG, PBS_EVENTCLASS_HOOK, LOG_INFO, __func__,
+		  "hook executor stopped");
+}
+
+/**
+ * @brief
+ *	Start or stop the hook executor to match $hook_executor.
+ *
+ *	The executor is a pbs_python process that keeps the Python interpreter,
+ *	the hook scripts and the modules they import loaded, and forks a child
+ *	of itself to run each hook.  A failed executor is restarted at most
+ *	once every HOOK_EXECUTOR_RESTART seconds; until then hooks run by
+ *	executing pbs_python as usual.
+ */
+static void
+hook_executor_check(void)
+{
+	char pypath[MAXPATHLEN + 1];
+	char sockpath[MAXPATHLEN + 1];
+	char *arg[6];
+	pid_t pid;
+
+	if (!mom_hook_executor) {
+		hook_executor_stop();
+		return;
+	}
+	if ((hook_executor_pid > 0) ||
+	    (time_now < hook_executor_started + HOOK_EXECUTOR_RESTART))
+		return;
+
+	hook_executor_started = time_now;
+	snprintf(pypath, sizeof(pypath), "%s/bin/pbs_python", pbs_conf.pbs_exec_path);
+	hook_executor_path(sockpath, sizeof(sockpath));
+	arg[0] = pypath;
+	arg[1] = HOOK_EXECUTOR_MODE;
+	arg[2] = sockpath;
+	arg[3] = "-L";
+	arg[4] = path_log;
+	arg[5] = NULL;
+
+	pid = fork();
+	if (pid == -1) {
+		log_err(errno, __func__, "fork failed");
+		return;
+	}
+	if (pid == 0) {
+		/* releasing ports */
+		tpp_terminate();
+		net_close(-1);
+		setsid();
+		if (pbs_conf.pbs_conf_file != NULL)
+			(void) setenv("PBS_CONF_FILE", pbs_conf.pbs_conf_file, 1);
+		execve(pypath, arg, environ);
+		log_err(errno, __func__, "execve of hook executor");
+		exit(1);
+	}
+	if (set_task(WORK_Deferred_Child, pid, post_hook_executor, NULL) == NULL)
+		log_err(errno, __func__, msg_err_malloc);
+	hook_executor_pid = pid;
+	log_eventf(PBSEVENT_DEBUG, PBS_EVENTCLASS_HOOK, LOG_INFO, __func__,
+		   "hook executor started, pid %d", pid);
+}
+
+/**
+ * @brief
+ *	Run a hook in the hook executor instead of executing pbs_python.
+ *	Called in the forked MoM child in place of execve().  The child
+ *	waits for the hook to finish and exits with its status, so that the
+ *	MoM sees the same thing as for an executed pbs_python.
+ *
+ * @param[in]	arg - pbs_python arguments, arg[0] is the program
+ * @param[in]	hook_config - hook config file, or ""
+ *
+ * @return	int
+ * @retval	-1	- the request could not be sent, execute pbs_python
+ *
+ * @note
+ *	Does not return once the request has been sent.
+ */
+static int
+hook_executor_run(char **arg, char *hook_config)
+{
+	struct sockaddr_un addr;
+	char cwd[MAXPATHLEN + 1];
+	char *req;
+	char *p;
+	uint32_t rlen;
+	size_t len;
+	ssize_t n;
+	int status;
+	int sock;
+	int i;
+
+	if (getcwd(cwd, sizeof(cwd)) == NULL)
+		return (-1);
+	len = strlen(cwd) + 1 + strlen(hook_config) + 1;
+	for (i = 1; arg[i] != NULL; i++)
+		len += strlen(arg[i]) + 1;
+	if (len > HOOK_EXECUTOR_MAXREQ)
+		return (-1);
+	if ((req = malloc(sizeof(rlen) + len)) == NULL)
+		return (-1);
+	rlen = (uint32_t) len;
+	memcpy(req, &rlen, sizeof(rlen));
+	p = req + sizeof(rlen);
+	for (i = -1; (i == -1) || (arg[i] != NULL); i++) {
+		char *str = (i == -1) ? cwd : ((i == 0) ? hook_config : arg[i]);
+
+		memcpy(p, str, strlen(str) + 1);
+		p += strlen(str) + 1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	hook_executor_path(addr.sun_path, sizeof(addr.sun_path));
+	if ((sock = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+		free(req);
+		return (-1);
+	}
+	if ((connect(sock, (struct sockaddr *) &addr, sizeof(addr)) == -1) ||
+	    (write(sock, req, sizeof(rlen) + len) != (ssize_t) (sizeof(rlen) + len))) {
+		log_err(errno, __func__, "hook executor unavailable, executing pbs_python");
+		(void) close(sock);
+		free(req);
+		return (-1);
+	}
+	free(req);
+
+	while ((n = read(sock, &status, sizeof(status))) == -1 && errno == EINTR)
+		;
+	if (n != sizeof(status)) {
+		log_err(errno, __func__, "no status from hook executor");
+		exit(255);
+	}
+	if (WIFSIGNALED(status)) {
+		(void) signal(WTERMSIG(status), SIG_DFL);
+		(void) kill(getpid(), WTERMSIG(status));
+	}
+	exit(WIFEXITED(status) ? WEXITSTATUS(status) : 255);
+}
+#endif /* WIN32 */
+
 /**
  * @brief
  *	Print to file pointed to by 'fp', the values in a vnl_t structure 'vp'.
@@ -815,6 +1010,9 @@ run_hook(hook *phook, unsigned int event_type, mom_hook_input_t *hook_input,
 
 	snprintf(pypath, MAXPATHLEN, "%s/bin/pbs_python", pbs_conf.pbs_exec_path);
 	run_exit = 0;
+#ifndef WIN32
+	hook_executor_check();
+#endif
 
 	if ((phook->user == HOOK_PBSUSER) && (event_type & USER_MOM_EVENTS))
 		runas_jobuser = 1;
@@ -1289,6 +1487,13 @@ run_hook(hook *phook, unsigned int event_type, mom_hook_input_t *hook_input,
 			}
 		}
 
+		/*
+		 * Hooks that run as root can be handed to the hook executor,
+		 * which comes back here only if it could not take the hook.
+		 */
+		if ((hook_executor_pid > 0) && !child && !runas_jobuser)
+			(void) hook_executor_run(arg, hook_config_path);
+
 #ifdef __SANITIZE_ADDRESS__
 		/*
 		 * Ignore ASAN link order for pbs_python because Python bin
@@ -226,6 +226,12 @@ DIR *dir;
 char pbs_tmpdir[_POSIX_PATH_MAX] = TMP_DIR;
 char pbs_jobdir_root[_POSIX_PATH_MAX] = "";
 int pbs_jobdir_root_shared = FALSE;
+char cgroup_sample_root[_POSIX_PATH_MAX] = "";
+int mom_job_journal = 0;
+int mom_hook_executor = 0;
+int mom_cgroup_manager = 0;
+int sister_tree_fanout = 0;
+int stage_workers = 1;
 vnl_t *vnlp = NULL; /* vnode list */
 unsigned long hooks_rescdef_checksum = 0;
 
@@ -448,6 +454,8 @@ static handler_ret_t parse_config(char *);
 static handler_ret_t prologalarm(char *);
 static handler_ret_t set_joinjob_alarm(char *);
 static handler_ret_t set_job_launch_delay(char *);
+static handler_ret_t set_sister_tree_fanout(char *);
+static handler_ret_t set_stage_workers(char *);
 static handler_ret_t restricted(char *);
 static handler_ret_t set_alien_attach(char *);
 static handler_ret_t set_alien_kill(char *);
@@ -461,9 +469,13 @@ static handler_ret_t set_vnode_per_numa_node(char *);
 static handler_ret_t set_alps_confirm_switch_timeout(char *);
 #endif /* MOM_ALPS */
 static handler_ret_t set_attach_allow(char *);
+static handler_ret_t set_cgroup_sample_root(char *);
 static handler_ret_t set_checkpoint_path(char *);
 static handler_ret_t set_enforcement(char *);
 static handler_ret_t set_jobdir_root(char *);
+static handler_ret_t set_job_state_journal(char *);
+static handler_ret_t set_hook_executor(char *);
+static handler_ret_t set_cgroup_manager(char *);
 static handler_ret_t set_kbd_idle(char *);
 static handler_ret_t set_max_check_poll(char *);
 static handler_ret_t set_min_check_poll(char *);
@@ -518,13 +530,17 @@ static struct specials {
 	{"alps_confirm_switch_timeout", set_alps_confirm_switch_timeout},
 #endif /* MOM_ALPS */
 	{"attach_allow", set_attach_allow},
+	{"cgroup_manager", set_cgroup_manager},
+	{"cgroup_sample_root", set_cgroup_sample_root},
 	{"checkpoint_path", set_checkpoint_path},
 	{"clienthost", addclient},
 	{"configversion", config_verscheck},
 	{"cputmult", cputmult},
 	{"enforce", set_enforcement},
+	{"hook_executor", set_hook_executor},
 	{"ideal_load", setidealload},
 	{"jobdir_root", set_jobdir_root},
+	{"job_state_journal", set_job_state_journal},
 	{"kbd_idle", set_kbd_idle},
 	{"logevent", setlogevent},
 	{"max_check_poll", set_max_check_poll},
@@ -538,6 +554,8 @@ static struct specials {
 	{"port", set_momport},
 	{"prologalarm", prologalarm},
 	{"sister_join_job_alarm", set_joinjob_alarm},
+	{"sister_tree_fanout", set_sister_tree_fanout},
+	{"stage_workers", set_stage_workers},
 	{"job_launch_delay", set_job_launch_delay},
 	{"restart_background", set_restart_background},
 	{"restart_transmogrify", set_restart_transmogrify},
@@ -835,6 +853,7 @@ struct config common_config[] = {
 	{"uname", {requname}},
 	{"validuser", {validuser}},
 	{"reslist", {reslist}},
+	{"launch_latency", {launch_latency}},
 	{NULL, {nullproc}}};
 
 /**
@@ -1926,6 +1945,59 @@ set_job_launch_delay(char *value)
 	return HANDLER_SUCCESS;
 }
 
+/**
+ * @brief
+ *	Handler function for the $sister_tree_fanout config option.
+ *	A value of 0 (or 1) keeps every sister talking straight to
+ *	Mother Superior.
+ *
+ * @param[in]	value - the input given in config file.
+ *
+ * @return handler_ret_t
+ * @retval HANDLER_SUCCESS
+ * @retval HANDLER_FAIL
+ */
+static handler_ret_t
+set_sister_tree_fanout(char *value)
+{
+	long i;
+	char *endp;
+
+	log_event(PBSEVENT_SYSTEM, PBS_EVENTCLASS_SERVER, LOG_NOTICE,
+		  "sister_tree_fanout", value);
+	i = strtol(value, &endp, 10);
+	if ((*endp != '\0') || (i < 0) || (i > INT_MAX))
+		return HANDLER_FAIL; /* error */
+	sister_tree_fanout = (int) i;
+	return HANDLER_SUCCESS;
+}
+
+/**
+ * @brief
+ *	Handler function for the $stage_workers config option, the number
+ *	of file pairs of a copy request staged at the same time.
+ *
+ * @param[in]	value - the input given in config file.
+ *
+ * @return handler_ret_t
+ * @retval HANDLER_SUCCESS
+ * @retval HANDLER_FAIL
+ */
+static handler_ret_t
+set_stage_workers(char *value)
+{
+	long i;
+	char *endp;
+
+	log_event(PBSEVENT_SYSTEM, PBS_EVENTCLASS_SERVER, LOG_NOTICE,
+		  "stage_workers", value);
+	i = strtol(value, &endp, 10);
+	if ((*endp != '\0') || (i < 1) || (i > 64))
+		return HANDLER_FAIL; /* error */
+	stage_workers = (int) i;
+	return HANDLER_SUCCESS;
+}
+
 #ifdef WIN32
 
 /**
@@ -2816,6 +2888,41 @@ set_jobdir_root(char *value)
 	return HANDLER_SUCCESS;
 }
 
+/**
+ * @brief
+ *	Set the directory holding the cgroup v2 directory of each job,
+ *	named by job id.  When set, job resource usage is read from the
+ *	job's cgroup instead of walking /proc.
+ *
+ * @param[in] value - directory path
+ *
+ * @return      handler_ret_t
+ * @retval      HANDLER_FAIL            Failure
+ * @retval      HANDLER_SUCCESS         Success
+ *
+ */
+static handler_ret_t
+set_cgroup_sample_root(char *value)
+{
+	char *cleaned_value;
+
+	log_event(PBSEVENT_SYSTEM, PBS_EVENTCLASS_SERVER,
+		  LOG_INFO, __func__, value);
+	cleaned_value = remove_quotes(value); /* remove quotes if any present */
+	if (cleaned_value == NULL)
+		return HANDLER_FAIL;
+
+	if ((*cleaned_value != '/') ||
+	    (strlen(cleaned_value) > sizeof(cgroup_sample_root) - 1)) {
+		free(cleaned_value);
+		return HANDLER_FAIL;
+	}
+
+	strcpy(cgroup_sample_root, cleaned_value);
+	free(cleaned_value);
+	return HANDLER_SUCCESS;
+}
+
 /**
  * @brief
  *	sets boolean value
@@ -2975,6 +3082,53 @@ set_attach_allow(char *value)
 	return (set_boolean(__func__, value, &attach_allow));
 }
 
+/**
+ * @brief
+ *	Set the configuration flag that defines whether job and task
+ *	state changes are appended to the job state journal rather than
+ *	rewriting the job and task files.
+ *
+ * @retval 0 failure
+ * @retval 1 success
+ *
+ */
+static handler_ret_t
+set_job_state_journal(char *value)
+{
+	return (set_boolean(__func__, value, &mom_job_journal));
+}
+
+/**
+ * @brief
+ *	Set the configuration flag that defines whether hooks that run
+ *	as root are handed to a persistent hook executor process rather
+ *	than executing pbs_python for each hook.
+ *
+ * @retval 0 failure
+ * @retval 1 success
+ *
+ */
+static handler_ret_t
+set_hook_executor(char *value)
+{
+	return (set_boolean(__func__, value, &mom_hook_executor));
+}
+
+/**
+ * @brief
+ *	Set the configuration flag that defines whether MoM creates a
+ *	cgroup v2 for each job, configured by pbs_cgroups.CF.
+ *
+ * @retval 0 failure
+ * @retval 1 success
+ *
+ */
+static handler_ret_t
+set_cgroup_manager(char *value)
+{
+	return (set_boolean(__func__, value, &mom_cgroup_manager));
+}
+
 #if MOM_ALPS
 /**
  * @brief
@@ -4012,6 +4166,12 @@ read_config(char *file)
 #endif /* MOM_ALPS */
 
 	strcpy(pbs_jobdir_root, "");
+	strcpy(cgroup_sample_root, "");
+	mom_job_journal = 0;
+	mom_hook_executor = 0;
+	mom_cgroup_manager = 0;
+	sister_tree_fanout = 0;
+	stage_workers = 1;
 	restrict_user = 0;
 	restrict_user_maxsys = 999;
 	gen_nodefile_on_sister_mom = TRUE;
@@ -7848,7 +8008,7 @@ main(int argc, char *argv[])
 
 	/* initialize variables */
 
-	if ((jobs_idx = pbs_idx_create(0, 0)) == NULL) {
+	if ((jobs_idx = pbs_idx_create(PBS_IDX_HASH, 0)) == NULL) {
 		log_err(-1, __func__, "Creating jobs index failed!");
 		fprintf(stderr, "Creating jobs index failed!\n");
 		return (-1);
@@ -8391,6 +8551,8 @@ main(int argc, char *argv[])
 		end_proc();
 #endif
 
+		job_journal_checkpoint(0);
+
 		dorestrict_user();
 
 		/* check on User Activity */
@@ -8726,12 +8888,21 @@ main(int argc, char *argv[])
 				if ((pjob->ji_qs.ji_svrflags & JOB_SVFLG_HERE) &&
 				    (pjob->ji_nodekill == TM_ERROR_NODE)) {
 					int err_flag = 0;
+					int nsent, nwant;
 					/*
 					 ** If can't send poll to everybody, the
-					 ** time has come to die.
+					 ** time has come to die.  A fanout tree job
+					 ** only polls our direct children, they poll
+					 ** the rest of the tree.
 					 */
-					if (send_sisters(pjob, IM_POLL_JOB, NULL) !=
-					    pjob->ji_numnodes - 1) {
+					if (pjob->ji_tree != NULL) {
+						nwant = sister_tree_children(pjob, 0, NULL);
+						nsent = send_sisters_tree(pjob, IM_POLL_JOB);
+					} else {
+						nwant = pjob->ji_numnodes - 1;
+						nsent = send_sisters(pjob, IM_POLL_JOB, NULL);
+					}
+					if (nsent != nwant) {
 
 						for (num = 0, np = pjob->ji_hosts; num < pjob->ji_numnodes; num++, np++) {
 							if (reliable_job_node_find(&pjob->ji_failed_node_list, np->hn_host) != NULL) {
@@ -8850,6 +9021,11 @@ main(int argc, char *argv[])
 	while ((pjob = (job *) GET_NEXT(mom_deadjobs)) != NULL)
 		job_purge_mom(pjob);
 
+	job_journal_checkpoint(1);
+#ifndef WIN32
+	hook_executor_stop();
+#endif
+
 	{
 		int csret;
 		if ((csret = CS_close_app()) != CS_SUCCESS) {
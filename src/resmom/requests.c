@@ -1075,6 +1075,7 @@ req_modifyjob(struct batch_request *preq)
 			free_attr(job_attr_def, &pattr[i], i);
 			if ((newattr[i].at_type == ATR_TYPE_LIST) ||
 			    (newattr[i].at_type == ATR_TYPE_RESC)) {
+				drop_resc_index(&newattr[i]); /* newattr goes out of scope */
 				list_move(&newattr[i].at_val.at_list,
 					  &(pattr + i)->at_val.at_list);
 			} else {
@@ -3061,14 +3062,10 @@ req_cpyfile(struct batch_request *preq)
 	gid_t usergid = 0;
 	int rc;
 	pid_t pid;
-	struct rqfpair *pair;
-	int rmtflag;
 	cpy_files stage_inout;
-	char *prmt;
 	char dup_rqcpf_jobid[PBS_MAXSVRJOBID + 1];
 	struct work_task *wtask = NULL;
 	int tot_copies = 0;
-	bool copy_failed = FALSE;
 
 #if defined(PBS_SECURITY) && (PBS_SECURITY == KRB5)
 	struct krb_holder *ticket = NULL;
@@ -3229,36 +3226,13 @@ req_cpyfile(struct batch_request *preq)
 	 */
 
 	copy_start = time(0);
-	for (pair = (struct rqfpair *) GET_NEXT(rqcpf->rq_pair);
-	     pair != 0;
-	     pair = (struct rqfpair *) GET_NEXT(pair->fp_link), tot_copies++) {
-		if (copy_failed)
-			continue;
-		DBPRT(("%s: local %s remote %s\n", __func__, pair->fp_local, pair->fp_rmt))
-
-		stage_inout.from_spool = 0;
-		prmt = pair->fp_rmt;
-
-		if (local_or_remote(&prmt) == 0) {
-			/* destination host is this host, use cp */
-			rmtflag = 0;
-		} else {
-			/* destination host is another, use (pbs_)rcp */
-			rmtflag = 1;
-		}
-
-		rc = stage_file(dir, rmtflag, rqcpf->rq_owner,
-				pair, preq->rq_conn, &stage_inout, prmt, rqcpf->rq_jobid);
-		/*
-		 ** Here we break out of the the loop on error.
-		 ** This will only happen on a stagein failure.
-		 */
-		if (rc != 0) {
-			copy_failed = TRUE;
-			continue;
-		}
-		num_copies++;
-	}
+	/*
+	 ** Pairs are staged by up to $stage_workers processes at once.
+	 ** No new pair is started after an error, which will only
+	 ** happen on a stagein failure.
+	 */
+	tot_copies = stage_files(dir, rqcpf->rq_owner, &rqcpf->rq_pair,
+				 preq->rq_conn, &stage_inout, rqcpf->rq_jobid, &num_copies);
 	copy_stop = time(0);
 
 	/* If there was a stage in failure, remove the job directory.
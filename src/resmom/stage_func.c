@@ -51,6 +51,13 @@
 #include <time.h>
 #include <sys/wait.h>
 #include <dirent.h>
+#ifndef WIN32
+#include <poll.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#endif
 #include "tpp.h"
 #include "pbs_ifl.h"
 #include "list_link.h"
@@ -76,6 +83,7 @@ extern size_t cred_len;		/* length of cred buffer */
 #ifndef WIN32
 extern int cred_pipe;
 extern char *pwd_buf;
+extern int write_pipe_data(int, void *, int);
 #endif
 extern char mom_host[PBS_MAXHOSTNAME + 1]; /* MoM host name */
 
@@ -92,6 +100,8 @@ static int sys_copy(int, int, char *, char *, struct rqfpair *, int, char *, cha
 #define PATHCMP strncmp
 #endif
 
+#define STAGE_COPY_CHUNK (8 * 1024 * 1024) /* bytes per copy_file_range/sendfile */
+
 #ifdef WIN32
 /**
  * @brief
@@ -1156,6 +1166,496 @@ error:
 	return rc;
 }
 
+#ifndef WIN32
+/*
+ * A staging worker: a child of the staging process copying one file pair.
+ * It sends its results back on a pipe as a stage_result followed by the
+ * bad file text and the NUL terminated names of the files it staged in.
+ */
+struct stage_result {
+	int sr_rc;		/* return of stage_file() */
+	int sr_bad_files;	/* cpy_files bad_files */
+	int sr_stageout_failed; /* cpy_files stageout_failed */
+	int sr_file_num;	/* number of staged in file names */
+	int sr_bad_len;		/* length of bad file text */
+};
+
+typedef struct stage_worker {
+	pid_t sw_pid;		  /* worker pid, 0 if slot is free */
+	int sw_fd;		  /* read end of the result pipe */
+	int sw_seq;		  /* pair number, for logging */
+	struct rqfpair *sw_pair;  /* pair being staged */
+	struct timeval sw_start;  /* when staging began */
+	char *sw_buf;		  /* result read so far */
+	size_t sw_len;		  /* bytes in sw_buf */
+	size_t sw_size;		  /* size of sw_buf */
+} stage_worker;
+
+/**
+ * @brief
+ *	stage_wild - check if the source of a file pair has a wildcard,
+ *	in which case it may expand into files of other pairs.
+ *
+ * @param[in]	dir	-	direction of copy
+ * @param[in]	pair	-	file pair
+ *
+ * @return	int
+ * @retval	1 - wildcard
+ * @retval	0 - no wildcard
+ */
+static int
+stage_wild(int dir, struct rqfpair *pair)
+{
+	char *src = (dir == STAGE_DIR_OUT) ? pair->fp_local : pair->fp_rmt;
+	char *ps = strrchr(src, '/');
+
+	ps = (ps != NULL) ? ps + 1 : src;
+	return ((strchr(ps, '*') != NULL) || (strchr(ps, '?') != NULL));
+}
+
+/**
+ * @brief
+ *	stage_overlap - check if one path is the other or lies below it.
+ *
+ * @param[in]	a	-	first path
+ * @param[in]	b	-	second path
+ *
+ * @return	int
+ * @retval	1 - paths overlap
+ * @retval	0 - paths are independent
+ */
+static int
+stage_overlap(char *a, char *b)
+{
+	size_t la = strlen(a);
+	size_t lb = strlen(b);
+
+	if (la > lb) {
+		char *t = a;
+
+		a = b;
+		b = t;
+		la = lb;
+	}
+	if (strncmp(a, b, la) != 0)
+		return 0;
+	return ((b[la] == '\0') || (b[la] == '/') || ((la > 0) && (a[la - 1] == '/')));
+}
+
+/**
+ * @brief
+ *	stage_conflict - check if a file pair may be staged while the pairs
+ *	held by busy workers are.  Pairs touching the same local path, or
+ *	the same path on the other side, and pairs with a wildcard source,
+ *	are staged one at a time.
+ *
+ * @param[in]	dir	-	direction of copy
+ * @param[in]	workers	-	worker slots
+ * @param[in]	nworkers -	number of worker slots
+ * @param[in]	pair	-	next file pair
+ *
+ * @return	int
+ * @retval	1 - wait for a worker to finish first
+ * @retval	0 - pair can be staged now
+ */
+static int
+stage_conflict(int dir, stage_worker *workers, int nworkers, struct rqfpair *pair)
+{
+	int wild = stage_wild(dir, pair);
+	int i;
+
+	for (i = 0; i < nworkers; i++) {
+		struct rqfpair *busy = workers[i].sw_pair;
+
+		if (workers[i].sw_pid == 0)
+			continue;
+		if (wild || stage_wild(dir, busy))
+			return 1;
+		if (stage_overlap(busy->fp_local, pair->fp_local) ||
+		    stage_overlap(busy->fp_rmt, pair->fp_rmt))
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * @brief
+ *	stage_one - stage a single file pair and log how long it took.
+ *
+ * @param[in]		dir		-	direction of copy
+ * @param[in]		owner		-	username for owner of copy request
+ * @param[in]		pair		-	file pair
+ * @param[in]		conn		-	socket on which request is received
+ * @param[in/out]	stage_inout	-	pointer to cpy_files struct
+ * @param[in]		jobid		-	job ID
+ *
+ * @return	int
+ * @retval	0 - all OK
+ * @retval	!0 - error
+ */
+static int
+stage_one(int dir, char *owner, struct rqfpair *pair, int conn, cpy_files *stage_inout, char *jobid)
+{
+	char *prmt = pair->fp_rmt;
+	int rmtflag;
+
+	stage_inout->from_spool = 0;
+	/* destination host is this host, use cp, else (pbs_)rcp */
+	rmtflag = (local_or_remote(&prmt) == 0) ? 0 : 1;
+	return (stage_file(dir, rmtflag, owner, pair, conn, stage_inout, prmt, jobid));
+}
+
+/**
+ * @brief
+ *	stage_log - log the outcome and time taken of one file pair.
+ *
+ * @param[in]	dir	-	direction of copy
+ * @param[in]	jobid	-	job ID
+ * @param[in]	seq	-	pair number
+ * @param[in]	total	-	number of pairs
+ * @param[in]	pair	-	file pair
+ * @param[in]	rc	-	return of stage_file()
+ * @param[in]	start	-	when staging of the pair began
+ *
+ * @return	void
+ */
+static void
+stage_log(int dir, char *jobid, int seq, int total, struct rqfpair *pair, int rc, struct timeval *start)
+{
+	struct timeval now;
+	long msecs;
+
+	gettimeofday(&now, NULL);
+	msecs = (now.tv_sec - start->tv_sec) * 1000 +
+		(now.tv_usec - start->tv_usec) / 1000;
+	log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_JOB, LOG_DEBUG, jobid,
+		   "stage%s %d/%d %s %s in %ld.%03ld secs",
+		   (dir == STAGE_DIR_OUT) ? "out" : "in", seq, total,
+		   pair->fp_local, (rc == 0) ? "done" : "failed",
+		   msecs / 1000, msecs % 1000);
+}
+
+/**
+ * @brief
+ *	stage_send_result - send the results of a worker to the staging
+ *	process.
+ *
+ * @param[in]	fd		-	write end of the result pipe
+ * @param[in]	rc		-	return of stage_file()
+ * @param[in]	stage_inout	-	cpy_files struct of the worker
+ *
+ * @return	void
+ */
+static void
+stage_send_result(int fd, int rc, cpy_files *stage_inout)
+{
+	struct stage_result res;
+	int i;
+
+	res.sr_rc = rc;
+	res.sr_bad_files = stage_inout->bad_files;
+	res.sr_stageout_failed = stage_inout->stageout_failed;
+	res.sr_file_num = stage_inout->file_num;
+	res.sr_bad_len = (stage_inout->bad_list != NULL) ? strlen(stage_inout->bad_list) : 0;
+
+	if (write_pipe_data(fd, &res, sizeof(res)) != 0)
+		return;
+	if ((res.sr_bad_len > 0) &&
+	    (write_pipe_data(fd, stage_inout->bad_list, res.sr_bad_len) != 0))
+		return;
+	for (i = 0; i < stage_inout->file_num; i++) {
+		if (write_pipe_data(fd, stage_inout->file_list[i],
+				    strlen(stage_inout->file_list[i]) + 1) != 0)
+			return;
+	}
+}
+
+/**
+ * @brief
+ *	stage_merge - fold the results a worker sent into those of the request.
+ *
+ * @param[in]		sw		-	finished worker
+ * @param[in/out]	stage_inout	-	cpy_files struct of the request
+ *
+ * @return	int
+ * @retval	return of stage_file() in the worker, -1 if results were lost
+ */
+static int
+stage_merge(stage_worker *sw, cpy_files *stage_inout)
+{
+	struct stage_result res;
+	char *p;
+	char *end;
+	char **tmp;
+
+	if ((sw->sw_buf == NULL) || (sw->sw_len < sizeof(res))) {
+		stage_inout->bad_files = 1;
+		add_bad_list(&(stage_inout->bad_list), "Staging worker died copying ", 2);
+		add_bad_list(&(stage_inout->bad_list), sw->sw_pair->fp_local, 0);
+		return -1;
+	}
+	memcpy(&res, sw->sw_buf, sizeof(res));
+	p = sw->sw_buf + sizeof(res);
+	end = sw->sw_buf + sw->sw_len;
+
+	if (res.sr_bad_files)
+		stage_inout->bad_files = 1;
+	if (res.sr_stageout_failed)
+		stage_inout->stageout_failed = TRUE;
+	if ((res.sr_bad_len > 0) && (res.sr_bad_len <= end - p)) {
+		char save = p[res.sr_bad_len];
+
+		p[res.sr_bad_len] = '\0';
+		add_bad_list(&(stage_inout->bad_list), p, 0);
+		p[res.sr_bad_len] = save;
+		p += res.sr_bad_len;
+	}
+	for (; (res.sr_file_num > 0) && (p < end); res.sr_file_num--) {
+		size_t len = strnlen(p, end - p);
+
+		if (len == (size_t) (end - p))
+			break;
+		if (stage_inout->file_max == stage_inout->file_num) {
+			tmp = (char **) realloc(stage_inout->file_list,
+						(stage_inout->file_max + 10) * sizeof(char *));
+			if (tmp == NULL) {
+				log_err(ENOMEM, __func__, "Out of Memory!");
+				break;
+			}
+			stage_inout->file_list = tmp;
+			stage_inout->file_max += 10;
+		}
+		if ((stage_inout->file_list[stage_inout->file_num] = strdup(p)) == NULL) {
+			log_err(ENOMEM, __func__, "Out of Memory!");
+			break;
+		}
+		stage_inout->file_num++;
+		p += len + 1;
+	}
+	return res.sr_rc;
+}
+
+/**
+ * @brief
+ *	stage_reap - wait for one busy worker to finish, log and merge its
+ *	results.
+ *
+ * @param[in]		dir		-	direction of copy
+ * @param[in]		workers		-	worker slots
+ * @param[in]		nworkers	-	number of worker slots
+ * @param[in]		total		-	number of pairs
+ * @param[in/out]	stage_inout	-	cpy_files struct of the request
+ * @param[in]		jobid		-	job ID
+ *
+ * @return	int
+ * @retval	return of stage_file() for the pair the worker staged
+ */
+static int
+stage_reap(int dir, stage_worker *workers, int nworkers, int total, cpy_files *stage_inout, char *jobid)
+{
+	struct pollfd pfd[nworkers];
+	int slot[nworkers];
+	int npfd;
+	int i;
+	int rc;
+	ssize_t n;
+
+	for (;;) {
+		for (i = 0, npfd = 0; i < nworkers; i++) {
+			if (workers[i].sw_pid == 0)
+				continue;
+			pfd[npfd].fd = workers[i].sw_fd;
+			pfd[npfd].events = POLLIN;
+			pfd[npfd].revents = 0;
+			slot[npfd++] = i;
+		}
+		if (poll(pfd, npfd, -1) == -1) {
+			if (errno == EINTR)
+				continue;
+			log_err(errno, __func__, "poll");
+			/* give up on reading, take the first busy worker */
+			i = slot[0];
+			break;
+		}
+		for (i = -1, n = 0; n < npfd; n++) {
+			stage_worker *sw;
+			ssize_t got;
+
+			if (pfd[n].revents == 0)
+				continue;
+			sw = &workers[slot[n]];
+			if (sw->sw_len == sw->sw_size) {
+				char *tmp = realloc(sw->sw_buf, sw->sw_size + 4096);
+
+				if (tmp == NULL) {
+					i = slot[n];
+					break;
+				}
+				sw->sw_buf = tmp;
+				sw->sw_size += 4096;
+			}
+			got = read(sw->sw_fd, sw->sw_buf + sw->sw_len, sw->sw_size - sw->sw_len);
+			if (got > 0)
+				sw->sw_len += got;
+			else if ((got == 0) || (errno != EINTR)) {
+				i = slot[n]; /* end of results */
+				break;
+			}
+		}
+		if (i != -1)
+			break;
+	}
+
+	close(workers[i].sw_fd);
+	while ((waitpid(workers[i].sw_pid, NULL, 0) == -1) && (errno == EINTR))
+		;
+	rc = stage_merge(&workers[i], stage_inout);
+	stage_log(dir, jobid, workers[i].sw_seq, total, workers[i].sw_pair, rc, &workers[i].sw_start);
+	free(workers[i].sw_buf);
+	memset(&workers[i], 0, sizeof(stage_worker));
+	return rc;
+}
+
+/**
+ * @brief
+ *	stage_files - Stage all the file pairs of a copy request.  Up to
+ *	$stage_workers pairs are staged at the same time, each by a child
+ *	process, the others are staged one after another as before.
+ *	Progress and time taken are logged for each pair.
+ *
+ * @param[in]		dir		-	direction of copy
+ * @param[in]		owner		-	username for owner of copy request
+ * @param[in]		pairs		-	list of file pairs
+ * @param[in]		conn		-	socket on which request is received
+ * @param[in/out]	stage_inout	-	pointer to cpy_files struct
+ * @param[in]		jobid		-	job ID
+ * @param[out]		num_copies	-	number of pairs staged
+ *
+ * @return	int
+ * @retval	number of file pairs in the request
+ *
+ * @note
+ *	As before, no new pair is started once one has failed.  On a stage in
+ *	failure all the files staged in are removed.
+ */
+int
+stage_files(int dir, char *owner, pbs_list_head *pairs, int conn, cpy_files *stage_inout, char *jobid, int *num_copies)
+{
+	struct rqfpair *pair;
+	stage_worker *workers = NULL;
+	int nworkers = stage_workers;
+	int total = 0;
+	int seq = 0;
+	int nbusy = 0;
+	int failed = 0;
+	int fds[2];
+	int i;
+	struct timeval start;
+
+	*num_copies = 0;
+	for (pair = (struct rqfpair *) GET_NEXT(*pairs); pair != NULL;
+	     pair = (struct rqfpair *) GET_NEXT(pair->fp_link))
+		total++;
+
+	/* a credential goes down cred_pipe once per copy, keep them in order */
+	if ((cred_pipe != -1) || (total < 2))
+		nworkers = 1;
+	if ((nworkers > 1) &&
+	    ((workers = (stage_worker *) calloc(nworkers, sizeof(stage_worker))) == NULL)) {
+		log_err(errno, __func__, MALLOC_ERR_MSG);
+		nworkers = 1;
+	}
+
+	pair = (struct rqfpair *) GET_NEXT(*pairs);
+	while ((pair != NULL) || (nbusy > 0)) {
+		if ((pair != NULL) && failed) {
+			pair = (struct rqfpair *) GET_NEXT(pair->fp_link);
+			continue;
+		}
+		if ((pair == NULL) || (nbusy == nworkers) ||
+		    ((nbusy > 0) && stage_conflict(dir, workers, nworkers, pair))) {
+			if (stage_reap(dir, workers, nworkers, total, stage_inout, jobid) != 0)
+				failed = 1;
+			else
+				(*num_copies)++;
+			nbusy--;
+			continue;
+		}
+
+		DBPRT(("%s: local %s remote %s\n", __func__, pair->fp_local, pair->fp_rmt))
+		seq++;
+		gettimeofday(&start, NULL);
+		if (nworkers > 1) {
+			for (i = 0; workers[i].sw_pid != 0; i++)
+				;
+			if (pipe(fds) == -1) {
+				log_err(errno, __func__, "pipe");
+			} else if ((workers[i].sw_pid = fork()) == -1) {
+				log_err(errno, __func__, "fork");
+				workers[i].sw_pid = 0;
+				close(fds[0]);
+				close(fds[1]);
+			} else if (workers[i].sw_pid == 0) {
+				cpy_files mine;
+				int rc;
+
+				/* worker: stage the pair, report and be gone */
+				close(fds[0]);
+				memset(&mine, 0, sizeof(mine));
+				mine.sandbox_private = stage_inout->sandbox_private;
+				mine.direct_write = stage_inout->direct_write;
+				rc = stage_one(dir, owner, pair, conn, &mine, jobid);
+				stage_send_result(fds[1], rc, &mine);
+				_exit(0);
+			} else {
+				close(fds[1]);
+				workers[i].sw_fd = fds[0];
+				workers[i].sw_seq = seq;
+				workers[i].sw_pair = pair;
+				workers[i].sw_start = start;
+				nbusy++;
+				pair = (struct rqfpair *) GET_NEXT(pair->fp_link);
+				continue;
+			}
+			/* no worker to be had, stage the pair myself */
+			while (nbusy > 0) {
+				if (stage_reap(dir, workers, nworkers, total, stage_inout, jobid) != 0)
+					failed = 1;
+				else
+					(*num_copies)++;
+				nbusy--;
+			}
+			if (failed)
+				continue;
+		}
+
+		i = stage_one(dir, owner, pair, conn, stage_inout, jobid);
+		stage_log(dir, jobid, seq, total, pair, i, &start);
+		if (i != 0)
+			failed = 1; /* only happens on a stage in failure */
+		else
+			(*num_copies)++;
+		pair = (struct rqfpair *) GET_NEXT(pair->fp_link);
+	}
+
+	if (failed && (workers != NULL) && (dir == STAGE_DIR_IN)) {
+		/* workers only removed their own files, remove the rest */
+		for (i = 0; i < stage_inout->file_num; i++) {
+			DBPRT(("%s: delete %s\n", __func__, stage_inout->file_list[i]))
+			if (remtree(stage_inout->file_list[i]) != 0 && errno != ENOENT) {
+				char temp[80 + MAXPATHLEN];
+
+				sprintf(temp, msg_err_unlink, "stage in", stage_inout->file_list[i]);
+				log_err(errno, "req_cpyfile", temp);
+				add_bad_list(&(stage_inout->bad_list), temp, 2);
+			}
+		}
+	}
+	free(workers);
+	return total;
+}
+#endif /* WIN32 */
+
 /**
  * @brief
  *	rmjobdir - Remove the staging and execution directory and any files
@@ -1397,6 +1897,121 @@ is_pbs_rcp_path(void)
 	return (0);
 }
 #endif
+#ifndef WIN32
+/**
+ * @brief
+ *	local_copy - copy a single regular file on this host without
+ *	running "cp", using copy_file_range() or sendfile() so the data
+ *	does not pass through user space.  Mode and times are kept as
+ *	"cp -p" does.
+ *
+ * @param[in]	from	-	source file
+ * @param[in]	to	-	destination file or directory
+ *
+ * @return	int
+ * @retval	0 - file copied
+ * @retval	-1 - not copied, the caller falls back to "cp"
+ *
+ */
+static int
+local_copy(char *from, char *to)
+{
+	char dest[MAXPATHLEN + 1];
+	char buf[8192];
+	struct stat sb;
+	struct stat db;
+	struct timespec times[2];
+	int how = 0; /* 0 copy_file_range, 1 sendfile, 2 read/write */
+	int fin = -1;
+	int fout = -1;
+	ssize_t n;
+	char *slash;
+
+	if ((lstat(from, &sb) == -1) || !S_ISREG(sb.st_mode))
+		return -1;
+
+	/* as with cp, a directory destination gets the source file name */
+	if ((stat(to, &db) == 0) && S_ISDIR(db.st_mode)) {
+		slash = strrchr(from, '/');
+		if (snprintf(dest, sizeof(dest), "%s/%s", to,
+			     (slash != NULL) ? slash + 1 : from) >= sizeof(dest))
+			return -1;
+	} else
+		pbs_strncpy(dest, to, sizeof(dest));
+
+	if ((fin = open(from, O_RDONLY)) == -1)
+		return -1;
+	if ((fout = open(dest, O_WRONLY | O_CREAT | O_TRUNC, 0600)) == -1) {
+		close(fin);
+		return -1;
+	}
+
+	for (;;) {
+		if (how == 0) {
+#ifdef SYS_copy_file_range
+			n = syscall(SYS_copy_file_range, fin, NULL, fout, NULL,
+				    STAGE_COPY_CHUNK, 0);
+			if ((n == -1) && ((errno == ENOSYS) || (errno == EXDEV) ||
+					  (errno == EINVAL) || (errno == EOPNOTSUPP))) {
+				how = 1;
+				continue;
+			}
+#else
+			how = 1;
+			continue;
+#endif
+		} else if (how == 1) {
+			n = sendfile(fout, fin, NULL, STAGE_COPY_CHUNK);
+			if ((n == -1) && ((errno == ENOSYS) || (errno == EINVAL))) {
+				how = 2;
+				continue;
+			}
+		} else {
+			n = read(fin, buf, sizeof(buf));
+			if (n > 0) {
+				ssize_t w;
+				ssize_t off = 0;
+
+				while (off < n) {
+					if ((w = write(fout, buf + off, n - off)) == -1) {
+						if (errno == EINTR)
+							continue;
+						break;
+					}
+					off += w;
+				}
+				if (off < n)
+					n = -1;
+			}
+		}
+		if (n == 0)
+			break;
+		if ((n == -1) && (errno != EINTR))
+			goto err;
+	}
+
+	times[0] = sb.st_atim;
+	times[1] = sb.st_mtim;
+	if ((fchmod(fout, sb.st_mode & 07777) == -1) ||
+	    (futimens(fout, times) == -1))
+		goto err;
+	close(fin);
+	if (close(fout) == -1) {
+		fout = -1;
+		goto err;
+	}
+	return 0;
+
+err:
+	log_errf(errno, __func__, "copy of %s to %s, trying %s", from, dest,
+		 pbs_conf.cp_path);
+	close(fin);
+	if (fout != -1)
+		close(fout);
+	return -1;
+}
+#endif
+
 /**
  * @brief
  *	sys_copy
@@ -1627,6 +2242,9 @@ sys_copy(int dir, int rmtflg, char *owner, char *src, struct rqfpair *pair, int
 				return (0); /* don't need to copy, just return zero */
 			else
 				ag1 = "-rp";
+			/* a plain file needs no cp process */
+			if ((loop == 1) && (local_copy(ag2, ag3) == 0))
+				return (0);
 
 			/* remote, try scp */
 		} else if (pbs_conf.scp_path != NULL && (loop % 2) == 1) {
@@ -52,7 +52,9 @@
 #include <limits.h>
 #include <assert.h>
 #include <signal.h>
+#include <spawn.h>
 #include <termios.h>
+#include <time.h>
 #include <sys/param.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -99,9 +101,15 @@
 #include "renew_creds.h"
 
 #include "mock_run.h"
+#include "resmon.h"
 
 #define PIPE_READ_TIMEOUT 5
 #define EXTRA_ENV_PTRS 32
+#define LAUNCH_BUCKETS 10 /* buckets of a launch latency histogram */
+
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || ((__GLIBC__ == 2) && (__GLIBC_MINOR__ >= 34)))
+#define SPAWN_CLOSEFROM 1 /* posix_spawn can close all other descriptors */
+#endif
 
 /* Global Variables */
 
@@ -126,6 +134,7 @@ extern time_t time_resc_updated;
 extern char *path_hooks_workdir;
 extern long joinjob_alarm_time;
 extern long job_launch_delay;
+extern int rm_errno;
 int mom_reader_go; /* see catchinter() & mom_writer() */
 
 extern int x11_reader_go;
@@ -174,6 +183,20 @@ char *variables_else[] = {/* variables to add, value computed */
 			  "PBS_ARRAY_ID"};
 
 static int num_var_else = sizeof(variables_else) / sizeof(char *);
+
+/*
+ * Launch latency histograms, index 0 for jobs: from the fork of the job
+ * starter until it reports the session, index 1 for tasks spawned into
+ * a running job.  Bucket i counts launches up to launch_bounds[i] msecs,
+ * the last one all slower launches.
+ */
+static const int launch_bounds[LAUNCH_BUCKETS - 1] = {5, 10, 25, 50, 100, 250, 500, 1000, 2500};
+static struct launch_hist {
+	unsigned long lh_count[LAUNCH_BUCKETS];
+	unsigned long lh_total;
+	double lh_sum; /* msecs */
+	double lh_max; /* msecs */
+} launch_hist[2];
 static void catchinter(int);
 
 extern int is_direct_write(job *, enum job_file, char *, int *);
@@ -1045,10 +1068,185 @@ mkjobdir(char *jobid, char *jobdir, uid_t uid, gid_t gid)
 	return 0;
 }
 
+/**
+ * @brief
+ *	spawn_helper - start a helper program with posix_spawn(), which
+ *	does not copy the address space of MoM the way fork() does.
+ *
+ * @param[in] path - program to run
+ * @param[in] argv - its arguments
+ * @param[in] envp - its environment
+ * @param[in] fd3 - descriptor to hand it as descriptor 3, or -1
+ * @param[in] fd4 - descriptor to hand it as descriptor 4, or -1
+ * @param[in] closeall - close all its other descriptors past stderr
+ *
+ * @return	pid_t
+ * @retval	process id	Success
+ * @retval	-1		Failure, errno set
+ *
+ */
+static pid_t
+spawn_helper(char *path, char **argv, char **envp, int fd3, int fd4, int closeall)
+{
+	posix_spawn_file_actions_t fa;
+	pid_t pid;
+	int rc;
+
+	if ((rc = posix_spawn_file_actions_init(&fa)) != 0) {
+		errno = rc;
+		return -1;
+	}
+	if (fd3 != -1) {
+		posix_spawn_file_actions_adddup2(&fa, fd3, 3);
+		if (fd3 > 3)
+			posix_spawn_file_actions_addclose(&fa, fd3);
+	}
+	if (fd4 != -1) {
+		posix_spawn_file_actions_adddup2(&fa, fd4, 4);
+		if (fd4 > 4)
+			posix_spawn_file_actions_addclose(&fa, fd4);
+	}
+#ifdef SPAWN_CLOSEFROM
+	if (closeall)
+		posix_spawn_file_actions_addclosefrom_np(&fa, (fd4 != -1) ? 5 : ((fd3 != -1) ? 4 : 3));
+#endif
+
+	rc = posix_spawn(&pid, path, &fa, NULL, argv, envp);
+	posix_spawn_file_actions_destroy(&fa);
+	if (rc != 0) {
+		errno = rc;
+		return -1;
+	}
+	return pid;
+}
+
+/**
+ * @brief
+ *	launch_clock - monotonic time, in msecs, for launch latencies.
+ *
+ * @return	double
+ *
+ */
+static double
+launch_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((double) ts.tv_sec * 1000.0 + (double) ts.tv_nsec / 1000000.0);
+}
+
+/**
+ * @brief
+ *	launch_record - add a launch to a launch latency histogram.
+ *
+ * @param[in] which - 0 for a job, 1 for a task
+ * @param[in] start - launch_clock() when the launch began
+ * @param[in] jobid - job id, for logging
+ *
+ * @return	Void
+ *
+ */
+static void
+launch_record(int which, double start, char *jobid)
+{
+	struct launch_hist *lh = &launch_hist[which];
+	double msecs;
+	int i;
+
+	if (start == 0)
+		return;
+	msecs = launch_clock() - start;
+	for (i = 0; i < LAUNCH_BUCKETS - 1; i++) {
+		if (msecs <= launch_bounds[i])
+			break;
+	}
+	lh->lh_count[i]++;
+	lh->lh_total++;
+	lh->lh_sum += msecs;
+	if (msecs > lh->lh_max)
+		lh->lh_max = msecs;
+	log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_JOB, LOG_DEBUG, jobid,
+		   "%s launched in %.1f msecs", (which == 0) ? "job" : "task", msecs);
+}
+
+/**
+ * @brief
+ *	launch_latency - report the launch latency histograms of jobs and
+ *	tasks, as "job count=<n> avg=<ms> max=<ms> le5=<n> ... gt2500=<n>"
+ *	followed by the same for "task".
+ *
+ * @param[in] attrib - pointer to rm_attribute structure
+ *
+ * @return	string
+ * @retval	log_buffer	Success
+ * @retval	NULL		Failure
+ *
+ */
+char *
+launch_latency(struct rm_attribute *attrib)
+{
+	size_t len = 0;
+	int which;
+	int i;
+
+	if (attrib) {
+		log_err(-1, __func__, "extra parameter(s)");
+		rm_errno = RM_ERR_BADPARAM;
+		return NULL;
+	}
+
+	for (which = 0; which < 2; which++) {
+		struct launch_hist *lh = &launch_hist[which];
+
+		len += snprintf(log_buffer + len, sizeof(log_buffer) - len,
+				"%s%s count=%lu avg=%.1f max=%.1f",
+				(which == 0) ? "" : " ", (which == 0) ? "job" : "task",
+				lh->lh_total, lh->lh_total ? lh->lh_sum / lh->lh_total : 0.0,
+				lh->lh_max);
+		for (i = 0; i < LAUNCH_BUCKETS - 1; i++)
+			len += snprintf(log_buffer + len, sizeof(log_buffer) - len,
+					" le%d=%lu", launch_bounds[i], lh->lh_count[i]);
+		len += snprintf(log_buffer + len, sizeof(log_buffer) - len,
+				" gt%d=%lu", launch_bounds[LAUNCH_BUCKETS - 2], lh->lh_count[i]);
+	}
+	return log_buffer;
+}
+
+/**
+ * @brief
+ *	spawn_demux - start pbs_demux beside the shell of a multinode job,
+ *	with the job's stdout and stderr sockets as descriptors 3 and 4.
+ *
+ * @param[in] pjob - pointer to job structure
+ *
+ * @return	pid_t
+ * @retval	process id	Success
+ * @retval	-1		Failure
+ *
+ */
+static pid_t
+spawn_demux(job *pjob)
+{
+	char *arg[2];
+	char *shellname;
+
+	shellname = strrchr(pbs_conf.pbs_demux_path, '/');
+	if (shellname)
+		++shellname; /* go past last '/' */
+	else
+		shellname = pbs_conf.pbs_demux_path;
+	arg[0] = shellname;
+	arg[1] = NULL;
+
+	return (spawn_helper(pbs_conf.pbs_demux_path, arg, pjob->ji_env.v_envp,
+			     pjob->ji_stdout, pjob->ji_stderr, 0));
+}
+
 /**
  * @brief
  * 	rmtmpdir - remove the temporary directory
- *	This may take awhile so the task is forked and execed to another
+ *	This may take awhile so it is handed to another
  *	process.
  *
  * @param[in] jobid - job id
@@ -1062,7 +1260,6 @@ rmtmpdir(char *jobid)
 {
 	static char rmdir[MAXPATHLEN + 1];
 	struct stat sb;
-	pid_t pid;
 	char *rm = "/bin/rm";
 	char *rf = "-rf";
 	char *tmpdir;
@@ -1088,20 +1285,34 @@ rmtmpdir(char *jobid)
 		newdir = tmpdir;
 	}
 
-	/* fork and exec the cleantmp process */
-	pid = fork();
-	if (pid < 0) {
-		log_err(errno, __func__, "fork");
+#ifdef SPAWN_CLOSEFROM
+	/* spawn the cleantmp process, it needs none of our descriptors */
+	{
+		char *args[] = {"pbs_cleandir", rf, newdir, NULL};
+
+		if (spawn_helper(rm, args, environ, -1, -1, 1) == -1)
+			log_err(errno, __func__, "posix_spawn");
 		return;
 	}
+#else
+	/* fork and exec the cleantmp process */
+	{
+		pid_t pid = fork();
 
-	if (pid > 0) /* parent */
-		return;
+		if (pid < 0) {
+			log_err(errno, __func__, "fork");
+			return;
+		}
+
+		if (pid > 0) /* parent */
+			return;
 
-	tpp_terminate();
-	execl(rm, "pbs_cleandir", rf, newdir, NULL);
-	log_err(errno, __func__, "execl");
-	exit(21);
+		tpp_terminate();
+		execl(rm, "pbs_cleandir", rf, newdir, NULL);
+		log_err(errno, __func__, "execl");
+		exit(21);
+	}
+#endif
 }
 
 /**
@@ -1821,6 +2032,7 @@ record_finish_exec(int sd)
 	enqueue_update_for_send(pjob, IS_RESCUSED);
 	next_sample_time = min_check_poll;
 	log_eventf(PBSEVENT_JOB, PBS_EVENTCLASS_JOB, LOG_INFO, pjob->ji_qs.ji_jobid, "Started, pid = %d", sjr.sj_session);
+	launch_record(0, pjob->ji_launch_start, pjob->ji_qs.ji_jobid);
 
 	return;
 }
@@ -3127,9 +3339,18 @@ finish_exec(job *pjob)
 	set_jattr_l_slim(pjob, JOB_ATR_stime, time_now, SET);
 	pjob->ji_sampletim = time_now;
 
+	/* put the job in its own cgroup if MoM manages them */
+	if (cgroup_job_create(pjob) == -1) {
+		exec_bail(pjob, JOB_EXEC_RETRY, log_buffer);
+		return;
+	}
+
 	/*
 	 * Fork the child process that will become the job.
+	 * It is a copy of MoM since the setup below works on the job
+	 * as MoM holds it in memory; only helpers use spawn_helper().
 	 */
+	pjob->ji_launch_start = launch_clock();
 	cpid = fork_me(-1);
 	if (cpid > 0) {
 		conn_t *conn = NULL;
@@ -4410,7 +4631,7 @@ finish_exec(job *pjob)
 	starter_return(upfds, downfds, JOB_EXEC_OK, &sjr);
 	log_close(0);
 
-	if ((pjob->ji_numnodes == 1) || nodemux || ((cpid = fork()) > 0)) {
+	if ((pjob->ji_numnodes == 1) || nodemux || (spawn_demux(pjob) != -1)) {
 		/* parent does the shell */
 		FILE *f;
 
@@ -4522,35 +4743,8 @@ finish_exec(job *pjob)
 		free_str_array(hook_output.env);
 		free_str_array(the_env);
 		the_env = NULL;
-	} else if (cpid == 0) { /* child does demux */
-		char *arg[2];
-		char *shellname;
-
-		/* setup descriptors 3 and 4 */
-		(void) dup2(pjob->ji_stdout, 3);
-		if (pjob->ji_stdout > 3)
-			close(pjob->ji_stdout);
-		(void) dup2(pjob->ji_stderr, 4);
-		if (pjob->ji_stderr > 4)
-			close(pjob->ji_stderr);
-
-		/* construct argv array */
+	} else
 		shell = pbs_conf.pbs_demux_path;
-		shellname = strrchr(shell, '/');
-		if (shellname)
-			++shellname; /* go past last '/' */
-		else
-			shellname = shell;
-		arg[0] = shellname;
-		arg[1] = NULL;
-
-		/* we're purposely not calling log_close() here */
-		/* for this causes a side-effect. log_close() would */
-		/* do an fclose(<logfile>), but its file position */
-		/* is still shared with the parent mom, which */
-		/* could be writing to the <logfile>. */
-		execve(shell, arg, pjob->ji_env.v_envp);
-	}
 	fprintf(temp_stderr, "pbs_mom, exec of %s failed with error: %s\n",
 		shell, strerror(errno));
 	exit(254); /* should never, ever get here */
@@ -4580,6 +4774,7 @@ start_process(task *ptask, char **argv, char **envp, bool nodemux)
 	int ebsize;
 	char buf[MAXPATHLEN + 2];
 	pid_t pid;
+	double launch_start;
 	int pipes[2], kid_read, kid_write, parent_read, parent_write;
 	int pts;
 	int i, j, k;
@@ -4648,9 +4843,16 @@ start_process(task *ptask, char **argv, char **envp, bool nodemux)
 		ipaddr = ap->sin_addr.s_addr;
 	}
 
+	/* a sister's first task creates the job cgroup */
+	if (cgroup_job_create(pjob) == -1) {
+		log_joberr(-1, __func__, log_buffer, pjob->ji_qs.ji_jobid);
+		return PBSE_SYSTEM;
+	}
+
 	/*
 	 ** Begin a new process for the fledgling task.
 	 */
+	launch_start = launch_clock();
 	if ((pid = fork_me(-1)) == -1)
 		return PBSE_SYSTEM;
 	else if (pid != 0) { /* parent */
@@ -4705,6 +4907,7 @@ start_process(task *ptask, char **argv, char **envp, bool nodemux)
 			       ptask->ti_qs.ti_task, argv[0]);
 		log_event(PBSEVENT_JOB, PBS_EVENTCLASS_JOB, LOG_INFO,
 			  pjob->ji_qs.ji_jobid, log_buffer);
+		launch_record(1, launch_start, pjob->ji_qs.ji_jobid);
 
 		return PBSE_NONE;
 	}
@@ -6049,6 +6252,7 @@ start_exec(job *pjob)
 		int nodemux = 0;
 		int mtfd = -1;
 		int com;
+		tm_task_id treetask;
 
 		pjob->ji_resources = (noderes *) calloc(nodenum - 1,
 							sizeof(noderes));
@@ -6220,12 +6424,17 @@ start_exec(job *pjob)
 			pjob->ji_extended.ji_ext.ji_stderr = pjob->ji_ports[1];
 		}
 
+		/*
+		 * A wide job may have its JOIN acks gathered up a fanout
+		 * tree, the fanout rides along as the JOIN taskid.
+		 */
+		treetask = (com == IM_JOIN_JOB) ? sister_tree_setup(pjob) : TM_NULL_TASK;
 		for (i = 1; i < nodenum; i++) {
 			np = &pjob->ji_hosts[i];
 
 			if (i == 1)
 				ep = event_alloc(pjob, com, -1, np,
-						 TM_NULL_EVENT, TM_NULL_TASK);
+						 TM_NULL_EVENT, treetask);
 			else
 				ep = event_dup(ep, pjob, np);
 
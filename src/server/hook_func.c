@@ -79,6 +79,7 @@
  * find_mom_hook_action
  * add_pending_mom_hook_action
  * delete_pending_mom_hook_action
+ * drop_synced_mom_hook_action
  * has_pending_mom_action_delete
  * sync_mom_hookfiles_count
  * collapse_hook_tr
@@ -5303,6 +5304,49 @@ delete_pending_mom_hook_action(void *minfo, char *hookname,
 	}
 }
 
+/**
+ * @brief
+ *		Drops the pending send actions of 'hookname' for the mom in 'minfo'
+ *		whose content the mom already has, going by the checksums the mom
+ *		reported. This keeps a mom that reconnects with up to date hooks
+ *		from being sent the same files again. Actions already sent and
+ *		awaiting a reply are left alone.
+ *
+ * @param[in]	minfo		- the mom that reported its hook checksums
+ * @param[in]	hookname	- name of hook with matching checksums
+ * @param[in] 	action		- the send actions whose content matched
+ *				(MOM_HOOK_ACTION_SEND_ATTRS,
+ *				MOM_HOOK_ACTION_SEND_SCRIPT, etc...)
+ *
+ * @return void
+ */
+void
+drop_synced_mom_hook_action(void *minfo, char *hookname, unsigned int action)
+{
+	mom_svrinfo_t *psvrmom;
+	mom_hook_action_t *pact;
+
+	if ((minfo == NULL) || (hookname == NULL))
+		return;
+
+	psvrmom = (mom_svrinfo_t *) ((mominfo_t *) minfo)->mi_data;
+	if (psvrmom == NULL)
+		return;
+
+	pact = find_mom_hook_action(psvrmom->msr_action, psvrmom->msr_num_action, hookname);
+	if (pact == NULL)
+		return;
+
+	action &= (pact->action & ~pact->reply_expected);
+	if (action == 0)
+		return;
+
+	log_eventf(PBSEVENT_DEBUG3, PBS_EVENTCLASS_HOOK, LOG_INFO, hookname,
+		   "mom %s already has matching content, dropping pending action %u",
+		   ((mominfo_t *) minfo)->mi_host, action);
+	delete_pending_mom_hook_action(minfo, hookname, action);
+}
+
 /**
  * @brief
  *		Determines if 'hookname' has a pending MOM_HOOK_ACTION_DELETE to
@@ -349,6 +349,7 @@ job_alloc(void)
 	pj->ji_stdout = 0;
 	pj->ji_stderr = 0;
 	pj->ji_setup = NULL;
+	pj->ji_tree = NULL;
 	pj->ji_momsubt = 0;
 	pj->ji_msconnected = 0;
 	CLEAR_HEAD(pj->ji_multinodejobs);
@@ -548,6 +549,7 @@ job_free(job *pj)
 
 	reliable_job_node_free(&pj->ji_failed_node_list);
 	reliable_job_node_free(&pj->ji_node_list);
+	sister_tree_free(pj);
 
 	if (pj->ji_bg_hook_task) {
 		mom_process_hooks_params_t *php;
@@ -1109,6 +1111,12 @@ job_purge(job *pjob)
 
 #ifdef PBS_MOM
 
+	/* journaled updates of the job must not outlive its files */
+	job_journal_purge(pjob);
+
+	/* remove the job cgroup created by $cgroup_manager */
+	cgroup_job_remove(pjob);
+
 	/* on the mom end, perform file-system related cleanup in a forked process
 	 * only if job is executed successfully with exit status 0(JOB_EXEC_OK)
 	 */
@@ -1549,7 +1557,7 @@ update_resources_list(job *pjob, char *res_list_name,
 		while (pr != NULL) {
 			next = (resource *) GET_NEXT(pr->rs_link);
 			if (pr->rs_defin->rs_flags & (ATR_DFLAG_RASSN | ATR_DFLAG_FNASSN | ATR_DFLAG_ANASSN)) {
-				delete_link(&pr->rs_link);
+				unlink_resc_entry(get_jattr(pjob, res_list_index), pr);
 				if (pr->rs_value.at_flags & ATR_VFLAG_INDIRECT)
 					free_str(&pr->rs_value);
 				else
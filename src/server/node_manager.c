@@ -352,6 +352,87 @@ reply_hellosvr(int stream, int need_inv)
 	return dis_flush(stream);
 }
 
+/**
+ * @brief Reply to IS_HELLOSVR for the moms whose inventory is needed and
+ * the other moms in one multicast, with the mom ip addresses sent only once
+ * and only the need inventory flag differing per mom.
+ *
+ * @param[in] mtfd_inv - mcast channel of the moms whose inventory is needed
+ * @param[in] mtfd_noinv - mcast channel of the other moms
+ *
+ * @return int
+ * @retval DIS_SUCCESS (0) for success
+ * @retval DIS_NOCOMMIT if nothing was sent, reply on each channel instead
+ * @retval != 0 otherwise.
+ */
+static int
+reply_hellosvr_scatter(int mtfd_inv, int mtfd_noinv)
+{
+	int chans[2] = {mtfd_inv, mtfd_noinv};
+	int count[2] = {0, 0};
+	char *prefix[2] = {NULL, NULL};
+	size_t prefix_len[2];
+	char **prefixes = NULL;
+	size_t *prefix_lens = NULL;
+	int *strms;
+	int nmembers;
+	int mtfd;
+	int ret = DIS_NOCOMMIT;
+	int i, j;
+
+	if ((mtfd = tpp_mcast_open()) == -1)
+		return DIS_NOCOMMIT;
+
+	/* moms whose inventory is needed come first, then the others */
+	for (i = 0; i < 2; i++) {
+		strms = tpp_mcast_members(chans[i], &count[i]);
+		for (j = 0; j < count[i]; j++) {
+			if (tpp_mcast_add_strm(mtfd, strms[j], FALSE) == -1)
+				goto done;
+		}
+	}
+	nmembers = count[0] + count[1];
+
+	for (i = 0; i < 2; i++) {
+		if (is_compose(mtfd, IS_REPLYHELLO) != DIS_SUCCESS || diswsi(mtfd, i == 0) != DIS_SUCCESS)
+			goto done;
+		if ((prefix[i] = dis_take_writebuf(mtfd, &prefix_len[i])) == NULL)
+			goto done;
+	}
+
+	prefixes = malloc(sizeof(char *) * nmembers);
+	prefix_lens = malloc(sizeof(size_t) * nmembers);
+	if (prefixes == NULL || prefix_lens == NULL)
+		goto done;
+	for (j = 0; j < nmembers; j++) {
+		i = (j < count[0]) ? 0 : 1;
+		prefixes[j] = prefix[i];
+		prefix_lens[j] = prefix_len[i];
+	}
+
+	if (send_ip_addrs_to_mom(mtfd, 1) != DIS_SUCCESS)
+		goto done;
+
+	switch (dis_flush_scatter(mtfd, nmembers, prefixes, prefix_lens)) {
+		case 0:
+			ret = DIS_SUCCESS;
+			break;
+		case -1:
+			ret = DIS_PROTO;
+			break;
+		default:
+			break;
+	}
+
+done:
+	tpp_mcast_close(mtfd);
+	free(prefix[0]);
+	free(prefix[1]);
+	free(prefixes);
+	free(prefix_lens);
+	return ret;
+}
+
 /**
  * @brief
  *  	delete node with given key
@@ -3115,12 +3196,20 @@ mcast_msg(struct work_task *ptask)
 			break;
 
 		case IS_REPLYHELLO:
-			if (mtfd_replyhello != -1)
-				if ((ret = reply_hellosvr(mtfd_replyhello, 1)) != DIS_SUCCESS)
-					close_streams(mtfd_replyhello, ret);
-			if (mtfd_replyhello_noinv != -1)
-				if ((ret = reply_hellosvr(mtfd_replyhello_noinv, 0)) != DIS_SUCCESS)
-					close_streams(mtfd_replyhello_noinv, ret);
+			ret = DIS_NOCOMMIT;
+			if (pbs_conf.pbs_mcast_scatter && mtfd_replyhello != -1 && mtfd_replyhello_noinv != -1)
+				ret = reply_hellosvr_scatter(mtfd_replyhello, mtfd_replyhello_noinv);
+			if (ret == DIS_NOCOMMIT) {
+				if (mtfd_replyhello != -1)
+					if ((ret = reply_hellosvr(mtfd_replyhello, 1)) != DIS_SUCCESS)
+						close_streams(mtfd_replyhello, ret);
+				if (mtfd_replyhello_noinv != -1)
+					if ((ret = reply_hellosvr(mtfd_replyhello_noinv, 0)) != DIS_SUCCESS)
+						close_streams(mtfd_replyhello_noinv, ret);
+			} else if (ret != DIS_SUCCESS) {
+				close_streams(mtfd_replyhello, ret);
+				close_streams(mtfd_replyhello_noinv, ret);
+			}
 
 			tpp_mcast_close(mtfd_replyhello);
 			tpp_mcast_close(mtfd_replyhello_noinv);
@@ -3630,6 +3719,8 @@ update2_to_vnode(vnal_t *pvnal, int new, mominfo_t *pmom, int *madenew, int from
 						extern int resc_access_perm;
 						int perms = resc_access_perm;
 						resc_access_perm |= ATR_PERM_ALLOW_INDIRECT;
+						if ((prs->rs_value.at_flags & ATR_VFLAG_INDIRECT) == 0)
+							prdef->rs_free(&prs->rs_value);
 						bad = decode_str(&prs->rs_value, psrp->vna_name, resc, psrp->vna_val);
 						resc_access_perm = perms;
 						if (bad == 0) {
@@ -4617,9 +4708,7 @@ found:
 				if (prc == NULL)
 					prc = add_resource_entry(pala, prd);
 				if (!is_attr_set(&prc->rs_value)) {
-					if (is_attr_set(&prc->rs_value))
-						free(prc->rs_value.at_val.at_str);
-					prc->rs_value.at_val.at_str = strdup(psvrmom->msr_arch);
+					prd->rs_decode(&prc->rs_value, NULL, NULL, psvrmom->msr_arch);
 					prc->rs_value.at_flags |= (ATR_SET_MOD_MCACHE | ATR_VFLAG_DEFLT);
 				}
 
@@ -5104,6 +5193,20 @@ found:
 								    hname, haction);
 				}
 
+				/* no need to resend what the mom already has */
+				haction = 0;
+				if ((phook->hook_control_checksum > 0) &&
+				    (phook->hook_control_checksum == chksum_hk))
+					haction |= MOM_HOOK_ACTION_SEND_ATTRS;
+				if ((phook->hook_script_checksum > 0) &&
+				    (phook->hook_script_checksum == chksum_py))
+					haction |= MOM_HOOK_ACTION_SEND_SCRIPT;
+				if ((phook->hook_config_checksum > 0) &&
+				    (phook->hook_config_checksum == chksum_cf))
+					haction |= MOM_HOOK_ACTION_SEND_CONFIG;
+				if (haction != 0)
+					drop_synced_mom_hook_action(pmom, hname, haction);
+
 				if (add_to_svrattrl_list(&reported_hooks, hname,
 							 NULL, NULL, 0, NULL) == -1) {
 					log_event(PBSEVENT_DEBUG3,
@@ -5139,7 +5242,9 @@ found:
 				add_pending_mom_hook_action(pmom,
 							    PBS_RESCDEF,
 							    MOM_HOOK_ACTION_SEND_RESCDEF);
-			}
+			} else if (hook_rescdef_checksum > 0)
+				drop_synced_mom_hook_action(pmom, PBS_RESCDEF,
+							    MOM_HOOK_ACTION_SEND_RESCDEF);
 
 			/* Look for mom hooks known to the server that are */
 			/* not known to the mom sending the request. */
@@ -640,7 +640,7 @@ pbsd_init(int type)
 	 * 8A. If not a "create" initialization, recover queues.
 	 *    If a create, remove any queues that might be there.
 	 */
-	if ((queues_idx = pbs_idx_create(0, 0)) == NULL) {
+	if ((queues_idx = pbs_idx_create(PBS_IDX_HASH, 0)) == NULL) {
 		log_err(-1, __func__, "Creating queue index failed!");
 		return (-1);
 	}
@@ -682,7 +682,7 @@ pbsd_init(int type)
 	set_ical_zoneinfo(zone_dir);
 
 	/* load reservations */
-	if ((resvs_idx = pbs_idx_create(0, 0)) == NULL) {
+	if ((resvs_idx = pbs_idx_create(PBS_IDX_HASH, 0)) == NULL) {
 		log_err(-1, __func__, "Creating reservations index failed!");
 		return (-1);
 	}
@@ -704,7 +704,7 @@ pbsd_init(int type)
 	 *    If a create or clean recovery, delete any jobs.
 	 *    Before job creation/recovery, create the jobs index.
 	 */
-	if ((jobs_idx = pbs_idx_create(0, 0)) == NULL) {
+	if ((jobs_idx = pbs_idx_create(PBS_IDX_HASH, 0)) == NULL) {
 		log_err(-1, __func__, "Creating jobs index failed!");
 		return (-1);
 	}
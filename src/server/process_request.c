@@ -256,6 +256,24 @@ req_authenticate(conn_t *conn, struct batch_request *request)
 	if (strcmp(request->rq_ind.rq_auth.rq_auth_method, AUTH_RESVPORT_NAME) == 0) {
 		transport_chan_set_ctx_status(cp->cn_sock, AUTH_STATUS_CTX_READY, FOR_AUTH);
 	}
+
+	/*
+	 * client offered binary integers for its own connection, acknowledge
+	 * with the encoding in auxcode (old clients never offer, old servers
+	 * reply with auxcode 0) and switch after the reply went out in text
+	 */
+	if (cp == conn && request->rq_extend != NULL && strstr(request->rq_extend, PBS_EXTEND_DIS_BINARY) != NULL) {
+		int sock = conn->cn_sock;
+
+		if (request->rq_reply.brp_choice != BATCH_REPLY_CHOICE_NULL)
+			reply_free(&request->rq_reply);
+		request->rq_reply.brp_choice = BATCH_REPLY_CHOICE_NULL;
+		request->rq_reply.brp_code = PBSE_NONE;
+		request->rq_reply.brp_auxcode = DIS_ENC_BINARY;
+		if (reply_send(request) == 0)
+			dis_set_encoding(sock, DIS_ENC_BINARY);
+		return;
+	}
 	reply_ack(request);
 }
 
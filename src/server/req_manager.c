@@ -1017,7 +1017,7 @@ mgr_unset_attr(attribute *pattr, void *pidx, attribute_def *pdef, int limit, svr
 					}
 					prsdef->rs_free(&presc->rs_value);
 				}
-				delete_link(&presc->rs_link);
+				unlink_resc_entry(pattr + index, presc);
 				free(presc);
 				presc = NULL;
 			}
@@ -2788,7 +2788,7 @@ create_pbs_node2(char *objname, svrattrl *plist, int perms, int *bad, struct pbs
 
 		/* create node index if not already done */
 		if (node_idx == NULL) {
-			if ((node_idx = pbs_idx_create(0, 0)) == NULL) {
+			if ((node_idx = pbs_idx_create(PBS_IDX_HASH, 0)) == NULL) {
 				svr_totnodes--;
 				free_pnode(pnode);
 				return (PBSE_SYSTEM);
@@ -4271,7 +4271,7 @@ mgr_resource_unset(struct batch_request *preq)
 				if (i == SVR_ATR_resource_assn) {
 					if (pattr->at_flags & ATR_VFLAG_SET) {
 						presc->rs_defin->rs_free(&presc->rs_value);
-						delete_link(&presc->rs_link);
+						unlink_resc_entry(pattr, presc);
 						free(presc);
 						presc = (resource *) GET_NEXT(get_attr_list(pattr));
 						if (presc == NULL)
@@ -4298,7 +4298,7 @@ mgr_resource_unset(struct batch_request *preq)
 			q_attr = get_qattr(pq_list[q_count], QE_ATR_ResourceAssn);
 			presc = get_resource(q_attr, prdef);
 			presc->rs_defin->rs_free(&presc->rs_value);
-			delete_link(&presc->rs_link);
+			unlink_resc_entry(q_attr, presc);
 			free(presc);
 			presc = (resource *) GET_NEXT(q_attr->at_val.at_list);
 			if (presc == NULL)
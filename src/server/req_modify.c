@@ -592,6 +592,7 @@ modify_job_attr(job *pjob, svrattrl *plist, int perm, int *bad)
 			free_attr(job_attr_def, &pattr[i], i);
 			if ((pre_copy[i].at_type == ATR_TYPE_LIST) ||
 			    (pre_copy[i].at_type == ATR_TYPE_RESC)) {
+				drop_resc_index(&pre_copy[i]); /* pre_copy is freed below */
 				list_move(&pre_copy[i].at_val.at_list,
 					  &pattr[i].at_val.at_list);
 			} else {
@@ -646,6 +647,7 @@ modify_job_attr(job *pjob, svrattrl *plist, int perm, int *bad)
 				default:
 					if ((newattr[i].at_type == ATR_TYPE_LIST) ||
 					    (newattr[i].at_type == ATR_TYPE_RESC)) {
+						drop_resc_index(&newattr[i]); /* newattr is freed below */
 						list_move(&newattr[i].at_val.at_list,
 							  &pattr[i].at_val.at_list);
 					} else {
@@ -1378,6 +1380,7 @@ modify_resv_attr(resc_resv *presv, svrattrl *plist, int perm, int *bad)
 		if (newattr[i].at_flags & ATR_VFLAG_MODIFY) {
 			resv_attr_def[i].at_free(pattr + i);
 			if ((newattr[i].at_type == ATR_TYPE_LIST) || (newattr[i].at_type == ATR_TYPE_RESC)) {
+				drop_resc_index(&newattr[i]); /* newattr goes out of scope */
 				list_move(&newattr[i].at_val.at_list, &(pattr + i)->at_val.at_list);
 			} else {
 				*(pattr + i) = newattr[i];
@@ -2743,7 +2743,7 @@ get_queue_for_reservation(resc_resv *presv)
 		prdef = find_resc_def(svr_resc_def, dont_set_in_max[i].ds_name);
 		dont_set_in_max[i].ds_rescp = find_resc_entry(pattr, prdef);
 		if (dont_set_in_max[i].ds_rescp)
-			delete_link(&dont_set_in_max[i].ds_rescp->rs_link);
+			unlink_resc_entry(pattr, dont_set_in_max[i].ds_rescp);
 	}
 
 	rc = resv_attr_def[RESV_ATR_resource].at_encode(pattr, plhed,
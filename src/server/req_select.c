@@ -89,6 +89,7 @@ static void free_sellist(struct select_list *pslist);
 static int sel_attr(attribute *, struct select_list *);
 static int select_job(job *, struct select_list *, int, int);
 static int select_subjob(char, struct select_list *);
+static int selstat_job(struct batch_request *, job *, int, char *, stat_page_t *, int *);
 
 /**
  * @brief
@@ -331,6 +332,7 @@ req_selectjobs(struct batch_request *preq)
 	int rc;
 	struct select_list *selistp;
 	pbs_sched *psched;
+	stat_page_t page;
 
 	if (preq->rq_extend != NULL) {
 		/*
@@ -339,9 +341,9 @@ req_selectjobs(struct batch_request *preq)
 		 * if the letter S is in the extend string, select real jobs,
 		 * regualar and running subjobs as it is requested by the Scheduler.
 		 */
-		if (strchr(preq->rq_extend, 'T') || strchr(preq->rq_extend, 't'))
+		if (stat_extend_flag(preq->rq_extend, 'T') || stat_extend_flag(preq->rq_extend, 't'))
 			dosubjobs = 1;
-		else if (strchr(preq->rq_extend, 'S'))
+		else if (stat_extend_flag(preq->rq_extend, 'S'))
 			dosubjobs = 2;
 		/*
 		 * If the letter x is in the extend string, Check if the server is
@@ -349,7 +351,7 @@ req_selectjobs(struct batch_request *preq)
 		 * then return with PBSE_JOBHISTNOTSET error. Otherwise select history
 		 * jobs also.
 		 */
-		if (strchr(preq->rq_extend, 'x')) {
+		if (stat_extend_flag(preq->rq_extend, 'x')) {
 			if (svr_history_enable == 0) {
 				req_reject(PBSE_JOBHISTNOTSET, 0, preq);
 				return;
@@ -358,6 +360,13 @@ req_selectjobs(struct batch_request *preq)
 		}
 	}
 
+	/* sort, limit and offset only apply to the Select-status reply */
+	rc = parse_stat_page(preq->rq_type == PBS_BATCH_SelStat ? preq->rq_extend : NULL, preq->rq_perm, &page);
+	if (rc != PBSE_NONE) {
+		req_reject(rc, 0, preq);
+		return;
+	}
+
 	/*
 	 * The first selstat() call from the scheduler indicates that a cycle
 	 * is in progress and has reached the point of querying for jobs.
@@ -420,30 +429,17 @@ req_selectjobs(struct batch_request *preq)
 
 					/* Select-Status Reply */
 
-					plist = (svrattrl *) GET_NEXT(preq->rq_ind.rq_select.rq_rtnattr);
-					if (dosubjobs == 1 && pjob->ji_ajinfo) {
-						for (i = pjob->ji_ajinfo->tkm_start; i <= pjob->ji_ajinfo->tkm_end; i += pjob->ji_ajinfo->tkm_step) {
-							char sjst = JOB_STATE_LTR_QUEUED;
-
-							get_subjob_and_state(pjob, i, &sjst, NULL);
-							if (sjst == JOB_STATE_LTR_UNKNOWN)
-								continue;
-							if (pstate == 0 || chk_job_statenum(sjst, pstate)) {
-								if (preply->brp_count >= MAX_JOBS_PER_REPLY) {
-									rc = reply_send_status_part(preq);
-									if (rc != PBSE_NONE)
-										return;
-									preply->brp_count = 0;
-								}
-								rc = status_subjob(pjob, preq, plist, i, &preply->brp_un.brp_status, &bad, 0);
-								if (rc && rc != PBSE_PERM)
-									goto out;
-								plist = (svrattrl *) GET_NEXT(preq->rq_ind.rq_select.rq_rtnattr);
-							}
-						}
-					} else {
-						rc = status_job(pjob, preq, plist, &preply->brp_un.brp_status, &bad, 0);
-						if (rc && rc != PBSE_PERM)
+					if (page.sp_sort_idx != -1) {
+						/* status after all are collected and sorted */
+						if ((rc = stat_page_add(&page, pjob)) != PBSE_NONE)
+							goto out;
+					} else if (page.sp_active && stat_page_full(&page))
+						break;
+					else {
+						rc = selstat_job(preq, pjob, dosubjobs, pstate, page.sp_active ? &page : NULL, &bad);
+						if (rc == -1)
+							goto gone;
+						else if (rc != PBSE_NONE)
 							goto out;
 					}
 				}
@@ -456,15 +452,98 @@ req_selectjobs(struct batch_request *preq)
 		if (preq->rq_type != PBS_BATCH_SelectJobs && preply->brp_count >= MAX_JOBS_PER_REPLY && pjob) {
 			rc = reply_send_status_part(preq);
 			if (rc != PBSE_NONE)
-				return;
+				goto gone;
+		}
+	}
+
+	if (page.sp_sort_idx != -1) {
+		stat_page_sort(&page);
+		for (i = 0; i < page.sp_njobs && !stat_page_full(&page); i++) {
+			if (preply->brp_count >= MAX_JOBS_PER_REPLY) {
+				rc = reply_send_status_part(preq);
+				if (rc != PBSE_NONE)
+					goto gone;
+			}
+			rc = selstat_job(preq, page.sp_jobs[i].se_job, dosubjobs, pstate, &page, &bad);
+			if (rc == -1)
+				goto gone;
+			else if (rc != PBSE_NONE)
+				goto out;
 		}
 	}
 out:
+	free_stat_page(&page);
 	free_sellist(selistp);
 	if (rc)
 		req_reject(rc, 0, preq);
 	else
 		reply_send(preq);
+	return;
+
+gone:
+	/* a partial reply could not be sent, the connection is closed */
+	free_stat_page(&page);
+	free_sellist(selistp);
+}
+
+/**
+ * @brief
+ * 		selstat_job - add the status of a selected job to the Select-status
+ *		reply, or with dosubjobs the status of each of its subjobs in pstate
+ *
+ * @param[in,out]	preq	-	Select-status Job Request, reply updated
+ * @param[in]	pjob	-	selected job
+ * @param[in]	dosubjobs	-	expand an Array job into its subjobs
+ * @param[in]	pstate	-	job states selected, NULL for any
+ * @param[in,out]	pg	-	paging control, NULL if not paging, each
+ *				subjob counts against the offset and limit
+ * @param[out]	bad	-	index of first bad attribute
+ *
+ * @return	int
+ * @retval	PBSE_NONE	: success
+ * @retval	-1	: a partial reply could not be sent
+ * @retval	other	: PBS error code to reject the request with
+ */
+static int
+selstat_job(struct batch_request *preq, job *pjob, int dosubjobs, char *pstate, stat_page_t *pg, int *bad)
+{
+	struct batch_reply *preply = &preq->rq_reply;
+	svrattrl *plist;
+	int rc;
+	int i;
+	int admit;
+
+	plist = (svrattrl *) GET_NEXT(preq->rq_ind.rq_select.rq_rtnattr);
+	if (dosubjobs == 1 && pjob->ji_ajinfo) {
+		for (i = pjob->ji_ajinfo->tkm_start; i <= pjob->ji_ajinfo->tkm_end; i += pjob->ji_ajinfo->tkm_step) {
+			char sjst = JOB_STATE_LTR_QUEUED;
+
+			get_subjob_and_state(pjob, i, &sjst, NULL);
+			if (sjst == JOB_STATE_LTR_UNKNOWN)
+				continue;
+			if (pstate == 0 || chk_job_statenum(sjst, pstate)) {
+				if (pg != NULL && (admit = stat_page_admit(pg)) <= 0) {
+					if (admit < 0)
+						break;
+					continue;
+				}
+				if (preply->brp_count >= MAX_JOBS_PER_REPLY) {
+					if (reply_send_status_part(preq) != PBSE_NONE)
+						return -1;
+					preply->brp_count = 0;
+				}
+				rc = status_subjob(pjob, preq, plist, i, &preply->brp_un.brp_status, bad, 0);
+				if (rc && rc != PBSE_PERM)
+					return rc;
+				plist = (svrattrl *) GET_NEXT(preq->rq_ind.rq_select.rq_rtnattr);
+			}
+		}
+	} else if (pg == NULL || stat_page_admit(pg) > 0) {
+		rc = status_job(pjob, preq, plist, &preply->brp_un.brp_status, bad, 0);
+		if (rc && rc != PBSE_PERM)
+			return rc;
+	}
+	return PBSE_NONE;
 }
 
 /**
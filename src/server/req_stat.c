@@ -47,6 +47,14 @@
  * Functions included are:
  * 	do_stat_of_a_job()
  * 	stat_a_jobidname()
+ * 	stat_extend_flag()
+ * 	parse_stat_page()
+ * 	stat_page_add()
+ * 	stat_page_sort()
+ * 	stat_page_admit()
+ * 	stat_page_full()
+ * 	free_stat_page()
+ * 	stat_job_visible()
  * 	req_stat_job()
  * 	req_stat_que()
  * 	status_que()
@@ -131,6 +139,10 @@ static int status_resv(resc_resv *, struct batch_request *, pbs_list_head *);
  * 	Support function for req_stat_job() and stat_a_jobidname().
  * 	Builds status reply for normal job, Array job, and if requested all of the
  * 	subjobs of the array (but not a single or range of subjobs).
+ * 	With a paged status each entry, the Array job and each of its subjobs,
+ * 	counts against the offset and limit. The client cannot expand a page
+ * 	which starts or ends inside an array from array_indices_remaining, so
+ * 	then all subjobs, queued ones too, are statused here as plain jobs.
  *
  * @note
  * 	If dohistjobs is not set and the job is history, no status or error
@@ -140,17 +152,20 @@ static int status_resv(resc_resv *, struct batch_request *, pbs_list_head *);
  * @param[in]     pjob       - pointer to the job to be statused
  * @param[in]     dohistjobs - flag to include job if it is a history job
  * @param[in]     dosubjobs  - flag to expand a Array job to include all subjobs
+ * @param[in,out] pg         - paging control, NULL if not paging
  *
  * @return int
  * @retval PBSE_NONE  - no error
  * @retval !PBSE_NONE - PBS error code to return to client
  */
 static int
-do_stat_of_a_job(struct batch_request *preq, job *pjob, int dohistjobs, int dosubjobs)
+do_stat_of_a_job(struct batch_request *preq, job *pjob, int dohistjobs, int dosubjobs, stat_page_t *pg)
 {
 	int i;
 	svrattrl *pal;
-	int rc;
+	int rc = PBSE_NONE;
+	int admit = 1;
+	int expand;
 	struct batch_reply *preply = &preq->rq_reply;
 
 	/* if history job and not asking for them, just return */
@@ -161,12 +176,22 @@ do_stat_of_a_job(struct batch_request *preq, job *pjob, int dohistjobs, int dosu
 	if ((pjob->ji_qs.ji_svrflags & JOB_SVFLG_SubJob) == 0) {
 		/* this is not a subjob, go ahead and build the status reply for this job */
 		pal = (svrattrl *) GET_NEXT(preq->rq_ind.rq_status.rq_attr);
-		rc = status_job(pjob, preq, pal, &preply->brp_un.brp_status, &bad, dosubjobs);
-		if (dosubjobs && (pjob->ji_qs.ji_svrflags & JOB_SVFLG_ArrayJob) && (rc == PBSE_NONE || rc != PBSE_PERM) && pjob->ji_ajinfo != NULL && pjob->ji_ajinfo->tkm_ct != pjob->ji_ajinfo->tkm_subjsct[JOB_STATE_QUEUED]) {
+		if (pg != NULL && (admit = stat_page_admit(pg)) < 0)
+			return PBSE_NONE;
+		/* the client expands the queued subjobs unless paging */
+		expand = dosubjobs && pg == NULL;
+		if (admit > 0)
+			rc = status_job(pjob, preq, pal, &preply->brp_un.brp_status, &bad, expand);
+		if (dosubjobs && (pjob->ji_qs.ji_svrflags & JOB_SVFLG_ArrayJob) && (rc == PBSE_NONE || rc != PBSE_PERM) && pjob->ji_ajinfo != NULL && (pg != NULL || pjob->ji_ajinfo->tkm_ct != pjob->ji_ajinfo->tkm_subjsct[JOB_STATE_QUEUED])) {
 			for (i = pjob->ji_ajinfo->tkm_start; i <= pjob->ji_ajinfo->tkm_end; i += pjob->ji_ajinfo->tkm_step) {
-				if (range_contains(pjob->ji_ajinfo->trm_quelist, i))
+				if (pg == NULL && range_contains(pjob->ji_ajinfo->trm_quelist, i))
+					continue;
+				if (pg != NULL && (admit = stat_page_admit(pg)) <= 0) {
+					if (admit < 0)
+						break;
 					continue;
-				rc = status_subjob(pjob, preq, pal, i, &preply->brp_un.brp_status, &bad, 1);
+				}
+				rc = status_subjob(pjob, preq, pal, i, &preply->brp_un.brp_status, &bad, expand);
 				if (rc && rc != PBSE_PERM)
 					break;
 			}
@@ -228,7 +253,7 @@ stat_a_jobidname(struct batch_request *preq, char *name, int dohistjobs, int dos
 			return PBSE_UNKJOBID;
 		else if (!dohistjobs && (rc = svr_chk_histjob(pjob)) != PBSE_NONE)
 			return rc;
-		return do_stat_of_a_job(preq, pjob, dohistjobs, dosubjobs);
+		return do_stat_of_a_job(preq, pjob, dohistjobs, dosubjobs, NULL);
 	} else {
 		/* range of sub jobs */
 		range = get_range_from_jid(name);
@@ -267,6 +292,291 @@ stat_a_jobidname(struct batch_request *preq, char *name, int dohistjobs, int dos
 	}
 }
 
+/**
+ * @brief
+ * 	Check for a single letter flag in the extend string of a status or
+ * 	select request. Only the letters before the first ":option=value"
+ * 	count, the option values may contain any letter.
+ *
+ * @param[in] extend - extend string of the request, may be NULL
+ * @param[in] flag   - flag letter to look for
+ *
+ * @return int
+ * @retval 1 - flag is set
+ * @retval 0 - flag is not set
+ */
+int
+stat_extend_flag(char *extend, int flag)
+{
+	char *pc;
+	char *opt;
+
+	if (extend == NULL || (pc = strchr(extend, flag)) == NULL)
+		return 0;
+	opt = strchr(extend, ':');
+	return (opt == NULL || pc < opt);
+}
+
+/**
+ * @brief
+ * 	Get the value of a numeric ":option=value" from an extend string.
+ *
+ * @param[in]  extend - extend string of the request
+ * @param[in]  opt    - option, one of the EXTEND_OPT_* of the job status
+ * @param[out] value  - value of the option, untouched if option not given
+ *
+ * @return int
+ * @retval 0  - option not given
+ * @retval 1  - option given, value set
+ * @retval -1 - option given with a value which is not a non-negative number
+ */
+static int
+get_stat_extend_num(char *extend, char *opt, long *value)
+{
+	char *pc;
+	char *end;
+	long val;
+
+	if ((pc = strstr(extend, opt)) == NULL)
+		return 0;
+	pc += strlen(opt);
+	val = strtol(pc, &end, 10);
+	if (end == pc || val < 0 || (*end != '\0' && *end != ':'))
+		return -1;
+	*value = val;
+	return 1;
+}
+
+/**
+ * @brief
+ * 	Parse the sort, limit and offset options of a job status request
+ * 	(see EXTEND_OPT_SORT and friends in libpbs.h) into a stat_page_t.
+ *
+ * @param[in]  extend - extend string of the request, may be NULL
+ * @param[in]  perm   - privilege of the requestor, to read the sort attribute
+ * @param[out] pg     - paging control, always initialized
+ *
+ * @return int
+ * @retval PBSE_NONE    - success, pg->sp_active set if there is anything to do
+ * @retval PBSE_IVALREQ - malformed option
+ * @retval PBSE_NOATTR  - unknown sort attribute
+ * @retval PBSE_UNKRESC - unknown sort resource
+ * @retval PBSE_PERM    - requestor may not read the sort attribute
+ */
+int
+parse_stat_page(char *extend, int perm, stat_page_t *pg)
+{
+	char name[256]; /* attribute[.resource] */
+	char *pc;
+	char *end;
+	char *resc;
+	int rc;
+
+	memset(pg, 0, sizeof(stat_page_t));
+	pg->sp_sort_idx = -1;
+	if (extend == NULL)
+		return PBSE_NONE;
+
+	if ((rc = get_stat_extend_num(extend, EXTEND_OPT_LIMIT, &pg->sp_limit)) == -1)
+		return PBSE_IVALREQ;
+	if (rc == 1)
+		pg->sp_active = 1;
+	if ((rc = get_stat_extend_num(extend, EXTEND_OPT_OFFSET, &pg->sp_offset)) == -1)
+		return PBSE_IVALREQ;
+	if (rc == 1)
+		pg->sp_active = 1;
+
+	if ((pc = strstr(extend, EXTEND_OPT_SORT)) == NULL)
+		return PBSE_NONE;
+	pc += strlen(EXTEND_OPT_SORT);
+	if (*pc == '-') {
+		pg->sp_sort_desc = 1;
+		pc++;
+	}
+	if ((end = strchr(pc, ':')) == NULL)
+		end = pc + strlen(pc);
+	if (end == pc || (size_t) (end - pc) >= sizeof(name))
+		return PBSE_IVALREQ;
+	memcpy(name, pc, end - pc);
+	name[end - pc] = '\0';
+	if ((resc = strchr(name, '.')) != NULL)
+		*resc++ = '\0';
+
+	pg->sp_sort_idx = find_attr(job_attr_idx, job_attr_def, name);
+	if (pg->sp_sort_idx < 0)
+		return PBSE_NOATTR;
+	if ((job_attr_def[pg->sp_sort_idx].at_flags & perm & ATR_DFLAG_RDACC) == 0)
+		return PBSE_PERM;
+	if (resc != NULL) {
+		if (job_attr_def[pg->sp_sort_idx].at_type != ATR_TYPE_RESC)
+			return PBSE_IVALREQ;
+		if ((pg->sp_sort_rdef = find_resc_def(svr_resc_def, resc)) == NULL)
+			return PBSE_UNKRESC;
+	}
+	pg->sp_active = 1;
+	return PBSE_NONE;
+}
+
+/**
+ * @brief
+ * 	Collect a matching job to be sorted by stat_page_sort().
+ *
+ * @param[in,out] pg   - paging control
+ * @param[in]     pjob - job which matched the request
+ *
+ * @return int
+ * @retval PBSE_NONE   - success
+ * @retval PBSE_SYSTEM - out of memory
+ */
+int
+stat_page_add(stat_page_t *pg, job *pjob)
+{
+	if (pg->sp_njobs == pg->sp_size) {
+		int size = pg->sp_size ? pg->sp_size * 2 : 1024;
+		stat_page_ent_t *tmp = realloc(pg->sp_jobs, size * sizeof(stat_page_ent_t));
+
+		if (tmp == NULL)
+			return PBSE_SYSTEM;
+		pg->sp_jobs = tmp;
+		pg->sp_size = size;
+	}
+	pg->sp_jobs[pg->sp_njobs].se_job = pjob;
+	pg->sp_jobs[pg->sp_njobs].se_page = pg;
+	pg->sp_njobs++;
+	return PBSE_NONE;
+}
+
+/**
+ * @brief
+ * 	qsort compare function of stat_page_sort(). Jobs without the sort
+ * 	attribute (or resource) set go last, ties keep queue rank order.
+ * 	qsort has no context argument, each entry points at its paging control.
+ */
+static int
+cmp_stat_page(const void *a, const void *b)
+{
+	stat_page_t *sort_page = ((stat_page_ent_t *) a)->se_page;
+	job *pj1 = ((stat_page_ent_t *) a)->se_job;
+	job *pj2 = ((stat_page_ent_t *) b)->se_job;
+	attribute *pat1 = get_jattr(pj1, sort_page->sp_sort_idx);
+	attribute *pat2 = get_jattr(pj2, sort_page->sp_sort_idx);
+	int set1 = is_attr_set(pat1);
+	int set2 = is_attr_set(pat2);
+	int rc = 0;
+
+	if (sort_page->sp_sort_rdef != NULL) {
+		resource *pr1 = set1 ? find_resc_entry(pat1, sort_page->sp_sort_rdef) : NULL;
+		resource *pr2 = set2 ? find_resc_entry(pat2, sort_page->sp_sort_rdef) : NULL;
+
+		set1 = pr1 != NULL && is_attr_set(&pr1->rs_value);
+		set2 = pr2 != NULL && is_attr_set(&pr2->rs_value);
+		if (set1 && set2)
+			rc = sort_page->sp_sort_rdef->rs_comp(&pr1->rs_value, &pr2->rs_value);
+	} else if (set1 && set2)
+		rc = job_attr_def[sort_page->sp_sort_idx].at_comp(pat1, pat2);
+
+	if (set1 != set2)
+		return set1 ? -1 : 1;
+	if (rc != 0)
+		return sort_page->sp_sort_desc ? -rc : rc;
+	if (get_jattr_ll(pj1, JOB_ATR_qrank) < get_jattr_ll(pj2, JOB_ATR_qrank))
+		return -1;
+	return get_jattr_ll(pj1, JOB_ATR_qrank) > get_jattr_ll(pj2, JOB_ATR_qrank);
+}
+
+/**
+ * @brief
+ * 	Sort the jobs collected by stat_page_add() by the sort attribute.
+ *
+ * @param[in,out] pg - paging control
+ */
+void
+stat_page_sort(stat_page_t *pg)
+{
+	if (pg->sp_njobs < 2)
+		return;
+	qsort(pg->sp_jobs, pg->sp_njobs, sizeof(stat_page_ent_t), cmp_stat_page);
+}
+
+/**
+ * @brief
+ * 	Account for the next matching entry, a job or one subjob of an
+ * 	Array job, against the offset and limit.
+ *
+ * @param[in,out] pg - paging control
+ *
+ * @return int
+ * @retval 1  - status this entry
+ * @retval 0  - skip this entry, it is before the offset
+ * @retval -1 - page is full, stop looking at jobs
+ */
+int
+stat_page_admit(stat_page_t *pg)
+{
+	if (stat_page_full(pg))
+		return -1;
+	if (pg->sp_seen++ < pg->sp_offset)
+		return 0;
+	pg->sp_taken++;
+	return 1;
+}
+
+/**
+ * @brief
+ * 	Has the limit of a paged status been reached?
+ *
+ * @param[in] pg - paging control
+ *
+ * @return int
+ * @retval 1 - page is full
+ * @retval 0 - more entries fit
+ */
+int
+stat_page_full(stat_page_t *pg)
+{
+	return (pg->sp_limit > 0 && pg->sp_taken >= pg->sp_limit);
+}
+
+/**
+ * @brief
+ * 	Free what parse_stat_page() and stat_page_add() allocated.
+ *
+ * @param[in,out] pg - paging control
+ */
+void
+free_stat_page(stat_page_t *pg)
+{
+	free(pg->sp_jobs);
+	pg->sp_jobs = NULL;
+	pg->sp_njobs = 0;
+	pg->sp_size = 0;
+}
+
+/**
+ * @brief
+ * 	Would do_stat_of_a_job() return status for this job? Used to count
+ * 	jobs against the offset and limit of a paged status.
+ *
+ * @param[in] preq       - the stat job batch request
+ * @param[in] pjob       - job to check
+ * @param[in] dohistjobs - flag to include history jobs
+ *
+ * @return int
+ * @retval 1 - job would be statused
+ * @retval 0 - job would be skipped
+ */
+static int
+stat_job_visible(struct batch_request *preq, job *pjob, int dohistjobs)
+{
+	if (!dohistjobs && (check_job_state(pjob, JOB_STATE_LTR_FINISHED) || check_job_state(pjob, JOB_STATE_LTR_MOVED)))
+		return 0;
+	if (pjob->ji_qs.ji_svrflags & JOB_SVFLG_SubJob)
+		return 0;
+	if (!get_sattr_long(SVR_ATR_query_others) && svr_authorize_jobreq(preq, pjob))
+		return 0;
+	return 1;
+}
+
 /**
  * @brief
  * 	Service the Status Job Request
@@ -292,11 +602,14 @@ req_stat_job(struct batch_request *preq)
 	int dohistjobs = 0;
 	char *name;
 	job *pjob = NULL;
+	job *pnext;
 	pbs_queue *pque = NULL;
 	struct batch_reply *preply;
 	int rc = 0;
 	int type = 0;
 	char *pnxtjid = NULL;
+	stat_page_t page;
+	int i;
 
 	/* check for any extended flag in the batch request. 't' for
 	 * the sub jobs. If 'x' is there, then check if the server is
@@ -305,9 +618,9 @@ req_stat_job(struct batch_request *preq)
 	 * jobs.
 	 */
 	if (preq->rq_extend) {
-		if (strchr(preq->rq_extend, (int) 't'))
+		if (stat_extend_flag(preq->rq_extend, 't'))
 			dosubjobs = 1; /* status sub jobs of an Array Job */
-		if (strchr(preq->rq_extend, (int) 'x')) {
+		if (stat_extend_flag(preq->rq_extend, 'x')) {
 			if (svr_history_enable == 0) {
 				req_reject(PBSE_JOBHISTNOTSET, 0, preq);
 				return;
@@ -316,6 +629,12 @@ req_stat_job(struct batch_request *preq)
 		}
 	}
 
+	/* sort, limit and offset apply to the jobs of a queue or the server */
+	if ((rc = parse_stat_page(preq->rq_extend, preq->rq_perm, &page)) != PBSE_NONE) {
+		req_reject(rc, 0, preq);
+		return;
+	}
+
 	/*
 	 * first, validate the name of the requested object, either
 	 * a job, a queue, or the whole server.
@@ -383,19 +702,51 @@ req_stat_job(struct batch_request *preq)
 
 	} else {
 		pjob = (job *) GET_NEXT(type == 2 ? pque->qu_jobs : svr_alljobs);
-		while (pjob) {
-			rc = do_stat_of_a_job(preq, pjob, dohistjobs, dosubjobs);
+		for (; pjob != NULL; pjob = pnext) {
+			pnext = (job *) GET_NEXT(type == 2 ? pjob->ji_jobque : pjob->ji_alljobs);
+			if (page.sp_active) {
+				if (!stat_job_visible(preq, pjob, dohistjobs))
+					continue;
+				if (page.sp_sort_idx != -1) {
+					/* status after all are collected and sorted */
+					if ((rc = stat_page_add(&page, pjob)) != PBSE_NONE)
+						break;
+					continue;
+				}
+				if (stat_page_full(&page))
+					break;
+			}
+			rc = do_stat_of_a_job(preq, pjob, dohistjobs, dosubjobs, page.sp_active ? &page : NULL);
 			if (rc != PBSE_NONE) {
+				free_stat_page(&page);
 				req_reject(rc, bad, preq);
 				return;
 			}
-			pjob = (job *) GET_NEXT(type == 2 ? pjob->ji_jobque : pjob->ji_alljobs);
-			if (preply->brp_count >= MAX_JOBS_PER_REPLY && pjob) {
+			if (preply->brp_count >= MAX_JOBS_PER_REPLY && pnext) {
 				rc = reply_send_status_part(preq);
-				if (rc != PBSE_NONE)
+				if (rc != PBSE_NONE) {
+					free_stat_page(&page);
 					return;
+				}
+			}
+		}
+
+		if (rc == PBSE_NONE && page.sp_sort_idx != -1) {
+			stat_page_sort(&page);
+			for (i = 0; i < page.sp_njobs && !stat_page_full(&page); i++) {
+				rc = do_stat_of_a_job(preq, page.sp_jobs[i].se_job, dohistjobs, dosubjobs, &page);
+				if (rc != PBSE_NONE)
+					break;
+				if (preply->brp_count >= MAX_JOBS_PER_REPLY && i + 1 < page.sp_njobs) {
+					rc = reply_send_status_part(preq);
+					if (rc != PBSE_NONE) {
+						free_stat_page(&page);
+						return;
+					}
+				}
 			}
 		}
+		free_stat_page(&page);
 	}
 
 	if (rc && rc != PBSE_PERM)
@@ -284,7 +284,7 @@ decode_place(attribute *patr, char *name, char *rescn, char *val)
 
 #endif /* not PBS_MOM */
 
-	return (decode_str(patr, name, rescn, val));
+	return (decode_istr(patr, name, rescn, val));
 }
 
 /**
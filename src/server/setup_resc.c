@@ -352,6 +352,7 @@ expand_resc_array(char *rname, int rtype, int rflag)
 	pnew->rs_type = rtype;
 	pnew->rs_entlimflg = 0;
 	pnew->rs_next = NULL;
+	pnew->rs_index = 0;
 
 	if (pbs_idx_insert(resc_attrdef_idx, pnew->rs_name, pnew) != PBS_IDX_RET_OK) {
 		free(pnew->rs_name);
@@ -90,6 +90,13 @@
 #include "batch_request.h"
 #include "hook.h"
 #include <signal.h>
+#ifndef WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#endif
 #include "job.h"
 #include "reservation.h"
 #include "server.h"
@@ -1390,6 +1397,418 @@ argv_list_to_str(pbs_list_head *argv_list)
 	return (ret_string);
 }
 
+#ifndef WIN32
+/*
+ * Hook executor support, see HOOK_EXECUTOR_MODE in hook.h.
+ */
+#define EXEC_MAXCONN 64	      /* hooks running at one time */
+#define EXEC_POLL_MSECS 1000 /* how often to check on the parent MoM */
+
+/* a hook run in progress */
+struct exec_conn {
+	int ec_fd;     /* connection to the MoM child, -1 once closed */
+	pid_t ec_pid;  /* process running the hook, 0 once reaped */
+};
+
+/* a hook script compiled by the executor */
+struct exec_script {
+	struct python_script *es_script;
+	struct exec_script *es_next;
+};
+
+static struct exec_script *exec_scripts = NULL;
+static int exec_sigpipe[2] = {-1, -1};
+
+/*
+ * Imports the modules named in the top level import statements of a hook
+ * script, so that they are already loaded when the hook runs.
+ */
+static const char exec_preload_src[] =
+	"def _pbs_hook_executor_preload(path):\n"
+	"    import ast, importlib\n"
+	"    try:\n"
+	"        with open(path) as f:\n"
+	"            tree = ast.parse(f.read())\n"
+	"    except Exception:\n"
+	"        return\n"
+	"    for node in tree.body:\n"
+	"        if isinstance(node, ast.Import):\n"
+	"            names = [a.name for a in node.names]\n"
+	"        elif isinstance(node, ast.ImportFrom) and node.level == 0 and node.module:\n"
+	"            names = [node.module]\n"
+	"        else:\n"
+	"            continue\n"
+	"        for name in names:\n"
+	"            if name == 'pbs' or name.startswith('pbs.'):\n"
+	"                continue\n"
+	"            try:\n"
+	"                importlib.import_module(name)\n"
+	"            except BaseException:\n"
+	"                pass\n";
+
+/**
+ * @brief
+ *		SIGCHLD handler of the hook executor, wakes up its poll loop.
+ *
+ * @param[in]	sig - signal number
+ */
+static void
+exec_sigchld(int sig)
+{
+	int save_errno = errno;
+
+	/* a full pipe already has a wakeup pending */
+	(void) !write(exec_sigpipe[1], "c", 1);
+	errno = save_errno;
+}
+
+/**
+ * @brief
+ *		Return the compiled hook script cached by the hook executor for
+ *		'path', compiling it first if it is not yet cached.
+ *
+ * @param[in]	path - hook script path
+ * @param[in]	add - if set, compile and cache the script if needed
+ *
+ * @return	struct python_script *
+ * @retval	NULL	- not cached
+ */
+static struct python_script *
+exec_script_find(char *path, int add)
+{
+	struct exec_script *es;
+	struct python_script *py_script = NULL;
+	PyObject *mod;
+	PyObject *func;
+	PyObject *res;
+
+	for (es = exec_scripts; es != NULL; es = es->es_next) {
+		if (strcmp(es->es_script->path, path) == 0) {
+			if (add)
+				(void) pbs_python_check_and_compile_script(&svr_interp_data,
+									   es->es_script);
+			return (es->es_script);
+		}
+	}
+	if (!add || (path[0] == '\0'))
+		return (NULL);
+
+	if (pbs_python_ext_alloc_python_script(path, &py_script) != 0)
+		return (NULL);
+	if (pbs_python_check_and_compile_script(&svr_interp_data, py_script) != 0) {
+		pbs_python_ext_free_python_script(py_script);
+		free(py_script);
+		return (NULL);
+	}
+	if ((es = malloc(sizeof(struct exec_script))) == NULL) {
+		pbs_python_ext_free_python_script(py_script);
+		free(py_script);
+		return (NULL);
+	}
+	es->es_script = py_script;
+	es->es_next = exec_scripts;
+	exec_scripts = es;
+
+	/* warm up the modules the script imports */
+	mod = PyImport_AddModule("__main__");
+	func = (mod != NULL) ? PyObject_GetAttrString(mod, "_pbs_hook_executor_preload") : NULL;
+	if (func != NULL) {
+		res = PyObject_CallFunction(func, "s", path);
+		Py_XDECREF(res);
+		Py_DECREF(func);
+	}
+	PyErr_Clear();
+	log_eventf(PBSEVENT_DEBUG3, PBS_EVENTCLASS_HOOK, LOG_INFO, __func__,
+		   "loaded hook script %s", path);
+	return (py_script);
+}
+
+/**
+ * @brief
+ *		Read a hook executor request from a connection.
+ *
+ * @param[in]	fd - connection
+ * @param[out]	len - length of the request
+ *
+ * @return	char *
+ * @retval	malloc-ed request, NUL-terminated
+ * @retval	NULL	- bad or incomplete request
+ */
+static char *
+exec_read_request(int fd, size_t *len)
+{
+	uint32_t rlen;
+	char *buf;
+	ssize_t n;
+	size_t got = 0;
+
+	if (read(fd, &rlen, sizeof(rlen)) != sizeof(rlen))
+		return (NULL);
+	if ((rlen == 0) || (rlen > HOOK_EXECUTOR_MAXREQ))
+		return (NULL);
+	if ((buf = malloc(rlen + 1)) == NULL)
+		return (NULL);
+	while (got < rlen) {
+		n = read(fd, buf + got, rlen - got);
+		if (n <= 0) {
+			if ((n == -1) && (errno == EINTR))
+				continue;
+			free(buf);
+			return (NULL);
+		}
+		got += n;
+	}
+	buf[rlen] = '\0';
+	*len = rlen;
+	return (buf);
+}
+
+/**
+ * @brief
+ *		Run the hook executor.
+ *
+ *		Starts the Python interpreter once, then accepts requests from
+ *		MoM on a UNIX socket.  Each request is run in a forked child,
+ *		which inherits the interpreter, the imported modules and the
+ *		compiled hook script, and returns from this function to run
+ *		the hook the same way "pbs_python --hook" does.  The wait status
+ *		of the child is sent back on the connection.  If the connection
+ *		is closed first, the child is killed.  The executor exits when
+ *		the MoM that started it goes away.
+ *
+ * @param[in]	argv - pbs_python --hook-executor <socket> [-L <path_log>]
+ * @param[out]	argc_out - argument count for hook mode
+ * @param[out]	argv_out - arguments for hook mode
+ * @param[out]	script_out - the cached hook script to run
+ *
+ * @return	int
+ * @retval	0	- in a child, run the hook
+ * @retval	1	- the executor failed
+ */
+static int
+hook_executor(char *argv[], int *argc_out, char ***argv_out,
+	      struct python_script **script_out)
+{
+	struct sockaddr_un addr;
+	struct exec_conn conns[EXEC_MAXCONN];
+	struct pollfd pfds[EXEC_MAXCONN + 2];
+	struct sigaction act;
+	pid_t ppid = getppid();
+	pid_t pid;
+	char *sockpath;
+	char *path_log = NULL;
+	char *req;
+	char *p;
+	char **nargv;
+	size_t len;
+	int lfd;
+	int fd;
+	int nconn = 0;
+	int nargs;
+	int i;
+	int j;
+	int status;
+	char c;
+
+	/* python externs */
+	extern void pbs_python_svr_initialize_interpreter_data(struct python_interpreter_data * interp_data);
+	extern void pbs_python_svr_destroy_interpreter_data(struct python_interpreter_data * interp_data);
+
+	if ((argv[2] == NULL) || (argv[2][0] == '\0'))
+		return (1);
+	sockpath = argv[2];
+	if ((argv[3] != NULL) && (strcmp(argv[3], "-L") == 0))
+		path_log = argv[4];
+	if (strlen(sockpath) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "pbs_python: socket path %s too long\n", sockpath);
+		return (1);
+	}
+	if (log_open_main("", path_log ? path_log : ".", 1) != 0) {
+		fprintf(stderr, "pbs_python: Unable to open logfile\n");
+		return (1);
+	}
+
+	svr_interp_data.data_initialized = 0;
+	svr_interp_data.init_interpreter_data = pbs_python_svr_initialize_interpreter_data;
+	svr_interp_data.destroy_interpreter_data = pbs_python_svr_destroy_interpreter_data;
+	svr_interp_data.daemon_name = strdup(PBS_PYTHON_PROGRAM);
+	if ((svr_interp_data.daemon_name == NULL) ||
+	    (pbs_python_ext_start_interpreter(&svr_interp_data) != 0)) {
+		log_err(-1, __func__, "Failed to start Python interpreter");
+		return (1);
+	}
+	if (PyRun_SimpleString(exec_preload_src) != 0)
+		log_err(-1, __func__, "Failed to set up module preloading");
+
+	if (pipe(exec_sigpipe) == -1) {
+		log_err(errno, __func__, "pipe");
+		return (1);
+	}
+	(void) fcntl(exec_sigpipe[0], F_SETFL, O_NONBLOCK);
+	(void) fcntl(exec_sigpipe[1], F_SETFL, O_NONBLOCK);
+	memset(&act, 0, sizeof(act));
+	sigemptyset(&act.sa_mask);
+	act.sa_handler = exec_sigchld;
+	act.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+	(void) sigaction(SIGCHLD, &act, NULL);
+	act.sa_handler = SIG_IGN;
+	act.sa_flags = 0;
+	(void) sigaction(SIGPIPE, &act, NULL);
+
+	if ((lfd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+		log_err(errno, __func__, "socket");
+		return (1);
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", sockpath);
+	(void) unlink(sockpath);
+	if ((bind(lfd, (struct sockaddr *) &addr, sizeof(addr)) == -1) ||
+	    (chmod(sockpath, 0600) == -1) ||
+	    (listen(lfd, EXEC_MAXCONN) == -1)) {
+		log_errf(errno, __func__, "unable to listen on %s", sockpath);
+		return (1);
+	}
+	log_eventf(PBSEVENT_DEBUG, PBS_EVENTCLASS_HOOK, LOG_INFO, __func__,
+		   "hook executor listening on %s", sockpath);
+
+	for (;;) {
+		if (getppid() != ppid)
+			break;
+
+		/* reap finished hooks and report their status */
+		while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+			for (i = 0; i < nconn; i++) {
+				if (conns[i].ec_pid != pid)
+					continue;
+				if (conns[i].ec_fd != -1) {
+					if (write(conns[i].ec_fd, &status, sizeof(status)) != sizeof(status))
+						log_err(errno, __func__, "failed to send hook status");
+					(void) close(conns[i].ec_fd);
+				}
+				conns[i] = conns[--nconn];
+				break;
+			}
+		}
+
+		pfds[0].fd = lfd;
+		pfds[0].events = (nconn < EXEC_MAXCONN) ? POLLIN : 0;
+		pfds[1].fd = exec_sigpipe[0];
+		pfds[1].events = POLLIN;
+		for (i = 0; i < nconn; i++) {
+			pfds[i + 2].fd = conns[i].ec_fd;
+			pfds[i + 2].events = POLLIN;
+		}
+		if (poll(pfds, nconn + 2, EXEC_POLL_MSECS) <= 0)
+			continue;
+
+		while (read(exec_sigpipe[0], &c, 1) == 1)
+			;
+
+		/* a MoM side that goes away takes its hook with it */
+		for (i = 0; i < nconn; i++) {
+			if ((conns[i].ec_fd != -1) && (pfds[i + 2].revents != 0)) {
+				(void) kill(-conns[i].ec_pid, SIGKILL);
+				(void) close(conns[i].ec_fd);
+				conns[i].ec_fd = -1;
+			}
+		}
+
+		if ((pfds[0].revents & POLLIN) == 0)
+			continue;
+		if ((fd = accept(lfd, NULL, NULL)) == -1)
+			continue;
+#ifdef SO_PEERCRED
+		{
+			struct ucred cred;
+			socklen_t clen = sizeof(cred);
+
+			if ((getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &clen) == -1) ||
+			    (cred.uid != 0)) {
+				log_err(-1, __func__, "rejected request from non-root peer");
+				(void) close(fd);
+				continue;
+			}
+		}
+#endif
+		if ((req = exec_read_request(fd, &len)) == NULL) {
+			log_err(-1, __func__, "bad hook request");
+			(void) close(fd);
+			continue;
+		}
+
+		/* split into cwd, config file, and the hook mode arguments */
+		nargs = 0;
+		for (p = req; p < req + len; p += strlen(p) + 1)
+			nargs++;
+		if ((nargs < 4) || ((nargv = calloc(nargs, sizeof(char *))) == NULL)) {
+			free(req);
+			(void) close(fd);
+			continue;
+		}
+		nargv[0] = argv[0];
+		p = req + strlen(req) + 1;
+		p += strlen(p) + 1;
+		for (j = 1; p < req + len; p += strlen(p) + 1)
+			nargv[j++] = p;
+		nargv[j] = NULL;
+
+		/* the script is the last argument */
+		(void) exec_script_find(nargv[j - 1], 1);
+
+		pid = fork();
+		if (pid == 0) {
+#if PY_VERSION_HEX >= 0x03070000
+			PyOS_AfterFork_Child();
+#else
+			PyOS_AfterFork();
+#endif
+			act.sa_handler = SIG_DFL;
+			(void) sigaction(SIGCHLD, &act, NULL);
+			(void) sigaction(SIGPIPE, &act, NULL);
+			(void) close(exec_sigpipe[0]);
+			(void) close(exec_sigpipe[1]);
+			(void) close(lfd);
+			for (i = 0; i < nconn; i++)
+				if (conns[i].ec_fd != -1)
+					(void) close(conns[i].ec_fd);
+			(void) close(fd);
+			setsid();
+
+			if (chdir(req) == -1)
+				log_errf(errno, __func__, "chdir %s", req);
+			p = req + strlen(req) + 1;
+			if (*p == '\0')
+				(void) unsetenv(PBS_HOOK_CONFIG_FILE);
+			else
+				(void) setenv(PBS_HOOK_CONFIG_FILE, p, 1);
+
+			*argc_out = j;
+			*argv_out = nargv;
+			*script_out = exec_script_find(nargv[j - 1], 0);
+			return (0);
+		}
+		free(nargv);
+		free(req);
+		if (pid == -1) {
+			log_err(errno, __func__, "fork");
+			(void) close(fd);
+			continue;
+		}
+		conns[nconn].ec_fd = fd;
+		conns[nconn].ec_pid = pid;
+		nconn++;
+	}
+
+	log_event(PBSEVENT_DEBUG, PBS_EVENTCLASS_HOOK, LOG_INFO, __func__,
+		  "MoM went away, hook executor exiting");
+	for (i = 0; i < nconn; i++)
+		(void) kill(-conns[i].ec_pid, SIGKILL);
+	(void) unlink(sockpath);
+	exit(0);
+}
+#endif /* WIN32 */
+
 /**
  *
  * @brief
@@ -1412,6 +1831,7 @@ main(int argc, char *argv[], char *envp[])
 #endif
 	char **lenvp = NULL;
 	int i, rc;
+	struct python_script *exec_py_script = NULL; /* set in a hook executor child */
 
 	/* python externs */
 	extern void pbs_python_svr_initialize_interpreter_data(struct python_interpreter_data * interp_data);
@@ -1493,6 +1913,14 @@ main(int argc, char *argv[], char *envp[])
 		svr_resc_def[i].rs_next = &svr_resc_def[i + 1];
 	/* last entry is left with null pointer */
 
+#ifndef WIN32
+	if ((argv[1] != NULL) && (strcmp(argv[1], HOOK_EXECUTOR_MODE) == 0)) {
+		/* returns only in a child that is to run a hook */
+		if (hook_executor(argv, &argc, &argv, &exec_py_script) != 0)
+			return 1;
+	}
+#endif
+
 	if ((argv[1] == NULL) || (strcmp(argv[1], HOOK_MODE) != 0)) {
 		char *python_path = NULL;
 		if (get_py_progname(&python_path)) {
@@ -1989,20 +2417,25 @@ main(int argc, char *argv[], char *envp[])
 			snprintf(logname, sizeof(logname), "%s", full_logname);
 		}
 
-		/* set python interp data */
-		svr_interp_data.data_initialized = 0;
-		svr_interp_data.init_interpreter_data = pbs_python_svr_initialize_interpreter_data;
-		svr_interp_data.destroy_interpreter_data = pbs_python_svr_destroy_interpreter_data;
+		/* set python interp data, unless a hook executor already did */
+		if (!svr_interp_data.interp_started) {
+			svr_interp_data.data_initialized = 0;
+			svr_interp_data.init_interpreter_data = pbs_python_svr_initialize_interpreter_data;
+			svr_interp_data.destroy_interpreter_data = pbs_python_svr_destroy_interpreter_data;
 
-		svr_interp_data.daemon_name = strdup(PBS_PYTHON_PROGRAM);
+			svr_interp_data.daemon_name = strdup(PBS_PYTHON_PROGRAM);
 
-		if (svr_interp_data.daemon_name == NULL) { /* should not happen */
-			fprintf(stderr, "strdup failed");
-			exit(1);
+			if (svr_interp_data.daemon_name == NULL) { /* should not happen */
+				fprintf(stderr, "strdup failed");
+				exit(1);
+			}
 		}
 
-		(void) pbs_python_ext_alloc_python_script(hook_script,
-							  (struct python_script **) &py_script);
+		if ((exec_py_script != NULL) && (strcmp(exec_py_script->path, hook_script) == 0))
+			py_script = exec_py_script;
+		else
+			(void) pbs_python_ext_alloc_python_script(hook_script,
+								  (struct python_script **) &py_script);
 
 		hook_perf_stat_start(perf_label, HOOK_PERF_START_PYTHON, 0);
 		if (pbs_python_ext_start_interpreter(&svr_interp_data) != 0) {
@@ -0,0 +1,850 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+/**
+ * @file	tpp_bench.c
+ *
+ * @brief
+ *	Loopback throughput and latency benchmark for the TPP library.
+ *
+ * @par Functionality:
+ *	Starts a pbs_comm router and a number of leaves on the local host, each
+ *	in its own process since the TPP library keeps one instance per process.
+ *	One leaf (the driver) sends messages of a given size either round robin
+ *	to the other leaves, or through a multicast channel to the first few of
+ *	them, keeping a bounded window of unacknowledged messages per receiver.
+ *	Receivers time stamp each message on arrival; since all processes share
+ *	CLOCK_MONOTONIC, this gives one way latency directly.
+ *
+ *	At the end it reports delivered messages per second, p50/p99/max latency
+ *	and the CPU time (router and leaves together) spent per message.
+ *
+ *	TPP does not use loopback addresses, so all processes identify as this
+ *	host's name (or the -H option), which must resolve to a real interface.
+ *	Authentication and compression settings come from pbs.conf, as for
+ *	the daemons, so with resvport authentication it must run as root.
+ */
+#include <pbs_config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <avltree.h>
+
+#include "pbs_ifl.h"
+#include "pbs_internal.h"
+#include "log.h"
+#include "tpp.h"
+#include "auth.h"
+
+#define BENCH_DEF_PORT 17100
+
+#define BENCH_MSG_HELLO 1 /* receiver to driver and back, id is receiver index */
+#define BENCH_MSG_DATA 2  /* driver to receiver, seq and ts set */
+#define BENCH_MSG_ACK 3	  /* receiver to driver, id is messages received so far */
+#define BENCH_MSG_DONE 4  /* driver to receiver, and the final ACK back */
+
+/* header at the start of every benchmark message */
+typedef struct {
+	uint32_t type;
+	uint32_t id;
+	uint64_t seq;
+	uint64_t ts; /* CLOCK_MONOTONIC time the message was sent, in ns */
+} bench_hdr_t;
+
+/* what each leaf process reports back to the parent */
+typedef struct {
+	uint64_t count;	   /* messages sent (driver) or received (receiver) */
+	uint64_t first_ns; /* time of first send or receive */
+	uint64_t last_ns;  /* time of last send or receive */
+} bench_result_t;
+
+static char bench_host[PBS_MAXHOSTNAME + 1]; /* name all processes use, TPP ignores loopback addresses */
+static int router_port = BENCH_DEF_PORT;
+static int num_receivers = 4;
+static int msg_size = 256;
+static long num_msgs = 100000;
+static int fanout = 0; /* 0 for round robin unicast, else multicast to so many receivers */
+static int window = 256;
+static int router_threads = 2;
+static char *logfile = "/dev/null";
+
+static volatile sig_atomic_t got_term = 0;
+
+/**
+ * @brief
+ *	Current CLOCK_MONOTONIC time in nanoseconds
+ */
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+term_handler(int sig)
+{
+	got_term = 1;
+}
+
+/**
+ * @brief
+ *	Write or read a buffer fully on a pipe
+ *
+ * @return	Error code
+ * @retval	-1 - Failure
+ * @retval	 0 - Success
+ */
+static int
+write_all(int fd, void *buf, size_t len)
+{
+	char *p = buf;
+	ssize_t n;
+
+	while (len > 0) {
+		if ((n = write(fd, p, len)) == -1) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int
+read_all(int fd, void *buf, size_t len)
+{
+	char *p = buf;
+	ssize_t n;
+
+	while (len > 0) {
+		if ((n = read(fd, p, len)) <= 0) {
+			if (n == -1 && errno == EINTR)
+				continue;
+			return -1;
+		}
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/**
+ * @brief
+ *	Run the router side of the benchmark until told to stop
+ *
+ * @return	exit status of the router process
+ */
+static int
+run_router(void)
+{
+	static struct tpp_config conf;
+	struct sigaction act;
+
+	if (set_tpp_config(&pbs_conf, &conf, bench_host, router_port, NULL) == -1) {
+		fprintf(stderr, "router: error setting TPP config\n");
+		return 1;
+	}
+	conf.node_type = TPP_ROUTER_NODE;
+	conf.numthreads = router_threads;
+
+	avl_set_maxthreads(router_threads + 1);
+
+	sigemptyset(&act.sa_mask);
+	act.sa_flags = 0;
+	act.sa_handler = term_handler;
+	sigaction(SIGTERM, &act, NULL);
+
+	if (tpp_init_router(&conf) == -1) {
+		fprintf(stderr, "router: tpp init failed\n");
+		return 1;
+	}
+
+	while (!got_term)
+		pause();
+
+	tpp_router_shutdown();
+	return 0;
+}
+
+/**
+ * @brief
+ *	Initialize this process as a TPP leaf at the given port
+ *
+ * @return	The fd to monitor for TPP events
+ * @retval	-1 - Failure
+ */
+static int
+leaf_init(int port)
+{
+	static struct tpp_config conf;
+	char routers[PBS_MAXHOSTNAME + 10];
+
+	snprintf(routers, sizeof(routers), "%s:%d", bench_host, router_port);
+	if (set_tpp_config(&pbs_conf, &conf, bench_host, port, routers) == -1) {
+		fprintf(stderr, "leaf %d: error setting TPP config\n", port);
+		return -1;
+	}
+	conf.node_type = TPP_LEAF_NODE;
+	conf.numthreads = 1;
+
+	return tpp_init(&conf);
+}
+
+/**
+ * @brief
+ *	Wait up to ms milliseconds for TPP to have something for the app
+ */
+static void
+leaf_wait(int tpp_fd, int ms)
+{
+	struct pollfd pfd;
+
+	pfd.fd = tpp_fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	(void) poll(&pfd, 1, ms);
+}
+
+/**
+ * @brief
+ *	Read the benchmark header of the next message on a stream, and skip
+ *	past the rest of the message
+ *
+ * @return	Error code
+ * @retval	-1 - No message, the stream was closed
+ * @retval	 0 - Success
+ */
+static int
+leaf_read(int sd, bench_hdr_t *hdr)
+{
+	char *p = (char *) hdr;
+	int got = 0;
+	int n;
+
+	while (got < sizeof(bench_hdr_t)) {
+		if ((n = tpp_recv(sd, p + got, sizeof(bench_hdr_t) - got)) <= 0)
+			break;
+		got += n;
+	}
+	tpp_eom(sd);
+	return (got == sizeof(bench_hdr_t)) ? 0 : -1;
+}
+
+/**
+ * @brief
+ *	Send a header only control message on a stream
+ */
+static int
+leaf_send_ctl(int sd, int type, uint32_t id)
+{
+	bench_hdr_t hdr;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.type = type;
+	hdr.id = id;
+	hdr.ts = now_ns();
+	return (tpp_send(sd, &hdr, sizeof(hdr)) == sizeof(hdr)) ? 0 : -1;
+}
+
+/**
+ * @brief
+ *	Run a receiving leaf: say hello to the driver until it answers, then
+ *	record the latency of every data message until the driver is done
+ *
+ * @param[in] idx    - index of this receiver
+ * @param[in] out_fd - pipe to write the results to
+ *
+ * @return	exit status of the receiver process
+ */
+static int
+run_receiver(int idx, int out_fd)
+{
+	int tpp_fd;
+	int sd = -1;
+	int hello_ok = 0;
+	int done = 0;
+	int ack_every;
+	uint64_t hello_at = 0;
+	uint64_t *lat;
+	bench_result_t res;
+	bench_hdr_t hdr;
+	int rsd;
+	uint64_t t;
+
+	if ((lat = malloc(num_msgs * sizeof(uint64_t))) == NULL) {
+		fprintf(stderr, "receiver %d: out of memory\n", idx);
+		return 1;
+	}
+	memset(&res, 0, sizeof(res));
+	ack_every = (window > 1) ? window / 2 : 1;
+
+	if ((tpp_fd = leaf_init(router_port + 2 + idx)) == -1)
+		return 1;
+
+	while (!done) {
+		if (!hello_ok && now_ns() - hello_at > 1000000000ULL) {
+			/* (re)try hello, the driver may not have joined yet */
+			if (sd != -1)
+				tpp_close(sd);
+			if ((sd = tpp_open(bench_host, router_port + 1)) != -1)
+				leaf_send_ctl(sd, BENCH_MSG_HELLO, idx);
+			hello_at = now_ns();
+		}
+
+		leaf_wait(tpp_fd, 100);
+
+		while ((rsd = tpp_poll()) >= 0) {
+			if (leaf_read(rsd, &hdr) != 0) {
+				tpp_close(rsd);
+				if (rsd == sd) {
+					if (hello_ok) {
+						fprintf(stderr, "receiver %d: lost driver\n", idx);
+						return 1;
+					}
+					sd = -1;
+				}
+				continue;
+			}
+			switch (hdr.type) {
+				case BENCH_MSG_HELLO:
+					hello_ok = 1;
+					break;
+
+				case BENCH_MSG_DATA:
+					t = now_ns();
+					if (res.count == 0)
+						res.first_ns = t;
+					res.last_ns = t;
+					lat[res.count++] = t - hdr.ts;
+					if (res.count % ack_every == 0)
+						leaf_send_ctl(sd, BENCH_MSG_ACK, (uint32_t) res.count);
+					break;
+
+				case BENCH_MSG_DONE:
+					leaf_send_ctl(sd, BENCH_MSG_DONE, (uint32_t) res.count);
+					done = 1;
+					break;
+			}
+		}
+	}
+
+	/* give the final ack time to leave before the TPP thread goes away */
+	leaf_wait(tpp_fd, 200);
+
+	if (write_all(out_fd, &res, sizeof(res)) != 0 ||
+	    write_all(out_fd, lat, res.count * sizeof(uint64_t)) != 0)
+		return 1;
+
+	tpp_shutdown();
+	free(lat);
+	return 0;
+}
+
+/**
+ * @brief
+ *	Handle every message waiting for the driver
+ *
+ * @param[in,out] rsd   - stream of each receiver, filled in as they say hello
+ * @param[in,out] acked - messages acknowledged by each receiver
+ * @param[in,out] ready - number of receivers that said hello
+ * @param[in,out] done  - number of receivers that sent their final ack
+ *
+ * @return	Error code
+ * @retval	-1 - A receiver went away
+ * @retval	 0 - Success
+ */
+static int
+driver_events(int *rsd, uint64_t *acked, int *ready, int *done)
+{
+	bench_hdr_t hdr;
+	int sd;
+
+	while ((sd = tpp_poll()) >= 0) {
+		if (leaf_read(sd, &hdr) != 0) {
+			tpp_close(sd);
+			if (*ready > 0) {
+				fprintf(stderr, "driver: lost a receiver\n");
+				return -1;
+			}
+			continue;
+		}
+		if (hdr.type == BENCH_MSG_HELLO && hdr.id >= (uint32_t) num_receivers)
+			continue;
+
+		switch (hdr.type) {
+			case BENCH_MSG_HELLO:
+				if (rsd[hdr.id] == -1) {
+					rsd[hdr.id] = sd;
+					(*ready)++;
+				}
+				leaf_send_ctl(sd, BENCH_MSG_HELLO, hdr.id);
+				break;
+
+			case BENCH_MSG_ACK:
+			case BENCH_MSG_DONE: {
+				int i;
+
+				for (i = 0; i < num_receivers; i++) {
+					if (rsd[i] == sd) {
+						acked[i] = hdr.id;
+						if (hdr.type == BENCH_MSG_DONE)
+							(*done)++;
+						break;
+					}
+				}
+			} break;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief
+ *	Run the driving leaf: wait for every receiver, then send the messages
+ *	keeping at most "window" of them unacknowledged per receiver
+ *
+ * @param[in] out_fd - pipe to write the results to
+ *
+ * @return	exit status of the driver process
+ */
+static int
+run_driver(int out_fd)
+{
+	int tpp_fd;
+	int *rsd;
+	uint64_t *sent;
+	uint64_t *acked;
+	int ready = 0;
+	int done = 0;
+	int mtfd = -1;
+	int nmembers;
+	char *buf;
+	bench_hdr_t *hdr;
+	bench_result_t res;
+	long seq;
+	int i;
+
+	rsd = malloc(num_receivers * sizeof(int));
+	sent = calloc(num_receivers, sizeof(uint64_t));
+	acked = calloc(num_receivers, sizeof(uint64_t));
+	buf = calloc(1, msg_size);
+	if (!rsd || !sent || !acked || !buf) {
+		fprintf(stderr, "driver: out of memory\n");
+		return 1;
+	}
+	for (i = 0; i < num_receivers; i++)
+		rsd[i] = -1;
+	hdr = (bench_hdr_t *) buf;
+	hdr->type = BENCH_MSG_DATA;
+
+	if ((tpp_fd = leaf_init(router_port + 1)) == -1)
+		return 1;
+
+	while (ready < num_receivers) {
+		leaf_wait(tpp_fd, 100);
+		if (driver_events(rsd, acked, &ready, &done) != 0)
+			return 1;
+	}
+
+	nmembers = (fanout > 0) ? fanout : 1;
+	if (fanout > 0) {
+		if ((mtfd = tpp_mcast_open()) == -1) {
+			fprintf(stderr, "driver: tpp_mcast_open failed\n");
+			return 1;
+		}
+		for (i = 0; i < fanout; i++) {
+			if (tpp_mcast_add_strm(mtfd, rsd[i], false) != 0) {
+				fprintf(stderr, "driver: tpp_mcast_add_strm failed\n");
+				return 1;
+			}
+		}
+	}
+
+	memset(&res, 0, sizeof(res));
+	res.first_ns = now_ns();
+
+	for (seq = 0; seq < num_msgs; seq++) {
+		int r = (fanout > 0) ? 0 : (seq % num_receivers);
+
+		/* wait for the window of the receiver(s) to open */
+		for (;;) {
+			for (i = r; i < r + nmembers; i++) {
+				if (sent[i] - acked[i] >= window)
+					break;
+			}
+			if (i == r + nmembers)
+				break;
+			leaf_wait(tpp_fd, 10);
+			if (driver_events(rsd, acked, &ready, &done) != 0)
+				return 1;
+		}
+
+		hdr->seq = seq;
+		hdr->ts = now_ns();
+		if (fanout > 0) {
+			char *copy;
+
+			/* tpp_mcast_send takes over the buffer */
+			if ((copy = malloc(msg_size)) == NULL) {
+				fprintf(stderr, "driver: out of memory\n");
+				return 1;
+			}
+			memcpy(copy, buf, msg_size);
+			if (tpp_mcast_send(mtfd, copy, msg_size, msg_size) != msg_size) {
+				fprintf(stderr, "driver: tpp_mcast_send failed\n");
+				return 1;
+			}
+		} else if (tpp_send(rsd[r], buf, msg_size) != msg_size) {
+			fprintf(stderr, "driver: tpp_send failed\n");
+			return 1;
+		}
+		for (i = r; i < r + nmembers; i++)
+			sent[i]++;
+		res.count++;
+
+		if (driver_events(rsd, acked, &ready, &done) != 0)
+			return 1;
+	}
+	res.last_ns = now_ns();
+
+	for (i = 0; i < num_receivers; i++)
+		leaf_send_ctl(rsd[i], BENCH_MSG_DONE, 0);
+
+	while (done < num_receivers) {
+		leaf_wait(tpp_fd, 100);
+		if (driver_events(rsd, acked, &ready, &done) != 0)
+			return 1;
+	}
+
+	if (mtfd != -1)
+		tpp_mcast_close(mtfd);
+
+	if (write_all(out_fd, &res, sizeof(res)) != 0)
+		return 1;
+
+	tpp_shutdown();
+	return 0;
+}
+
+/**
+ * @brief
+ *	Wait until the router accepts connections on its port
+ *
+ * @return	Error code
+ * @retval	-1 - Router did not come up in time
+ * @retval	 0 - Success
+ */
+static int
+wait_for_router(void)
+{
+	struct sockaddr_in in;
+	int i;
+
+	memset(&in, 0, sizeof(in));
+	in.sin_family = AF_INET;
+	in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	in.sin_port = htons(router_port);
+
+	for (i = 0; i < 100; i++) {
+		int sock;
+		int rc;
+
+		if ((sock = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+			return -1;
+		rc = connect(sock, (struct sockaddr *) &in, sizeof(in));
+		close(sock);
+		if (rc == 0)
+			return 0;
+		usleep(100000);
+	}
+	return -1;
+}
+
+/**
+ * @brief
+ *	Fork a benchmark process running the given role
+ *
+ * @param[in]  role   - -2 router, -1 driver, else receiver index
+ * @param[out] out_fd - read end of the pipe the child reports on
+ *
+ * @return	pid of the child
+ * @retval	-1 - Failure
+ */
+static pid_t
+start_proc(int role, int *out_fd)
+{
+	int pfd[2];
+	pid_t pid;
+	int rc;
+
+	if (pipe(pfd) == -1) {
+		perror("pipe");
+		return -1;
+	}
+	if ((pid = fork()) == -1) {
+		perror("fork");
+		return -1;
+	}
+	if (pid > 0) {
+		close(pfd[1]);
+		*out_fd = pfd[0];
+		return pid;
+	}
+
+	close(pfd[0]);
+	if (load_auths(AUTH_SERVER)) {
+		fprintf(stderr, "failed to load auth lib\n");
+		exit(1);
+	}
+	if (role == -2)
+		rc = run_router();
+	else if (role == -1)
+		rc = run_driver(pfd[1]);
+	else
+		rc = run_receiver(role, pfd[1]);
+	unload_auths();
+	exit(rc);
+}
+
+static int
+cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a;
+	uint64_t y = *(const uint64_t *) b;
+
+	return (x < y) ? -1 : (x > y);
+}
+
+static double
+cpu_secs(struct rusage *ru)
+{
+	return ru->ru_utime.tv_sec + ru->ru_utime.tv_usec / 1e6 +
+	       ru->ru_stime.tv_sec + ru->ru_stime.tv_usec / 1e6;
+}
+
+static void
+usage(char *prog)
+{
+	fprintf(stderr, "usage: %s [-H host] [-p router_port] [-l receivers] [-s msg_size] [-n messages]\n"
+			"\t[-f fanout] [-w window] [-t router_threads] [-L logfile]\n"
+			"\t-f 0 sends round robin to the receivers, -f N multicasts to the first N\n",
+		prog);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int c;
+	pid_t router_pid;
+	pid_t driver_pid;
+	pid_t *recv_pid;
+	int router_fd;
+	int driver_fd;
+	int *recv_fd;
+	bench_result_t dres;
+	bench_result_t rres;
+	uint64_t *lat = NULL;
+	uint64_t nlat = 0;
+	uint64_t last_ns;
+	struct rusage ru;
+	double router_cpu;
+	double leaf_cpu = 0;
+	double secs;
+	int status;
+	int failed = 0;
+	int i;
+
+	while ((c = getopt(argc, argv, "H:p:l:s:n:f:w:t:L:")) != -1) {
+		switch (c) {
+			case 'H':
+				snprintf(bench_host, sizeof(bench_host), "%s", optarg);
+				break;
+			case 'p':
+				router_port = atoi(optarg);
+				break;
+			case 'l':
+				num_receivers = atoi(optarg);
+				break;
+			case 's':
+				msg_size = atoi(optarg);
+				break;
+			case 'n':
+				num_msgs = atol(optarg);
+				break;
+			case 'f':
+				fanout = atoi(optarg);
+				break;
+			case 'w':
+				window = atoi(optarg);
+				break;
+			case 't':
+				router_threads = atoi(optarg);
+				break;
+			case 'L':
+				logfile = optarg;
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (num_receivers < 1 || num_msgs < 1 || window < 1 || router_threads < 1 ||
+	    fanout < 0 || fanout > num_receivers || router_port < 1 || router_port + 2 + num_receivers > 65535) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (bench_host[0] == '\0' && gethostname(bench_host, sizeof(bench_host)) == -1) {
+		perror("gethostname");
+		return 1;
+	}
+	if (msg_size < (int) sizeof(bench_hdr_t))
+		msg_size = sizeof(bench_hdr_t);
+
+	if (pbs_loadconf(0) == 0) {
+		fprintf(stderr, "%s: failed to load pbs.conf\n", argv[0]);
+		return 1;
+	}
+	(void) log_open(logfile, "");
+
+	signal(SIGPIPE, SIG_IGN);
+
+	recv_pid = calloc(num_receivers, sizeof(pid_t));
+	recv_fd = calloc(num_receivers, sizeof(int));
+	if (!recv_pid || !recv_fd) {
+		fprintf(stderr, "%s: out of memory\n", argv[0]);
+		return 1;
+	}
+
+	if ((router_pid = start_proc(-2, &router_fd)) == -1)
+		return 1;
+	if (wait_for_router() != 0) {
+		fprintf(stderr, "%s: pbs_comm did not start on port %d\n", argv[0], router_port);
+		kill(router_pid, SIGTERM);
+		return 1;
+	}
+	if ((driver_pid = start_proc(-1, &driver_fd)) == -1)
+		return 1;
+	for (i = 0; i < num_receivers; i++) {
+		if ((recv_pid[i] = start_proc(i, &recv_fd[i])) == -1)
+			return 1;
+	}
+
+	/* collect the results, latencies of all receivers are pooled */
+	last_ns = 0;
+	for (i = 0; i < num_receivers; i++) {
+		uint64_t *tmp;
+
+		if (read_all(recv_fd[i], &rres, sizeof(rres)) != 0) {
+			failed = 1;
+			continue;
+		}
+		if ((tmp = realloc(lat, (nlat + rres.count + 1) * sizeof(uint64_t))) == NULL) {
+			fprintf(stderr, "%s: out of memory\n", argv[0]);
+			return 1;
+		}
+		lat = tmp;
+		if (read_all(recv_fd[i], lat + nlat, rres.count * sizeof(uint64_t)) != 0) {
+			failed = 1;
+			continue;
+		}
+		nlat += rres.count;
+		if (rres.last_ns > last_ns)
+			last_ns = rres.last_ns;
+	}
+	if (read_all(driver_fd, &dres, sizeof(dres)) != 0)
+		failed = 1;
+
+	for (i = 0; i < num_receivers; i++) {
+		if (wait4(recv_pid[i], &status, 0, &ru) == recv_pid[i])
+			leaf_cpu += cpu_secs(&ru);
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			failed = 1;
+	}
+	if (wait4(driver_pid, &status, 0, &ru) == driver_pid)
+		leaf_cpu += cpu_secs(&ru);
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		failed = 1;
+
+	kill(router_pid, SIGTERM);
+	router_cpu = 0;
+	if (wait4(router_pid, &status, 0, &ru) == router_pid)
+		router_cpu = cpu_secs(&ru);
+
+	if (failed || nlat == 0) {
+		fprintf(stderr, "%s: benchmark failed, see %s for TPP logs\n", argv[0], logfile);
+		return 1;
+	}
+
+	qsort(lat, nlat, sizeof(uint64_t), cmp_u64);
+	secs = (last_ns - dres.first_ns) / 1e9;
+
+	printf("pattern:    %s, %d receivers, %d byte messages, window %d, %d pbs_comm threads\n",
+	       (fanout > 0) ? "multicast" : "unicast round robin", num_receivers, msg_size, window, router_threads);
+	if (fanout > 0)
+		printf("fanout:     %d\n", fanout);
+	printf("sent:       %lu messages\n", (unsigned long) dres.count);
+	printf("delivered:  %lu messages in %.3f s, %.0f msgs/s, %.2f MB/s\n",
+	       (unsigned long) nlat, secs, nlat / secs, nlat * (double) msg_size / secs / 1e6);
+	printf("latency:    p50 %.1f us, p99 %.1f us, max %.1f us\n",
+	       lat[nlat / 2] / 1e3, lat[(nlat * 99) / 100] / 1e3, lat[nlat - 1] / 1e3);
+	printf("cpu:        pbs_comm %.3f s, leaves %.3f s, %.2f us per delivered message\n",
+	       router_cpu, leaf_cpu, (router_cpu + leaf_cpu) * 1e6 / nlat);
+
+	free(lat);
+	return 0;
+}
@@ -0,0 +1,135 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+
+from tests.functional import *
+
+
+class TestInternedStrings(TestFunctional):
+    """
+    Test suite for string attribute values shared between jobs and
+    nodes, such as queue, Account_Name, project and
+    Resource_List.place. Changing the value of one object must leave
+    the others alone, also across a server restart.
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'False'})
+        a = {'queue_type': 'execution', 'enabled': 'True',
+             'started': 'True'}
+        self.server.manager(MGR_CMD_CREATE, QUEUE, a, id='workq2')
+
+    def submit_jobs(self, count, attrib):
+        """
+        Submit count jobs with the same attributes
+        """
+        jids = []
+        for _ in range(count):
+            j = Job(TEST_USER, attrib)
+            jids.append(self.server.submit(j))
+        return jids
+
+    def check_jobs(self, jids, attrib):
+        """
+        Check that every job in jids has the given attributes
+        """
+        for jid in jids:
+            self.server.expect(JOB, attrib, id=jid, max_attempts=1)
+
+    def test_shared_job_values(self):
+        """
+        Submit jobs sharing queue, account, project and place, change
+        these on some of the jobs and delete others, then check every
+        job kept its own values, before and after a server restart
+        """
+        a = {ATTR_A: 'acct1', ATTR_project: 'proj1',
+             ATTR_l + '.place': 'scatter'}
+        jids = self.submit_jobs(6, a)
+        exp = {ATTR_queue: 'workq', ATTR_A: 'acct1',
+               ATTR_project: 'proj1', 'Resource_List.place': 'scatter'}
+        self.check_jobs(jids, exp)
+
+        self.server.alterjob(jids[0], {ATTR_A: 'acct2',
+                                       ATTR_project: 'proj2',
+                                       ATTR_l + '.place': 'free'})
+        self.server.movejob(jids[1], 'workq2')
+        # back to the value the other jobs share
+        self.server.alterjob(jids[2], {ATTR_A: 'acct2'})
+        self.server.alterjob(jids[2], {ATTR_A: 'acct1'})
+        self.server.delete(jids[3])
+        self.server.expect(JOB, 'queue', id=jids[3], op=UNSET)
+
+        same = [jids[2], jids[4], jids[5]]
+        for _ in range(2):
+            self.check_jobs(same, exp)
+            self.check_jobs([jids[0]], {ATTR_queue: 'workq',
+                                        ATTR_A: 'acct2',
+                                        ATTR_project: 'proj2',
+                                        'Resource_List.place': 'free'})
+            self.check_jobs([jids[1]], {ATTR_queue: 'workq2',
+                                        ATTR_A: 'acct1',
+                                        ATTR_project: 'proj1'})
+            self.assertEqual(sorted(self.server.select({ATTR_A: 'acct1'})),
+                             sorted(same + [jids[1]]))
+            self.assertEqual(self.server.select({ATTR_A: 'acct2'}),
+                             [jids[0]])
+            self.server.restart()
+
+    def test_shared_node_queue(self):
+        """
+        Set the same queue and partition on vnodes, then change and
+        unset them on one of the vnodes only
+        """
+        a = {'resources_available.ncpus': 1}
+        self.mom.create_vnodes(a, 3, usenatvnode=False)
+        vnodes = ['%s[%d]' % (self.mom.shortname, i) for i in range(3)]
+        a = {'queue': 'workq2', 'partition': 'P1'}
+        for vn in vnodes:
+            self.server.manager(MGR_CMD_SET, NODE, a, id=vn)
+        self.server.manager(MGR_CMD_SET, NODE, {'queue': 'workq'},
+                            id=vnodes[0])
+        self.server.manager(MGR_CMD_UNSET, NODE, 'partition', id=vnodes[1])
+        for _ in range(2):
+            self.server.expect(NODE, {'queue': 'workq', 'partition': 'P1'},
+                               id=vnodes[0])
+            self.server.expect(NODE, {'queue': 'workq2'}, id=vnodes[1])
+            self.server.expect(NODE, 'partition', op=UNSET, id=vnodes[1])
+            self.server.expect(NODE, a, id=vnodes[2])
+            self.server.restart()
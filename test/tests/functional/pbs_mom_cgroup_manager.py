@@ -0,0 +1,121 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+
+from tests.functional import *
+
+
+class TestMomCgroupManager(TestFunctional):
+    """
+    Test MoM creating job cgroups herself when the $cgroup_manager mom
+    config parameter is set
+    """
+
+    cfg = {
+        "cgroup_prefix": "pbs_ptl_jobs",
+        "exclude_hosts": [],
+        "run_only_on_hosts": [],
+        "cgroup": {
+            "cpuset": {"enabled": True, "exclude_cpus": [],
+                       "exclude_hosts": []},
+            "memory": {"enabled": True, "exclude_hosts": [],
+                       "enforce_default": True, "default": "256MB"},
+            "memsw": {"enabled": False}
+        }
+    }
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        rv = self.du.run_cmd(self.mom.shortname,
+                             cmd=['grep', '-w', 'cgroup2', '/proc/mounts'])
+        if rv['rc'] != 0 or not rv['out']:
+            self.skipTest('cgroup v2 is not mounted on the MoM host')
+        self.cgbase = os.path.join(rv['out'][0].split()[1],
+                                   self.cfg['cgroup_prefix'])
+        cfgfile = self.du.create_temp_file(hostname=self.mom.shortname,
+                                           body=json.dumps(self.cfg))
+        self.cfpath = os.path.join(self.mom.pbs_conf['PBS_HOME'],
+                                   'mom_priv', 'hooks', 'pbs_cgroups.CF')
+        self.du.run_copy(self.mom.shortname, src=cfgfile, dest=self.cfpath,
+                         sudo=True)
+        self.mom.add_config({'$cgroup_manager': 'True'})
+
+    def tearDown(self):
+        self.du.rm(self.mom.shortname, self.cfpath, sudo=True, force=True)
+        TestFunctional.tearDown(self)
+
+    def test_job_cgroup_lifecycle(self):
+        """
+        Verify that a job runs in a cgroup limited to its cpus and
+        memory, and that the cgroup is removed when the job ends
+        """
+        a = {'Resource_List.select': '1:ncpus=1:mem=300mb'}
+        j = Job(TEST_USER, attrs=a)
+        j.set_sleep_time(20)
+        jid = self.server.submit(j)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.mom.log_match("%s;created cgroup" % jid)
+        cgdir = os.path.join(self.cgbase, jid)
+        rv = self.du.cat(self.mom.shortname,
+                         os.path.join(cgdir, 'memory.max'), sudo=True)
+        self.assertEqual(rv['out'][0], str(300 * 1024 * 1024))
+        rv = self.du.cat(self.mom.shortname,
+                         os.path.join(cgdir, 'cgroup.procs'), sudo=True)
+        self.assertTrue(rv['out'])
+
+        self.server.expect(JOB, 'queue', op=UNSET, id=jid, offset=20)
+        self.mom.log_match("%s;removed job cgroup" % jid)
+        self.assertFalse(self.du.isdir(self.mom.shortname, cgdir,
+                                       sudo=True))
+
+    def test_excluded_host(self):
+        """
+        Verify that no cgroup is created on a host listed in exclude_hosts
+        """
+        cfg = dict(self.cfg, exclude_hosts=[self.mom.shortname])
+        cfgfile = self.du.create_temp_file(hostname=self.mom.shortname,
+                                           body=json.dumps(cfg))
+        self.du.run_copy(self.mom.shortname, src=cfgfile, dest=self.cfpath,
+                         sudo=True)
+        j = Job(TEST_USER)
+        j.set_sleep_time(5)
+        jid = self.server.submit(j)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.mom.log_match("%s;created cgroup" % jid, existence=False,
+                           max_attempts=5)
@@ -0,0 +1,100 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+
+from tests.functional import *
+
+
+class TestMomCgroupSampling(TestFunctional):
+    """
+    Test MoM reading job usage from a cgroup v2 directory when the
+    $cgroup_sample_root mom config parameter is set
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.cgroot = self.du.create_temp_dir(hostname=self.mom.shortname)
+        self.mom.add_config({'$cgroup_sample_root': self.cgroot,
+                             '$min_check_poll': 5,
+                             '$max_check_poll': 5})
+
+    def write_cgroup(self, jid, usage_usec, mem_bytes, populated=1):
+        """
+        Populate a fake cgroup v2 directory for job jid
+        """
+        cgdir = os.path.join(self.cgroot, jid)
+        cmd = 'mkdir -p %s\n' % cgdir
+        cmd += 'echo "usage_usec %d" > %s\n' % (usage_usec,
+                                               os.path.join(cgdir,
+                                                            'cpu.stat'))
+        cmd += 'echo "%d" > %s\n' % (mem_bytes,
+                                     os.path.join(cgdir, 'memory.peak'))
+        cmd += 'echo "populated %d" > %s\n' % (populated,
+                                               os.path.join(cgdir,
+                                                            'cgroup.events'))
+        rv = self.du.run_cmd(self.mom.shortname, cmd=cmd, sudo=True,
+                             as_script=True)
+        self.assertEqual(rv['rc'], 0)
+
+    def test_usage_from_cgroup(self):
+        """
+        Verify that cput and mem reported for a job come from the
+        job's cgroup files instead of its processes
+        """
+        j = Job(TEST_USER)
+        j.set_sleep_time(1000)
+        jid = self.server.submit(j)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.write_cgroup(jid, 120 * 1000000, 100 * 1024 * 1024)
+        self.server.expect(JOB, {'resources_used.cput': '00:02:00',
+                                 'resources_used.mem': '102400kb'},
+                           id=jid, offset=5, interval=2, max_attempts=30)
+
+    def test_fallback_to_proc(self):
+        """
+        Verify that a job without a cgroup directory is still sampled
+        and that its end is detected through /proc
+        """
+        j = Job(TEST_USER)
+        j.set_sleep_time(10)
+        jid = self.server.submit(j)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.server.expect(JOB, 'resources_used.cput', op=SET, id=jid)
+        self.server.log_match(jid + ";Exit_status=0", interval=4,
+                              max_attempts=30)
@@ -0,0 +1,102 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+
+from tests.functional import *
+
+
+class TestMomHookExecutor(TestFunctional):
+    """
+    Test MoM running hooks through the hook executor enabled by the
+    $hook_executor mom config parameter
+    """
+
+    hook_body = """
+import pbs
+import os
+e = pbs.event()
+pbs.logmsg(pbs.LOG_DEBUG, "executor hook ran for %s in %s" %
+           (e.job.id, os.getcwd()))
+e.accept()
+"""
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.mom.add_config({'$hook_executor': 'True'})
+        self.sock = os.path.join(self.mom.pbs_conf['PBS_HOME'], 'mom_priv',
+                                 'hooks', 'tmp', 'executor.sock')
+
+    def test_hook_runs_in_executor(self):
+        """
+        Verify that an execjob_begin hook runs, and keeps running for
+        later jobs, once MoM has started the hook executor
+        """
+        a = {'event': 'execjob_begin', 'enabled': 'True'}
+        self.server.create_import_hook('hx', a, self.hook_body)
+        for _ in range(2):
+            j = Job(TEST_USER)
+            j.set_sleep_time(5)
+            jid = self.server.submit(j)
+            self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+            self.mom.log_match("executor hook ran for %s" % jid)
+        self.mom.log_match("hook executor started, pid")
+        self.assertTrue(self.du.isfile(self.mom.hostname, self.sock,
+                                       sudo=True))
+
+    def test_executor_stopped_when_disabled(self):
+        """
+        Verify that turning $hook_executor off stops the executor and
+        that hooks still run by executing pbs_python
+        """
+        a = {'event': 'execjob_begin', 'enabled': 'True'}
+        self.server.create_import_hook('hx', a, self.hook_body)
+        j = Job(TEST_USER)
+        j.set_sleep_time(5)
+        jid = self.server.submit(j)
+        self.mom.log_match("executor hook ran for %s" % jid)
+        self.mom.log_match("hook executor started, pid")
+
+        self.mom.unset_mom_config('$hook_executor', hup=True)
+        j = Job(TEST_USER)
+        j.set_sleep_time(5)
+        jid = self.server.submit(j)
+        self.mom.log_match("executor hook ran for %s" % jid)
+        self.mom.log_match("hook executor stopped")
+        self.assertFalse(self.du.isfile(self.mom.hostname, self.sock,
+                                        sudo=True))
@@ -362,6 +362,36 @@ class TestMomHookSync(TestFunctional):
             'to %s.*' % self.momB.hostname, existence=False,
             starttime=now, max_attempts=10, regexp=True)
 
+    def test_momhook_same_content_not_resent(self):
+        """
+        Kill mom, change the hook and change it back while mom is
+        down, so that the server queues sends of files mom already
+        has, then restart mom. The checksums mom reports on restart
+        match, so the queued sends are dropped instead of sent.
+        """
+        self.server.manager(MGR_CMD_SET, SERVER, {'log_events': 4095})
+        self.momB.signal('-KILL')
+        self.server.expect(NODE, {'state': 'down'}, id=self.hostB)
+
+        self.server.manager(MGR_CMD_SET, HOOK, {'alarm': 31},
+                            id=self.hook_name)
+        self.server.manager(MGR_CMD_SET, HOOK, {'alarm': 30},
+                            id=self.hook_name)
+
+        now = time.time()
+        self.momB.start()
+        self.server.expect(NODE, {'state': 'free'}, id=self.hostB)
+        self.server.log_match(
+            'mom %s already has matching content, ' % self.momB.hostname +
+            'dropping pending action', starttime=now, max_attempts=10)
+
+        self.logger.info("Waiting 3 secs for any hook updates to complete")
+        time.sleep(3)
+        self.server.log_match(
+            'successfully sent hook file .*cpufreq.HK ' +
+            'to %s.*' % self.momB.hostname, existence=False,
+            starttime=now, max_attempts=10, regexp=True)
+
     def compare_rescourcedef(self):
         srvret = None
 
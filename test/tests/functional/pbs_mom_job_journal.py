@@ -0,0 +1,117 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+
+from tests.functional import *
+
+
+class TestMomJobStateJournal(TestFunctional):
+    """
+    Test MoM saving job and task state through the journal enabled by
+    the $job_state_journal mom config parameter
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.mom.add_config({'$job_state_journal': 'True'})
+        self.journal = os.path.join(self.mom.pbs_conf['PBS_HOME'],
+                                    'mom_priv', 'jobs', 'journal')
+
+    def test_journal_replay_on_restart(self):
+        """
+        Verify that state journaled for a running job is applied when
+        MoM is killed and restarted, and that the job keeps running
+        """
+        j = Job(TEST_USER)
+        j.set_sleep_time(60)
+        jid = self.server.submit(j)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.assertTrue(self.du.isfile(self.mom.hostname, self.journal,
+                                       sudo=True))
+
+        self.mom.signal('-KILL')
+        self.mom.start(args=['-p'])
+        self.mom.log_match("applied [0-9]+ journal records", regexp=True)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.server.expect(JOB, 'queue', op=UNSET, id=jid, offset=60)
+
+    def test_journal_skips_records_older_than_file(self):
+        """
+        Verify that journal records of a job are not replayed over a
+        job file written after them, as a forked MoM child writes it
+        """
+        j = Job(TEST_USER)
+        j.set_sleep_time(60)
+        jid = self.server.submit(j)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.assertTrue(self.du.isfile(self.mom.hostname, self.journal,
+                                       sudo=True))
+
+        self.mom.signal('-KILL')
+        # stands in for a direct write of the job file after the records
+        jobfile = os.path.join(self.mom.pbs_conf['PBS_HOME'], 'mom_priv',
+                               'jobs', jid + '.JB')
+        rv = self.du.run_cmd(self.mom.hostname, cmd=['touch', jobfile],
+                             sudo=True)
+        self.assertEqual(rv['rc'], 0)
+        self.mom.start(args=['-p'])
+        self.mom.log_match("skipped [1-9][0-9]* older than their files",
+                           regexp=True)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.server.expect(JOB, 'queue', op=UNSET, id=jid, offset=60)
+
+    def test_journal_removed_when_disabled(self):
+        """
+        Verify that turning $job_state_journal off folds the journal
+        into the job files and removes it
+        """
+        j = Job(TEST_USER)
+        j.set_sleep_time(60)
+        jid = self.server.submit(j)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.assertTrue(self.du.isfile(self.mom.hostname, self.journal,
+                                       sudo=True))
+
+        self.mom.add_config({'$job_state_journal': 'False'})
+        self.mom.signal('-HUP')
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        # the journal is removed on MoM's next pass through her main loop
+        time.sleep(2)
+        self.assertFalse(self.du.isfile(self.mom.hostname, self.journal,
+                                        sudo=True))
@@ -0,0 +1,96 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+import os
+import re
+
+
+class TestMomLaunchLatency(TestFunctional):
+    """
+    Test the launch latency MoM records for jobs and tasks
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.mom.add_config({'$logevent': '0xffffffff'})
+
+    def launch_latency(self):
+        """
+        Query the launch_latency resource of the mom and return, for
+        'job' and 'task', the count and the sum of the bucket counts
+        """
+        rmget = os.path.join(self.server.pbs_conf['PBS_EXEC'],
+                             'unsupported', 'pbs_rmget')
+        cmd = [rmget, '-m', self.mom.shortname, 'launch_latency']
+        rv = self.du.run_cmd(self.server.hostname, cmd, sudo=True)
+        self.assertEqual(rv['rc'], 0, 'pbs_rmget failed: %s' % rv['err'])
+        out = ' '.join(rv['out'])
+        self.assertIn('launch_latency=job count=', out)
+        res = {}
+        for which in ['job', 'task']:
+            m = re.search(r'%s count=(\d+) avg=\S+ max=\S+((?: \w+=\d+)+)'
+                          % which, out)
+            self.assertIsNotNone(m, 'no %s histogram in %s' % (which, out))
+            buckets = [int(b.split('=')[1]) for b in m.group(2).split()]
+            res[which] = (int(m.group(1)), sum(buckets))
+        self.logger.info('launch_latency: %s' % res)
+        return res
+
+    def test_job_and_task_latency(self):
+        """
+        Verify that the launch of a job and of a task spawned into it
+        are timed in the mom log and counted in the launch_latency
+        histograms of the resource monitor
+        """
+        before = self.launch_latency()
+        script = ['pbsdsh -n 0 -- /bin/true', 'sleep 1']
+        j = Job(TEST_USER)
+        j.create_script('\n'.join(script))
+        jid = self.server.submit(j)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.mom.log_match(
+            "%s;job launched in [0-9.]+ msecs" % jid, regexp=True)
+        self.mom.log_match(
+            "%s;task launched in [0-9.]+ msecs" % jid, regexp=True)
+        after = self.launch_latency()
+        for which in ['job', 'task']:
+            self.assertGreater(after[which][0], before[which][0])
+            self.assertGreater(after[which][1], before[which][1])
+            self.assertEqual(after[which][0], after[which][1])
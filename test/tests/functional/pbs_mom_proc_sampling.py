@@ -0,0 +1,167 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+
+from tests.functional import *
+
+
+class TestMomProcSampling(TestFunctional):
+    """
+    Test MoM sampling job usage from the processes of the job's tasks
+    and killing the job's processes
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        ret = self.du.run_cmd(self.mom.shortname, cmd=['nproc'])
+        if ret['rc'] != 0 or int(ret['out'][0]) < 2:
+            self.skipTest("Test requires a mom host with 2 or more cpus")
+        self.mom.add_config({'$min_check_poll': 5,
+                             '$max_check_poll': 5})
+        a = {'resources_available.ncpus': 4}
+        self.server.manager(MGR_CMD_SET, NODE, a, id=self.mom.shortname)
+        self.pbsdsh = os.path.join(self.server.pbs_conf['PBS_EXEC'],
+                                   'bin', 'pbsdsh')
+
+    def create_script(self, body):
+        """
+        Create an executable script on the mom host
+        """
+        fn = self.du.create_temp_file(hostname=self.mom.shortname,
+                                      body=body, asuser=TEST_USER)
+        self.du.chmod(hostname=self.mom.shortname, path=fn, mode=0o755,
+                      sudo=True)
+        return fn
+
+    def procs_left(self, fn):
+        """
+        Return the pids of the processes running the script fn on the
+        mom host
+        """
+        # bracket a character so that the pattern does not match itself
+        d, b = os.path.split(fn)
+        pattern = os.path.join(d, '[%s]%s' % (b[0], b[1:]))
+        ret = self.du.run_cmd(self.mom.shortname, cmd=['pgrep', '-f',
+                                                       pattern])
+        return [p for p in ret['out'] if p.strip()]
+
+    def get_usage(self, jid):
+        """
+        Return the cput and walltime in seconds and the mem of a job
+        """
+        st = self.server.status(JOB, id=jid)[0]
+        bu = BatchUtils()
+        cput = bu.convert_duration(st.get('resources_used.cput', '0'))
+        wall = bu.convert_duration(st.get('resources_used.walltime', '0'))
+        mem = PbsTypeSize(st.get('resources_used.mem', '0kb'))
+        return (int(cput), int(wall), mem)
+
+    def test_multitask_usage_and_kill(self):
+        """
+        Run a job with two tasks, each running two busy processes that
+        hold 20mb of memory, check that cput and mem add up over all
+        the processes of both tasks, then check that qdel kills every
+        process of the job
+        """
+        busy = self.create_script("#!/bin/bash\n"
+                                  "x=$(head -c 20000000 /dev/zero | "
+                                  "tr '\\0' a)\n"
+                                  "while :; do :; done\n")
+        task = self.create_script("#!/bin/bash\n"
+                                  "%s &\n%s &\nwait\n" % (busy, busy))
+        a = {'Resource_List.select': '1:ncpus=4', ATTR_S: '/bin/bash'}
+        j = Job(TEST_USER, attrs=a)
+        j.create_script(body=["%s -n 0 -- %s &" % (self.pbsdsh, task),
+                              "%s -n 0 -- %s &" % (self.pbsdsh, task),
+                              "wait"])
+        jid = self.server.submit(j)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.server.expect(JOB, 'resources_used.walltime', op=SET, id=jid)
+
+        # each task's processes hold 40mb, both together at least 80mb
+        usage = None
+        for _ in range(30):
+            usage = self.get_usage(jid)
+            if usage[1] >= 20 and usage[2] >= PbsTypeSize('80mb'):
+                break
+            time.sleep(2)
+        self.logger.info("cput=%d walltime=%d mem=%s" % usage)
+        self.assertGreaterEqual(usage[2], PbsTypeSize('80mb'))
+        # four busy processes on two or more cpus
+        self.assertGreaterEqual(usage[0], usage[1] * 3 // 2)
+
+        self.assertEqual(len(self.procs_left(busy)), 4)
+        self.server.delete(jid)
+        self.server.expect(JOB, 'queue', id=jid, op=UNSET)
+        for _ in range(10):
+            if not self.procs_left(busy):
+                break
+            time.sleep(1)
+        self.assertEqual(self.procs_left(busy), [],
+                         "Processes of the job are left after qdel")
+
+    def test_paren_in_command_name(self):
+        """
+        Run a job whose busy process renames itself to a command name
+        holding ') ' and field like text, and check that its cput is
+        still counted, and keeps growing over later samples
+        """
+        busy = self.create_script("#!/bin/bash\n"
+                                  "printf 'ptl) R 1 1 (x' > /proc/self/comm\n"
+                                  "while :; do :; done\n")
+        a = {'Resource_List.select': '1:ncpus=1', ATTR_S: '/bin/bash'}
+        j = Job(TEST_USER, attrs=a)
+        j.create_script(body=[busy])
+        jid = self.server.submit(j)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.server.expect(JOB, 'resources_used.walltime', op=SET, id=jid)
+
+        last = 0
+        for _ in range(3):
+            usage = None
+            for _ in range(15):
+                usage = self.get_usage(jid)
+                if usage[0] >= last + 10:
+                    break
+                time.sleep(2)
+            self.logger.info("cput=%d walltime=%d mem=%s" % usage)
+            self.assertGreaterEqual(usage[0], last + 10)
+            last = usage[0]
+        self.server.delete(jid)
+        self.server.expect(JOB, 'queue', id=jid, op=UNSET)
@@ -0,0 +1,136 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+@requirements(num_moms=4)
+class TestMomSisterTree(TestFunctional):
+    """
+    Test sister MoMs joining a job and reporting usage through a
+    fanout tree when the $sister_tree_fanout mom config parameter is set
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        if len(self.moms) < 4:
+            self.skipTest("test requires four MoMs as input, " +
+                          "use -p moms=<m1>:<m2>:<m3>:<m4>")
+        self.server.manager(MGR_CMD_SET, SERVER,
+                            {'job_history_enable': 'True'})
+
+    def submit_wide_job(self):
+        """
+        Submit a job spanning all the MoMs and return its id
+        """
+        a = {'Resource_List.select': '%d:ncpus=1' % len(self.moms),
+             'Resource_List.place': 'scatter'}
+        j = Job(TEST_USER, attrs=a)
+        j.set_sleep_time(10)
+        jid = self.server.submit(j)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        return jid
+
+    def test_tree_join(self):
+        """
+        Verify that a job wider than the fanout joins through the tree,
+        runs and ends normally with its usage reported
+        """
+        for mom in self.moms.values():
+            mom.add_config({'$sister_tree_fanout': 2})
+        jid = self.submit_wide_job()
+        ms = self.server.status(JOB, 'exec_host', id=jid)[0]['exec_host']
+        ms = ms.split('/')[0]
+        self.moms[ms].log_match(
+            "%s;sisters join through a tree of fanout 2" % jid)
+        self.server.expect(JOB, {'job_state': 'F',
+                                 'Exit_status': 0}, id=jid,
+                           extend='x', offset=10)
+        self.server.expect(JOB, 'resources_used.cput', op=SET, id=jid,
+                           extend='x')
+
+    def test_tree_not_used_by_default(self):
+        """
+        Verify that without $sister_tree_fanout every sister
+        joins directly
+        """
+        jid = self.submit_wide_job()
+        ms = self.server.status(JOB, 'exec_host', id=jid)[0]['exec_host']
+        ms = ms.split('/')[0]
+        self.moms[ms].log_match("%s;sisters join through a tree" % jid,
+                                existence=False, max_attempts=5)
+        self.server.expect(JOB, {'job_state': 'F',
+                                 'Exit_status': 0}, id=jid,
+                           extend='x', offset=10)
+
+    def test_tree_hook_resources_used(self):
+        """
+        Verify that resources_used values set by a mom hook on the
+        sisters below an intermediate node of the tree reach Mother
+        Superior and are accumulated once per node
+        """
+        for mom in self.moms.values():
+            mom.add_config({'$sister_tree_fanout': 2})
+        attr = {'type': 'long', 'flag': 'h'}
+        self.server.manager(MGR_CMD_CREATE, RSC, attr, id='foo_i',
+                            runas=ROOT_USER)
+        for mom in self.moms.values():
+            mom.log_match("resourcedef;copy hook-related file")
+        hook_body = """
+import pbs
+e = pbs.event()
+for jk in e.job_list.keys():
+    e.job_list[jk].resources_used["foo_i"] = 1
+"""
+        a = {'event': 'exechost_periodic', 'enabled': 'True', 'freq': 15}
+        self.server.create_import_hook('tree_used', a, hook_body,
+                                       overwrite=True)
+        a = {'Resource_List.select': '%d:ncpus=1' % len(self.moms),
+             'Resource_List.place': 'scatter'}
+        j = Job(TEST_USER, attrs=a)
+        j.set_sleep_time(60)
+        jid = self.server.submit(j)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        n = str(len(self.moms))
+        self.server.expect(JOB, {'job_state': 'R',
+                                 'resources_used.foo_i': n},
+                           attrop=PTL_AND, id=jid, offset=30)
+        self.server.expect(JOB, {'job_state': 'F',
+                                 'resources_used.foo_i': n},
+                           attrop=PTL_AND, id=jid, extend='x', offset=20)
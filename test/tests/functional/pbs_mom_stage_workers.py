@@ -0,0 +1,103 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+class TestMomStageWorkers(TestFunctional):
+    """
+    Test staging several file pairs of a job at the same time when
+    the $stage_workers mom config parameter is set
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.mom.add_config({'$logevent': '0xffffffff'})
+
+    def stagein_job(self, nfiles, extra=None):
+        """
+        Submit a job staging in nfiles files from this host, each one
+        checked by the job, plus the extra stagein pair if given,
+        and return its id
+        """
+        srcdir = self.du.create_temp_dir(asuser=TEST_USER)
+        pairs = []
+        for i in range(nfiles):
+            f = self.du.create_temp_file(dirname=srcdir, asuser=TEST_USER,
+                                         body='file %d\n' % i * 1000)
+            pairs.append('in%d@%s:%s' % (i, self.server.hostname, f))
+        if extra is not None:
+            pairs.append(extra)
+        script = ['for i in $(seq 0 %d); do' % (nfiles - 1),
+                  '    test -s in$i || exit 1',
+                  'done']
+        j = Job(TEST_USER, attrs={ATTR_stagein: ','.join(pairs),
+                                  ATTR_k: 'oe'})
+        j.create_script('\n'.join(script))
+        jid = self.server.submit(j)
+        return jid
+
+    def test_parallel_stagein(self):
+        """
+        Verify that with $stage_workers every file is staged in,
+        timed in the mom log, and the job finds all of them
+        """
+        self.server.manager(MGR_CMD_SET, SERVER,
+                            {'job_history_enable': 'True'})
+        self.mom.add_config({'$stage_workers': 4})
+        jid = self.stagein_job(6)
+        self.server.expect(JOB, {'job_state': 'F', 'Exit_status': 0},
+                           id=jid, extend='x', offset=2)
+        for i in range(1, 7):
+            self.mom.log_match("%s;stagein %d/6 " % (jid, i))
+        self.mom.log_match("%s;stagein .* done in .* secs" % jid,
+                           regexp=True)
+
+    def test_stagein_failure(self):
+        """
+        Verify that when one of the files cannot be staged in with
+        $stage_workers set, the failure is logged and the job
+        does not run
+        """
+        self.mom.add_config({'$stage_workers': 4})
+        bad = 'bad@%s:/nonexistent/stagein' % self.server.hostname
+        jid = self.stagein_job(2, extra=bad)
+        self.mom.log_match("%s;stagein .* failed in" % jid, regexp=True)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid, op=NE,
+                           max_attempts=5)
@@ -0,0 +1,124 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+
+from tests.functional import *
+
+
+class TestObjectIndex(TestFunctional):
+    """
+    Test suite for looking up server objects by name while many of them
+    are created and deleted, so that the indexes holding them grow and
+    reuse the slots of deleted entries
+    """
+
+    def check_queues(self, present, absent):
+        """
+        Check that the queues in present exist and those in absent don't
+        """
+        for q in present:
+            self.server.expect(QUEUE, {'queue_type': 'Execution'}, id=q,
+                               max_attempts=1)
+        for q in absent:
+            with self.assertRaises(PbsStatusError):
+                self.server.status(QUEUE, id=q)
+
+    def test_queue_index(self):
+        """
+        Create enough queues to grow the index several times, delete
+        every other one and recreate some, before and after a server
+        restart
+        """
+        a = {'queue_type': 'execution', 'enabled': 'True',
+             'started': 'True'}
+        names = ['idxq%d' % i for i in range(40)]
+        for q in names:
+            self.server.manager(MGR_CMD_CREATE, QUEUE, a, id=q)
+        for q in names[::2]:
+            self.server.manager(MGR_CMD_DELETE, QUEUE, id=q)
+        for q in names[:10:2]:
+            self.server.manager(MGR_CMD_CREATE, QUEUE, a, id=q)
+        present = names[1::2] + names[:10:2]
+        absent = names[10::2]
+        self.check_queues(present, absent)
+        self.server.restart()
+        self.check_queues(present, absent)
+
+    def test_job_index(self):
+        """
+        Submit enough jobs to grow the index several times, delete half
+        of them and submit more, then find every job by its id, before
+        and after a server restart
+        """
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'False'})
+        jids = []
+        for _ in range(100):
+            jids.append(self.server.submit(Job(TEST_USER)))
+        gone = jids[::2]
+        self.server.delete(gone)
+        for jid in gone:
+            self.server.expect(JOB, 'queue', id=jid, op=UNSET)
+        kept = jids[1::2]
+        for _ in range(50):
+            kept.append(self.server.submit(Job(TEST_USER)))
+        for _ in range(2):
+            for jid in kept:
+                self.server.expect(JOB, {'job_state': 'Q'}, id=jid,
+                                   max_attempts=1)
+            for jid in gone:
+                with self.assertRaises(PbsStatusError):
+                    self.server.status(JOB, id=jid)
+            self.server.restart()
+
+    def test_node_index(self):
+        """
+        Create enough vnodes to grow the index several times, delete
+        every other one, then find each remaining vnode by name
+        """
+        a = {'resources_available.ncpus': 1}
+        self.mom.create_vnodes(a, 40, usenatvnode=False)
+        vnodes = ['%s[%d]' % (self.mom.shortname, i) for i in range(40)]
+        for vn in vnodes[::2]:
+            self.server.manager(MGR_CMD_DELETE, NODE, id=vn)
+        for vn in vnodes[1::2]:
+            self.server.expect(NODE, {'resources_available.ncpus': 1},
+                               id=vn, max_attempts=1)
+        for vn in vnodes[::2]:
+            with self.assertRaises(PbsStatusError):
+                self.server.status(NODE, id=vn)
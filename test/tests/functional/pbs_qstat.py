@@ -157,3 +157,68 @@ class TestQstat(TestFunctional):
                                       % re.escape(self.mom.shortname),
                                       qstat_out), None, "The exec host does"
                             " not contain the task slot number")
+
+    def qstat_page_ids(self, *args):
+        """
+        Run qstat -f with the given options and return the job ids
+        in the order qstat listed them
+        """
+        qstat_cmd = os.path.join(self.server.pbs_conf['PBS_EXEC'],
+                                 'bin', 'qstat')
+        ret = self.du.run_cmd(self.server.hostname,
+                              cmd=[qstat_cmd, '-f'] + list(args))
+        self.assertEqual(ret['rc'], 0,
+                         'Qstat returned with non-zero exit status')
+        return [l.split(':', 1)[1].strip() for l in ret['out']
+                if l.startswith('Job Id:')]
+
+    def test_qstat_sort_limit_offset(self):
+        """
+        Test that qstat -k sorts the jobs in the server and -m and -c
+        return the requested page of the sorted jobs
+        """
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'False'})
+        jids = {}
+        for name in ['c', 'a', 'd', 'b']:
+            j = Job(TEST_USER, {ATTR_N: name})
+            jids[name] = self.server.submit(j)
+
+        ids = self.qstat_page_ids('-k', 'Job_Name')
+        self.assertEqual(ids, [jids[n] for n in 'abcd'])
+        ids = self.qstat_page_ids('-k', '-Job_Name')
+        self.assertEqual(ids, [jids[n] for n in 'dcba'])
+        ids = self.qstat_page_ids('-k', 'Job_Name', '-m', '2', '-c', '1')
+        self.assertEqual(ids, [jids[n] for n in 'bc'])
+        # without a sort key pages follow the submit order
+        ids = self.qstat_page_ids('-m', '2')
+        self.assertEqual(ids, [jids[n] for n in 'ca'])
+        ids = self.qstat_page_ids('-m', '2', '-c', '3')
+        self.assertEqual(ids, [jids['b']])
+
+    def test_qstat_limit_offset_subjobs(self):
+        """
+        Test that with qstat -t the Array job and each of its subjobs,
+        running and queued ones, count against -m and -c
+        """
+        attr = {'resources_available.ncpus': 1}
+        self.server.manager(MGR_CMD_SET, NODE, attr,
+                            id=self.mom.shortname)
+        j = Job(TEST_USER, {ATTR_J: '1-4'})
+        j.set_sleep_time(1000)
+        jid = self.server.submit(j)
+        sj1 = j.create_subjob_id(jid, 1)
+        self.server.expect(JOB, {'job_state': 'R'}, id=sj1)
+        j2 = Job(TEST_USER)
+        jid2 = self.server.submit(j2)
+        self.server.expect(JOB, {'job_state': 'Q'}, id=jid2)
+
+        sjids = [j.create_subjob_id(jid, x) for x in range(1, 5)]
+        all_ids = [jid] + sjids + [jid2]
+        self.assertEqual(self.qstat_page_ids('-t'), all_ids)
+        self.assertEqual(self.qstat_page_ids('-t', '-m', '3'), all_ids[:3])
+        self.assertEqual(self.qstat_page_ids('-t', '-m', '3', '-c', '2'),
+                         all_ids[2:5])
+        self.assertEqual(self.qstat_page_ids('-t', '-m', '3', '-c', '5'),
+                         all_ids[5:])
+        # without -t the Array job is a single entry
+        self.assertEqual(self.qstat_page_ids('-m', '2'), [jid, jid2])
@@ -0,0 +1,144 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+
+from tests.functional import *
+
+
+class TestRescListIndex(TestFunctional):
+    """
+    Test that long resource lists, which the server and mom index by
+    resource definition, stay correct when they are modified repeatedly
+    """
+    nresc = 40
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.rnames = ['tidx%d' % i for i in range(self.nresc)]
+        for r in self.rnames:
+            self.server.manager(MGR_CMD_CREATE, RSC, {'type': 'long'}, id=r)
+
+    def resc_attrs(self, base):
+        """
+        Resource_List values for every custom resource, offset by base
+        """
+        return dict(('Resource_List.%s' % r, base + i)
+                    for i, r in enumerate(self.rnames))
+
+    def test_alter_queued_job(self):
+        """
+        Alter every entry of a long Resource_List of a held job several
+        times and check the final values and that the server kept going
+        """
+        j = Job(TEST_USER, attrs=self.resc_attrs(0))
+        j.set_attributes({ATTR_h: None})
+        jid = self.server.submit(j)
+        self.server.expect(JOB, {'job_state': 'H'}, id=jid)
+        for n in range(1, 21):
+            self.server.alterjob(jid, self.resc_attrs(n * 100))
+            self.server.alterjob(jid, {'Resource_List.%s' % self.rnames[-1]:
+                                       n})
+        exp = self.resc_attrs(2000)
+        exp['Resource_List.%s' % self.rnames[-1]] = 20
+        self.server.expect(JOB, exp, id=jid)
+        self.assertTrue(self.server.isUp())
+
+    def test_alter_running_job(self):
+        """
+        Alter a long Resource_List of a running job, which also goes
+        through the modify request on the mom, and check both survive
+        and the job keeps the new values
+        """
+        j = Job(TEST_USER, attrs=self.resc_attrs(0))
+        j.set_sleep_time(1000)
+        jid = self.server.submit(j)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        for n in range(1, 11):
+            a = self.resc_attrs(n * 100)
+            a['Resource_List.walltime'] = 1000 + n
+            self.server.alterjob(jid, a)
+        exp = self.resc_attrs(1000)
+        exp['Resource_List.walltime'] = '00:16:50'
+        self.server.expect(JOB, exp, id=jid)
+        self.assertTrue(self.server.isUp())
+        self.assertTrue(self.mom.isUp())
+
+    def test_alter_reservation(self):
+        """
+        Modify a reservation whose Resource_List is long and check
+        the values after the modify
+        """
+        a = self.resc_attrs(0)
+        a['reserve_start'] = int(time.time()) + 3600
+        a['reserve_end'] = int(time.time()) + 7200
+        r = Reservation(TEST_USER, attrs=a)
+        rid = self.server.submit(r)
+        self.server.expect(RESV, {'reserve_state':
+                                  (MATCH_RE, 'RESV_CONFIRMED|2')}, id=rid)
+        for n in range(1, 6):
+            self.server.alterresv(rid, {'reserve_end':
+                                        int(time.time()) + 7200 + n * 60})
+        exp = dict(('Resource_List.%s' % r, i)
+                   for i, r in enumerate(self.rnames))
+        self.server.expect(RESV, exp, id=rid)
+        self.assertTrue(self.server.isUp())
+
+    def test_unset_node_resources(self):
+        """
+        Unset entries from the middle of a long resources_available of
+        a node, then look up the others and set the entries again
+        """
+        vn = self.mom.shortname
+        a = dict(('resources_available.%s' % r, i)
+                 for i, r in enumerate(self.rnames))
+        self.server.manager(MGR_CMD_SET, NODE, a, id=vn)
+        self.server.expect(NODE, a, id=vn)
+        gone = self.rnames[5:self.nresc - 5:3]
+        for r in gone:
+            self.server.manager(MGR_CMD_UNSET, NODE,
+                                'resources_available.%s' % r, id=vn)
+            left = dict((k, v) for k, v in a.items()
+                        if k.split('.')[1] not in gone[:gone.index(r) + 1])
+            self.server.expect(NODE, left, id=vn)
+        for r in gone:
+            self.server.expect(NODE, 'resources_available.%s' % r,
+                               op=UNSET, id=vn)
+        self.server.manager(MGR_CMD_SET, NODE, a, id=vn)
+        self.server.expect(NODE, a, id=vn)
+        self.assertTrue(self.server.isUp())
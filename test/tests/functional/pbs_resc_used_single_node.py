@@ -38,6 +38,7 @@
 # subject to Altair's trademark licensing policies.
 
 
+import json
 import time
 from tests.functional import *
 
@@ -231,3 +232,32 @@ e.job.resources_used["stra"] = '"glad,elated","happy"'
         s = self.server.accounting_match(
             "E;%s;.*%s.*" % (jid, acctlog_match), regexp=True, n=100)
         self.assertTrue(s)
+
+    def test_epilogue_json_layout(self):
+        """
+        Test that a JSON resources_used value set by a hook comes back
+        laid out exactly as Python's json.dumps() would lay it out,
+        for floats, integers too large for a double and non ASCII text.
+        """
+        raw = '{"a": -0, "b": 1.50, "c": 1E2, "d": 2.0, "e": 0.1, ' \
+              '"f": 1e-07, "g": 1e16, "h": 1e15, "i": 123.456e-10, ' \
+              '"j": 12345678901234567890, "k": -98765432109876543210, ' \
+              '"l": 2, "m": [0.5, 3, -1e300], "n": "tab\\there", ' \
+              '"o": "\\u00e9t\\u00e9", "p": "%s"}' % '\u2603 \U0001f600'
+        hook_body = "import pbs\n"
+        hook_body += "e = pbs.event()\n"
+        hook_body += "e.job.resources_used['foo_str3'] = %s\n" % ascii(raw)
+        a = {'event': "execjob_epilogue", 'enabled': 'True', 'order': '1000'}
+        rv = self.server.create_import_hook("epi", a, hook_body,
+                                            overwrite=True)
+        self.assertTrue(rv)
+
+        j = Job(TEST_USER)
+        j.set_attributes({'Resource_List.select': '1:ncpus=1'})
+        j.set_sleep_time("1")
+        jid = self.server.submit(j)
+
+        exp = "'%s'" % json.dumps(json.loads(raw))
+        self.server.expect(JOB, {'job_state': 'F',
+                                 'resources_used.foo_str3': exp},
+                           extend='x', offset=1, attrop=PTL_AND, id=jid)
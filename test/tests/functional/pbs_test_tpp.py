@@ -1099,11 +1099,242 @@ class TestTPP(TestFunctional):
         self.comm4.start()
         self.server.expect(JOB, 'queue', id=jid, op=UNSET, offset=30)
 
+    @requirements(num_moms=2, num_comms=2)
+    def test_leaf_router_hash(self):
+        """
+        This test verifies communication between server-mom and
+        between moms when the leaves order their pbs_comms by
+        consistent hash, and that they fail over to the other pbs_comm
+        Configuration:
+        Node 1 : Server, Sched, Mom, Comm (self.hostA)
+        Node 2 : Mom (self.hostB)
+        Node 3 : Comm (self.hostC)
+        """
+        self.common_setup()
+        a = {'PBS_COMM_ROUTERS': self.hostA}
+        self.set_pbs_conf(host_name=self.hostC, conf_param=a)
+        leaf_val = self.hostA + "," + self.hostC
+        b = {'PBS_LEAF_ROUTERS': leaf_val, 'PBS_LEAF_ROUTER_HASH': '1'}
+        self.set_pbs_conf(host_name=self.hostA, conf_param=b)
+        self.set_pbs_conf(host_name=self.hostB, conf_param=b)
+        self.common_steps_for_comm_failover()
+
+    @requirements(num_moms=2, num_comms=3)
+    def test_comm_multipath(self):
+        """
+        This test verifies that with PBS_COMM_MULTIPATH the pbs_comm of
+        the server spreads streams to the moms over both pbs_comms they
+        are connected to, and keeps them flowing when one of the two
+        pbs_comms goes away
+        Configuration:
+        Node 1 : Server, Sched, Comm (self.hostA)
+        Node 2 : Mom (self.hostB)
+        Node 3 : Mom (self.hostC)
+        Node 4 : Comm (self.hostD)
+        Node 5 : Comm (self.hostE)
+        """
+        self.common_setup(req_moms=2, req_comms=3, no_mom_on_comm=True)
+        a = {'PBS_COMM_ROUTERS': self.hostA}
+        self.set_pbs_conf(host_name=self.hostD, conf_param=a)
+        a = {'PBS_COMM_ROUTERS': self.hostA + "," + self.hostD}
+        self.set_pbs_conf(host_name=self.hostE, conf_param=a)
+        b = {'PBS_LEAF_ROUTERS': self.hostD + "," + self.hostE}
+        self.set_pbs_conf(host_name=self.hostB, conf_param=b)
+        self.set_pbs_conf(host_name=self.hostC, conf_param=b)
+        a = {'PBS_LEAF_ROUTERS': self.hostA, 'PBS_COMM_MULTIPATH': '1'}
+        self.set_pbs_conf(host_name=self.hostA, conf_param=a)
+        for mom in self.moms.values():
+            self.server.expect(NODE, {'state': 'free'}, id=mom.shortname)
+        self.common_steps(job=True, interactive=True)
+        commD = [c for c in self.comms.values()
+                 if c.shortname == self.hostD][0]
+        commD.stop('-KILL')
+        for mom in self.moms.values():
+            self.server.expect(NODE, {'state': 'free'}, id=mom.shortname)
+        self.common_steps(job=True, interactive=True)
+        commD.start()
+
+    @requirements(num_moms=2, num_comms=2)
+    def test_scatter_multiple_comm(self):
+        """
+        This test verifies that with PBS_MCAST_SCATTER the server's
+        reply to the moms' hello is split by the pbs_comms, both for a
+        mom attached to the server's pbs_comm and for a mom behind the
+        other pbs_comm, and that every mom gets its own reply
+        Configuration:
+        Node 1 : Server, Sched, Mom, Comm (self.hostA)
+        Node 2 : Mom (self.hostB)
+        Node 3 : Comm (self.hostC)
+        """
+        self.common_setup()
+        a = {'PBS_COMM_ROUTERS': self.hostA, 'PBS_MCAST_SCATTER': '1'}
+        self.set_pbs_conf(host_name=self.hostC, conf_param=a)
+        b = {'PBS_LEAF_ROUTERS': self.hostC, 'PBS_MCAST_SCATTER': '1'}
+        self.set_pbs_conf(host_name=self.hostB, conf_param=b)
+        # moms sharing a vnode pool get different replies to their hello
+        self.server.manager(MGR_CMD_DELETE, NODE, None, "")
+        attr = {'vnode_pool': '1'}
+        for mom in self.moms.values():
+            self.server.manager(MGR_CMD_CREATE, NODE, id=mom.shortname,
+                                attrib=attr)
+        start = time.time()
+        a = {'PBS_MCAST_SCATTER': '1'}
+        self.set_pbs_conf(host_name=self.hostA, conf_param=a)
+        for mom in self.moms.values():
+            self.server.expect(NODE, {'state': 'free'}, id=mom.shortname)
+        commA = [c for c in self.comms.values()
+                 if c.shortname == self.hostA][0]
+        commC = [c for c in self.comms.values()
+                 if c.shortname == self.hostC][0]
+        msg = "SCATTER packet from"
+        commA.log_match(msg, starttime=start)
+        commC.log_match(msg, starttime=start)
+        commA.log_match("Sending SCATTER packet to", starttime=start)
+        msg = "Failed to build (SCATTER|scatter)"
+        for comm in (commA, commC):
+            comm.log_match(msg, regexp=True, starttime=start,
+                           existence=False, max_attempts=1)
+        msg = "Hello (no inventory required) from server"
+        found = 0
+        for mom in self.moms.values():
+            try:
+                mom.log_match(msg, starttime=start, max_attempts=5)
+                found += 1
+            except PtlLogMatchError:
+                pass
+        self.assertEqual(found, 1, "Expected one non-inventory mom")
+        self.common_steps(job=True, interactive=True)
+
+    def run_compressed_job(self, codecs):
+        """
+        Run a two node job with a job script large enough to be
+        compressed on its way between server and moms, and check that
+        every daemon decoded what its peers sent
+        :param codecs: Codec configured on each host, None for the default
+        :type codecs: Dictionary
+        """
+        start = time.time()
+        for host, codec in codecs.items():
+            if codec is None:
+                continue
+            # a codec this build lacks falls back to zlib
+            msg = "TPP compression codec = (%s|zlib)" % codec
+            if host == self.server.shortname:
+                self.server.log_match(msg, regexp=True)
+            mom = [m for m in self.moms.values() if m.shortname == host]
+            if mom:
+                mom[0].log_match(msg, regexp=True)
+        set_attr = {ATTR_l + '.select': '2:ncpus=1',
+                    ATTR_l + '.place': 'scatter', ATTR_k: 'oe'}
+        j = Job(TEST_USER, set_attr)
+        pbsdsh_path = os.path.join(self.server.pbs_conf['PBS_EXEC'],
+                                   "bin", "pbsdsh")
+        filler = "\n".join(["# line %d of a large job script" % i
+                            for i in range(4000)])
+        script = "#!/bin/sh\n%s\n%s hostname\n" % (filler, pbsdsh_path)
+        j.create_script(script, hostname=self.server.client)
+        jid = self.server.submit(j)
+        self.server.expect(JOB, 'queue', id=jid, op=UNSET, offset=1)
+        self.server.log_match("%s;Exit_status=0" % jid)
+        msg = "[Dd]ecompression.*failed|Received data compressed with" \
+            "|Received zstd data made with"
+        self.server.log_match(msg, regexp=True, starttime=start,
+                              existence=False, max_attempts=1)
+        for mom in self.moms.values():
+            mom.log_match(msg, regexp=True, starttime=start,
+                          existence=False, max_attempts=1)
+
+    @requirements(num_moms=2, num_comms=2)
+    def test_compression_mixed_codecs(self):
+        """
+        This test verifies that server and moms configured with
+        different compression codecs understand each other, also
+        through a pbs_comm, which forwards the payload as is
+        Configuration:
+        Node 1 : Server, Sched, Mom, Comm (self.hostA), lz4
+        Node 2 : Mom (self.hostB), zstd
+        Node 3 : Comm (self.hostC)
+        """
+        self.common_setup()
+        a = {'PBS_COMM_ROUTERS': self.hostA}
+        self.set_pbs_conf(host_name=self.hostC, conf_param=a)
+        a = {'PBS_COMPRESSION_CODEC': 'lz4'}
+        self.set_pbs_conf(host_name=self.hostA, conf_param=a)
+        b = {'PBS_LEAF_ROUTERS': self.hostC, 'PBS_COMPRESSION_CODEC': 'zstd'}
+        self.set_pbs_conf(host_name=self.hostB, conf_param=b)
+        for mom in self.moms.values():
+            self.server.expect(NODE, {'state': 'free'}, id=mom.shortname)
+        self.run_compressed_job({self.hostA: 'lz4', self.hostB: 'zstd'})
+
+    @requirements(num_moms=2, num_comms=2)
+    def test_compression_with_zlib_peer(self):
+        """
+        This test verifies that a node using a fast codec still works
+        with a peer left at the default zlib, as a node without the
+        codec setting (or an older one) is
+        Configuration:
+        Node 1 : Server, Sched, Mom, Comm (self.hostA), zstd
+        Node 2 : Mom (self.hostB), default codec
+        Node 3 : Comm (self.hostC)
+        """
+        self.common_setup()
+        a = {'PBS_COMPRESSION_CODEC': 'zstd'}
+        self.set_pbs_conf(host_name=self.hostA, conf_param=a)
+        for mom in self.moms.values():
+            self.server.expect(NODE, {'state': 'free'}, id=mom.shortname)
+        start = time.time()
+        self.run_compressed_job({self.hostA: 'zstd', self.hostB: None})
+        # hostB never sends zstd, so everything sent to it stays zlib
+        mom = [m for m in self.moms.values() if m.shortname == self.hostB]
+        mom[0].log_match("sends zstd data", starttime=start,
+                         existence=False, max_attempts=1)
+        msg = "TPP compression codec = zstd, zlib to peers not known"
+        self.server.log_match(msg)
+
+    @requirements(num_moms=2, num_comms=2)
+    def test_compression_dict_mismatch(self):
+        """
+        This test verifies that nodes using zstd with different
+        compression dictionaries fall back to zlib with each other
+        instead of sending data the peer cannot decode
+        Configuration:
+        Node 1 : Server, Sched, Mom, Comm (self.hostA), zstd + dict
+        Node 2 : Mom (self.hostB), zstd without a dictionary
+        Node 3 : Comm (self.hostC)
+        """
+        self.common_setup()
+        if not os.path.isabs(self.du.which(self.hostA, 'zstd')):
+            self.skipTest("zstd command is needed to train a dictionary")
+        dict_path = os.path.join(self.server.pbs_conf['PBS_HOME'],
+                                 'tpp_test.dict')
+        cmd = "d=`mktemp -d`; for i in `seq 200`; do " \
+              "seq $i 7 $((i * 50)) > $d/$i; done; " \
+              "zstd -q -f --train $d/* -o %s; rm -rf $d" % dict_path
+        rc = self.du.run_cmd(self.hostA, cmd=cmd, as_script=True,
+                             sudo=True)
+        if rc['rc'] != 0:
+            self.skipTest("Could not train a zstd dictionary")
+        a = {'PBS_COMPRESSION_CODEC': 'zstd',
+             'PBS_COMPRESSION_DICT': dict_path}
+        self.set_pbs_conf(host_name=self.hostA, conf_param=a)
+        a = {'PBS_COMPRESSION_CODEC': 'zstd'}
+        self.set_pbs_conf(host_name=self.hostB, conf_param=a)
+        self.server.log_match("Loaded compression dictionary %s" %
+                              dict_path)
+        for mom in self.moms.values():
+            self.server.expect(NODE, {'state': 'free'}, id=mom.shortname)
+        self.run_compressed_job({self.hostA: 'zstd', self.hostB: 'zstd'})
+        self.unset_pbs_conf(self.hostA, ['PBS_COMPRESSION_DICT'])
+        self.du.rm(self.hostA, dict_path, sudo=True, force=True)
+
     def tearDown(self):
         os.environ['PBS_CONF_FILE'] = self.pbs_conf_path
         self.logger.info("Successfully exported PBS_CONF_FILE variable")
         conf_param = ['PBS_LEAF_ROUTERS', 'PBS_COMM_ROUTERS',
-                      'PBS_COMM_THREADS', 'PBS_COMM_LOG_EVENTS']
+                      'PBS_COMM_THREADS', 'PBS_COMM_LOG_EVENTS',
+                      'PBS_LEAF_ROUTER_HASH', 'PBS_COMM_MULTIPATH',
+                      'PBS_COMPRESSION_CODEC', 'PBS_COMPRESSION_DICT',
+                      'PBS_MCAST_SCATTER']
         for host in self.node_list:
             self.unset_pbs_conf(host, conf_param)
         self.node_list.clear()
@@ -0,0 +1,324 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+
+import socket
+
+from tests.interfaces import *
+
+# Prototypes of the libpbs internals used below, none of them are in the
+# installed headers.  Sizes match Linux x86_64 where int and long differ,
+# dis_long_double_t is a plain double as configure does not size it.
+dis_decls = '''
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+struct batch_reply {
+    int brp_code;
+    int brp_auxcode;
+    int brp_choice;
+};
+
+extern void DIS_tcp_funcs(void);
+extern void dis_init_tables(void);
+extern void dis_set_encoding(int, int);
+extern int dis_flush(int);
+extern int diswsi(int, int);
+extern int diswsl(int, long);
+extern int diswul(int, unsigned long);
+extern int diswui(int, unsigned);
+extern int diswcs(int, const char *, size_t);
+extern int diswl_(int, double, unsigned);
+extern int diswf(int, double);
+extern int disrsi(int, int *);
+extern long disrsl(int, int *);
+extern unsigned long disrul(int, int *);
+extern double disrd(int, int *);
+extern float disrf(int, int *);
+extern char *disrst(int, int *);
+extern int encode_DIS_ReqHdr(int, int, const char *);
+extern int encode_DIS_ReqExtend(int, const char *);
+extern int encode_DIS_Status(int, const char *, void *);
+extern struct batch_reply *PBSD_rdrpy_sock(int, int *, int);
+extern void PBSD_FreeReply(struct batch_reply *);
+'''
+
+codec_code = dis_decls + '''
+static int ivals[] = {0, 1, -1, 63, 64, -64, -65, 8191, -8192,
+                      INT_MAX, INT_MIN, INT_MAX - 1, INT_MIN + 1};
+static long lvals[] = {0, -1, LONG_MAX, LONG_MIN};
+static unsigned long uvals[] = {0, 1, 127, 128, UINT_MAX, ULONG_MAX};
+static double dvals[] = {0.0, -0.0, 1.0, -1.5, 0.1, -3.14159265358979,
+                         1e300, -2.5e-300, 123456789012345.0};
+static float fvals[] = {0.0f, -0.0f, 1.0f, -7.25f, 3.4e38f, 1.17e-38f};
+
+#define NELEM(a) (sizeof(a) / sizeof(a[0]))
+
+static int
+close_enough(double got, double want, double eps)
+{
+    if (got == want)
+        return 1;
+    if (want == 0.0)
+        return 0;
+    got = (got - want) / want;
+    return (got < 0 ? -got : got) < eps;
+}
+
+int main(void)
+{
+    int sv[2];
+    int enc;
+    int rc;
+    int bad = 0;
+    size_t i;
+
+    dis_init_tables();
+    DIS_tcp_funcs();
+    for (enc = 0; enc < 2; enc++) {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+            return 2;
+        dis_set_encoding(sv[0], enc);
+        dis_set_encoding(sv[1], enc);
+        for (i = 0; i < NELEM(ivals); i++)
+            diswsi(sv[0], ivals[i]);
+        for (i = 0; i < NELEM(lvals); i++)
+            diswsl(sv[0], lvals[i]);
+        for (i = 0; i < NELEM(uvals); i++)
+            diswul(sv[0], uvals[i]);
+        for (i = 0; i < NELEM(dvals); i++)
+            diswl_(sv[0], dvals[i], 15);
+        for (i = 0; i < NELEM(fvals); i++)
+            diswf(sv[0], fvals[i]);
+        diswcs(sv[0], "end", 3);
+        if (dis_flush(sv[0]) != 0)
+            return 2;
+        for (i = 0; i < NELEM(ivals); i++) {
+            int v = disrsi(sv[1], &rc);
+            if (rc != 0 || v != ivals[i]) {
+                printf("enc %d int %d got %d rc %d\\n", enc, ivals[i], v, rc);
+                bad++;
+            }
+        }
+        for (i = 0; i < NELEM(lvals); i++) {
+            long v = disrsl(sv[1], &rc);
+            if (rc != 0 || v != lvals[i]) {
+                printf("enc %d long %ld got %ld rc %d\\n", enc, lvals[i], v, rc);
+                bad++;
+            }
+        }
+        for (i = 0; i < NELEM(uvals); i++) {
+            unsigned long v = disrul(sv[1], &rc);
+            if (rc != 0 || v != uvals[i]) {
+                printf("enc %d ulong %lu got %lu rc %d\\n", enc, uvals[i], v, rc);
+                bad++;
+            }
+        }
+        for (i = 0; i < NELEM(dvals); i++) {
+            double v = disrd(sv[1], &rc);
+            if (rc != 0 || !close_enough(v, dvals[i], 1e-14)) {
+                printf("enc %d double %.17g got %.17g rc %d\\n", enc, dvals[i], v, rc);
+                bad++;
+            }
+        }
+        for (i = 0; i < NELEM(fvals); i++) {
+            float v = disrf(sv[1], &rc);
+            if (rc != 0 || !close_enough(v, fvals[i], 1e-6)) {
+                printf("enc %d float %g got %g rc %d\\n", enc, fvals[i], v, rc);
+                bad++;
+            }
+        }
+        {
+            char *s = disrst(sv[1], &rc);
+            if (rc != 0 || s == NULL || strcmp(s, "end") != 0) {
+                printf("enc %d lost sync rc %d\\n", enc, rc);
+                bad++;
+            }
+            free(s);
+        }
+        close(sv[0]);
+        close(sv[1]);
+    }
+    if (bad == 0)
+        printf("OK\\n");
+    return bad != 0;
+}
+'''
+
+# Authenticates over resvport the way a client of either version would,
+# offering binary integers only when asked to, then stats the server.
+peer_code = dis_decls + '''
+int main(int argc, char **argv)
+{
+    struct sockaddr_in sa;
+    struct sockaddr_in me;
+    socklen_t len = sizeof(me);
+    struct batch_reply *reply;
+    int sock;
+    int rc;
+    int port;
+    int offer;
+    int auxcode;
+
+    if (argc != 4)
+        return 2;
+    offer = atoi(argv[3]);
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(atoi(argv[2]));
+    if (inet_pton(AF_INET, argv[1], &sa.sin_addr) != 1)
+        return 2;
+    if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+        return 2;
+    if (bindresvport(sock, NULL) != 0)
+        return 3;
+    if (connect(sock, (struct sockaddr *) &sa, sizeof(sa)) != 0)
+        return 2;
+    getsockname(sock, (struct sockaddr *) &me, &len);
+    port = ntohs(me.sin_port);
+
+    DIS_tcp_funcs();
+    if (encode_DIS_ReqHdr(sock, 95, "root") ||
+        diswui(sock, 8) || diswcs(sock, "resvport", 8) ||
+        diswui(sock, 0) || diswui(sock, port) ||
+        encode_DIS_ReqExtend(sock, offer ? "dis_binary" : NULL) ||
+        dis_flush(sock))
+        return 4;
+    if ((reply = PBSD_rdrpy_sock(sock, &rc, 0)) == NULL || reply->brp_code != 0)
+        return 5;
+    auxcode = reply->brp_auxcode;
+    PBSD_FreeReply(reply);
+    printf("auxcode=%d\\n", auxcode);
+    if (auxcode == 1)
+        dis_set_encoding(sock, 1);
+
+    if (encode_DIS_ReqHdr(sock, 21, "root") ||
+        encode_DIS_Status(sock, "", NULL) ||
+        encode_DIS_ReqExtend(sock, NULL) ||
+        dis_flush(sock))
+        return 6;
+    if ((reply = PBSD_rdrpy_sock(sock, &rc, 0)) == NULL)
+        return 7;
+    printf("code=%d choice=%d\\n", reply->brp_code, reply->brp_choice);
+    PBSD_FreeReply(reply);
+    close(sock);
+    return 0;
+}
+'''
+
+
+class TestDisBinary(TestInterfaces):
+    """
+    Test suite for the binary integer encoding negotiated on DIS over TCP
+    """
+
+    def build(self, code):
+        """
+        Compile code against the installed libpbs, return the executable
+        """
+        if self.du.get_platform().lower() != 'linux':
+            self.skipTest("This test is only supported on Linux!")
+        _gcc = self.du.which(exe='gcc')
+        if _gcc == 'gcc':
+            self.skipTest("Couldn't find gcc!")
+        _ld = os.path.join(self.server.pbs_conf['PBS_EXEC'], 'lib')
+        self.assertTrue(self.du.isfile(path=os.path.join(_ld, 'libpbs.so')))
+        _fn = self.du.create_temp_file(body=code, suffix='.c')
+        _en = self.du.create_temp_file()
+        self.du.rm(path=_en)
+        cmd = ['gcc', '-g', '-O2', '-o', _en, _fn]
+        cmd += ['-L%s' % _ld, '-lpbs', '-lz', '-lcrypto']
+        _res = self.du.run_cmd(cmd=cmd)
+        self.assertEqual(_res['rc'], 0, "\n".join(_res['err']))
+        return 'LD_LIBRARY_PATH=%s %s' % (_ld, _en)
+
+    def test_varint_round_trip(self):
+        """
+        Write integers at the range limits, zero and negative floats in
+        both encodings and check they read back unchanged and in sync
+        """
+        _en = self.build(codec_code)
+        _res = self.du.run_cmd(cmd=[_en], as_script=True)
+        self.assertEqual(_res['rc'], 0, "\n".join(_res['out']))
+        self.assertEqual(_res['out'], ['OK'])
+
+    def peer(self, offer):
+        """
+        Run the resvport peer against the server, offering binary
+        integers or not, return its output
+        """
+        _en = self.build(peer_code)
+        _addr = socket.gethostbyname(self.server.hostname)
+        _port = self.server.pbs_conf.get('PBS_BATCH_SERVICE_PORT', '15001')
+        cmd = ['%s %s %s %d' % (_en, _addr, _port, offer)]
+        _res = self.du.run_cmd(self.server.hostname, cmd=cmd,
+                               as_script=True, sudo=True)
+        self.assertEqual(_res['rc'], 0, "\n".join(_res['err']))
+        return _res['out']
+
+    def test_old_client(self):
+        """
+        A client that does not offer binary integers stays on text
+        and still gets its status
+        """
+        self.assertEqual(self.peer(0), ['auxcode=0', 'code=0 choice=6'])
+
+    def test_new_client(self):
+        """
+        A client that offers binary integers gets it acknowledged and
+        the rest of the conversation decodes
+        """
+        self.assertEqual(self.peer(1), ['auxcode=1', 'code=0 choice=6'])
+
+    def test_mixed_clients(self):
+        """
+        Old and new clients are served side by side, each in its own
+        encoding, and ordinary commands keep working
+        """
+        for offer in (0, 1, 0, 1):
+            _exp = ['auxcode=%d' % offer, 'code=0 choice=6']
+            self.assertEqual(self.peer(offer), _exp)
+        _s = self.server.status(SERVER)[0]
+        self.assertIn(ATTR_SvrHost, _s)